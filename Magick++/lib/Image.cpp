@@ -3485,6 +3485,18 @@ std::string Magick::Image::signature ( const bool force_ ) const
     return std::string();
 }
 
+void Magick::Image::shrinkOnLoad ( const Geometry &geometry_ )
+{
+  if ( geometry_.isValid() )
+    defineValue( "jpeg", "shrink-on-load", geometry_ );
+  else
+    defineSet( "jpeg", "shrink-on-load", false );
+}
+Magick::Geometry Magick::Image::shrinkOnLoad ( void ) const
+{
+  return Magick::Geometry( defineValue( "jpeg", "shrink-on-load" ) );
+}
+
 void Magick::Image::size ( const Geometry &geometry_ )
 {
   modifyImage();
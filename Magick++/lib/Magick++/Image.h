@@ -1167,6 +1167,13 @@ namespace Magick
     // modified.
     std::string     signature ( const bool force_ = false ) const;
 
+    // Size the image is going to be resized to after it is read.
+    // Decoders which support it (e.g. JPEG) may then return a
+    // reduced size image (at least twice this size) without decoding
+    // the full resolution image.  Must be set before read().
+    void            shrinkOnLoad ( const Geometry &geometry_ );
+    Geometry        shrinkOnLoad ( void ) const;
+
     // Width and height of a raw image
     void            size ( const Geometry &geometry_ );
     Geometry        size ( void ) const;
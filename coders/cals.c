@@ -40,17 +40,72 @@
 #include "magick/log.h"
 #include "magick/magick.h"
 #include "magick/monitor.h"
-#include "magick/tempfile.h"
 #include "magick/utility.h"
 /*
-   Write an unsigned long to file with Intel/LSB ordering
+  TIFF wrapper which is assembled in memory and then decoded from a
+  memory blob.
 */
-static void CALS_WriteIntelULong(FILE *file,unsigned long ul)
+typedef struct _CALSWrapper
 {
-  fputc((unsigned char)ul,file);
-  fputc((unsigned char)(ul >> 8),file);
-  fputc((unsigned char)(ul >> 16),file);
-  fputc((unsigned char)(ul >> 24),file);
+  unsigned char
+    *data;
+
+  size_t
+    length,
+    extent;
+
+  MagickPassFail
+    status;
+} CALSWrapper;
+
+static MagickPassFail CALS_Reserve(CALSWrapper *wrapper,const size_t length)
+{
+  if ((wrapper->status != MagickFail) &&
+      (wrapper->length+length > wrapper->extent))
+    {
+      unsigned char
+        *new_data;
+
+      size_t
+        new_extent;
+
+      new_extent=Max(2*wrapper->extent,wrapper->length+length);
+      new_data=MagickReallocateResourceLimitedMemory(unsigned char *,
+                                                     wrapper->data,new_extent);
+      if (new_data == (unsigned char *) NULL)
+        wrapper->status=MagickFail;
+      else
+        {
+          wrapper->data=new_data;
+          wrapper->extent=new_extent;
+        }
+    }
+  return wrapper->status;
+}
+
+static void CALS_Write(CALSWrapper *wrapper,const void *data,const size_t length)
+{
+  if (CALS_Reserve(wrapper,length) == MagickFail)
+    return;
+  (void) memcpy(wrapper->data+wrapper->length,data,length);
+  wrapper->length+=length;
+}
+
+static void CALS_EncodeIntelULong(unsigned char *p,unsigned long ul)
+{
+  p[0]=(unsigned char) ul;
+  p[1]=(unsigned char) (ul >> 8);
+  p[2]=(unsigned char) (ul >> 16);
+  p[3]=(unsigned char) (ul >> 24);
+}
+
+static void CALS_WriteIntelULong(CALSWrapper *wrapper,unsigned long ul)
+{
+  unsigned char
+    buffer[4];
+
+  CALS_EncodeIntelULong(buffer,ul);
+  CALS_Write(wrapper,buffer,4);
 }
 
 /*
@@ -145,11 +200,8 @@ static Image *ReadCALSImage(const ImageInfo *image_info,ExceptionInfo *exception
     orient,
     density;
 
-  char
-    filename[MaxTextExtent];
-
-  FILE
-    *file;
+  CALSWrapper
+    wrapper;
 
   TimerInfo
     timer;
@@ -159,15 +211,12 @@ static Image *ReadCALSImage(const ImageInfo *image_info,ExceptionInfo *exception
     strip_off_pos,
     flen;
 
-  int
-    c;
+  size_t
+    count;
 
   ImageInfo
     *clone_info;
 
-  MagickPassFail
-    file_write_status;
-
   /*
     Open image file.
   */
@@ -257,90 +306,93 @@ static Image *ReadCALSImage(const ImageInfo *image_info,ExceptionInfo *exception
   (void) LogMagickEvent(CoderEvent,GetMagickModule(),
                         "Dimensions %lux%lu",width,height);
 
-  /* Create TIFF wrapper to handle file data using TIFF library */
-  file=AcquireTemporaryFileStream(filename,BinaryFileIOMode);
-  if (file == (FILE *) NULL)
-    ThrowReaderTemporaryFileException(filename);
-  file_write_status=MagickFail;
+  /*
+    Create TIFF wrapper to handle file data using TIFF library.  The
+    wrapper is assembled in memory so no temporary file is needed.
+  */
+  wrapper.length=0;
+  wrapper.extent=(size_t) Max(GetBlobSize(image)-TellBlob(image),0)+256;
+  wrapper.status=MagickPass;
+  wrapper.data=MagickAllocateResourceLimitedMemory(unsigned char *,
+                                                   wrapper.extent);
+  if (wrapper.data == (unsigned char *) NULL)
+    ThrowReaderException(ResourceLimitError,MemoryAllocationFailed,image);
   do
     {
       /* Intel TIFF with IFD at offset 8 - IFD has 14 records */
-      fwrite("\111\111\052\000\010\000\000\000\016\000",1,10,file);
+      CALS_Write(&wrapper,"\111\111\052\000\010\000\000\000\016\000",10);
       /* New sub image - normal type */
-      fwrite("\376\000\003\000\001\000\000\000\000\000\000\000",1,12,file);
+      CALS_Write(&wrapper,"\376\000\003\000\001\000\000\000\000\000\000\000",12);
       /* Image width */
-      fwrite("\000\001\004\000\001\000\000\000",1,8,file);
-      CALS_WriteIntelULong(file,width);
+      CALS_Write(&wrapper,"\000\001\004\000\001\000\000\000",8);
+      CALS_WriteIntelULong(&wrapper,width);
       /* Image height */
-      fwrite("\001\001\004\000\001\000\000\000",1,8,file);
-      CALS_WriteIntelULong(file,height);
+      CALS_Write(&wrapper,"\001\001\004\000\001\000\000\000",8);
+      CALS_WriteIntelULong(&wrapper,height);
       /* 1 bit per sample */
-      fwrite("\002\001\003\000\001\000\000\000\001\000\000\000",1,12,file);
+      CALS_Write(&wrapper,"\002\001\003\000\001\000\000\000\001\000\000\000",12);
       /* CCITT Group 4 compression */
-      fwrite("\003\001\003\000\001\000\000\000\004\000\000\000",1,12,file);
+      CALS_Write(&wrapper,"\003\001\003\000\001\000\000\000\004\000\000\000",12);
       /* Photometric interpretation MAX BLACK */
-      fwrite("\006\001\003\000\001\000\000\000\000\000\000\000",1,12,file);
+      CALS_Write(&wrapper,"\006\001\003\000\001\000\000\000\000\000\000\000",12);
       /* Strip offset */
-      fwrite("\021\001\003\000\001\000\000\000",1,8,file);
+      CALS_Write(&wrapper,"\021\001\003\000\001\000\000\000",8);
       strip_off_pos = 10 + (12 * 14) + 4 + 8;
-      CALS_WriteIntelULong(file,strip_off_pos);
+      CALS_WriteIntelULong(&wrapper,strip_off_pos);
       /* Orientation */
-      fwrite("\022\001\003\000\001\000\000\000",1,8,file);
-      CALS_WriteIntelULong(file,orient);
+      CALS_Write(&wrapper,"\022\001\003\000\001\000\000\000",8);
+      CALS_WriteIntelULong(&wrapper,orient);
       /* 1 sample per pixel */
-      fwrite("\025\001\003\000\001\000\000\000\001\000\000\000",1,12,file);
+      CALS_Write(&wrapper,"\025\001\003\000\001\000\000\000\001\000\000\000",12);
       /* Rows per strip (same as height) */
-      fwrite("\026\001\004\000\001\000\000\000",1,8,file);
-      CALS_WriteIntelULong(file,height);
+      CALS_Write(&wrapper,"\026\001\004\000\001\000\000\000",8);
+      CALS_WriteIntelULong(&wrapper,height);
       /* Strip byte count */
-      fwrite("\027\001\004\000\001\000\000\000\000\000\000\000",1,12,file);
-      byte_count_pos = ftell(file)-4;
+      CALS_Write(&wrapper,"\027\001\004\000\001\000\000\000\000\000\000\000",12);
+      byte_count_pos = (unsigned long) wrapper.length-4;
       /* X resolution */
-      fwrite("\032\001\005\000\001\000\000\000",1,8,file);
-      CALS_WriteIntelULong(file,strip_off_pos-8);
+      CALS_Write(&wrapper,"\032\001\005\000\001\000\000\000",8);
+      CALS_WriteIntelULong(&wrapper,strip_off_pos-8);
       /* Y resolution */
-      fwrite("\033\001\005\000\001\000\000\000",1,8,file);
-      CALS_WriteIntelULong(file,strip_off_pos-8);
+      CALS_Write(&wrapper,"\033\001\005\000\001\000\000\000",8);
+      CALS_WriteIntelULong(&wrapper,strip_off_pos-8);
       /* Resolution unit is inch */
-      fwrite("\050\001\003\000\001\000\000\000\002\000\000\000",1,12,file);
+      CALS_Write(&wrapper,"\050\001\003\000\001\000\000\000\002\000\000\000",12);
       /* Offset to next IFD ie end of images */
-      fwrite("\000\000\000\000",1,4,file);
+      CALS_Write(&wrapper,"\000\000\000\000",4);
       /* Write X/Y resolution as rational data */
-      CALS_WriteIntelULong(file,density);
-      CALS_WriteIntelULong(file,1);
+      CALS_WriteIntelULong(&wrapper,density);
+      CALS_WriteIntelULong(&wrapper,1);
 
       /* Copy image stream data */
       flen = 0;
-      c=ReadBlobByte(image);
-      while (c != EOF)
+      for ( ; ; )
         {
-          flen++;
-          (void) fputc(c,file);
-          c=ReadBlobByte(image);
+          if (CALS_Reserve(&wrapper,4096) == MagickFail)
+            break;
+          count=ReadBlob(image,wrapper.extent-wrapper.length,
+                         wrapper.data+wrapper.length);
+          if (count == 0)
+            break;
+          wrapper.length+=count;
+          flen+=(unsigned long) count;
         }
+      if (wrapper.status == MagickFail)
+        break;
 
       /* Return to correct location and output strip byte count */
-      if (fseek(file,byte_count_pos,SEEK_SET) != 0)
-        break;
-      CALS_WriteIntelULong(file,flen);
-      fflush(file);
-      if (ferror(file))
-        break;
-      file_write_status=MagickPass;
+      CALS_EncodeIntelULong(wrapper.data+byte_count_pos,flen);
     } while (0);
-  (void) fclose(file);
-  if (file_write_status != MagickPass)
+  if (wrapper.status != MagickPass)
     {
-      (void) LiberateTemporaryFile(filename);
-      ThrowReaderException(CoderError,UnableToWriteTemporaryFile,image);
+      MagickFreeResourceLimitedMemory(wrapper.data);
+      ThrowReaderException(ResourceLimitError,MemoryAllocationFailed,image);
     }
   DestroyImage(image);
   clone_info=CloneImageInfo(image_info);
-  clone_info->blob=(void *) NULL;
-  clone_info->length=0;
-  FormatString(clone_info->filename,"tiff:%.1024s",filename);
-  image=ReadImage(clone_info,exception);
-  (void) LiberateTemporaryFile(filename);
+  (void) strlcpy(clone_info->filename,"TIFF:",sizeof(clone_info->filename));
+  image=BlobToImage(clone_info,wrapper.data,wrapper.length,exception);
+  MagickFreeResourceLimitedMemory(wrapper.data);
   DestroyImageInfo(clone_info);
   if (image != (Image *) NULL)
     {
@@ -317,6 +317,7 @@ static Image *ReadEPTImage(const ImageInfo *image_info,
       ThrowReaderException(CorruptImageError,AnErrorHasOccurredWritingToFile,
         image)
     }
+  RecordBlobSpill(image_info->magick,(magick_uint64_t) ftell(file));
   (void) rewind(file);
   (void) fputs(translate_geometry,file);
   (void) fclose(file);
@@ -446,7 +447,6 @@ ModuleExport void RegisterEPTImage(void)
   entry->encoder=(EncoderHandler) WriteEPTImage;
   entry->magick=(MagickHandler) IsEPT;
   entry->adjoin=False;
-  entry->blob_support=MagickFalse;
   entry->description="Adobe Encapsulated PostScript with MS-DOS TIFF preview";
   entry->module="EPT";
   entry->coder_class=PrimaryCoderClass;
@@ -459,7 +459,6 @@ ModuleExport void RegisterEPTImage(void)
   entry->encoder=(EncoderHandler) WriteEPTImage;
   entry->magick=(MagickHandler) IsEPT;
   entry->adjoin=False;
-  entry->blob_support=MagickFalse;
   entry->description="Adobe Level II Encapsulated PostScript with MS-DOS TIFF preview";
   entry->module="EPT";
   entry->coder_class=PrimaryCoderClass;
@@ -472,7 +471,6 @@ ModuleExport void RegisterEPTImage(void)
   entry->encoder=(EncoderHandler) WriteEPTImage;
   entry->magick=(MagickHandler) IsEPT;
   entry->adjoin=False;
-  entry->blob_support=MagickFalse;
   entry->description="Adobe Level III Encapsulated PostScript with MS-DOS TIFF preview";
   entry->module="EPT";
   entry->coder_class=PrimaryCoderClass;
@@ -539,12 +537,18 @@ static unsigned int WriteEPTImage(const ImageInfo *image_info,Image *image)
 {
   char
     filename[MaxTextExtent],
-    ps_filename[MaxTextExtent],
-    tiff_filename[MaxTextExtent];
+    magick[MaxTextExtent];
 
-  FILE
-    *ps_file,
-    *tiff_file;
+  ImageInfo
+    *clone_info;
+
+  size_t
+    ps_length,
+    tiff_length;
+
+  void
+    *ps_blob,
+    *tiff_blob;
 
   unsigned int
     logging,
@@ -558,151 +562,124 @@ static unsigned int WriteEPTImage(const ImageInfo *image_info,Image *image)
   logging=IsEventLogging();
 
   (void) strlcpy(filename,image->filename,MaxTextExtent);
-  (void) strlcpy(ps_filename,image->magick_filename,MaxTextExtent);
+  (void) strlcpy(magick,image->magick,MaxTextExtent);
+  /*
+    The Postscript and TIFF sections are rendered into memory blobs
+    rather than temporary files.
+  */
+  clone_info=CloneImageInfo(image_info);
+  clone_info->blob=(void *) NULL;
+  clone_info->length=0;
+  ps_blob=(void *) NULL;
+  ps_length=0;
   if (LocaleCompare(image_info->magick,"EPS") != 0)
     {
       /*
-        Write image as Encapsulated Postscript to a temporary file.
+        Write image as Encapsulated Postscript.
       */
       char
         subformat[MaxTextExtent];
 
-      if(!AcquireTemporaryFileName(ps_filename))
-        ThrowWriterTemporaryFileException(ps_filename);
-
       /* Select desired EPS level */
-      (void) strcpy(subformat,"eps");
+      (void) strcpy(subformat,"EPS");
       if (LocaleCompare(image_info->magick,"EPT2") == 0)
-        (void) strcpy(subformat,"eps2");
+        (void) strcpy(subformat,"EPS2");
       else if (LocaleCompare(image_info->magick,"EPT3") == 0)
-        (void) strcpy(subformat,"eps3");
+        (void) strcpy(subformat,"EPS3");
 
       /* JPEG compression requires at least EPS2 */
       if ((image->compression == JPEGCompression) &&
           (LocaleCompare(subformat,"EPS") == 0))
-        (void) strcpy(subformat,"eps2");
+        (void) strcpy(subformat,"EPS2");
 
-      FormatString(image->filename,"%s:%.1024s",subformat,ps_filename);
       if (logging)
         (void) LogMagickEvent(CoderEvent,GetMagickModule(),
-                              "Writing temporary EPS file \"%s\"",ps_filename);
-      (void) WriteImage(image_info,image);
+                              "Writing %s section to memory",subformat);
+      (void) strlcpy(image->magick,subformat,MaxTextExtent);
+      ps_blob=ImageToBlob(clone_info,image,&ps_length,&image->exception);
     }
-  /*
-    Write image as TIFF to a temporary file.
-  */
-  if(!AcquireTemporaryFileName(tiff_filename))
+  else
     {
-      (void) LiberateTemporaryFile(ps_filename);
-      ThrowWriterTemporaryFileException(tiff_filename);
+      ps_blob=FileToBlob(image->magick_filename,&ps_length,&image->exception);
     }
-
-  FormatString(image->filename,"tiff:%.1024s",tiff_filename);
+  /*
+    Write image as TIFF preview.
+  */
   image->compression=RLECompression;
   if (logging)
     (void) LogMagickEvent(CoderEvent,GetMagickModule(),
-                          "Writing temporary TIFF preview file \"%s\"",tiff_filename);
-  (void) WriteImage(image_info,image);
+                          "Writing TIFF preview section to memory");
+  (void) strlcpy(image->magick,"TIFF",MaxTextExtent);
+  tiff_blob=ImageToBlob(clone_info,image,&tiff_length,&image->exception);
+  DestroyImageInfo(clone_info);
+  (void) strlcpy(image->filename,filename,MaxTextExtent);
+  (void) strlcpy(image->magick,magick,MaxTextExtent);
   /*
     Write EPT image.
   */
-  (void) strlcpy(image->filename,filename,MaxTextExtent);
   status=MagickFail;
-  if (OpenBlob(image_info,image,WriteBinaryBlobMode,&image->exception) != MagickFail)
+  if ((ps_blob != (void *) NULL) && (tiff_blob != (void *) NULL) &&
+      (OpenBlob(image_info,image,WriteBinaryBlobMode,&image->exception) != MagickFail))
     {
-      if ((ps_file=fopen(ps_filename,"rb")) != (FILE *) NULL)
-        {
-          if ((tiff_file=fopen(tiff_filename,"rb")) != (FILE *) NULL)
-            {
-              int
-                c;
-
-              struct stat
-                attributes;
-
-              /*
-                Write EPT image.
-              */
-
-              /* MS-DOS EPS binary file magic signature */
-              (void) WriteBlobLSBLong(image,0xc6d3d0c5ul);
-              /* Byte position in file for start of Postscript language code
-                 section */
-              (void) WriteBlobLSBLong(image,30);
-              if (logging)
-                (void) LogMagickEvent(CoderEvent,GetMagickModule(),
-                                      "EPS section offset is %lu bytes",(unsigned long) 30);
-              /* Byte length of PostScript language section. */
-              attributes.st_size=0;
-              (void) fstat(fileno(ps_file),&attributes);
-              if (logging)
-                (void) LogMagickEvent(CoderEvent,GetMagickModule(),
-                                      "EPS section is %lu bytes long",
-                                      (unsigned long)attributes.st_size);
-              (void) WriteBlobLSBLong(image,(unsigned long) attributes.st_size);
-              /* Byte position in file for start of Metafile screen
-                 representation (none provided). */
-              (void) WriteBlobLSBLong(image,0);
-              /* Byte length of Metafile section (PSize). (none provided) */
-              (void) WriteBlobLSBLong(image,0);
-              /* Byte position of TIFF representation. */
-              (void) WriteBlobLSBLong(image,(unsigned long) attributes.st_size+30);
-              if (logging)
-                (void) LogMagickEvent(CoderEvent,GetMagickModule(),
-                                      "TIFF section offset is %lu bytes",
-                                      (unsigned long) attributes.st_size+30);
-              /* Byte length of TIFF section. */
-              (void) fstat(fileno(tiff_file),&attributes);
-              if (logging)
-                (void) LogMagickEvent(CoderEvent,GetMagickModule(),
-                                      "TIFF section is %lu bytes long",
-                                      (unsigned long) attributes.st_size);
-              (void) WriteBlobLSBLong(image,(long) attributes.st_size);
-              /* Checksum of header (XOR of bytes 0-27). If Checksum is FFFF
-                 then ignore it. This is lazy code. */
-              (void) WriteBlobLSBShort(image,0xffff);
-              /* EPS section */
-              if (logging)
-                (void) LogMagickEvent(CoderEvent,GetMagickModule(),
-                                      "Writing EPS section at offset %ld",
-                                      (long) TellBlob(image));
-              for (c=fgetc(ps_file); c != EOF; c=fgetc(ps_file))
-                (void) WriteBlobByte(image,c);
-              /* TIFF section */
-              if (logging)
-                (void) LogMagickEvent(CoderEvent,GetMagickModule(),
-                                      "Writing TIFF section at offset %ld",
-                                      (long) TellBlob(image));
-              for (c=fgetc(tiff_file); c != EOF; c=fgetc(tiff_file))
-                (void) WriteBlobByte(image,c);
-              (void) fclose(tiff_file);
-              status=MagickPass;
-            }
-          else
-            {
-              (void) LogMagickEvent(CoderEvent,GetMagickModule(),
-                                    "Failed to open \"%s\" for read",
-                                    tiff_filename);
-            }
-          (void) fclose(ps_file);
-        }
-      else
+      /* MS-DOS EPS binary file magic signature */
+      (void) WriteBlobLSBLong(image,0xc6d3d0c5ul);
+      /* Byte position in file for start of Postscript language code
+         section */
+      (void) WriteBlobLSBLong(image,30);
+      if (logging)
+        (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                              "EPS section offset is %lu bytes",(unsigned long) 30);
+      /* Byte length of PostScript language section. */
+      if (logging)
+        (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                              "EPS section is %lu bytes long",
+                              (unsigned long) ps_length);
+      (void) WriteBlobLSBLong(image,(unsigned long) ps_length);
+      /* Byte position in file for start of Metafile screen
+         representation (none provided). */
+      (void) WriteBlobLSBLong(image,0);
+      /* Byte length of Metafile section (PSize). (none provided) */
+      (void) WriteBlobLSBLong(image,0);
+      /* Byte position of TIFF representation. */
+      (void) WriteBlobLSBLong(image,(unsigned long) ps_length+30);
+      if (logging)
+        (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                              "TIFF section offset is %lu bytes",
+                              (unsigned long) ps_length+30);
+      /* Byte length of TIFF section. */
+      if (logging)
+        (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                              "TIFF section is %lu bytes long",
+                              (unsigned long) tiff_length);
+      (void) WriteBlobLSBLong(image,(unsigned long) tiff_length);
+      /* Checksum of header (XOR of bytes 0-27). If Checksum is FFFF
+         then ignore it. This is lazy code. */
+      (void) WriteBlobLSBShort(image,0xffff);
+      /* EPS section */
+      if (logging)
+        (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                              "Writing EPS section at offset %ld",
+                              (long) TellBlob(image));
+      if (WriteBlob(image,ps_length,ps_blob) == ps_length)
         {
-          (void) LogMagickEvent(CoderEvent,GetMagickModule(),
-                                "Failed to open \"%s\" for read",ps_filename);
+          /* TIFF section */
+          if (logging)
+            (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                                  "Writing TIFF section at offset %ld",
+                                  (long) TellBlob(image));
+          if (WriteBlob(image,tiff_length,tiff_blob) == tiff_length)
+            status=MagickPass;
         }
-
       CloseBlob(image);
     }
   else
     {
       (void) LogMagickEvent(CoderEvent,GetMagickModule(),
-                                "Failed to open \"%s\" for write",
+                            "Failed to render EPT sections for \"%s\"",
                             image->filename);
     }
-  if (LocaleCompare(image_info->magick,"EPS") != 0)
-    (void) LiberateTemporaryFile(ps_filename);
-  (void) LiberateTemporaryFile(tiff_filename);
+  MagickFreeMemory(ps_blob);
+  MagickFreeMemory(tiff_blob);
   if (status == MagickFail)
     ThrowWriterException(FileOpenError,UnableToOpenFile,image);
   return(MagickPass);
@@ -40,6 +40,7 @@
 #include "magick/blob.h"
 #include "magick/color.h"
 #include "magick/colormap.h"
+#include "magick/compress-private.h"
 #include "magick/log.h"
 #include "magick/magick.h"
 #include "magick/monitor.h"
@@ -85,22 +86,19 @@ static unsigned int
 %
 %
 */
-#define MaxStackSize  4096
-#define NullCode (~0U)
+static size_t ReadGIFDataBlock(void *context,magick_uint8_t *data,
+  const size_t length)
+{
+  ARG_NOT_USED(length);
+  return(ReadBlobBlock((Image *) context,data));
+}
+
 static MagickPassFail DecodeImage(Image *image,const long opacity)
 {
-  int
-    bits,
-    code_size;
+  LZWDecodeInfo
+    *decoder;
 
   unsigned int
-    available,
-    clear,
-    code,
-    code_mask,
-    end_of_information,
-    in_code,
-    old_code,
     pass;
 
   unsigned long
@@ -116,26 +114,13 @@ static MagickPassFail DecodeImage(Image *image,const long opacity)
   register PixelPacket
     *q;
 
-  register unsigned char
-    *c;
-
-  register unsigned int
-    datum;
-
   size_t
     count;
 
-  unsigned short
-    *prefix;
-
   unsigned char
     data_size,
-    first,
     index,
-    *packet,
-    *pixel_stack,
-    *suffix,
-    *top_stack;
+    *row;
 
   MagickPassFail
     status=MagickPass;
@@ -143,58 +128,27 @@ static MagickPassFail DecodeImage(Image *image,const long opacity)
   assert(image != (Image *) NULL);
 
   data_size=ReadBlobByte(image);
-  if (data_size > 8U) /* 256 */
+  if ((data_size < 1U) || (data_size > 8U)) /* 256 */
     ThrowBinaryException(CorruptImageError,CorruptImage,image->filename);
   /*
-    Allocate decoder tables.
+    Allocate decoder.
   */
-  packet=MagickAllocateMemory(unsigned char *,256);
-  prefix=MagickAllocateArray(unsigned short *,MaxStackSize,sizeof(short));
-  suffix=MagickAllocateMemory(unsigned char *,MaxStackSize);
-  pixel_stack=MagickAllocateMemory(unsigned char *,MaxStackSize+1);
-  if ((packet == (unsigned char *) NULL) ||
-      (prefix == (unsigned short *) NULL) ||
-      (suffix == (unsigned char *) NULL) ||
-      (pixel_stack == (unsigned char *) NULL))
+  row=MagickAllocateMemory(unsigned char *,image->columns);
+  decoder=AllocateLZWDecoder(GIFLZWFlavor,data_size,ReadGIFDataBlock,image);
+  if ((row == (unsigned char *) NULL) ||
+      (decoder == (LZWDecodeInfo *) NULL))
     {
-      MagickFreeMemory(pixel_stack);
-      MagickFreeMemory(suffix);
-      MagickFreeMemory(prefix);
-      MagickFreeMemory(packet);
+      if (decoder != (LZWDecodeInfo *) NULL)
+        DestroyLZWDecoder(decoder);
+      MagickFreeMemory(row);
       ThrowBinaryException(ResourceLimitError,MemoryAllocationFailed,
                            image->filename);
     }
-  /*
-    Initialize GIF data stream decoder.
-  */
-  (void) memset(packet,0,256);
-  (void) memset(prefix,0,MaxStackSize*sizeof(short));
-  (void) memset(suffix,0,MaxStackSize);
-  (void) memset(pixel_stack,0,MaxStackSize+1);
-  clear=1U << data_size;
-  end_of_information=clear+1;
-  available=clear+2;
-  old_code=NullCode;
-  code_size=data_size+1;
-  code_mask=(1U << code_size)-1;
-  (void) memset(prefix,0,MaxStackSize*sizeof(short));
-  (void) memset(suffix,0,MaxStackSize);
-  for (code=0; code < clear; code++)
-    {
-      prefix[code]=0;
-      suffix[code]=(unsigned char) code;
-    }
   /*
     Decode GIF pixel stream.
   */
-  datum=0;
-  bits=0;
-  c=0;
-  count=0;
-  first=0;
   offset=0;
   pass=0;
-  top_stack=pixel_stack;
   for (y=0; y < image->rows; y++)
     {
       q=SetImagePixels(image,0,offset,image->columns,1);
@@ -206,121 +160,15 @@ static MagickPassFail DecodeImage(Image *image,const long opacity)
           break;
         }
       indexes=AccessMutableIndexes(image);
-      for (x=0; x < image->columns; )
+      count=LZWDecode(decoder,row,image->columns);
+      for (x=0; x < count; x++)
         {
-          if (top_stack == pixel_stack)
-            {
-              if (bits < code_size)
-                {
-                  /*
-                    Load bytes until there is enough bits for a code.
-                  */
-                  if (count == 0)
-                    {
-                      /*
-                        Read a new data block.
-                      */
-                      count=ReadBlobBlock(image,packet);
-                      if (count == 0)
-                        break;
-                      c=packet;
-                    }
-                  datum+=((unsigned int) *c) << bits;
-                  bits+=8;
-                  c++;
-                  count--;
-                  continue;
-                }
-              /*
-                Get the next code.
-              */
-              code=datum & code_mask;
-              datum>>=code_size;
-              bits-=code_size;
-              /*
-                Interpret the code
-              */
-              if (code == end_of_information)
-                break;
-              if (code == clear)
-                {
-                  /*
-                    Reset decoder.
-                  */
-                  code_size=data_size+1;
-                  code_mask=(1U << code_size)-1;
-                  available=clear+2;
-                  old_code=NullCode;
-                  continue;
-                }
-              if (old_code == NullCode)
-                {
-                  *top_stack++=suffix[code];
-                  old_code=code;
-                  first=(unsigned char) code;
-                  continue;
-                }
-              in_code=code;
-              if (code >= available)
-                {
-                  *top_stack++=first;
-                  code=old_code;
-                }
-              while (code >= clear)
-                {
-                  if (code >= MaxStackSize)
-                    {
-                      if (image->logging)
-                        (void) LogMagickEvent(CoderEvent,GetMagickModule(),
-                                              "Suffix index (%u) is outside of"
-                                              " bounds (0-%u)", code, MaxStackSize);
-                      status=MagickFail;
-                      break;
-                    }
-                  if ((top_stack-pixel_stack) >= MaxStackSize)
-                    {
-                      if (image->logging)
-                        (void) LogMagickEvent(CoderEvent,GetMagickModule(),
-                                              "Attempted overrun of pixel stack bounds");
-                      status=MagickFail;
-                      break;
-                    }
-                  *top_stack++=suffix[code];
-                  code=prefix[code];
-                }
-              if (status == MagickFail)
-                break;
-              first=suffix[code];
-              /*
-                Add a new string to the string table,
-              */
-              if (available < MaxStackSize)
-                {
-                  prefix[available]=(short) old_code;
-                  suffix[available]=first;
-                  available++;
-                  if (available >= (code_mask + 1) && code_size < 12)
-                    {
-                      code_size++;
-                      code_mask+=available;
-                    }
-                }
-              *top_stack++=first;
-              old_code=in_code;
-            }
-          if (status == MagickFail)
-            break;
-          /*
-            Pop a pixel off the pixel stack.
-          */
-          top_stack--;
-          index=(*top_stack);
+          index=row[x];
           VerifyColormapIndex(image,index);
           indexes[x]=index;
           *q=image->colormap[index];
           q->opacity=(Quantum)
             (index == opacity ? TransparentOpacity : OpaqueOpacity);
-          x++;
           q++;
         }
       if (image->interlace == NoInterlace)
@@ -379,10 +227,15 @@ static MagickPassFail DecodeImage(Image *image,const long opacity)
         {
           status=MagickFail;
           if (image->logging)
-            (void) LogMagickEvent(CoderEvent,GetMagickModule(),
-                                  "Quitting, LZW decode."
-                                  " Decoded only %lu columns out of %lu.",
-                                  x, image->columns);
+            {
+              if (LZWDecodeStatus(decoder) == MagickFail)
+                (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                                      "Invalid LZW code");
+              (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                                    "Quitting, LZW decode."
+                                    " Decoded only %lu columns out of %lu.",
+                                    x, image->columns);
+            }
           break;
         }
       if (image->previous == (Image *) NULL)
@@ -395,10 +248,8 @@ static MagickPassFail DecodeImage(Image *image,const long opacity)
               break;
             }
     }
-  MagickFreeMemory(pixel_stack);
-  MagickFreeMemory(suffix);
-  MagickFreeMemory(prefix);
-  MagickFreeMemory(packet);
+  DestroyLZWDecoder(decoder);
+  MagickFreeMemory(row);
   if ((status == MagickFail) || (y < image->rows))
     {
       if ((image->logging) && (y < image->rows))
@@ -411,7 +262,7 @@ static MagickPassFail DecodeImage(Image *image,const long opacity)
     }
   return(MagickPass);
 }
-
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -423,12 +274,18 @@ static MagickPassFail DecodeImage(Image *image,const long opacity)
 %                                                                             %
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %
-%  Method EncodeImage compresses an image via GIF-coding.
+%  Method EncodeImage compresses an image via GIF-coding.  If lossy is
+%  not zero, strings already in the LZW string table are written in place
+%  of the pixels when no color differs from the pixel it replaces by more
+%  than lossy, measured as the sum of the absolute differences of the
+%  8-bit red, green, and blue values.  The transparent color is never
+%  replaced nor used as a replacement.
 %
 %  The format of the EncodeImage method is:
 %
 %      MagickPassFail EncodeImage(const ImageInfo *image_info,Image *image,
-%        const unsigned int data_size)
+%        const unsigned int data_size,const long opacity,
+%        const unsigned int lossy)
 %
 %  A description of each parameter follows:
 %
@@ -439,199 +296,160 @@ static MagickPassFail DecodeImage(Image *image,const long opacity)
 %
 %    o image: The address of a structure of type Image.
 %
-%    o data_size:  The number of bits in the compressed packet.
+%    o data_size:  The number of bits per pixel.
+%
+%    o opacity:  The colormap index of the transparent color, or -1.
+%
+%    o lossy:  The largest color difference allowed, or zero for lossless
+%      compression.
 %
 %
 */
-#define MaxCode(number_bits)  ((short) ((1U << (number_bits))-1))
-#define MaxHashTable  5003
-#define MaxGIFBits  12
-#define MaxGIFTable  ((short) (1U << MaxGIFBits))
-
-#define GIFOutputCode(code) \
-{ \
-  /*  \
-    Emit a code. \
-  */ \
-  if (bits > 0) \
-    datum|=((unsigned int) code << bits); \
-  else \
-    datum=(unsigned int) code; \
-  bits+=number_bits; \
-  while (bits >= 8) \
-  { \
-    /*  \
-      Add a character to current packet. \
-    */ \
-    packet[byte_count++]=(unsigned char) (datum & 0xff); \
-    if (byte_count >= 254) \
-      { \
-        (void) WriteBlobByte(image,byte_count); \
-        (void) WriteBlob(image,byte_count,(char *) packet); \
-        byte_count=0; \
-      } \
-    datum>>=8; \
-    bits-=8; \
-  } \
-  if (free_code > max_code)  \
-    { \
-      number_bits++; \
-      if (number_bits == MaxGIFBits) \
-        max_code=MaxGIFTable; \
-      else \
-        max_code=MaxCode(number_bits); \
-    } \
+typedef struct _GIFDataBlockInfo
+{
+  Image
+    *image;
+
+  size_t
+    count;
+
+  unsigned char
+    packet[256];
+} GIFDataBlockInfo;
+
+static MagickPassFail WriteGIFDataBlocks(void *context,
+  const magick_uint8_t *data,const size_t length)
+{
+  GIFDataBlockInfo
+    *block_info=(GIFDataBlockInfo *) context;
+
+  register size_t
+    i;
+
+  /*
+    Write data in sub-blocks of 254 bytes.
+  */
+  for (i=0; i < length; i++)
+    {
+      block_info->packet[block_info->count++]=data[i];
+      if (block_info->count >= 254)
+        {
+          (void) WriteBlobByte(block_info->image,
+                               (magick_uint8_t) block_info->count);
+          (void) WriteBlob(block_info->image,block_info->count,
+                           (char *) block_info->packet);
+          block_info->count=0;
+        }
+    }
+  return(MagickPass);
 }
+
+static magick_uint8_t *AllocateGIFLossyCosts(const Image *image,
+  const long opacity,const unsigned int lossy)
+{
+  long
+    distance;
+
+  magick_uint8_t
+    *costs;
+
+  register unsigned int
+    i,
+    j;
+
+  costs=MagickAllocateMemory(magick_uint8_t *,256*256);
+  if (costs == (magick_uint8_t *) NULL)
+    return(costs);
+  (void) memset(costs,255,256*256);
+  for (i=0; i < image->colors; i++)
+    for (j=0; j < image->colors; j++)
+      {
+        if (((long) i == opacity) || ((long) j == opacity))
+          continue;
+        distance=
+          labs((long) ScaleQuantumToChar(image->colormap[i].red)-
+               (long) ScaleQuantumToChar(image->colormap[j].red))+
+          labs((long) ScaleQuantumToChar(image->colormap[i].green)-
+               (long) ScaleQuantumToChar(image->colormap[j].green))+
+          labs((long) ScaleQuantumToChar(image->colormap[i].blue)-
+               (long) ScaleQuantumToChar(image->colormap[j].blue));
+        if (distance <= (long) lossy)
+          costs[(i << 8) | j]=(magick_uint8_t) Min(distance,254);
+      }
+  return(costs);
+}
+
 static MagickPassFail EncodeImage(const ImageInfo *image_info,Image *image,
-  const unsigned int data_size)
+  const unsigned int data_size,const long opacity,const unsigned int lossy)
 {
+  GIFDataBlockInfo
+    block_info;
 
-  int
-    displacement,
-    next_pixel,
-    bits,
-    byte_count,
-    k,
-    number_bits,
-    offset,
-    pass;
+  LZWEncodeInfo
+    *encoder;
 
   long
-    datum,
+    offset,
     y;
 
-  register const PixelPacket
-    *p;
-
   register const IndexPacket
     *indexes;
 
   register long
-    i,
     x;
 
-  short
-    clear_code,
-    end_of_information_code,
-    free_code,
-    *hash_code,
-    *hash_prefix,
-    index,
-    max_code,
-    waiting_code;
+  magick_uint8_t
+    *costs,
+    *row;
 
-  unsigned char
-    *packet,
-    *hash_suffix;
+  unsigned int
+    pass;
+
+  MagickPassFail
+    status=MagickPass;
 
   /*
-    Allocate encoder tables.
+    Allocate encoder.
   */
   assert(image != (Image *) NULL);
-  packet=MagickAllocateMemory(unsigned char *,256);
-  hash_code=MagickAllocateArray(short *,MaxHashTable,sizeof(short));
-  hash_prefix=MagickAllocateArray(short *,MaxHashTable,sizeof(short));
-  hash_suffix=MagickAllocateMemory(unsigned char *,MaxHashTable);
-  if ((packet == (unsigned char *) NULL) || (hash_code == (short *) NULL) ||
-      (hash_prefix == (short *) NULL) ||
-      (hash_suffix == (unsigned char *) NULL))
+  block_info.image=image;
+  block_info.count=0;
+  costs=(magick_uint8_t *) NULL;
+  if ((lossy != 0) && (image_info->compression != NoCompression))
+    costs=AllocateGIFLossyCosts(image,opacity,lossy);
+  row=MagickAllocateMemory(magick_uint8_t *,image->columns);
+  encoder=AllocateLZWEncoder(GIFLZWFlavor,data_size,
+                             image_info->compression != NoCompression,
+                             costs,WriteGIFDataBlocks,&block_info);
+  if ((row == (magick_uint8_t *) NULL) ||
+      (encoder == (LZWEncodeInfo *) NULL) ||
+      ((lossy != 0) && (image_info->compression != NoCompression) &&
+       (costs == (magick_uint8_t *) NULL)))
     {
-      MagickFreeMemory(packet);
-      MagickFreeMemory(hash_code);
-      MagickFreeMemory(hash_prefix);
-      MagickFreeMemory(hash_suffix);
+      if (encoder != (LZWEncodeInfo *) NULL)
+        DestroyLZWEncoder(encoder);
+      MagickFreeMemory(row);
+      MagickFreeMemory(costs);
       return(MagickFail);
     }
-  /*
-    Initialize GIF encoder.
-  */
-  number_bits=data_size;
-  max_code=MaxCode(number_bits);
-  clear_code=((short) 1U << (data_size-1));
-  end_of_information_code=clear_code+1;
-  free_code=clear_code+2;
-  byte_count=0;
-  datum=0;
-  bits=0;
-  for (i=0; i < MaxHashTable; i++)
-    hash_code[i]=0;
-  GIFOutputCode(clear_code);
   /*
     Encode pixels.
   */
   offset=0;
   pass=0;
-  waiting_code=0;
   for (y=0; y < (long) image->rows; y++)
   {
-    p=AcquireImagePixels(image,0,offset,image->columns,1,&image->exception);
-    if (p == (const PixelPacket *) NULL)
+    if (AcquireImagePixels(image,0,offset,image->columns,1,&image->exception)
+        == (const PixelPacket *) NULL)
       break;
     indexes=AccessImmutableIndexes(image);
-    if (y == 0)
-      waiting_code=(*indexes);
-    for (x=(y == 0) ? 1 : 0; x < (long) image->columns; x++)
-    {
-      /*
-        Probe hash table.
-      */
-      index=indexes[x] & 0xff;
-      p++;
-      k=(int) ((unsigned int) index << (MaxGIFBits-8))+waiting_code;
-      if (k >= MaxHashTable)
-        k-=MaxHashTable;
-      next_pixel=False;
-      displacement=1;
-      if ((image_info->compression != NoCompression) && (hash_code[k] > 0))
-        {
-          if ((hash_prefix[k] == waiting_code) && (hash_suffix[k] == index))
-            {
-              waiting_code=hash_code[k];
-              continue;
-            }
-          if (k != 0)
-            displacement=MaxHashTable-k;
-          for ( ; ; )
-          {
-            k-=displacement;
-            if (k < 0)
-              k+=MaxHashTable;
-            if (hash_code[k] == 0)
-              break;
-            if ((hash_prefix[k] == waiting_code) && (hash_suffix[k] == index))
-              {
-                waiting_code=hash_code[k];
-                next_pixel=True;
-                break;
-              }
-          }
-          if (next_pixel == True)
-            continue;
-        }
-      GIFOutputCode(waiting_code);
-      if (free_code < MaxGIFTable)
-        {
-          hash_code[k]=free_code++;
-          hash_prefix[k]=waiting_code;
-          hash_suffix[k]=(unsigned char) index;
-        }
-      else
-        {
-          /*
-            Fill the hash table with empty entries.
-          */
-          for (k=0; k < MaxHashTable; k++)
-            hash_code[k]=0;
-          /*
-            Reset compressor and issue a clear code.
-          */
-          free_code=clear_code+2;
-          GIFOutputCode(clear_code);
-          number_bits=data_size;
-          max_code=MaxCode(number_bits);
-        }
-      waiting_code=index;
-    }
+    for (x=0; x < (long) image->columns; x++)
+      row[x]=(magick_uint8_t) (indexes[x] & 0xff);
+    if (LZWEncode(encoder,row,image->columns) == MagickFail)
+      {
+        status=MagickFail;
+        break;
+      }
     if ((image_info->interlace == NoInterlace) ||
         (image_info->interlace == UndefinedInterlace))
       offset++;
@@ -683,41 +501,24 @@ static MagickPassFail EncodeImage(const ImageInfo *image_info,Image *image,
           break;
   }
   /*
-    Flush out the buffered code.
-  */
-  GIFOutputCode(waiting_code);
-  GIFOutputCode(end_of_information_code);
-  if (bits > 0)
-    {
-      /*
-        Add a character to current packet.
-      */
-      packet[byte_count++]=(unsigned char) (datum & 0xff);
-      if (byte_count >= 254)
-        {
-          (void) WriteBlobByte(image,byte_count);
-          (void) WriteBlob(image,byte_count,(char *) packet);
-          byte_count=0;
-        }
-    }
-  /*
-    Flush accumulated data.
+    Flush out the buffered code and accumulated data.
   */
-  if (byte_count > 0)
+  if (FinishLZWEncoder(encoder) == MagickFail)
+    status=MagickFail;
+  if (block_info.count > 0)
     {
-      (void) WriteBlobByte(image,byte_count);
-      (void) WriteBlob(image,byte_count,(char *) packet);
+      (void) WriteBlobByte(image,(magick_uint8_t) block_info.count);
+      (void) WriteBlob(image,block_info.count,(char *) block_info.packet);
     }
   /*
     Free encoder memory.
   */
-  MagickFreeMemory(hash_suffix);
-  MagickFreeMemory(hash_prefix);
-  MagickFreeMemory(hash_code);
-  MagickFreeMemory(packet);
-  return(MagickPass);
+  DestroyLZWEncoder(encoder);
+  MagickFreeMemory(row);
+  MagickFreeMemory(costs);
+  return(status);
 }
-
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -1323,6 +1124,7 @@ static MagickPassFail WriteGIFImage(const ImageInfo *image_info,Image *image)
 
   unsigned int
     interlace,
+    lossy,
     status;
 
   unsigned long
@@ -1397,6 +1199,14 @@ static MagickPassFail WriteGIFImage(const ImageInfo *image_info,Image *image)
              image_info->interlace);
   if (image_info->adjoin && (image->next != (Image *) NULL))
     interlace=NoInterlace;
+  lossy=0;
+  {
+    const char
+      *value;
+
+    if ((value=AccessDefinition(image_info,"gif","lossy")) != (const char *) NULL)
+      lossy=(unsigned int) Min(Max(MagickAtoL(value),0),765);
+  }
   opacity=(-1);
   scene=0;
   do
@@ -1608,7 +1418,7 @@ static MagickPassFail WriteGIFImage(const ImageInfo *image_info,Image *image)
     */
     c=Max(bits_per_pixel,2);
     (void) WriteBlobByte(image,c);
-    status=EncodeImage(image_info,image,Max(bits_per_pixel,2)+1);
+    status=EncodeImage(image_info,image,Max(bits_per_pixel,2),opacity,lossy);
     if (status == MagickFail)
       {
         MagickFreeMemory(global_colormap);
@@ -1317,6 +1317,55 @@ static Image *ReadJPEGImage(const ImageInfo *image_info,
                               (long) scale_factor,
                               jpeg_info.scale_num,jpeg_info.scale_denom);
     }
+  /*
+    If the caller is going to resize the image to a known geometry
+    (e.g. -define jpeg:shrink-on-load=800x600), let the JPEG library
+    perform a reduced-size IDCT so that the full resolution image is
+    never decompressed.  The decoded image is kept at least twice the
+    target size so that the subsequent resize still has enough samples
+    to filter properly.
+  */
+  else if ((value=AccessDefinition(image_info,"jpeg","shrink-on-load")))
+    {
+      long
+        target_x,
+        target_y;
+
+      unsigned long
+        scale_factor,
+        target_columns,
+        target_rows;
+
+      target_x=0;
+      target_y=0;
+      target_columns=jpeg_info.image_width;
+      target_rows=jpeg_info.image_height;
+      (void) GetMagickGeometry(value,&target_x,&target_y,&target_columns,
+                               &target_rows);
+      if ((target_columns != 0) && (target_rows != 0))
+        {
+          scale_factor=jpeg_info.image_width/(2*target_columns);
+          if (scale_factor > jpeg_info.image_height/(2*target_rows))
+            scale_factor=jpeg_info.image_height/(2*target_rows);
+          if (scale_factor > 8)
+            scale_factor=8;
+          if (scale_factor > 1)
+            {
+              image->magick_columns=jpeg_info.image_width;
+              image->magick_rows=jpeg_info.image_height;
+              jpeg_info.scale_denom *= (unsigned int) scale_factor;
+              jpeg_calc_output_dimensions(&jpeg_info);
+            }
+          if (image->logging)
+            (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                                  "Shrink-on-load geometry: %lux%lu,"
+                                  " Scale_factor: %lu (scale_num=%d,"
+                                  " scale_denom=%d)",
+                                  target_columns,target_rows,
+                                  scale_factor > 1 ? scale_factor : 1UL,
+                                  jpeg_info.scale_num,jpeg_info.scale_denom);
+        }
+    }
 #if 0
   /*
     The subrange parameter is set by the filename array syntax similar
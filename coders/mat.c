@@ -310,6 +310,14 @@ unsigned char val = 0;
   *BuffL = val;
 }
 
+/** Release the decompressed copy of a compressed MATLAB object. */
+static void FreeDecompressedBlock(ImageInfo *clone_info)
+{
+  if(clone_info==NULL) return;
+  MagickFreeResourceLimitedMemory(clone_info->blob);
+  clone_info->length = 0;
+}
+
 #if defined(HasZLIB)
 static voidpf ZLIBAllocFunc(voidpf opaque, uInt items, uInt size) MAGICK_FUNC_MALLOC;
 static voidpf ZLIBAllocFunc(voidpf opaque, uInt items, uInt size)
@@ -323,41 +331,32 @@ static void ZLIBFreeFunc(voidpf opaque, voidpf address)
   MagickFree(address);
 }
 
-/** This procedure decompreses an image block for a new MATLAB format. */
+/** This procedure decompreses an image block for a new MATLAB format.
+    The decompressed data is kept in memory (clone_info->blob) and is
+    read through a seekable memory blob, so no temporary file is needed. */
 static Image *DecompressBlock(Image *orig, magick_uint32_t *Size, ImageInfo *clone_info, ExceptionInfo *exception)
 {
 Image *image2;
-void *cache_block, *decompress_block;
+void *cache_block;
+unsigned char *decompress_block, *new_block;
 z_stream zip_info;
-FILE *mat_file;
 size_t magick_size;
+size_t block_size, out_size;
 int status;
 int zip_status;
-magick_off_t TotalSize = 0;
+size_t TotalSize = 0;
 
   if(clone_info==NULL) return NULL;
-  if(clone_info->file)          /* Close file opened from previous transaction. */
-  {
-    fclose(clone_info->file);
-    clone_info->file = NULL;
-    (void) unlink(clone_info->filename);
-  }
+  FreeDecompressedBlock(clone_info);    /* Release data from previous transaction. */
 
   cache_block = MagickAllocateResourceLimitedMemory(unsigned char *,(size_t)((*Size<16384) ? *Size : 16384));
   if(cache_block==NULL) return NULL;
-  decompress_block = MagickAllocateResourceLimitedMemory(unsigned char *,(size_t)(4096));
+  block_size = (*Size < 16384) ? 65536 : 4*(size_t) *Size;
+  decompress_block = MagickAllocateResourceLimitedMemory(unsigned char *,block_size);
   if(decompress_block==NULL)
   {
     MagickFreeResourceLimitedMemory(cache_block);
-    return NULL;
-  }
-
-  mat_file = AcquireTemporaryFileStream(clone_info->filename,BinaryFileIOMode);
-  if(!mat_file)
-  {
-    MagickFreeResourceLimitedMemory(cache_block);
-    MagickFreeResourceLimitedMemory(decompress_block);
-    (void) LogMagickEvent(CoderEvent,GetMagickModule(),"Cannot create file stream for decompressed image");
+    (void) LogMagickEvent(CoderEvent,GetMagickModule(),"Cannot allocate memory for decompressed image");
     return NULL;
   }
 
@@ -371,8 +370,6 @@ magick_off_t TotalSize = 0;
       ThrowException(exception,CorruptImageError, UnableToUncompressImage, orig->filename);
       MagickFreeResourceLimitedMemory(cache_block);
       MagickFreeResourceLimitedMemory(decompress_block);
-      (void)fclose(mat_file);
-      LiberateTemporaryFile(clone_info->filename);
       return NULL;
     }
   /* zip_info.next_out = 8*4; */
@@ -387,8 +384,25 @@ magick_off_t TotalSize = 0;
 
     while(zip_info.avail_in>0)
     {
-      zip_info.avail_out = 4096;
-      zip_info.next_out = decompress_block;
+      if(TotalSize == block_size)
+      {
+        /* Enlarge the output buffer. */
+        new_block = MagickReallocateResourceLimitedMemory(unsigned char *,decompress_block,2*block_size);
+        if(new_block==NULL)
+          {
+            (void) LogMagickEvent(CoderEvent,GetMagickModule(),"Cannot allocate memory for decompressed image");
+            inflateEnd(&zip_info);
+            MagickFreeResourceLimitedMemory(cache_block);
+            MagickFreeResourceLimitedMemory(decompress_block);
+            ThrowException(exception,ResourceLimitError,MemoryAllocationFailed,orig->filename);
+            return NULL;
+          }
+        decompress_block = new_block;
+        block_size *= 2;
+      }
+      zip_info.avail_out = (uInt) Min(block_size-TotalSize,(size_t) 0x40000000);
+      zip_info.next_out = decompress_block+TotalSize;
+      out_size = zip_info.avail_out;
       zip_status = inflate(&zip_info,Z_NO_FLUSH);
       if ((zip_status != Z_OK) && (zip_status != Z_STREAM_END))
         {
@@ -396,13 +410,10 @@ magick_off_t TotalSize = 0;
           inflateEnd(&zip_info);
           MagickFreeResourceLimitedMemory(cache_block);
           MagickFreeResourceLimitedMemory(decompress_block);
-          (void)fclose(mat_file);
-          LiberateTemporaryFile(clone_info->filename);
           ThrowException(exception,CorruptImageError, UnableToUncompressImage, orig->filename);
           return NULL;
         }
-      fwrite(decompress_block, 4096-zip_info.avail_out, 1, mat_file);
-      TotalSize += 4096-zip_info.avail_out;
+      TotalSize += out_size-zip_info.avail_out;
 
       if(zip_status == Z_STREAM_END) goto DblBreak;
     }
@@ -414,22 +425,23 @@ magick_off_t TotalSize = 0;
 DblBreak:
 
   inflateEnd(&zip_info);                        /* Release all caches used by zip. */
-  (void)fclose(mat_file);
   MagickFreeResourceLimitedMemory(cache_block);
-  MagickFreeResourceLimitedMemory(decompress_block);
-  *Size = TotalSize;
+  *Size = (magick_uint32_t) TotalSize;
+  if(TotalSize == 0)
+  {
+    MagickFreeResourceLimitedMemory(decompress_block);
+    return NULL;
+  }
 
-  if((clone_info->file=fopen(clone_info->filename,"rb"))==NULL) goto UnlinkFile;
-  if((image2 = AllocateImage(clone_info))==NULL) goto EraseFile;
+  clone_info->blob = (void *) decompress_block;
+  clone_info->length = TotalSize;
+  if((image2 = AllocateImage(clone_info))==NULL) goto FreeBlock;
   status = OpenBlob(clone_info,image2,ReadBinaryBlobMode,exception);
   if (status == False)
   {
     DeleteImageFromList(&image2);
-EraseFile:
-    fclose(clone_info->file);
-    clone_info->file = NULL;
-UnlinkFile:
-    LiberateTemporaryFile(clone_info->filename);
+FreeBlock:
+    FreeDecompressedBlock(clone_info);
     return NULL;
   }
 
@@ -441,7 +453,10 @@ UnlinkFile:
 #define ThrowMATReaderException(code_,reason_,image_) \
 { \
   if (clone_info) \
+  { \
+    FreeDecompressedBlock(clone_info); \
     DestroyImageInfo(clone_info);    \
+  } \
   ThrowReaderException(code_,reason_,image_); \
 }
 
@@ -454,7 +469,10 @@ UnlinkFile:
      DeleteImageFromList(&image2); \
   } \
   if(clone_info) \
+  { \
+    FreeDecompressedBlock(clone_info); \
     DestroyImageInfo(clone_info);    \
+  } \
   MagickFreeResourceLimitedMemory(BImgBuff); \
   ThrowReaderException(code_,reason_,image_); \
 }
@@ -903,12 +921,18 @@ MATLAB_KO: ThrowMATReaderException(CorruptImageError,ImproperImageHeader,image);
     if(MATLAB_HDR.DataType == miCOMPRESSED)
     {
       if(clone_info==NULL)
+      {
         if((clone_info=CloneImageInfo(image_info)) == NULL)
                 {
                   if(logging) (void)LogMagickEvent(CoderEvent,GetMagickModule(),
                                    "CloneImageInfo failed");
                   continue;
                 }
+        /* Decompressed data is attached as a private memory blob. */
+        clone_info->blob = NULL;
+        clone_info->length = 0;
+        clone_info->file = NULL;
+      }
       image2 = DecompressBlock(image,&MATLAB_HDR.ObjectSize,clone_info,exception);
       if(image2==NULL)
       {
@@ -1307,12 +1331,7 @@ skip_reading_current:
         DeleteImageFromList(&image2);
         if(clone_info)
         {
-          if(clone_info->file)
-          {
-            fclose(clone_info->file);
-            clone_info->file = NULL;
-            (void) unlink(clone_info->filename);
-          }
+          FreeDecompressedBlock(clone_info);
         }
       }
 
@@ -1350,14 +1369,9 @@ END_OF_READING:
       p->scene=scene++;
   }
 
-  if(clone_info != NULL)        /* cleanup garbage file from compression */
+  if(clone_info != NULL)        /* cleanup garbage data from compression */
   {
-    if(clone_info->file)
-    {
-      fclose(clone_info->file);
-      clone_info->file = NULL;
-      (void) unlink(clone_info->filename);
-    }
+    FreeDecompressedBlock(clone_info);
     DestroyImageInfo(clone_info);
     clone_info = NULL;
   }
@@ -1579,7 +1593,6 @@ ModuleExport void RegisterMATImage(void)
                         "MATLAB Level 4.0-6.0 image formats";
 #endif
   entry->module = "MAT";
-  entry->blob_support=False;
   (void) RegisterMagickInfo(entry);
 }
 
@@ -42,6 +42,7 @@
 #include "magick/color_lookup.h"
 #include "magick/colormap.h"
 #include "magick/compress.h"
+#include "magick/compress-private.h"
 #include "magick/constitute.h"
 #include "magick/enum_strings.h"
 #include "magick/log.h"
@@ -49,6 +50,7 @@
 #include "magick/monitor.h"
 #include "magick/pixel_cache.h"
 #include "magick/profile.h"
+#include "magick/resource.h"
 #include "magick/utility.h"
 #include "magick/version.h"
 #if defined(HasZLIB)
@@ -63,6 +65,31 @@
 */
 static unsigned int
   WriteMIFFImage(const ImageInfo *,Image *);
+
+#if defined(HasZLIB)
+/*
+  Destination of parallel deflate output.
+*/
+typedef struct _MIFFDeflateContext
+{
+  Image
+    *image;
+
+  unsigned char
+    *record;          /* Record which has not been written yet */
+
+  size_t
+    record_length,
+    record_size;      /* Record size (accepted by ReadMIFFImage()) */
+} MIFFDeflateContext;
+#endif /* defined(HasZLIB) */
+
+/*
+  Identifier of images stored as independently compressed blocks of
+  rows.  Readers which do not support the block layout reject it since
+  the identifier is not "ImageMagick".
+*/
+#define MIFFBlocksId "ImageMagick-Blocks"
 
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -730,6 +757,339 @@ static void ZLIBFreeFunc(voidpf opaque, voidpf address)
 }
 #endif /* defined(HasZLIB) */
 
+/*
+  Return the number of blocks of rows to decode or encode at a time.
+*/
+static unsigned long
+GetMIFFBlockThreads(const unsigned long blocks)
+{
+  magick_int64_t
+    threads=1;
+
+#if defined(HAVE_OPENMP)
+  threads=GetMagickResourceLimit(ThreadsResource);
+  if (threads > 256)
+    threads=256;
+#endif
+  if (threads > (magick_int64_t) blocks)
+    threads=(magick_int64_t) blocks;
+  if (threads < 1)
+    threads=1;
+  return (unsigned long) threads;
+}
+
+/*
+  Decompress one block of rows.  The decompressed length must match
+  the expected length exactly.
+*/
+static MagickPassFail
+DecodeMIFFBlock(const CompressionType compression,
+                const unsigned char *source,const size_t source_length,
+                unsigned char *destination,const size_t destination_length)
+{
+  switch (compression)
+    {
+#if defined(HasZLIB)
+    case ZipCompression:
+      {
+        uLongf
+          length;
+
+        length=(uLongf) destination_length;
+        if ((uncompress(destination,&length,source,(uLong) source_length)
+             != Z_OK) || (length != destination_length))
+          return MagickFail;
+        return MagickPass;
+      }
+#endif /* defined(HasZLIB) */
+#if defined(HasBZLIB)
+    case BZipCompression:
+      {
+        unsigned int
+          length;
+
+        length=(unsigned int) destination_length;
+        if ((BZ2_bzBuffToBuffDecompress((char *) destination,&length,
+                                        (char *) source,
+                                        (unsigned int) source_length,0,0)
+             != BZ_OK) || (length != destination_length))
+          return MagickFail;
+        return MagickPass;
+      }
+#endif /* defined(HasBZLIB) */
+    default:
+      break;
+    }
+  return MagickFail;
+}
+
+/*
+  Skip length bytes of block data.
+*/
+static MagickPassFail
+SkipMIFFBlocks(Image *image,magick_uint64_t length)
+{
+  unsigned char
+    buffer[8192];
+
+  size_t
+    count;
+
+  if (length == 0)
+    return MagickPass;
+  if (BlobIsSeekable(image))
+    return (SeekBlob(image,(magick_off_t) length,SEEK_CUR) < 0) ?
+      MagickFail : MagickPass;
+  while (length != 0)
+    {
+      count=(size_t) Min(length,sizeof(buffer));
+      if (ReadBlob(image,count,buffer) != count)
+        return MagickFail;
+      length-=count;
+    }
+  return MagickPass;
+}
+
+/*
+  Read image pixels stored as independently compressed blocks of
+  block_rows rows, preceded by an index of the compressed length of
+  each block.  The image columns and rows describe the region of
+  interest, which starts at region_x,region_y within the stored
+  columns and rows.  Only the blocks which hold rows of the region
+  are decompressed, several at a time, and the others are skipped.
+  Rows are imported in order so that a stream pixel cache receives
+  them in sequence.
+*/
+static MagickPassFail
+ReadMIFFBlocks(Image *image,const CompressionType compression,
+               const QuantumType quantum_type,const unsigned int quantum_size,
+               const size_t packet_size,const unsigned long columns,
+               const unsigned long rows,const long region_x,
+               const long region_y,const unsigned long block_rows,
+               const unsigned long blocks,ExceptionInfo *exception)
+{
+  magick_uint32_t
+    *lengths;
+
+  magick_uint64_t
+    offset;
+
+  size_t
+    block_size,
+    maximum_length,
+    row_size;
+
+  unsigned char
+    *compressed,
+    *decompressed;
+
+  unsigned long
+    block,
+    first_block,
+    last_block,
+    threads;
+
+  MagickPassFail
+    status=MagickPass;
+
+  row_size=packet_size*columns;
+  block_size=row_size*block_rows;
+  first_block=(unsigned long) region_y/block_rows;
+  last_block=((unsigned long) region_y+image->rows-1)/block_rows;
+  threads=GetMIFFBlockThreads(last_block-first_block+1);
+  /*
+    Read block index.
+  */
+  lengths=MagickAllocateResourceLimitedArray(magick_uint32_t *,blocks,
+                                             sizeof(magick_uint32_t));
+  if (lengths == (magick_uint32_t *) NULL)
+    {
+      ThrowException(exception,ResourceLimitError,MemoryAllocationFailed,
+                     image->filename);
+      return MagickFail;
+    }
+  maximum_length=0;
+  for (block=0; block < blocks; block++)
+    {
+      size_t
+        length;
+
+      lengths[block]=ReadBlobMSBLong(image);
+      length=row_size*Min(block_rows,rows-block*block_rows);
+      if (compression == NoCompression)
+        {
+          if (lengths[block] != length)
+            status=MagickFail;
+        }
+      else if (lengths[block] > length+length/100+600)
+        {
+          status=MagickFail;
+        }
+      if ((block >= first_block) && (block <= last_block))
+        maximum_length=Max(maximum_length,lengths[block]);
+    }
+  if (EOFBlob(image) || (status == MagickFail))
+    {
+      MagickFreeResourceLimitedMemory(lengths);
+      ThrowException(exception,CorruptImageError,ImproperImageHeader,
+                     image->filename);
+      return MagickFail;
+    }
+  if (image->logging)
+    (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                          "Reading blocks %lu to %lu of %lu using %lu threads",
+                          first_block,last_block,blocks,threads);
+  compressed=MagickAllocateResourceLimitedArray(unsigned char *,threads,
+                                                maximum_length);
+  decompressed=(unsigned char *) NULL;
+  if (compression != NoCompression)
+    decompressed=MagickAllocateResourceLimitedArray(unsigned char *,threads,
+                                                    block_size);
+  if ((compressed == (unsigned char *) NULL) ||
+      ((compression != NoCompression) &&
+       (decompressed == (unsigned char *) NULL)))
+    {
+      MagickFreeResourceLimitedMemory(decompressed);
+      MagickFreeResourceLimitedMemory(compressed);
+      MagickFreeResourceLimitedMemory(lengths);
+      ThrowException(exception,ResourceLimitError,MemoryAllocationFailed,
+                     image->filename);
+      return MagickFail;
+    }
+  /*
+    Skip blocks preceding the region.
+  */
+  offset=0;
+  for (block=0; block < first_block; block++)
+    offset+=lengths[block];
+  if (SkipMIFFBlocks(image,offset) == MagickFail)
+    {
+      ThrowException(exception,CorruptImageError,UnexpectedEndOfFile,
+                     image->filename);
+      status=MagickFail;
+    }
+  for (block=first_block; (status != MagickFail) && (block <= last_block);
+       block+=threads)
+    {
+      long
+        count,
+        i;
+
+      count=(long) Min(threads,last_block-block+1);
+      for (i=0; i < count; i++)
+        if (ReadBlob(image,lengths[block+i],compressed+i*maximum_length)
+            != lengths[block+i])
+          {
+            ThrowException(exception,CorruptImageError,UnexpectedEndOfFile,
+                           image->filename);
+            status=MagickFail;
+            break;
+          }
+      if ((status != MagickFail) && (compression != NoCompression))
+        {
+#if defined(HAVE_OPENMP)
+#  pragma omp parallel for num_threads(threads) schedule(static,1)
+#endif
+          for (i=0; i < count; i++)
+            {
+              MagickPassFail
+                thread_status;
+
+              thread_status=status;
+              if (thread_status == MagickFail)
+                continue;
+
+              thread_status=
+                DecodeMIFFBlock(compression,compressed+i*maximum_length,
+                                lengths[block+i],decompressed+i*block_size,
+                                row_size*Min(block_rows,
+                                             rows-(block+i)*block_rows));
+
+              if (thread_status == MagickFail)
+                {
+                  status=MagickFail;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (status)
+#endif
+                }
+            }
+          if (status == MagickFail)
+            ThrowException(exception,CorruptImageError,
+                           UnableToUncompressImage,image->filename);
+        }
+      /*
+        Import the rows of the region.
+      */
+      for (i=0; (status != MagickFail) && (i < count); i++)
+        {
+          const unsigned char
+            *data;
+
+          long
+            y,
+            y_max;
+
+          data=(compression == NoCompression) ?
+            compressed+i*maximum_length : decompressed+i*block_size;
+          y=(long) ((block+i)*block_rows);
+          y_max=(long) Min(y+block_rows,(unsigned long) region_y+image->rows);
+          if (y < region_y)
+            y=region_y;
+          for ( ; y < y_max; y++)
+            {
+              if (SetImagePixels(image,0,y-region_y,image->columns,1) ==
+                  (PixelPacket *) NULL)
+                {
+                  status=MagickFail;
+                  break;
+                }
+              if (!ImportImagePixelArea(image,quantum_type,quantum_size,
+                                        data+(size_t) (y-(long) ((block+i)*
+                                                                 block_rows))*
+                                        row_size+(size_t) region_x*packet_size,
+                                        0,0))
+                {
+                  status=MagickFail;
+                  break;
+                }
+              if (!SyncImagePixels(image))
+                {
+                  status=MagickFail;
+                  break;
+                }
+              if (image->previous == (Image *) NULL)
+                if (QuantumTick(y-region_y,image->rows))
+                  if (!MagickMonitorFormatted(y-region_y,image->rows,exception,
+                                              LoadImageText,image->filename,
+                                              image->columns,image->rows))
+                    {
+                      status=MagickFail;
+                      break;
+                    }
+            }
+        }
+    }
+  /*
+    Skip blocks following the region.
+  */
+  if (status != MagickFail)
+    {
+      offset=0;
+      for (block=last_block+1; block < blocks; block++)
+        offset+=lengths[block];
+      if (SkipMIFFBlocks(image,offset) == MagickFail)
+        {
+          ThrowException(exception,CorruptImageError,UnexpectedEndOfFile,
+                         image->filename);
+          status=MagickFail;
+        }
+    }
+  MagickFreeResourceLimitedMemory(decompressed);
+  MagickFreeResourceLimitedMemory(compressed);
+  MagickFreeResourceLimitedMemory(lengths);
+  return status;
+}
+
 #define ThrowMIFFReaderException(code_,reason_,image_) \
 do { \
   MagickFreeResourceLimitedMemory(comment); \
@@ -784,6 +1144,9 @@ static Image *ReadMIFFImage(const ImageInfo *image_info,
   QuantumType
     quantum_type;
 
+  RectangleInfo
+    region;
+
   register unsigned long
     i;
 
@@ -811,6 +1174,12 @@ static Image *ReadMIFFImage(const ImageInfo *image_info,
     packet_size,
     quantum_size;
 
+  unsigned long
+    block_rows,
+    blocks,
+    stored_columns,
+    stored_rows;
+
   ProfileInfo
     *profiles=0;
 
@@ -854,6 +1223,8 @@ static Image *ReadMIFFImage(const ImageInfo *image_info,
       Decode image header;  header terminates one character beyond a ':'.
     */
     colors=0;
+    block_rows=0;
+    blocks=0;
     image->depth=8;
     image->compression=NoCompression;
     image->storage_class=DirectClass;
@@ -1016,8 +1387,11 @@ static Image *ReadMIFFImage(const ImageInfo *image_info,
                                   "keyword[%u]=\"%s\" values=\"%s\"",keyword_count,keyword,values);
             /*
               Insist that the first keyword value must be 'ImageMagick' (id=ImageMagick)
+              or 'ImageMagick-Blocks'
             */
-            if ((keyword_count == 1) && (LocaleCompare(values,"ImageMagick") != 0))
+            if ((keyword_count == 1) &&
+                (LocaleCompare(values,"ImageMagick") != 0) &&
+                (LocaleCompare(values,MIFFBlocksId) != 0))
               {
                 (void) LogMagickEvent(CoderEvent,GetMagickModule(),
                                       "First keyword/value must be 'id=ImageMagick'");
@@ -1047,6 +1421,18 @@ static Image *ReadMIFFImage(const ImageInfo *image_info,
                       exception);
                     break;
                   }
+                if ((LocaleCompare(keyword,"block-rows") == 0) &&
+                    (LocaleCompare(id,MIFFBlocksId) == 0))
+                  {
+                    block_rows=MagickAtoL(values);
+                    break;
+                  }
+                if ((LocaleCompare(keyword,"blocks") == 0) &&
+                    (LocaleCompare(id,MIFFBlocksId) == 0))
+                  {
+                    blocks=MagickAtoL(values);
+                    break;
+                  }
                 if (LocaleCompare(keyword,"blue-primary") == 0)
                   {
                     (void) sscanf(values,"%lf,%lf",
@@ -1430,7 +1816,12 @@ static Image *ReadMIFFImage(const ImageInfo *image_info,
     /*
       Verify that required image information is defined.
     */
-    if ((LocaleCompare(id,"ImageMagick") != 0) ||
+    if (((LocaleCompare(id,"ImageMagick") != 0) &&
+         (LocaleCompare(id,MIFFBlocksId) != 0)) ||
+        ((LocaleCompare(id,MIFFBlocksId) == 0) &&
+         ((block_rows == 0) || (image->rows == 0) ||
+          (blocks != (image->rows+block_rows-1)/block_rows) ||
+          (image->compression == RLECompression))) ||
         (image->storage_class == UndefinedClass) ||
         (image->compression == UndefinedCompression) ||
         (image->colorspace == UndefinedColorspace) ||
@@ -1625,6 +2016,54 @@ static Image *ReadMIFFImage(const ImageInfo *image_info,
             MagickFreeResourceLimitedMemory(colormap);
           }
       }
+    /*
+      Only the requested region (e.g. image.miff[640x480+0+0]) of an
+      image stored as blocks of rows is read.
+    */
+    stored_columns=image->columns;
+    stored_rows=image->rows;
+    region.x=0;
+    region.y=0;
+    region.width=image->columns;
+    region.height=image->rows;
+    if ((blocks != 0) && (image_info->tile != (char *) NULL) &&
+        !IsSubimage(image_info->tile,False))
+      {
+        (void) GetGeometry(image_info->tile,&region.x,&region.y,
+                           &region.width,&region.height);
+        if (region.width == 0)
+          region.width=image->columns;
+        if (region.height == 0)
+          region.height=image->rows;
+        if (((region.x+(long) region.width) <= 0) ||
+            ((region.y+(long) region.height) <= 0) ||
+            (region.x >= (long) image->columns) ||
+            (region.y >= (long) image->rows))
+          ThrowMIFFReaderException(OptionError,GeometryDoesNotContainImage,
+                                   image);
+        if (region.x < 0)
+          {
+            region.width+=region.x;
+            region.x=0;
+          }
+        if (region.y < 0)
+          {
+            region.height+=region.y;
+            region.y=0;
+          }
+        if ((region.x+region.width) > image->columns)
+          region.width=image->columns-region.x;
+        if ((region.y+region.height) > image->rows)
+          region.height=image->rows-region.y;
+        if ((region.width != image->columns) ||
+            (region.height != image->rows))
+          {
+            image->columns=region.width;
+            image->rows=region.height;
+            image->page=region;
+          }
+      }
+
     if (image_info->ping && (image_info->subrange != 0))
       if (image->scene >= (image_info->subimage+image_info->subrange-1))
         break;
@@ -1714,7 +2153,18 @@ static Image *ReadMIFFImage(const ImageInfo *image_info,
       Read image pixels.
     */
    length=0;
-    switch (image->compression)
+    if (blocks != 0)
+      {
+        /*
+          Read independently compressed blocks of rows.
+        */
+        if (ReadMIFFBlocks(image,image->compression,quantum_type,quantum_size,
+                           packet_size,stored_columns,stored_rows,region.x,
+                           region.y,block_rows,blocks,exception) == MagickFail)
+          status=MagickFail;
+        y=(long) image->rows;
+      }
+    else switch (image->compression)
       {
 #if defined(HasZLIB)
       case ZipCompression:
@@ -2318,6 +2768,346 @@ static void WriteRunlengthPacket(const Image *image,
   ThrowWriterException(code_,reason_,image_); \
 }
 
+#if defined(HasZLIB)
+/*
+  Write the pending record of compressed data.
+*/
+static MagickPassFail
+FlushMIFFDeflateRecord(MIFFDeflateContext *deflate_context)
+{
+  size_t
+    length;
+
+  length=deflate_context->record_length;
+  deflate_context->record_length=0;
+  if (length == 0)
+    return MagickPass;
+  if ((WriteBlobMSBLong(deflate_context->image,(magick_uint32_t) length)
+       != 4) ||
+      (WriteBlob(deflate_context->image,length,deflate_context->record)
+       != length))
+    return MagickFail;
+  return MagickPass;
+}
+
+/*
+  Write compressed data as length-prefixed records of record_size
+  bytes.  The last record is held back until FlushMIFFDeflateRecord()
+  is called, so that it always includes the end of the pixel data.
+  ReadMIFFImage() stops reading once it has all the pixels, so a
+  final record holding just the end of the zlib stream would be left
+  unread.
+*/
+static MagickPassFail
+WriteMIFFDeflateRecords(void *context,const magick_uint8_t *data,
+                        const size_t length)
+{
+  MIFFDeflateContext
+    *deflate_context = (MIFFDeflateContext *) context;
+
+  size_t
+    count,
+    offset;
+
+  for (offset=0; offset < length; offset+=count)
+    {
+      if (deflate_context->record_length == deflate_context->record_size)
+        if (FlushMIFFDeflateRecord(deflate_context) == MagickFail)
+          return MagickFail;
+      count=Min(length-offset,deflate_context->record_size-
+                deflate_context->record_length);
+      (void) memcpy(deflate_context->record+deflate_context->record_length,
+                    data+offset,count);
+      deflate_context->record_length+=count;
+    }
+  return MagickPass;
+}
+#endif /* defined(HasZLIB) */
+
+/*
+  Compress one block of rows.  On entry destination_length is the size
+  of the destination buffer, and on return it is the compressed length.
+*/
+static MagickPassFail
+EncodeMIFFBlock(const CompressionType compression,const int level,
+                const unsigned char *source,const size_t source_length,
+                unsigned char *destination,size_t *destination_length)
+{
+  switch (compression)
+    {
+#if defined(HasZLIB)
+    case ZipCompression:
+      {
+        uLongf
+          length;
+
+        length=(uLongf) *destination_length;
+        if (compress2(destination,&length,source,(uLong) source_length,
+                      level) != Z_OK)
+          return MagickFail;
+        *destination_length=(size_t) length;
+        return MagickPass;
+      }
+#endif /* defined(HasZLIB) */
+#if defined(HasBZLIB)
+    case BZipCompression:
+      {
+        unsigned int
+          length;
+
+        length=(unsigned int) *destination_length;
+        if (BZ2_bzBuffToBuffCompress((char *) destination,&length,
+                                     (char *) source,
+                                     (unsigned int) source_length,
+                                     Max(level,1),0,0) != BZ_OK)
+          return MagickFail;
+        *destination_length=(size_t) length;
+        return MagickPass;
+      }
+#endif /* defined(HasBZLIB) */
+    default:
+      break;
+    }
+  return MagickFail;
+}
+
+/*
+  Return the number of rows per block requested via -define
+  miff:block-rows, limited so that a compressed block length fits the
+  32-bit block index, or zero if the block layout was not requested.
+*/
+static unsigned long
+GetMIFFBlockRows(const ImageInfo *image_info,const Image *image,
+                 const size_t row_size)
+{
+  const char
+    *value;
+
+  long
+    block_rows;
+
+  size_t
+    maximum_rows;
+
+  if ((value=AccessDefinition(image_info,"miff","block-rows")) == NULL)
+    return 0;
+  block_rows=MagickAtoL(value);
+  if (block_rows <= 0)
+    return 0;
+  maximum_rows=(size_t) (4294967295.0/1.01-600.0)/row_size;
+  if ((unsigned long) block_rows > maximum_rows)
+    block_rows=(long) maximum_rows;
+  if ((unsigned long) block_rows > image->rows)
+    block_rows=(long) image->rows;
+  return (unsigned long) block_rows;
+}
+
+/*
+  Write image pixels as independently compressed blocks of block_rows
+  rows, preceded by an index of the compressed length of each block.
+  Several blocks are compressed at a time.  Since the index precedes
+  the blocks, compressed blocks are retained until all of them have
+  been compressed.
+*/
+static MagickPassFail
+WriteMIFFBlocks(const ImageInfo *image_info,Image *image,
+                const CompressionType compression,
+                const QuantumType quantum_type,const unsigned int quantum_size,
+                const size_t packet_size,const unsigned long block_rows)
+{
+  magick_uint32_t
+    *lengths;
+
+  size_t
+    block_size,
+    maximum_length,
+    row_size;
+
+  unsigned char
+    **blocks_data,
+    *pixels;
+
+  unsigned long
+    block,
+    blocks,
+    threads;
+
+  MagickPassFail
+    status=MagickPass;
+
+  row_size=packet_size*image->columns;
+  block_size=row_size*block_rows;
+  maximum_length=block_size+block_size/100+600;
+  blocks=(image->rows+block_rows-1)/block_rows;
+  threads=GetMIFFBlockThreads(blocks);
+  if (image->logging)
+    (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                          "Writing %lu blocks of %lu rows using %lu threads",
+                          blocks,block_rows,threads);
+  lengths=MagickAllocateResourceLimitedClearedArray(magick_uint32_t *,blocks,
+                                                    sizeof(magick_uint32_t));
+  blocks_data=MagickAllocateResourceLimitedClearedArray(unsigned char **,
+                                                        blocks,
+                                                        sizeof(unsigned char *));
+  pixels=MagickAllocateResourceLimitedArray(unsigned char *,threads,
+                                            block_size);
+  if ((lengths == (magick_uint32_t *) NULL) ||
+      (blocks_data == (unsigned char **) NULL) ||
+      (pixels == (unsigned char *) NULL))
+    {
+      MagickFreeResourceLimitedMemory(pixels);
+      MagickFreeResourceLimitedMemory(blocks_data);
+      MagickFreeResourceLimitedMemory(lengths);
+      ThrowException(&image->exception,ResourceLimitError,
+                     MemoryAllocationFailed,image->filename);
+      return MagickFail;
+    }
+  for (block=0; block < blocks; block++)
+    lengths[block]=(magick_uint32_t)
+      (row_size*Min(block_rows,image->rows-block*block_rows));
+  if (compression == NoCompression)
+    for (block=0; block < blocks; block++)
+      (void) WriteBlobMSBLong(image,lengths[block]);
+  for (block=0; (status != MagickFail) && (block < blocks); block+=threads)
+    {
+      long
+        count,
+        i,
+        y;
+
+      unsigned long
+        rows;
+
+      /*
+        Export the rows of the next blocks.
+      */
+      count=(long) Min(threads,blocks-block);
+      rows=Min(count*block_rows,image->rows-block*block_rows);
+      for (y=0; y < (long) rows; y++)
+        {
+          if (AcquireImagePixels(image,0,(long) (block*block_rows)+y,
+                                 image->columns,1,&image->exception)
+              == (const PixelPacket *) NULL)
+            {
+              status=MagickFail;
+              break;
+            }
+          (void) ExportImagePixelArea(image,quantum_type,quantum_size,
+                                      pixels+(size_t) y*row_size,0,0);
+        }
+      if (status == MagickFail)
+        break;
+      if (compression == NoCompression)
+        {
+          if (WriteBlob(image,rows*row_size,pixels) != rows*row_size)
+            status=MagickFail;
+        }
+      else
+        {
+          for (i=0; i < count; i++)
+            {
+              blocks_data[block+i]=
+                MagickAllocateResourceLimitedMemory(unsigned char *,
+                                                    maximum_length);
+              if (blocks_data[block+i] == (unsigned char *) NULL)
+                {
+                  ThrowException(&image->exception,ResourceLimitError,
+                                 MemoryAllocationFailed,image->filename);
+                  status=MagickFail;
+                  break;
+                }
+            }
+          if (status == MagickFail)
+            break;
+#if defined(HAVE_OPENMP)
+#  pragma omp parallel for num_threads(threads) schedule(static,1)
+#endif
+          for (i=0; i < count; i++)
+            {
+              size_t
+                length;
+
+              MagickPassFail
+                thread_status;
+
+              thread_status=status;
+              if (thread_status == MagickFail)
+                continue;
+
+              length=maximum_length;
+              thread_status=
+                EncodeMIFFBlock(compression,
+                                (int) Min(image_info->quality/10,9),
+                                pixels+i*block_size,lengths[block+i],
+                                blocks_data[block+i],&length);
+              lengths[block+i]=(magick_uint32_t) length;
+
+              if (thread_status == MagickFail)
+                {
+                  status=MagickFail;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (status)
+#endif
+                }
+            }
+          if (status == MagickFail)
+            {
+              if (compression == ZipCompression)
+                ThrowException(&image->exception,CoderError,
+                               UnableToZipCompressImage,image->filename);
+              else
+                ThrowException(&image->exception,ResourceLimitError,
+                               MemoryAllocationFailed,image->filename);
+              break;
+            }
+          /*
+            Release the unused part of the compressed blocks.
+          */
+          for (i=0; i < count; i++)
+            {
+              blocks_data[block+i]=
+                MagickReallocateResourceLimitedMemory(unsigned char *,
+                                                      blocks_data[block+i],
+                                                      lengths[block+i]);
+              if (blocks_data[block+i] == (unsigned char *) NULL)
+                {
+                  ThrowException(&image->exception,ResourceLimitError,
+                                 MemoryAllocationFailed,image->filename);
+                  status=MagickFail;
+                  break;
+                }
+            }
+        }
+      if (image->previous == (Image *) NULL)
+        if (!MagickMonitorFormatted(block*block_rows+rows-1,image->rows,
+                                    &image->exception,SaveImageText,
+                                    image->filename,image->columns,
+                                    image->rows))
+          status=MagickFail;
+    }
+  if ((status != MagickFail) && (compression != NoCompression))
+    {
+      /*
+        Write block index followed by the blocks.
+      */
+      for (block=0; block < blocks; block++)
+        (void) WriteBlobMSBLong(image,lengths[block]);
+      for (block=0; block < blocks; block++)
+        if (WriteBlob(image,lengths[block],blocks_data[block]) !=
+            lengths[block])
+          {
+            status=MagickFail;
+            break;
+          }
+    }
+  for (block=0; block < blocks; block++)
+    MagickFreeResourceLimitedMemory(blocks_data[block]);
+  MagickFreeResourceLimitedMemory(blocks_data);
+  MagickFreeResourceLimitedMemory(pixels);
+  MagickFreeResourceLimitedMemory(lengths);
+  return status;
+}
+
 static unsigned int WriteMIFFImage(const ImageInfo *image_info,Image *image)
 {
 
@@ -2375,6 +3165,7 @@ static unsigned int WriteMIFFImage(const ImageInfo *image_info,Image *image)
     quantum_size;
 
   unsigned long
+    block_rows,
     packet_size,
     scene;
 
@@ -2393,6 +3184,12 @@ static unsigned int WriteMIFFImage(const ImageInfo *image_info,Image *image)
 #if defined(HasZLIB)
   z_stream
     zip_info;
+
+  MIFFDeflateContext
+    deflate_context;
+
+  ParallelDeflateInfo
+    *parallel_deflate = (ParallelDeflateInfo *) NULL;
 #endif
 
   size_t
@@ -2468,10 +3265,20 @@ static unsigned int WriteMIFFImage(const ImageInfo *image_info,Image *image)
     if ((pixels == (unsigned char *) NULL) ||
         (compress_pixels == (unsigned char *) NULL))
       ThrowMIFFWriterException(ResourceLimitError,MemoryAllocationFailed,image);
+    /*
+      Store pixels as independently compressed blocks of rows if
+      requested via -define miff:block-rows.
+    */
+    block_rows=0;
+    if (compression != RLECompression)
+      block_rows=GetMIFFBlockRows(image_info,image,packet_size*image->columns);
     /*
       Write MIFF header.
     */
-    (void) WriteBlobString(image,"id=ImageMagick  version=1.0\n");
+    if (block_rows != 0)
+      (void) WriteBlobString(image,"id=" MIFFBlocksId "  version=1.0\n");
+    else
+      (void) WriteBlobString(image,"id=ImageMagick  version=1.0\n");
     if (image->storage_class == PseudoClass)
       FormatString(buffer,"class=PseudoClass  colors=%u  matte=%.1024s\n",
                    image->colors,MagickBoolToString(image->matte));
@@ -2510,6 +3317,12 @@ static unsigned int WriteMIFFImage(const ImageInfo *image_info,Image *image)
     FormatString(buffer,"columns=%lu  rows=%lu  depth=%u\n",image->columns,
       image->rows,depth);
     (void) WriteBlobString(image,buffer);
+    if (block_rows != 0)
+      {
+        FormatString(buffer,"block-rows=%lu  blocks=%lu\n",block_rows,
+                     (image->rows+block_rows-1)/block_rows);
+        (void) WriteBlobString(image,buffer);
+      }
     if ((image->x_resolution != 0) && (image->y_resolution != 0))
       {
         char
@@ -2813,6 +3626,13 @@ static unsigned int WriteMIFFImage(const ImageInfo *image_info,Image *image)
     (void) LogMagickEvent(CoderEvent,GetMagickModule(),
                           "Using QuantumType %s, depth %u",
                           QuantumTypeToString(quantum_type),quantum_size);
+    if (block_rows != 0)
+      {
+        if (WriteMIFFBlocks(image_info,image,compression,quantum_type,
+                            quantum_size,packet_size,block_rows) == MagickFail)
+          status=False;
+      }
+    else
     for (y=0; y < (long) image->rows; y++)
     {
       p=AcquireImagePixels(image,0,y,image->columns,1,&image->exception);
@@ -2830,11 +3650,49 @@ static unsigned int WriteMIFFImage(const ImageInfo *image_info,Image *image)
 
           if (y == 0)
             {
-              zip_info.zalloc=ZLIBAllocFunc;
-              zip_info.zfree=ZLIBFreeFunc;
-              zip_info.opaque=(voidpf) NULL;
-              code=deflateInit(&zip_info,(int) Min(image_info->quality/10,9));
-              status|=code >= 0;
+              size_t
+                block_size;
+
+              /*
+                Compress blocks of rows concurrently if requested via
+                -define miff:deflate-block-size.
+              */
+              if ((block_size=GetParallelDeflateBlockSize(image_info,"miff")) != 0)
+                {
+                  deflate_context.image=image;
+                  deflate_context.record=compress_pixels;
+                  deflate_context.record_length=0;
+                  deflate_context.record_size=packet_size*image->columns+256;
+                  parallel_deflate=
+                    AllocateParallelDeflate((int) Min(image_info->quality/10,9),
+                                            Z_DEFAULT_STRATEGY,block_size,
+                                            WriteMIFFDeflateRecords,
+                                            &deflate_context);
+                }
+              if (parallel_deflate == (ParallelDeflateInfo *) NULL)
+                {
+                  zip_info.zalloc=ZLIBAllocFunc;
+                  zip_info.zfree=ZLIBFreeFunc;
+                  zip_info.opaque=(voidpf) NULL;
+                  code=deflateInit(&zip_info,(int) Min(image_info->quality/10,9));
+                  status|=code >= 0;
+                }
+            }
+          if (parallel_deflate != (ParallelDeflateInfo *) NULL)
+            {
+              (void) ExportImagePixelArea(image,quantum_type,quantum_size,pixels,0,0);
+              if (ParallelDeflateWrite(parallel_deflate,pixels,
+                                       packet_size*image->columns) == MagickFail)
+                status=False;
+              if (y == (long) (image->rows-1))
+                {
+                  if ((FinishParallelDeflate(parallel_deflate) == MagickFail) ||
+                      (FlushMIFFDeflateRecord(&deflate_context) == MagickFail))
+                    status=False;
+                  DestroyParallelDeflate(parallel_deflate);
+                  parallel_deflate=(ParallelDeflateInfo *) NULL;
+                }
+              break;
             }
           zip_info.next_in=pixels;
           zip_info.avail_in=(uInt) (packet_size*image->columns);
@@ -2965,8 +3823,14 @@ static unsigned int WriteMIFFImage(const ImageInfo *image_info,Image *image)
                                       image->columns,image->rows))
             break;
     }
+#if defined(HasZLIB)
+    DestroyParallelDeflate(parallel_deflate);
+    parallel_deflate=(ParallelDeflateInfo *) NULL;
+#endif
     MagickFreeResourceLimitedMemory(pixels);
     MagickFreeResourceLimitedMemory(compress_pixels);
+    if (status == False)
+      break;
     if (image->next == (Image *) NULL)
       break;
     image=SyncNextImageInList(image);
@@ -46,6 +46,7 @@
 #include "magick/monitor.h"
 #include "magick/pixel_cache.h"
 #include "magick/profile.h"
+#include "magick/signature.h"
 #include "magick/utility.h"
 
 /*
@@ -91,6 +92,289 @@ static MagickBool IsMPC(const unsigned char *magick,const size_t length)
     return(MagickTrue);
   return(MagickFalse);
 }
+
+/*
+  The optional index file (-define mpc:index) which accompanies an MPC
+  file records where the header and pixel cache of each frame reside,
+  along with a SHA-256 digest of the header.  A frame may then be
+  located without parsing the frames preceding it, and its header is
+  validated before it is attached.  The index consists of a 56 byte
+  header, which records the length and modification time of the MPC and
+  cache files, followed by one fixed-length record per frame.  All values
+  are stored in big-endian order.  The index only serves to accelerate
+  reading, so an index which does not match its files is ignored.
+*/
+#define MPCIndexMagick "MagickCacheIndex"
+#define MPCIndexMagickLength 16
+#define MPCIndexVersion 1U
+#define MPCIndexHeaderLength 56
+#define MPCIndexRecordLength 80
+#define MPCIndexDigestLength 32
+
+typedef struct _MPCIndexRecord
+{
+  magick_uint64_t
+    header_offset,
+    header_length,
+    cache_offset,
+    cache_length;
+
+  unsigned long
+    scene,
+    columns,
+    rows;
+
+  unsigned char
+    digest[MPCIndexDigestLength];
+} MPCIndexRecord;
+
+static void
+StoreMPCIndexValue(unsigned char *q,magick_uint64_t value,
+                   unsigned int octets)
+{
+  while (octets > 0)
+    {
+      octets--;
+      q[octets]=(unsigned char) (value & 0xff);
+      value >>= 8;
+    }
+}
+
+static magick_uint64_t
+LoadMPCIndexValue(const unsigned char *p,const unsigned int octets)
+{
+  magick_uint64_t
+    value;
+
+  unsigned int
+    i;
+
+  value=0;
+  for (i=0; i < octets; i++)
+    value=(value << 8) | p[i];
+  return(value);
+}
+
+static void
+FinalizeMPCHeaderDigest(SignatureInfo *signature_info,unsigned char *digest)
+{
+  unsigned int
+    i;
+
+  FinalizeSignature(signature_info);
+  for (i=0; i < 8; i++)
+    StoreMPCIndexValue(digest+4*i,signature_info->digest[i] & 0xffffffffUL,4);
+}
+
+static void
+GetMPCFileAttributes(const char *filename,magick_uint64_t *length,
+                     magick_uint64_t *modified)
+{
+  MagickStatStruct_t
+    attributes;
+
+  *length=0;
+  *modified=0;
+  if (MagickStat(filename,&attributes) != 0)
+    return;
+  *length=(magick_uint64_t) attributes.st_size;
+  *modified=(magick_uint64_t) attributes.st_mtime;
+}
+
+/*
+  Verify that the index records describe contiguous frame headers and
+  pixel caches which lie within the MPC and cache files.
+*/
+static MagickPassFail
+CheckMPCIndexRecords(const MPCIndexRecord *records,const size_t frames,
+                     const magick_uint64_t mpc_length,
+                     const magick_uint64_t cache_length)
+{
+  size_t
+    i;
+
+  for (i=0; i < frames; i++)
+    {
+      if ((records[i].header_length == 0) ||
+          (records[i].header_offset > mpc_length) ||
+          (records[i].header_length > mpc_length-records[i].header_offset) ||
+          (records[i].cache_offset >= cache_length) ||
+          (records[i].columns == 0) || (records[i].rows == 0))
+        return(MagickFail);
+      if (i == 0)
+        {
+          if ((records[i].header_offset != 0) ||
+              (records[i].cache_offset != 0))
+            return(MagickFail);
+        }
+      else if ((records[i].header_offset != records[i-1].header_offset+
+                records[i-1].header_length) ||
+               (records[i].cache_offset != records[i-1].cache_offset+
+                records[i-1].cache_length))
+        return(MagickFail);
+    }
+  if (cache_length-records[frames-1].cache_offset >
+      records[frames-1].cache_length)
+    return(MagickFail);
+  return(MagickPass);
+}
+
+/*
+  Load the index which accompanies an MPC file.  An index which does not
+  describe the current MPC and pixel cache files is ignored.
+*/
+static MPCIndexRecord *
+ReadMPCIndex(const char *index_filename,const char *mpc_filename,
+             const char *cache_filename,size_t *frames)
+{
+  ExceptionInfo
+    exception;
+
+  const char
+    *reason;
+
+  MPCIndexRecord
+    *records;
+
+  const unsigned char
+    *p;
+
+  unsigned char
+    *index;
+
+  magick_uint64_t
+    cache_length,
+    cache_modified,
+    mpc_length,
+    mpc_modified;
+
+  size_t
+    i,
+    length;
+
+  *frames=0;
+  if (!IsAccessibleNoLogging(index_filename))
+    return((MPCIndexRecord *) NULL);
+  GetMPCFileAttributes(mpc_filename,&mpc_length,&mpc_modified);
+  GetMPCFileAttributes(cache_filename,&cache_length,&cache_modified);
+  records=(MPCIndexRecord *) NULL;
+  reason=(const char *) NULL;
+  length=0;
+  GetExceptionInfo(&exception);
+  index=(unsigned char *) FileToBlob(index_filename,&length,&exception);
+  DestroyExceptionInfo(&exception);
+  if (index == (unsigned char *) NULL)
+    reason="unreadable";
+  else if ((length < MPCIndexHeaderLength) ||
+           (memcmp(index,MPCIndexMagick,MPCIndexMagickLength) != 0) ||
+           (LoadMPCIndexValue(index+16,4) != MPCIndexVersion))
+    reason="unsupported format";
+  else
+    {
+      *frames=(size_t) LoadMPCIndexValue(index+20,4);
+      if ((*frames == 0) ||
+          (((length-MPCIndexHeaderLength) % MPCIndexRecordLength) != 0) ||
+          (((length-MPCIndexHeaderLength)/MPCIndexRecordLength) != *frames))
+        reason="improper length";
+      else if ((LoadMPCIndexValue(index+24,8) != mpc_length) ||
+               (LoadMPCIndexValue(index+40,8) != mpc_modified))
+        reason="MPC file has changed";
+      else if ((LoadMPCIndexValue(index+32,8) != cache_length) ||
+               (LoadMPCIndexValue(index+48,8) != cache_modified))
+        reason="cache file has changed";
+      else
+        {
+          records=MagickAllocateArray(MPCIndexRecord *,*frames,
+                                      sizeof(MPCIndexRecord));
+          if (records == (MPCIndexRecord *) NULL)
+            reason="memory allocation failed";
+        }
+    }
+  if (records != (MPCIndexRecord *) NULL)
+    {
+      p=index+MPCIndexHeaderLength;
+      for (i=0; i < *frames; i++)
+        {
+          records[i].header_offset=LoadMPCIndexValue(p,8);
+          records[i].header_length=LoadMPCIndexValue(p+8,8);
+          records[i].cache_offset=LoadMPCIndexValue(p+16,8);
+          records[i].cache_length=LoadMPCIndexValue(p+24,8);
+          records[i].scene=(unsigned long) LoadMPCIndexValue(p+32,4);
+          records[i].columns=(unsigned long) LoadMPCIndexValue(p+36,4);
+          records[i].rows=(unsigned long) LoadMPCIndexValue(p+40,4);
+          (void) memcpy(records[i].digest,p+48,MPCIndexDigestLength);
+          p+=MPCIndexRecordLength;
+        }
+      if (CheckMPCIndexRecords(records,*frames,mpc_length,cache_length)
+          == MagickFail)
+        {
+          MagickFreeMemory(records);
+          reason="inconsistent frame records";
+        }
+    }
+  if (records != (MPCIndexRecord *) NULL)
+    {
+      (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                            "Using MPC index %.1024s (%lu frames)",
+                            index_filename,(unsigned long) *frames);
+    }
+  else
+    {
+      *frames=0;
+      (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                            "Ignoring MPC index %.1024s (%s)",
+                            index_filename,reason);
+    }
+  MagickFreeMemory(index);
+  return(records);
+}
+
+/*
+  Verify that the frame header which starts one byte before the current
+  blob position matches its index record.  The blob is left positioned
+  where it was found.
+*/
+static MagickPassFail
+ValidateMPCHeader(Image *image,const MPCIndexRecord *record)
+{
+  SignatureInfo
+    signature_info;
+
+  magick_uint64_t
+    remaining;
+
+  size_t
+    count;
+
+  unsigned char
+    buffer[8192],
+    digest[MPCIndexDigestLength];
+
+  if ((magick_uint64_t) TellBlob(image) != record->header_offset+1)
+    return(MagickFail);
+  if (SeekBlob(image,(magick_off_t) record->header_offset,SEEK_SET) < 0)
+    return(MagickFail);
+  GetSignatureInfo(&signature_info);
+  for (remaining=record->header_length; remaining != 0; remaining-=count)
+    {
+      count=(size_t) Min(remaining,sizeof(buffer));
+      if (ReadBlob(image,count,buffer) != count)
+        return(MagickFail);
+      UpdateSignature(&signature_info,buffer,count);
+    }
+  FinalizeMPCHeaderDigest(&signature_info,digest);
+  if (SeekBlob(image,(magick_off_t) record->header_offset+1,SEEK_SET) < 0)
+    return(MagickFail);
+  if (memcmp(digest,record->digest,MPCIndexDigestLength) != 0)
+    {
+      (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                            "MPC header digest at offset %" MAGICK_UINT64_F
+                            "u does not match the index",
+                            record->header_offset);
+      return(MagickFail);
+    }
+  return(MagickPass);
+}
 
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -130,6 +414,7 @@ static MagickBool IsMPC(const unsigned char *magick,const size_t length)
 do { \
   MagickFreeResourceLimitedMemory(comment); \
   MagickFreeResourceLimitedMemory(values); \
+  MagickFreeMemory(index_records); \
   if (number_of_profiles > 0) \
     { \
       unsigned int _index; \
@@ -144,13 +429,44 @@ do { \
   ThrowReaderException(code_,reason_,image_); \
 } while (0);
 
+/*
+  Discard the frames read using an index which does not match the MPC
+  file, and read the file again from the start without the index.
+*/
+#define RereadMPCWithoutIndex(image_) \
+do { \
+  (void) LogMagickEvent(CoderEvent,GetMagickModule(), \
+                        "Ignoring MPC index %.1024s (frame %lu does not" \
+                        " match)",index_filename,(unsigned long) frame); \
+  MagickFreeResourceLimitedMemory(comment); \
+  MagickFreeResourceLimitedMemory(values); \
+  MagickFreeMemory(index_records); \
+  if (number_of_profiles > 0) \
+    { \
+      unsigned int _index; \
+      for (_index=0; _index < number_of_profiles; _index++) \
+        { \
+          MagickFreeMemory(profiles[_index].name); \
+          MagickFreeResourceLimitedMemory(profiles[_index].info); \
+        } \
+      MagickFreeResourceLimitedMemory(profiles); \
+      number_of_profiles=0; \
+    } \
+  CloseBlob(image_); \
+  DestroyImageList(image_); \
+  return(ReadMPCFrames(image_info,MagickFalse,exception)); \
+} while (0);
+
 #define ReadMPCMaxKeyWordCount 256 /* Arbitrary limit on number of keywords in MPC frame */
 
-static Image *ReadMPCImage(const ImageInfo *image_info,ExceptionInfo *exception)
+static Image *ReadMPCFrames(const ImageInfo *image_info,
+                            const MagickBool use_index,
+                            ExceptionInfo *exception)
 {
   char
     cache_filename[MaxTextExtent],
     id[MaxTextExtent],
+    index_filename[MaxTextExtent],
     keyword[MaxTextExtent];
 
   ExtendedSignedIntegralType
@@ -162,6 +478,13 @@ static Image *ReadMPCImage(const ImageInfo *image_info,ExceptionInfo *exception)
   int
     c;
 
+  MPCIndexRecord
+    *index_records=(MPCIndexRecord *) NULL;
+
+  size_t
+    frame=0,
+    index_frames=0;
+
   register unsigned long
     i;
 
@@ -209,16 +532,58 @@ static Image *ReadMPCImage(const ImageInfo *image_info,ExceptionInfo *exception)
     ThrowReaderException(FileOpenError,UnableToOpenFile,image);
   (void) strlcpy(cache_filename,image->filename,MaxTextExtent);
   AppendImageFormat("cache",cache_filename);
+  (void) strlcpy(index_filename,image->filename,MaxTextExtent);
+  AppendImageFormat("index",index_filename);
+  if (use_index && BlobIsSeekable(image))
+    index_records=ReadMPCIndex(index_filename,image->filename,
+                               cache_filename,&index_frames);
+  *id='\0';
+  offset=0;
+  if ((index_records != (MPCIndexRecord *) NULL) &&
+      (image_info->subrange != 0))
+    {
+      unsigned long
+        number;
+
+      /*
+        Seek directly to the first requested frame, numbering frames as
+        ReadImage() does when selecting them.
+      */
+      number=0;
+      for (i=0; i < index_frames; i++)
+        {
+          if (index_records[i].scene != 0)
+            number=index_records[i].scene;
+          if (number == image_info->subimage)
+            break;
+          number++;
+        }
+      if ((i != 0) && (i < index_frames))
+        {
+          frame=i;
+          if (SeekBlob(image,(magick_off_t) index_records[i].header_offset,
+                       SEEK_SET) < 0)
+            RereadMPCWithoutIndex(image);
+          offset=(ExtendedSignedIntegralType) index_records[i].cache_offset;
+          image->scene=number;
+        }
+    }
   c=ReadBlobByte(image);
   if (c == EOF)
     {
+      MagickFreeMemory(index_records);
       DestroyImage(image);
       return((Image *) NULL);
     }
-  *id='\0';
-  offset=0;
   do
   {
+    /*
+      Validate the header against the index.
+    */
+    if (index_records != (MPCIndexRecord *) NULL)
+      if ((frame >= index_frames) ||
+          (ValidateMPCHeader(image,&index_records[frame]) == MagickFail))
+        RereadMPCWithoutIndex(image);
     /*
       Decode image header;  header terminates one character beyond a ':'.
     */
@@ -957,6 +1322,15 @@ static Image *ReadMPCImage(const ImageInfo *image_info,ExceptionInfo *exception)
           image->filename);
         break;
       }
+    if (index_records != (MPCIndexRecord *) NULL)
+      if (((magick_uint64_t) TellBlob(image) !=
+           index_records[frame].header_offset+
+           index_records[frame].header_length) ||
+          (!image_info->ping &&
+           ((magick_uint64_t) offset != index_records[frame].cache_offset)) ||
+          (image->columns != index_records[frame].columns) ||
+          (image->rows != index_records[frame].rows))
+        RereadMPCWithoutIndex(image);
     if (image_info->ping && (image_info->subrange != 0))
       if (image->scene >= (image_info->subimage+image_info->subrange-1))
         break;
@@ -971,6 +1345,10 @@ static Image *ReadMPCImage(const ImageInfo *image_info,ExceptionInfo *exception)
     if (status == MagickFail)
       ThrowMPCReaderException(CacheError,UnableToPeristPixelCache,image);
     StopTimer(&image->timer);
+    frame++;
+    if (image_info->subrange != 0)
+      if (image->scene >= (image_info->subimage+image_info->subrange-1))
+        break;
     /*
       Proceed to next image.
     */
@@ -986,6 +1364,7 @@ static Image *ReadMPCImage(const ImageInfo *image_info,ExceptionInfo *exception)
         AllocateNextImage(image_info,image);
         if (image->next == (Image *) NULL)
           {
+            MagickFreeMemory(index_records);
             DestroyImageList(image);
             return((Image *) NULL);
           }
@@ -997,11 +1376,17 @@ static Image *ReadMPCImage(const ImageInfo *image_info,ExceptionInfo *exception)
           break;
       }
   } while (c != EOF);
+  MagickFreeMemory(index_records);
   while (image->previous != (Image *) NULL)
     image=image->previous;
   CloseBlob(image);
   return(image);
 }
+
+static Image *ReadMPCImage(const ImageInfo *image_info,ExceptionInfo *exception)
+{
+  return(ReadMPCFrames(image_info,MagickTrue,exception));
+}
 
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -1073,6 +1458,137 @@ ModuleExport void UnregisterMPCImage(void)
   (void) UnregisterMagickInfo("MPC");
 }
 
+/*
+  Write the index which accompanies an MPC file, taking the header
+  digests from the MPC file as written.
+*/
+static MagickPassFail
+WriteMPCIndex(Image *image,const char *index_filename,
+              const char *cache_filename,MPCIndexRecord *records,
+              const size_t frames)
+{
+  SignatureInfo
+    signature_info;
+
+  MagickPassFail
+    status;
+
+  magick_uint64_t
+    cache_length,
+    cache_modified,
+    mpc_file_length,
+    mpc_modified;
+
+  size_t
+    i,
+    length,
+    mpc_length;
+
+  unsigned char
+    *index,
+    *mpc,
+    *q;
+
+  mpc=(unsigned char *) FileToBlob(image->filename,&mpc_length,
+                                   &image->exception);
+  if (mpc == (unsigned char *) NULL)
+    return(MagickFail);
+  length=MPCIndexHeaderLength+frames*MPCIndexRecordLength;
+  index=MagickAllocateMemory(unsigned char *,length);
+  if (index == (unsigned char *) NULL)
+    {
+      MagickFreeMemory(mpc);
+      ThrowException(&image->exception,ResourceLimitError,
+                     MemoryAllocationFailed,image->filename);
+      return(MagickFail);
+    }
+  (void) memcpy(index,MPCIndexMagick,MPCIndexMagickLength);
+  StoreMPCIndexValue(index+16,MPCIndexVersion,4);
+  StoreMPCIndexValue(index+20,frames,4);
+  GetMPCFileAttributes(image->filename,&mpc_file_length,&mpc_modified);
+  GetMPCFileAttributes(cache_filename,&cache_length,&cache_modified);
+  StoreMPCIndexValue(index+24,mpc_file_length,8);
+  StoreMPCIndexValue(index+32,cache_length,8);
+  StoreMPCIndexValue(index+40,mpc_modified,8);
+  StoreMPCIndexValue(index+48,cache_modified,8);
+  status=MagickPass;
+  q=index+MPCIndexHeaderLength;
+  for (i=0; i < frames; i++)
+    {
+      if (records[i].header_offset+records[i].header_length > mpc_length)
+        {
+          ThrowException(&image->exception,CorruptImageError,
+                         UnexpectedEndOfFile,image->filename);
+          status=MagickFail;
+          break;
+        }
+      GetSignatureInfo(&signature_info);
+      UpdateSignature(&signature_info,mpc+records[i].header_offset,
+                      (size_t) records[i].header_length);
+      FinalizeMPCHeaderDigest(&signature_info,records[i].digest);
+      StoreMPCIndexValue(q,records[i].header_offset,8);
+      StoreMPCIndexValue(q+8,records[i].header_length,8);
+      StoreMPCIndexValue(q+16,records[i].cache_offset,8);
+      StoreMPCIndexValue(q+24,records[i].cache_length,8);
+      StoreMPCIndexValue(q+32,records[i].scene,4);
+      StoreMPCIndexValue(q+36,records[i].columns,4);
+      StoreMPCIndexValue(q+40,records[i].rows,4);
+      StoreMPCIndexValue(q+44,0,4);
+      (void) memcpy(q+48,records[i].digest,MPCIndexDigestLength);
+      q+=MPCIndexRecordLength;
+    }
+  if (status != MagickFail)
+    {
+      FILE
+        *file;
+
+      if ((file=fopen(index_filename,"wb")) == (FILE *) NULL)
+        status=MagickFail;
+      else
+        {
+          if (fwrite(index,1,length,file) != length)
+            status=MagickFail;
+          if (fclose(file) != 0)
+            status=MagickFail;
+        }
+      if (status == MagickFail)
+        ThrowException(&image->exception,BlobError,UnableToWriteBlob,
+                       index_filename);
+    }
+  MagickFreeMemory(index);
+  MagickFreeMemory(mpc);
+  return(status);
+}
+
+/*
+  Remove an index left by a previous write of the same MPC file, which
+  would no longer describe it.  Only files holding an MPC index are
+  removed.
+*/
+static void
+RemoveMPCIndex(const char *index_filename)
+{
+  char
+    magick[MPCIndexMagickLength];
+
+  FILE
+    *file;
+
+  MagickBool
+    is_index;
+
+  is_index=MagickFalse;
+  if ((file=fopen(index_filename,"rb")) != (FILE *) NULL)
+    {
+      is_index=((fread(magick,1,MPCIndexMagickLength,file) ==
+                 MPCIndexMagickLength) &&
+                (memcmp(magick,MPCIndexMagick,MPCIndexMagickLength) == 0));
+      (void) fclose(file);
+    }
+  if (is_index)
+    (void) remove(index_filename);
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -1106,7 +1622,8 @@ static MagickPassFail WriteMPCImage(const ImageInfo *image_info,Image *image)
 {
   char
     buffer[MaxTextExtent],
-    cache_filename[MaxTextExtent];
+    cache_filename[MaxTextExtent],
+    index_filename[MaxTextExtent];
 
   const ImageAttribute
     *attribute;
@@ -1114,6 +1631,15 @@ static MagickPassFail WriteMPCImage(const ImageInfo *image_info,Image *image)
   ExtendedSignedIntegralType
     offset;
 
+  MPCIndexRecord
+    *index_records;
+
+  size_t
+    index_frames;
+
+  magick_off_t
+    header_offset;
+
   register unsigned long
     i;
 
@@ -1151,6 +1677,18 @@ static MagickPassFail WriteMPCImage(const ImageInfo *image_info,Image *image)
     ThrowWriterException(FileOpenError,UnableToOpenFile,image);
   (void) strlcpy(cache_filename,image->filename,MaxTextExtent);
   AppendImageFormat("cache",cache_filename);
+  (void) strlcpy(index_filename,image->filename,MaxTextExtent);
+  AppendImageFormat("index",index_filename);
+  index_records=(MPCIndexRecord *) NULL;
+  index_frames=0;
+  if ((AccessDefinition(image_info,"mpc","index") != (const char *) NULL) &&
+      (GetBlobFileHandle(image) != (FILE *) NULL))
+    {
+      index_records=MagickAllocateArray(MPCIndexRecord *,image_list_length,
+                                        sizeof(MPCIndexRecord));
+      if (index_records == (MPCIndexRecord *) NULL)
+        ThrowWriterException(ResourceLimitError,MemoryAllocationFailed,image);
+    }
   scene=0;
   offset=0;
   do
@@ -1158,6 +1696,7 @@ static MagickPassFail WriteMPCImage(const ImageInfo *image_info,Image *image)
     /*
       Write persistent cache meta-information.
     */
+    header_offset=TellBlob(image);
     (void) WriteBlobString(image,"id=MagickCache\n");
     FormatString(buffer,"quantum-depth=%d\n",QuantumDepth);
     (void) WriteBlobString(image,buffer);
@@ -1432,7 +1971,10 @@ static MagickPassFail WriteMPCImage(const ImageInfo *image_info,Image *image)
         packet_size=image->depth > 8 ? 6 : 3;
         colormap=MagickAllocateResourceLimitedArray(unsigned char *,packet_size,image->colors);
         if (colormap == (unsigned char *) NULL)
-          return(MagickFail);
+          {
+            MagickFreeMemory(index_records);
+            return(MagickFail);
+          }
         /*
           Write colormap to file.
         */
@@ -1460,12 +2002,30 @@ static MagickPassFail WriteMPCImage(const ImageInfo *image_info,Image *image)
         (void) WriteBlob(image, (size_t) packet_size*image->colors,colormap);
         MagickFreeResourceLimitedMemory(colormap);
       }
+    if (index_records != (MPCIndexRecord *) NULL)
+      {
+        index_records[index_frames].header_offset=header_offset;
+        index_records[index_frames].header_length=TellBlob(image)-header_offset;
+        index_records[index_frames].cache_offset=offset;
+        index_records[index_frames].scene=image->scene;
+        index_records[index_frames].columns=image->columns;
+        index_records[index_frames].rows=image->rows;
+      }
     /*
       Initialize persistent pixel cache.
     */
     status=PersistCache(image,cache_filename,MagickFalse,&offset,&image->exception);
     if (status == MagickFail)
-      ThrowWriterException(CacheError,UnableToPeristPixelCache,image);
+      {
+        MagickFreeMemory(index_records);
+        ThrowWriterException(CacheError,UnableToPeristPixelCache,image);
+      }
+    if (index_records != (MPCIndexRecord *) NULL)
+      {
+        index_records[index_frames].cache_length=
+          offset-index_records[index_frames].cache_offset;
+        index_frames++;
+      }
     if (image->next == (Image *) NULL)
       break;
     image=SyncNextImageInList(image);
@@ -1479,5 +2039,14 @@ static MagickPassFail WriteMPCImage(const ImageInfo *image_info,Image *image)
     while (image->previous != (Image *) NULL)
       image=image->previous;
   CloseBlob(image);
+  if (index_records != (MPCIndexRecord *) NULL)
+    {
+      if (status != MagickFail)
+        status=WriteMPCIndex(image,index_filename,cache_filename,
+                             index_records,index_frames);
+      MagickFreeMemory(index_records);
+    }
+  else
+    RemoveMPCIndex(index_filename);
   return(status);
 }
@@ -350,6 +350,7 @@ static Image *ReadPDFImage(const ImageInfo *image_info,ExceptionInfo *exception)
       }
   }
 
+  RecordBlobSpill(image_info->magick,(magick_uint64_t) ftell(file));
   (void) fclose(file);
   CloseBlob(image);
   /*
@@ -62,6 +62,7 @@
 #include "magick/channel.h"
 #include "magick/color.h"
 #include "magick/colormap.h"
+#include "magick/compress-private.h"
 #include "magick/constitute.h"
 #include "magick/enhance.h"
 #include "magick/log.h"
@@ -916,6 +917,189 @@ static void png_put_data(png_structp png_ptr,png_bytep data,png_size_t length)
     }
 }
 
+/*
+  Parallel IDAT compression (-define png:deflate-block-size).  libpng is
+  asked to store the filtered rows without compression.  The IDAT data
+  it writes is inflated again as it arrives and passed to a parallel
+  deflate stream, which writes new IDAT chunks.  Other chunks are passed
+  through unchanged.
+*/
+#define PNGDeflateIDATSize 65536U
+
+typedef struct _PNGDeflateInfo
+{
+  Image
+    *image;
+
+  ParallelDeflateInfo
+    *deflate;
+
+  z_stream
+    stream;             /* Inflates the IDAT data written by libpng */
+
+  MagickBool
+    stream_initialized,
+    stream_ended,
+    idat;               /* Current chunk is IDAT */
+
+  unsigned char
+    header[8],          /* Current chunk length and type */
+    buffer[PNGDeflateIDATSize];
+
+  size_t
+    header_length,
+    remaining;          /* Bytes of current chunk data and CRC to come */
+} PNGDeflateInfo;
+
+/*
+  Write compressed data as IDAT chunks.
+*/
+static MagickPassFail png_write_deflated_idat(void *context,
+  const magick_uint8_t *data,const size_t length)
+{
+  PNGDeflateInfo
+    *info = (PNGDeflateInfo *) context;
+
+  size_t
+    count,
+    offset;
+
+  unsigned char
+    chunk[4];
+
+  for (offset=0; offset < length; offset+=count)
+    {
+      count=Min(length-offset,PNGDeflateIDATSize);
+      PNGType(chunk,mng_IDAT);
+      if ((WriteBlobMSBULong(info->image,(magick_uint32_t) count) != 4) ||
+          (WriteBlob(info->image,4,chunk) != 4) ||
+          (WriteBlob(info->image,count,data+offset) != count) ||
+          (WriteBlobMSBULong(info->image,
+                             crc32(crc32(0,chunk,4),data+offset,(uInt) count))
+           != 4))
+        return MagickFail;
+    }
+  return MagickPass;
+}
+
+/*
+  Inflate IDAT data written by libpng and pass it to the parallel
+  deflate stream.
+*/
+static MagickPassFail png_inflate_idat(PNGDeflateInfo *info,
+  png_bytep data,const size_t length)
+{
+  int
+    code;
+
+  if (!info->stream_initialized)
+    {
+      if (inflateInit(&info->stream) != Z_OK)
+        return MagickFail;
+      info->stream_initialized=MagickTrue;
+    }
+  info->stream.next_in=data;
+  info->stream.avail_in=(uInt) length;
+  while ((info->stream.avail_in != 0) && !info->stream_ended)
+    {
+      info->stream.next_out=info->buffer;
+      info->stream.avail_out=(uInt) sizeof(info->buffer);
+      code=inflate(&info->stream,Z_NO_FLUSH);
+      if (code == Z_STREAM_END)
+        info->stream_ended=MagickTrue;
+      else if (code != Z_OK)
+        return MagickFail;
+      if (ParallelDeflateWrite(info->deflate,info->buffer,
+                               sizeof(info->buffer)-info->stream.avail_out)
+          == MagickFail)
+        return MagickFail;
+    }
+  return MagickPass;
+}
+
+static void png_put_deflated_data(png_structp png_ptr,png_bytep data,
+  png_size_t length)
+{
+  PNGDeflateInfo
+    *info;
+
+  size_t
+    count;
+
+  info=(PNGDeflateInfo *) png_get_io_ptr(png_ptr);
+  while (length != 0)
+    {
+      if (info->header_length < 8)
+        {
+          /*
+            Chunk length and type.
+          */
+          count=Min(length,8-info->header_length);
+          (void) memcpy(info->header+info->header_length,data,count);
+          info->header_length+=count;
+          if (info->header_length == 8)
+            {
+              info->remaining=(((size_t) info->header[0] << 24) |
+                               ((size_t) info->header[1] << 16) |
+                               ((size_t) info->header[2] << 8) |
+                               (size_t) info->header[3])+4;
+              info->idat=(memcmp(info->header+4,mng_IDAT,4) == 0);
+              if (!info->idat &&
+                  (WriteBlob(info->image,8,info->header) != 8))
+                png_error(png_ptr,"WriteBlob Failed");
+            }
+        }
+      else
+        {
+          /*
+            Chunk data and CRC.  The CRC of IDAT chunks is not needed.
+          */
+          count=Min(length,info->remaining);
+          if (info->idat)
+            {
+              if ((info->remaining > 4) &&
+                  (png_inflate_idat(info,data,Min(count,info->remaining-4))
+                   == MagickFail))
+                png_error(png_ptr,"Parallel deflate failed");
+            }
+          else if (WriteBlob(info->image,count,data) != count)
+            png_error(png_ptr,"WriteBlob Failed");
+          info->remaining-=count;
+          if (info->remaining == 0)
+            info->header_length=0;
+        }
+      data+=count;
+      length-=count;
+    }
+}
+
+static PNGDeflateInfo *png_allocate_deflate(Image *image,const int level,
+  const int strategy,const size_t block_size)
+{
+  PNGDeflateInfo
+    *info;
+
+  info=MagickAllocateClearedMemory(PNGDeflateInfo *,sizeof(PNGDeflateInfo));
+  if (info == (PNGDeflateInfo *) NULL)
+    return info;
+  info->image=image;
+  info->deflate=AllocateParallelDeflate(level,strategy,block_size,
+                                        png_write_deflated_idat,info);
+  if (info->deflate == (ParallelDeflateInfo *) NULL)
+    MagickFreeMemory(info);
+  return info;
+}
+
+static void png_destroy_deflate(PNGDeflateInfo *info)
+{
+  if (info == (PNGDeflateInfo *) NULL)
+    return;
+  if (info->stream_initialized)
+    (void) inflateEnd(&info->stream);
+  DestroyParallelDeflate(info->deflate);
+  MagickFreeMemory(info);
+}
+
 static void png_flush_data(png_structp png_ptr)
 {
   ARG_NOT_USED(png_ptr);
@@ -7011,6 +7195,17 @@ static MagickPassFail WriteOnePNGImage(MngInfo *mng_info,
   ImageCharacteristics
     characteristics;
 
+  PNGDeflateInfo
+    * volatile png_deflate = (PNGDeflateInfo *) NULL;
+
+  volatile int
+    deflate_filter = PNG_NO_FILTERS,
+    deflate_level = Z_DEFAULT_COMPRESSION,
+    deflate_strategy = Z_DEFAULT_STRATEGY;
+
+  volatile size_t
+    deflate_block_size;
+
   logging=LogMagickEvent(CoderEvent,GetMagickModule(),
                          "  enter WriteOnePNGImage()");
 
@@ -7103,6 +7298,7 @@ static MagickPassFail WriteOnePNGImage(MngInfo *mng_info,
 #endif
       png_destroy_write_struct(&ping,&ping_info);
       MagickFreeMemory(png_pixels);
+      png_destroy_deflate(png_deflate);
 #if defined(GMPNG_SETJMP_NOT_THREAD_SAFE)
       UnlockSemaphoreInfo(png_semaphore);
 #endif
@@ -7841,15 +8037,34 @@ static MagickPassFail WriteOnePNGImage(MngInfo *mng_info,
       if (logging)
         (void) LogMagickEvent(CoderEvent,GetMagickModule(),
                               "    Compression level: %d",level);
-      png_set_compression_level(ping,level);
+      deflate_level=level;
     }
   else
     {
       if (logging)
         (void) LogMagickEvent(CoderEvent,GetMagickModule(),
                               "    Compression strategy: Z_HUFFMAN_ONLY");
-      png_set_compression_strategy(ping, Z_HUFFMAN_ONLY);
-      png_set_compression_level(ping,2);
+      deflate_strategy=Z_HUFFMAN_ONLY;
+      deflate_level=2;
+    }
+  deflate_block_size=GetParallelDeflateBlockSize(image_info,"png");
+  if (deflate_block_size != 0)
+    {
+      /*
+        libpng stores the rows, which are then compressed in parallel.
+      */
+      if (logging)
+        (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                              "    Parallel deflate block size: %lu",
+                              (unsigned long) deflate_block_size);
+      png_set_compression_level(ping,Z_NO_COMPRESSION);
+    }
+  else
+    {
+      if (deflate_strategy != Z_DEFAULT_STRATEGY)
+        png_set_compression_strategy(ping,deflate_strategy);
+      if (deflate_level != Z_DEFAULT_COMPRESSION)
+        png_set_compression_level(ping,deflate_level);
     }
   if (logging)
     (void) LogMagickEvent(CoderEvent,GetMagickModule(),
@@ -7895,6 +8110,7 @@ static MagickPassFail WriteOnePNGImage(MngInfo *mng_info,
                                 "    Base filter method: NONE");
       }
     png_set_filter(ping,PNG_FILTER_TYPE_BASE,base_filter);
+    deflate_filter=base_filter;
   }
 
   ping_interlace_method=(image_info->interlace == LineInterlace);
@@ -8282,6 +8498,25 @@ static MagickPassFail WriteOnePNGImage(MngInfo *mng_info,
   png_pixels=MagickAllocateMemory(unsigned char *,rowbytes);
   if (png_pixels == (unsigned char *) NULL)
     png_error(ping, "Could not allocate png_pixels");
+  if (deflate_block_size != 0)
+    {
+      /*
+        Like libpng, use Z_FILTERED for filtered rows unless another
+        strategy was requested.  libpng filters rows when filtering was
+        not specified unless they are palette indexes or less than 8
+        bits deep.
+      */
+      if ((deflate_strategy == Z_DEFAULT_STRATEGY) &&
+          ((deflate_filter != PNG_NO_FILTERS) ||
+           ((ping_colortype != PNG_COLOR_TYPE_PALETTE) &&
+            (ping_bit_depth >= 8))))
+        deflate_strategy=Z_FILTERED;
+      png_deflate=png_allocate_deflate(image,deflate_level,deflate_strategy,
+                                       deflate_block_size);
+      if (png_deflate == (PNGDeflateInfo *) NULL)
+        png_error(ping, "Could not allocate parallel deflate");
+      png_set_write_fn(ping,png_deflate,png_put_deflated_data,png_flush_data);
+    }
   /*
     Initialize image scanlines.
   */
@@ -8504,6 +8739,18 @@ static MagickPassFail WriteOnePNGImage(MngInfo *mng_info,
 
   MagickFreeMemory(png_pixels);
 
+  if (png_deflate != (PNGDeflateInfo *) NULL)
+    {
+      /*
+        All IDAT data has been written by libpng once the last row is.
+      */
+      png_set_write_fn(ping,image,png_put_data,png_flush_data);
+      if (FinishParallelDeflate(png_deflate->deflate) == MagickFail)
+        png_error(ping, "Parallel deflate failed");
+      png_destroy_deflate(png_deflate);
+      png_deflate=(PNGDeflateInfo *) NULL;
+    }
+
   if (logging)
     {
       (void) LogMagickEvent(CoderEvent,GetMagickModule(),
@@ -9557,6 +9804,7 @@ static unsigned int WriteMNGImage(const ImageInfo *image_info,Image *image)
 
   unsigned long
     final_delay=0,
+    image_list_length,
     initial_delay;
 
 #if (PNG_LIBPNG_VER < 10200)
@@ -10181,6 +10429,7 @@ static unsigned int WriteMNGImage(const ImageInfo *image_info,Image *image)
 #endif
     }
   scene=0;
+  image_list_length=GetImageListLength(image);
   mng_info->delay=0;
 #if defined(PNG_WRITE_EMPTY_PLTE_SUPPORTED) ||  \
   defined(PNG_MNG_FEATURES_SUPPORTED)
@@ -10350,8 +10599,8 @@ static unsigned int WriteMNGImage(const ImageInfo *image_info,Image *image)
       if (image->next == (Image *) NULL)
         break;
       image=SyncNextImageInList(image);
-      if (QuantumTick(scene,GetImageListLength(image)))
-        if (!MagickMonitorFormatted(scene++,GetImageListLength(image),
+      if (QuantumTick(scene,image_list_length))
+        if (!MagickMonitorFormatted(scene++,image_list_length,
                                     &image->exception,SaveImagesTag,
                                     image->filename))
           break;
@@ -55,6 +55,10 @@
 static unsigned int
   WritePNMImage(const ImageInfo *,Image *);
 
+static MagickPassFail
+  WritePNMStream(const ImageInfo *,Image *,const Image *,
+                 const StreamEncodePhase,void **);
+
 
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -1242,6 +1246,8 @@ ModuleExport void RegisterPNMImage(void)
   entry=SetMagickInfo("PAM");
   entry->decoder=(DecoderHandler) ReadPNMImage;
   entry->encoder=(EncoderHandler) WritePNMImage;
+  entry->stream_encoder=(StreamEncoderHandler) WritePNMStream;
+  entry->stream_support=MagickTrue;
   entry->description="Portable Arbitrary Map format";
   entry->module="PNM";
   entry->coder_class=PrimaryCoderClass;
@@ -1258,6 +1264,8 @@ ModuleExport void RegisterPNMImage(void)
   entry=SetMagickInfo("PGM");
   entry->decoder=(DecoderHandler) ReadPNMImage;
   entry->encoder=(EncoderHandler) WritePNMImage;
+  entry->stream_encoder=(StreamEncoderHandler) WritePNMStream;
+  entry->stream_support=MagickTrue;
   entry->description="Portable graymap format (gray scale)";
   entry->module="PNM";
   entry->coder_class=PrimaryCoderClass;
@@ -1266,6 +1274,8 @@ ModuleExport void RegisterPNMImage(void)
   entry=SetMagickInfo("PNM");
   entry->decoder=(DecoderHandler) ReadPNMImage;
   entry->encoder=(EncoderHandler) WritePNMImage;
+  entry->stream_encoder=(StreamEncoderHandler) WritePNMStream;
+  entry->stream_support=MagickTrue;
   entry->magick=(MagickHandler) IsPNM;
   entry->description="Portable anymap";
   entry->module="PNM";
@@ -1275,6 +1285,8 @@ ModuleExport void RegisterPNMImage(void)
   entry=SetMagickInfo("PPM");
   entry->decoder=(DecoderHandler) ReadPNMImage;
   entry->encoder=(EncoderHandler) WritePNMImage;
+  entry->stream_encoder=(StreamEncoderHandler) WritePNMStream;
+  entry->stream_support=MagickTrue;
   entry->description="Portable pixmap format (color)";
   entry->module="PNM";
   entry->coder_class=PrimaryCoderClass;
@@ -2206,3 +2218,229 @@ static unsigned int WritePNMImage(const ImageInfo *image_info,Image *image)
   CloseBlob(image);
   return(True);
 }
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   W r i t e P N M S t r e a m                                               %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  Method WritePNMStream writes an image to a raw PGM, PPM, or PAM file a
+%  band of rows at a time (see StreamImage()).  Since the pixels are not
+%  available in advance, the PNM subformat is selected from the image
+%  colorspace and the is_grayscale flag rather than by inspecting the
+%  pixels, and ASCII and bilevel subformats are not supported.
+%
+%  The format of the WritePNMStream method is:
+%
+%      MagickPassFail WritePNMStream(const ImageInfo *image_info,Image *image,
+%        const Image *rows,const StreamEncodePhase phase,void **state)
+%
+%  A description of each parameter follows.
+%
+%    o image_info: Specifies a pointer to a ImageInfo structure.
+%
+%    o image:  The image attributes, and the output blob.
+%
+%    o rows:  The next band of rows.
+%
+%    o phase:  The encoding phase.
+%
+%    o state:  Encoder state retained between phases.
+%
+%
+*/
+typedef struct _PNMStreamState
+{
+  QuantumType
+    quantum_type;
+
+  unsigned int
+    bits_per_sample;
+
+  size_t
+    bytes_per_row;
+
+  unsigned char
+    *pixels;
+} PNMStreamState;
+
+static MagickPassFail QueryPNMStream(const ImageInfo *image_info,
+  Image *image)
+{
+  if ((image_info->quality == 0) ||
+      (AccessDefinition(image_info,"pnm","ascii")))
+    ThrowBinaryException(StreamError,NoStreamHandlerIsDefined,
+                         image->filename);
+  if (!IsRGBCompatibleColorspace(image->colorspace) &&
+      !((LocaleCompare(image_info->magick,"PAM") == 0) &&
+        (image->colorspace == CMYKColorspace)))
+    ThrowBinaryException(StreamError,NoStreamHandlerIsDefined,
+                         image->filename);
+  return(MagickPass);
+}
+
+static MagickPassFail WritePNMStream(const ImageInfo *image_info,Image *image,
+  const Image *rows,const StreamEncodePhase phase,void **state)
+{
+  char
+    buffer[MaxTextExtent];
+
+  PNMStreamState
+    *stream_state;
+
+  unsigned long
+    y;
+
+  stream_state=(PNMStreamState *) *state;
+  switch (phase)
+    {
+    case QueryStreamEncode:
+      return(QueryPNMStream(image_info,image));
+    case BeginStreamEncode:
+      {
+        const ImageAttribute
+          *attribute;
+
+        PNMSubformat
+          format;
+
+        if (QueryPNMStream(image_info,image) == MagickFail)
+          return(MagickFail);
+        stream_state=MagickAllocateClearedMemory(PNMStreamState *,
+                                                 sizeof(PNMStreamState));
+        if (stream_state == (PNMStreamState *) NULL)
+          ThrowBinaryException(ResourceLimitError,MemoryAllocationFailed,
+                               image->filename);
+        *state=stream_state;
+        stream_state->bits_per_sample=(image->depth <= 8 ? 8 :
+                                       image->depth <= 16 ? 16 : 32);
+        if (LocaleCompare(image_info->magick,"PAM") == 0)
+          {
+            format=PAM_Format;
+            if (image->colorspace == CMYKColorspace)
+              stream_state->quantum_type=(image->matte ? CMYKAQuantum :
+                                          CMYKQuantum);
+            else if (image->is_grayscale)
+              stream_state->quantum_type=(image->matte ? GrayAlphaQuantum :
+                                          GrayQuantum);
+            else
+              stream_state->quantum_type=(image->matte ? RGBAQuantum :
+                                          RGBQuantum);
+          }
+        else if ((LocaleCompare(image_info->magick,"PGM") == 0) ||
+                 ((LocaleCompare(image_info->magick,"PNM") == 0) &&
+                  image->is_grayscale))
+          {
+            format=PGM_RAW_Format;
+            stream_state->quantum_type=GrayQuantum;
+          }
+        else
+          {
+            format=PPM_RAW_Format;
+            stream_state->quantum_type=RGBQuantum;
+          }
+        stream_state->bytes_per_row=
+          MagickArraySize(image->columns,
+                          (stream_state->bits_per_sample/8)*
+                          MagickGetQuantumSamplesPerPixel(stream_state->
+                                                          quantum_type));
+        stream_state->pixels=
+          MagickAllocateResourceLimitedMemory(unsigned char *,
+                                              stream_state->bytes_per_row);
+        if (stream_state->pixels == (unsigned char *) NULL)
+          ThrowBinaryException(ResourceLimitError,MemoryAllocationFailed,
+                               image->filename);
+        (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                              "Streaming %s, %u bits, %s",
+                              (format == PAM_Format ? "P7" :
+                               format == PGM_RAW_Format ? "P5" : "P6"),
+                              stream_state->bits_per_sample,
+                              QuantumTypeToString(stream_state->quantum_type));
+        (void) WriteBlobString(image,(format == PAM_Format ? "P7\n" :
+                                      format == PGM_RAW_Format ? "P5\n" :
+                                      "P6\n"));
+        attribute=GetImageAttribute(image,"comment");
+        if (attribute != (const ImageAttribute *) NULL)
+          {
+            register char
+              *av;
+
+            (void) WriteBlobByte(image,'#');
+            for (av=attribute->value; *av != '\0'; av++)
+              {
+                (void) WriteBlobByte(image,*av);
+                if ((*av == '\n') && (*(av+1) != '\0'))
+                  (void) WriteBlobByte(image,'#');
+              }
+            (void) WriteBlobByte(image,'\n');
+          }
+        if (format == PAM_Format)
+          {
+            const char
+              *tuple_type;
+
+            switch (stream_state->quantum_type)
+              {
+              case GrayQuantum: tuple_type="GRAYSCALE"; break;
+              case GrayAlphaQuantum: tuple_type="GRAYSCALE_ALPHA"; break;
+              case RGBAQuantum: tuple_type="RGB_ALPHA"; break;
+              case CMYKQuantum: tuple_type="CMYK"; break;
+              case CMYKAQuantum: tuple_type="CMYK_ALPHA"; break;
+              default: tuple_type="RGB"; break;
+              }
+            FormatString(buffer,"WIDTH %lu\nHEIGHT %lu\nDEPTH %u"
+                         "\nMAXVAL %lu\nTUPLTYPE %s\nENDHDR\n",
+                         image->columns,image->rows,
+                         MagickGetQuantumSamplesPerPixel(stream_state->
+                                                         quantum_type),
+                         MaxValueGivenBits(stream_state->bits_per_sample),
+                         tuple_type);
+          }
+        else
+          {
+            FormatString(buffer,"%lu %lu\n%lu\n",image->columns,image->rows,
+                         MaxValueGivenBits(stream_state->bits_per_sample));
+          }
+        if (WriteBlobString(image,buffer) != strlen(buffer))
+          ThrowBinaryException(FileOpenError,UnableToWriteFile,
+                               image->filename);
+        break;
+      }
+    case RowsStreamEncode:
+      {
+        for (y=0; y < rows->rows; y++)
+          {
+            if (AcquireImagePixels(rows,0,y,rows->columns,1,&image->exception)
+                == (const PixelPacket *) NULL)
+              return(MagickFail);
+            if (ExportImagePixelArea(rows,stream_state->quantum_type,
+                                     stream_state->bits_per_sample,
+                                     stream_state->pixels,0,0) == MagickFail)
+              return(MagickFail);
+            if (WriteBlob(image,stream_state->bytes_per_row,
+                          (char *) stream_state->pixels) !=
+                stream_state->bytes_per_row)
+              ThrowBinaryException(FileOpenError,UnableToWriteFile,
+                                   image->filename);
+          }
+        break;
+      }
+    case EndStreamEncode:
+      {
+        if (stream_state != (PNMStreamState *) NULL)
+          {
+            MagickFreeResourceLimitedMemory(stream_state->pixels);
+            MagickFreeMemory(stream_state);
+            *state=(void *) NULL;
+          }
+        break;
+      }
+    }
+  return(MagickPass);
+}
@@ -301,6 +301,7 @@ static Image *ReadPSImage(const ImageInfo *image_info,ExceptionInfo *exception)
       ThrowReaderException(CorruptImageError,AnErrorHasOccurredWritingToFile,
         image)
     }
+  RecordBlobSpill(image_info->magick,(magick_uint64_t) ftell(file));
   (void) rewind(file);
   (void) fputs(translate_geometry,file);
   (void) fclose(file);
@@ -40,7 +40,6 @@
 #include "magick/constitute.h"
 #include "magick/magick.h"
 #include "magick/pixel_cache.h"
-#include "magick/tempfile.h"
 #include "magick/transform.h"
 #include "magick/utility.h"
 
@@ -194,9 +193,6 @@ static Image *ReadSFWImage(const ImageInfo *image_info,ExceptionInfo *exception)
       0xF9, 0xFA
     };
 
-  FILE
-    *file;
-
   Image
     *flipped_image,
     *image;
@@ -210,8 +206,7 @@ static Image *ReadSFWImage(const ImageInfo *image_info,ExceptionInfo *exception)
 
   char
     original_filename[MaxTextExtent],
-    original_magick[MaxTextExtent],
-    temporary_filename[MaxTextExtent];
+    original_magick[MaxTextExtent];
 
   size_t
     count;
@@ -219,10 +214,13 @@ static Image *ReadSFWImage(const ImageInfo *image_info,ExceptionInfo *exception)
   unsigned char
     *buffer,
     *buffer_end,
-    *offset;
+    *jfif,
+    *offset,
+    *p;
 
   size_t
-    buffer_size;
+    buffer_size,
+    jfif_size;
 
   TimerInfo
     timer;
@@ -312,30 +310,23 @@ static Image *ReadSFWImage(const ImageInfo *image_info,ExceptionInfo *exception)
     }
   TranslateSFWMarker(data++);  /* translate eoi marker */
   /*
-    Write JFIF file.
+    Assemble JFIF data in memory.
   */
-  clone_info=CloneImageInfo(image_info);
-  clone_info->blob=(void *) NULL;
-  clone_info->length=0;
-  file=AcquireTemporaryFileStream(temporary_filename,BinaryFileIOMode);
-  if (file == (FILE *) NULL)
+  jfif_size=(size_t) (offset-header+1)+sizeof(HuffmanTable)+
+    (size_t) (data-offset);
+  jfif=MagickAllocateResourceLimitedMemory(unsigned char *,jfif_size);
+  if (jfif == (unsigned char *) NULL)
     {
       MagickFreeResourceLimitedMemory(buffer);
-      DestroyImageInfo(clone_info);
-      ThrowReaderTemporaryFileException(image_info->filename)
+      ThrowReaderException(ResourceLimitError,MemoryAllocationFailed,image);
     }
-  (void) fwrite(header,(size_t) (offset-header+1),1,file);
-  (void) fwrite(HuffmanTable,1,sizeof(HuffmanTable)/sizeof(*HuffmanTable),file);
-  (void) fwrite(offset+1,(size_t) (data-offset),1,file);
-  status=ferror(file);
-  (void) fclose(file);
+  p=jfif;
+  (void) memcpy(p,header,(size_t) (offset-header+1));
+  p+=(size_t) (offset-header+1);
+  (void) memcpy(p,HuffmanTable,sizeof(HuffmanTable));
+  p+=sizeof(HuffmanTable);
+  (void) memcpy(p,offset+1,(size_t) (data-offset));
   MagickFreeResourceLimitedMemory(buffer);
-  if (status)
-    {
-      (void) LiberateTemporaryFile(temporary_filename);
-      DestroyImageInfo(clone_info);
-      ThrowReaderException(FileOpenError,UnableToWriteFile,image)
-    }
   CloseBlob(image);
   strlcpy(original_filename,image->filename,sizeof(original_filename));
   strlcpy(original_magick,image->magick,sizeof(original_magick));
@@ -343,10 +334,10 @@ static Image *ReadSFWImage(const ImageInfo *image_info,ExceptionInfo *exception)
   /*
     Read JPEG image.
   */
+  clone_info=CloneImageInfo(image_info);
   (void) strlcpy(clone_info->filename,"JPEG:",sizeof(clone_info->filename));
-  (void) strlcat(clone_info->filename,temporary_filename,sizeof(clone_info->filename));
-  image=ReadImage(clone_info,exception);
-  (void) LiberateTemporaryFile(temporary_filename);
+  image=BlobToImage(clone_info,jfif,jfif_size,exception);
+  MagickFreeResourceLimitedMemory(jfif);
   DestroyImageInfo(clone_info);
   if (image == (Image *) NULL)
     return(image);
@@ -45,6 +45,7 @@
 #include "magick/blob.h"
 #include "magick/colormap.h"
 #include "magick/constitute.h"
+#include "magick/enum_strings.h"
 #include "magick/log.h"
 #include "magick/magick.h"
 #include "magick/monitor.h"
@@ -53,6 +54,7 @@
 #include "magick/quantize.h"
 #include "magick/resize.h"
 #include "magick/resource.h"
+#include "magick/semaphore.h"
 #include "magick/tempfile.h"
 #include "magick/tsd.h"
 #include "magick/utility.h"
@@ -85,7 +87,7 @@
 
 #if defined(TIFF_VERSION_BIG)
 #  define HasBigTIFF 1
-#endif /* defined(TIFF_BIGTIFF_VERSION) */
+#endif /* defined(TIFF_VERSION_BIG) */
 
 #if defined(HAVE_STDINT_H) && (TIFFLIB_VERSION >= 20201219)
 #  undef uint16
@@ -94,6 +96,13 @@
 #  define uint32 uint32_t
 #endif /* TIFFLIB_VERSION */
 
+/*
+  Strips and tiles may be coded concurrently (see -define tiff:threads).
+*/
+#if defined(HAVE_OPENMP) && defined(TIFF_VERSION_BIG) && (TIFFLIB_VERSION >= 20111221)
+#  define TIFF_THREADED_CODING 1
+#endif
+
 /*
   Set to 1 in order to log low-level BLOB I/O at "coder" level.
 */
@@ -160,7 +169,9 @@ static tsize_t
 static MagickPassFail
   WriteGROUP4RAWImage(const ImageInfo *image_info,Image *image),
   WritePTIFImage(const ImageInfo *,Image *),
-  WriteTIFFImage(const ImageInfo *,Image *);
+  WriteTIFFImage(const ImageInfo *,Image *),
+  WriteTIFFStream(const ImageInfo *,Image *,const Image *,
+                  const StreamEncodePhase,void **);
 
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -1200,7 +1211,848 @@ SwabDataToNativeEndian(const uint16 bits_per_sample, tdata_t data,
                            NumberOfObjectsInArray(size,sizeof(uint16)));
     }
 }
-#endif
+#endif
+
+#if defined(TIFF_THREADED_CODING)
+/*
+  Concurrent strip and tile coding (-define tiff:threads=N).
+
+  libtiff keeps the codec state in the TIFF handle, so a handle may only
+  be used by one thread at a time.  Strips and tiles are coded
+  independently though, so each thread decodes, or encodes, batches of
+  them through its own handle.  Decoding handles are opened on the same
+  blob as the main handle, with access to the blob serialized.  Encoding
+  handles write to memory, and the compressed strips or tiles are then
+  written through the main handle, in order, as raw data.
+*/
+
+/*
+  Client data of a decoding handle.
+*/
+typedef struct _TIFFThreadClientData
+{
+  Image
+    *image;
+
+  SemaphoreInfo
+    *semaphore;       /* Serializes access to the blob */
+
+  toff_t
+    offset;           /* Offset of the next read */
+} TIFFThreadClientData;
+
+/*
+  In-memory file written by an encoding handle.
+*/
+typedef struct _TIFFThreadSink
+{
+  unsigned char
+    *data;
+
+  size_t
+    allocated,
+    length,           /* Current file length */
+    base;             /* File length once the header is written */
+
+  toff_t
+    offset;           /* Offset of the next write */
+} TIFFThreadSink;
+
+/*
+  State of concurrent decoding or encoding of the strips or tiles of
+  one image.
+*/
+typedef struct _TIFFThreadedCoder
+{
+  unsigned int
+    threads,          /* Number of coding handles */
+    batch;            /* Maximum number of chunks in a batch */
+
+  MagickBool
+    tiled;            /* Chunks are tiles rather than strips */
+
+  TIFF
+    *tiff,            /* Main handle */
+    **handles;        /* Coding handle of each thread */
+
+  TIFFThreadClientData
+    *client_data;     /* Client data of each decoding handle */
+
+  TIFFThreadSink
+    *sinks;           /* Output of each encoding handle */
+
+  ExceptionInfo
+    *exceptions;      /* Errors reported by each thread */
+
+  SemaphoreInfo
+    *semaphore;
+
+  tsize_t
+    chunk_size,       /* Bytes allocated per chunk */
+    *sizes;           /* Size (or -1) of each chunk in the batch */
+
+  unsigned char
+    *chunks;          /* Uncompressed chunks of the batch */
+
+  uint32
+    *ids,             /* Strip or tile number of each chunk (encoding) */
+    first,            /* Strip or tile number of first chunk (decoding) */
+    count,            /* Number of chunks in the batch */
+    total;            /* Number of strips or tiles in the image */
+
+  unsigned int
+    *owners;          /* Thread which encoded each chunk */
+
+  magick_uint64_t
+    *offsets,         /* Offset of each encoded chunk in its sink */
+    *lengths;         /* Length of each encoded chunk */
+} TIFFThreadedCoder;
+
+/*
+  Return the number of threads requested via -define tiff:threads=N,
+  bounded by the threads resource limit.
+*/
+static unsigned int
+TIFFCodingThreads(const ImageInfo *image_info)
+{
+  const char
+    *value;
+
+  long
+    threads=1;
+
+  magick_int64_t
+    limit;
+
+  if ((value=AccessDefinition(image_info,"tiff","threads")))
+    threads=MagickAtoL(value);
+  limit=GetMagickResourceLimit(ThreadsResource);
+  if (threads > limit)
+    threads=(long) limit;
+  if (threads > 256)
+    threads=256;
+  if (threads < 1)
+    threads=1;
+  return (unsigned int) threads;
+}
+
+/*
+  Decoding handle blob access.  Each handle has its own file offset.
+*/
+static tsize_t
+TIFFThreadReadBlob(thandle_t handle,tdata_t data,tsize_t size)
+{
+  TIFFThreadClientData
+    *client_data = (TIFFThreadClientData *) handle;
+
+  tsize_t
+    result=0;
+
+  LockSemaphoreInfo(client_data->semaphore);
+  if (SeekBlob(client_data->image,(magick_off_t) client_data->offset,SEEK_SET)
+      == (magick_off_t) client_data->offset)
+    result=(tsize_t) ReadBlob(client_data->image,(size_t) size,data);
+  UnlockSemaphoreInfo(client_data->semaphore);
+  client_data->offset+=result;
+  return result;
+}
+
+static tsize_t
+TIFFThreadWriteBlob(thandle_t handle,tdata_t data,tsize_t size)
+{
+  ARG_NOT_USED(handle);
+  ARG_NOT_USED(data);
+  ARG_NOT_USED(size);
+  return -1;
+}
+
+static toff_t
+TIFFThreadSeekBlob(thandle_t handle,toff_t offset,int whence)
+{
+  TIFFThreadClientData
+    *client_data = (TIFFThreadClientData *) handle;
+
+  if (whence == SEEK_CUR)
+    offset+=client_data->offset;
+  else if (whence == SEEK_END)
+    offset+=(toff_t) GetBlobSize(client_data->image);
+  client_data->offset=offset;
+  return offset;
+}
+
+static int
+TIFFThreadCloseBlob(thandle_t handle)
+{
+  ARG_NOT_USED(handle);
+  return 0;
+}
+
+static toff_t
+TIFFThreadGetBlobSize(thandle_t handle)
+{
+  TIFFThreadClientData
+    *client_data = (TIFFThreadClientData *) handle;
+
+  return (toff_t) GetBlobSize(client_data->image);
+}
+
+static int
+TIFFThreadMapBlob(thandle_t handle,tdata_t *base,toff_t *size)
+{
+  TIFFThreadClientData
+    *client_data = (TIFFThreadClientData *) handle;
+
+  *base=(tdata_t *) GetBlobStreamData(client_data->image);
+  if (*base == (tdata_t *) NULL)
+    return 0;
+  *size=(toff_t) GetBlobSize(client_data->image);
+  return 1;
+}
+
+static void
+TIFFThreadUnmapBlob(thandle_t handle,tdata_t base,toff_t size)
+{
+  ARG_NOT_USED(handle);
+  ARG_NOT_USED(base);
+  ARG_NOT_USED(size);
+}
+
+/*
+  Encoding handle in-memory file access.
+*/
+static tsize_t
+TIFFThreadReadSink(thandle_t handle,tdata_t data,tsize_t size)
+{
+  TIFFThreadSink
+    *sink = (TIFFThreadSink *) handle;
+
+  size_t
+    count=0;
+
+  if (sink->offset < sink->length)
+    count=Min((size_t) size,sink->length-(size_t) sink->offset);
+  if (count != 0)
+    (void) memcpy(data,sink->data+sink->offset,count);
+  sink->offset+=count;
+  return (tsize_t) count;
+}
+
+static tsize_t
+TIFFThreadWriteSink(thandle_t handle,tdata_t data,tsize_t size)
+{
+  TIFFThreadSink
+    *sink = (TIFFThreadSink *) handle;
+
+  size_t
+    end;
+
+  if (size <= 0)
+    return 0;
+  end=(size_t) sink->offset+(size_t) size;
+  if (end > sink->allocated)
+    {
+      size_t
+        allocated;
+
+      allocated=Max(Max(end,2*sink->allocated),65536U);
+      MagickReallocMemory(unsigned char *,sink->data,allocated);
+      if (sink->data == (unsigned char *) NULL)
+        {
+          sink->allocated=0;
+          sink->length=0;
+          return -1;
+        }
+      sink->allocated=allocated;
+    }
+  if (sink->offset > sink->length)
+    (void) memset(sink->data+sink->length,0,(size_t) sink->offset-sink->length);
+  (void) memcpy(sink->data+sink->offset,data,(size_t) size);
+  sink->offset=end;
+  if (end > sink->length)
+    sink->length=end;
+  return size;
+}
+
+static toff_t
+TIFFThreadSeekSink(thandle_t handle,toff_t offset,int whence)
+{
+  TIFFThreadSink
+    *sink = (TIFFThreadSink *) handle;
+
+  if (whence == SEEK_CUR)
+    offset+=sink->offset;
+  else if (whence == SEEK_END)
+    offset+=sink->length;
+  sink->offset=offset;
+  return offset;
+}
+
+static toff_t
+TIFFThreadGetSinkSize(thandle_t handle)
+{
+  TIFFThreadSink
+    *sink = (TIFFThreadSink *) handle;
+
+  return (toff_t) sink->length;
+}
+
+static int
+TIFFThreadMapSink(thandle_t handle,tdata_t *base,toff_t *size)
+{
+  ARG_NOT_USED(handle);
+  ARG_NOT_USED(base);
+  ARG_NOT_USED(size);
+  return 0;
+}
+
+/*
+  Return MagickTrue if strips or tiles using this compression may be
+  decoded concurrently.  JPEG, OJPEG, and SGILOG require settings made
+  on the main handle which the decoding handles would not share, and
+  JBIG is decoded as a single strip.
+*/
+static MagickBool
+TIFFThreadedDecodeSupported(const uint16 compress_tag,const uint16 photometric)
+{
+  if ((photometric == PHOTOMETRIC_LOGL) || (photometric == PHOTOMETRIC_LOGLUV))
+    return MagickFalse;
+  switch (compress_tag)
+    {
+    case COMPRESSION_NONE:
+    case COMPRESSION_JPEG:
+    case COMPRESSION_OJPEG:
+#if defined(COMPRESSION_JBIG)
+    case COMPRESSION_JBIG:
+#endif
+      return MagickFalse;
+    default:
+      break;
+    }
+  return MagickTrue;
+}
+
+/*
+  Return MagickTrue if strips or tiles using this compression may be
+  encoded concurrently.  Only lossless codecs whose settings are
+  replicated by CopyTIFFCodingFields() are supported.
+*/
+static MagickBool
+TIFFThreadedEncodeSupported(const uint16 compress_tag,const uint16 photometric)
+{
+  if (photometric == PHOTOMETRIC_YCBCR)
+    return MagickFalse;
+  switch (compress_tag)
+    {
+    case COMPRESSION_LZW:
+    case COMPRESSION_ADOBE_DEFLATE:
+    case COMPRESSION_DEFLATE:
+    case COMPRESSION_PACKBITS:
+#if defined(COMPRESSION_LZMA)
+    case COMPRESSION_LZMA:
+#endif
+#if defined(COMPRESSION_ZSTD)
+    case COMPRESSION_ZSTD:
+#endif
+      return MagickTrue;
+    default:
+      break;
+    }
+  return MagickFalse;
+}
+
+/*
+  Copy the fields which determine how strips or tiles are encoded from
+  the main handle to an encoding handle.
+*/
+static MagickPassFail
+CopyTIFFCodingFields(TIFF *tiff,TIFF *encoder,const MagickBool tiled)
+{
+  static const ttag_t
+    fields16[] =
+    {
+      TIFFTAG_BITSPERSAMPLE,
+      TIFFTAG_SAMPLESPERPIXEL,
+      TIFFTAG_PLANARCONFIG,
+      TIFFTAG_PHOTOMETRIC,
+      TIFFTAG_SAMPLEFORMAT,
+      TIFFTAG_FILLORDER,
+      TIFFTAG_COMPRESSION
+    };
+
+  int
+    value;
+
+  MagickPassFail
+    status=MagickPass;
+
+  register unsigned int
+    i;
+
+  uint16
+    count,
+    *extra,
+    value16;
+
+  uint32
+    value32;
+
+  if ((TIFFGetField(tiff,TIFFTAG_IMAGEWIDTH,&value32) != 1) ||
+      (TIFFSetField(encoder,TIFFTAG_IMAGEWIDTH,value32) != 1))
+    status=MagickFail;
+  if ((TIFFGetField(tiff,TIFFTAG_IMAGELENGTH,&value32) != 1) ||
+      (TIFFSetField(encoder,TIFFTAG_IMAGELENGTH,value32) != 1))
+    status=MagickFail;
+  if (tiled)
+    {
+      if ((TIFFGetField(tiff,TIFFTAG_TILEWIDTH,&value32) != 1) ||
+          (TIFFSetField(encoder,TIFFTAG_TILEWIDTH,value32) != 1))
+        status=MagickFail;
+      if ((TIFFGetField(tiff,TIFFTAG_TILELENGTH,&value32) != 1) ||
+          (TIFFSetField(encoder,TIFFTAG_TILELENGTH,value32) != 1))
+        status=MagickFail;
+    }
+  else
+    {
+      if ((TIFFGetFieldDefaulted(tiff,TIFFTAG_ROWSPERSTRIP,&value32) != 1) ||
+          (TIFFSetField(encoder,TIFFTAG_ROWSPERSTRIP,value32) != 1))
+        status=MagickFail;
+    }
+  for (i=0; i < ArraySize(fields16); i++)
+    if ((TIFFGetFieldDefaulted(tiff,fields16[i],&value16) != 1) ||
+        (TIFFSetField(encoder,fields16[i],value16) != 1))
+      status=MagickFail;
+  if (TIFFGetField(tiff,TIFFTAG_EXTRASAMPLES,&count,&extra) == 1)
+    (void) TIFFSetField(encoder,TIFFTAG_EXTRASAMPLES,count,extra);
+  /*
+    Codec specific fields (set after the compression).
+  */
+  if (TIFFGetField(tiff,TIFFTAG_PREDICTOR,&value16) == 1)
+    if (TIFFSetField(encoder,TIFFTAG_PREDICTOR,value16) != 1)
+      status=MagickFail;
+  if (TIFFGetField(tiff,TIFFTAG_ZIPQUALITY,&value) == 1)
+    (void) TIFFSetField(encoder,TIFFTAG_ZIPQUALITY,value);
+#if defined(COMPRESSION_LZMA)
+  if (TIFFGetField(tiff,TIFFTAG_LZMAPRESET,&value) == 1)
+    (void) TIFFSetField(encoder,TIFFTAG_LZMAPRESET,value);
+#endif
+#if defined(COMPRESSION_ZSTD)
+  if (TIFFGetField(tiff,TIFFTAG_ZSTD_LEVEL,&value) == 1)
+    (void) TIFFSetField(encoder,TIFFTAG_ZSTD_LEVEL,value);
+#endif
+  return status;
+}
+
+/*
+  Destroy the state allocated for concurrent coding.
+*/
+static void
+DestroyTIFFThreadedCoder(TIFFThreadedCoder *coder)
+{
+  register unsigned int
+    i;
+
+  if (coder == (TIFFThreadedCoder *) NULL)
+    return;
+  for (i=0; i < coder->threads; i++)
+    {
+      if ((coder->handles != (TIFF **) NULL) &&
+          (coder->handles[i] != (TIFF *) NULL))
+        TIFFCleanup(coder->handles[i]);
+      if (coder->sinks != (TIFFThreadSink *) NULL)
+        MagickFreeMemory(coder->sinks[i].data);
+      if (coder->exceptions != (ExceptionInfo *) NULL)
+        DestroyExceptionInfo(&coder->exceptions[i]);
+    }
+  MagickFreeMemory(coder->handles);
+  MagickFreeMemory(coder->client_data);
+  MagickFreeMemory(coder->sinks);
+  MagickFreeMemory(coder->exceptions);
+  MagickFreeMemory(coder->sizes);
+  MagickFreeMemory(coder->ids);
+  MagickFreeMemory(coder->owners);
+  MagickFreeMemory(coder->offsets);
+  MagickFreeMemory(coder->lengths);
+  MagickFreeResourceLimitedMemory(coder->chunks);
+  if (coder->semaphore != (SemaphoreInfo *) NULL)
+    DestroySemaphoreInfo(&coder->semaphore);
+  MagickFreeMemory(coder);
+}
+
+/*
+  Allocate the state common to decoding and encoding.  NULL is returned
+  if concurrent coding would not help (or memory is not available), in
+  which case the caller codes strips or tiles itself.
+*/
+static TIFFThreadedCoder *
+AllocateTIFFThreadedCoder(TIFF *tiff,unsigned int threads,
+                          const MagickBool encode)
+{
+  TIFFThreadedCoder
+    *coder;
+
+  register unsigned int
+    i;
+
+  coder=MagickAllocateClearedMemory(TIFFThreadedCoder *,
+                                    sizeof(TIFFThreadedCoder));
+  if (coder == (TIFFThreadedCoder *) NULL)
+    return coder;
+  coder->tiff=tiff;
+  coder->tiled=TIFFIsTiled(tiff) ? MagickTrue : MagickFalse;
+  if (coder->tiled)
+    {
+      coder->total=TIFFNumberOfTiles(tiff);
+      coder->chunk_size=TIFFTileSize(tiff);
+    }
+  else
+    {
+      coder->total=TIFFNumberOfStrips(tiff);
+      coder->chunk_size=TIFFStripSize(tiff);
+    }
+  coder->chunk_size=RoundUpToAlignment(coder->chunk_size,
+                                       sizeof(magick_int32_t));
+  if (threads > coder->total)
+    threads=coder->total;
+  if ((threads < 2) || (coder->chunk_size <= 0))
+    {
+      MagickFreeMemory(coder);
+      return coder;
+    }
+  /*
+    Batches of up to four chunks per thread, limiting the memory for
+    the batch to 64MB when there are more chunks than threads.
+  */
+  coder->batch=4*threads;
+  while ((coder->batch > threads) &&
+         ((magick_uint64_t) coder->batch*coder->chunk_size > 64*1024*1024))
+    coder->batch--;
+  if (coder->batch > coder->total)
+    coder->batch=coder->total;
+  coder->threads=threads;
+  coder->handles=MagickAllocateClearedArray(TIFF **,threads,sizeof(TIFF *));
+  coder->exceptions=MagickAllocateArray(ExceptionInfo *,threads,
+                                        sizeof(ExceptionInfo));
+  coder->sizes=MagickAllocateArray(tsize_t *,coder->batch,sizeof(tsize_t));
+  coder->chunks=MagickAllocateResourceLimitedArray(unsigned char *,
+                                                   coder->batch,
+                                                   coder->chunk_size);
+  if (encode)
+    {
+      coder->sinks=MagickAllocateClearedArray(TIFFThreadSink *,threads,
+                                              sizeof(TIFFThreadSink));
+      coder->ids=MagickAllocateArray(uint32 *,coder->batch,sizeof(uint32));
+      coder->owners=MagickAllocateArray(unsigned int *,coder->batch,
+                                        sizeof(unsigned int));
+      coder->offsets=MagickAllocateArray(magick_uint64_t *,coder->batch,
+                                         sizeof(magick_uint64_t));
+      coder->lengths=MagickAllocateArray(magick_uint64_t *,coder->batch,
+                                         sizeof(magick_uint64_t));
+    }
+  else
+    {
+      coder->client_data=MagickAllocateClearedArray(TIFFThreadClientData *,
+                                                    threads,
+                                                    sizeof(TIFFThreadClientData));
+    }
+  if (coder->exceptions != (ExceptionInfo *) NULL)
+    for (i=0; i < threads; i++)
+      GetExceptionInfo(&coder->exceptions[i]);
+  coder->semaphore=AllocateSemaphoreInfo();
+  if ((coder->handles == (TIFF **) NULL) ||
+      (coder->exceptions == (ExceptionInfo *) NULL) ||
+      (coder->sizes == (tsize_t *) NULL) ||
+      (coder->chunks == (unsigned char *) NULL) ||
+      (coder->semaphore == (SemaphoreInfo *) NULL) ||
+      (encode && ((coder->sinks == (TIFFThreadSink *) NULL) ||
+                  (coder->ids == (uint32 *) NULL) ||
+                  (coder->owners == (unsigned int *) NULL) ||
+                  (coder->offsets == (magick_uint64_t *) NULL) ||
+                  (coder->lengths == (magick_uint64_t *) NULL))) ||
+      (!encode && (coder->client_data == (TIFFThreadClientData *) NULL)))
+    {
+      if (coder->exceptions == (ExceptionInfo *) NULL)
+        coder->threads=0;
+      DestroyTIFFThreadedCoder(coder);
+      return (TIFFThreadedCoder *) NULL;
+    }
+  return coder;
+}
+
+/*
+  Prepare to decode the strips or tiles of the current directory of
+  tiff concurrently.
+*/
+static TIFFThreadedCoder *
+AllocateTIFFThreadedDecoder(TIFF *tiff,Image *image,unsigned int threads)
+{
+  TIFFThreadedCoder
+    *coder;
+
+  toff_t
+    directory_offset;
+
+  register unsigned int
+    i;
+
+  coder=AllocateTIFFThreadedCoder(tiff,threads,MagickFalse);
+  if (coder == (TIFFThreadedCoder *) NULL)
+    return coder;
+  directory_offset=TIFFCurrentDirOffset(tiff);
+  for (i=0; i < coder->threads; i++)
+    {
+      coder->client_data[i].image=image;
+      coder->client_data[i].semaphore=coder->semaphore;
+      coder->handles[i]=TIFFClientOpen(image->filename,"rb",
+                                       (thandle_t) &coder->client_data[i],
+                                       TIFFThreadReadBlob,TIFFThreadWriteBlob,
+                                       TIFFThreadSeekBlob,TIFFThreadCloseBlob,
+                                       TIFFThreadGetBlobSize,TIFFThreadMapBlob,
+                                       TIFFThreadUnmapBlob);
+      if ((coder->handles[i] == (TIFF *) NULL) ||
+          (TIFFSetSubDirectory(coder->handles[i],directory_offset) != 1))
+        {
+          DestroyTIFFThreadedCoder(coder);
+          return (TIFFThreadedCoder *) NULL;
+        }
+    }
+  return coder;
+}
+
+/*
+  Prepare to encode the strips or tiles of the current directory of
+  tiff concurrently.  The directory fields must already be set.
+*/
+static TIFFThreadedCoder *
+AllocateTIFFThreadedEncoder(TIFF *tiff,unsigned int threads)
+{
+  TIFFThreadedCoder
+    *coder;
+
+  register unsigned int
+    i;
+
+  coder=AllocateTIFFThreadedCoder(tiff,threads,MagickTrue);
+  if (coder == (TIFFThreadedCoder *) NULL)
+    return coder;
+  for (i=0; i < coder->threads; i++)
+    {
+      coder->handles[i]=TIFFClientOpen("TIFF encoder",
+                                       TIFFIsBigEndian(tiff) ? "wb" : "wl",
+                                       (thandle_t) &coder->sinks[i],
+                                       TIFFThreadReadSink,TIFFThreadWriteSink,
+                                       TIFFThreadSeekSink,TIFFThreadCloseBlob,
+                                       TIFFThreadGetSinkSize,TIFFThreadMapSink,
+                                       TIFFThreadUnmapBlob);
+      if ((coder->handles[i] == (TIFF *) NULL) ||
+          (CopyTIFFCodingFields(tiff,coder->handles[i],coder->tiled)
+           != MagickPass))
+        {
+          DestroyTIFFThreadedCoder(coder);
+          return (TIFFThreadedCoder *) NULL;
+        }
+      coder->sinks[i].base=coder->sinks[i].length;
+    }
+  return coder;
+}
+
+/*
+  Report the most severe error reported by the coding threads, and
+  restore the exception used by the error handlers of this thread.
+*/
+static void
+CollectTIFFThreadedExceptions(TIFFThreadedCoder *coder,
+                              ExceptionInfo *exception)
+{
+  register unsigned int
+    i;
+
+  (void) MagickTsdSetSpecific(tsd_key,(void *) exception);
+  for (i=0; i < coder->threads; i++)
+    if (coder->exceptions[i].severity != UndefinedException)
+      {
+        if (coder->exceptions[i].severity > exception->severity)
+          CopyException(exception,&coder->exceptions[i]);
+        DestroyExceptionInfo(&coder->exceptions[i]);
+        GetExceptionInfo(&coder->exceptions[i]);
+      }
+}
+
+/*
+  Return the decoded strip (or tile) number chunk, and set *size to its
+  size, or return NULL if it could not be decoded.  Strips (or tiles)
+  must be requested in increasing order.  When the requested strip is
+  not part of the current batch, the next batch is decoded.
+*/
+static unsigned char *
+ReadTIFFThreadedChunk(TIFFThreadedCoder *coder,const uint32 chunk,
+                      tsize_t *size,ExceptionInfo *exception)
+{
+  long
+    i;
+
+  *size=-1;
+  if (chunk >= coder->total)
+    return (unsigned char *) NULL;
+  if ((chunk < coder->first) || (chunk >= coder->first+coder->count))
+    {
+      coder->first=chunk;
+      coder->count=Min(coder->batch,coder->total-chunk);
+#if defined(HAVE_OPENMP)
+#  pragma omp parallel for num_threads(coder->threads) schedule(dynamic,1)
+#endif
+      for (i=0; i < (long) coder->count; i++)
+        {
+          int
+            thread;
+
+          unsigned char
+            *data;
+
+          thread=omp_get_thread_num();
+          (void) MagickTsdSetSpecific(tsd_key,(void *) &coder->exceptions[thread]);
+          data=coder->chunks+(size_t) i*coder->chunk_size;
+          if (coder->tiled)
+            coder->sizes[i]=TIFFReadEncodedTile(coder->handles[thread],
+                                                coder->first+i,data,
+                                                coder->chunk_size);
+          else
+            coder->sizes[i]=TIFFReadEncodedStrip(coder->handles[thread],
+                                                 coder->first+i,data,
+                                                 coder->chunk_size);
+        }
+      CollectTIFFThreadedExceptions(coder,exception);
+    }
+  *size=coder->sizes[chunk-coder->first];
+  if (*size == -1)
+    return (unsigned char *) NULL;
+  return coder->chunks+(size_t) (chunk-coder->first)*coder->chunk_size;
+}
+
+/*
+  Encode the queued strips (or tiles) concurrently, and write them in
+  order.
+*/
+static MagickPassFail
+FlushTIFFThreadedEncoder(TIFFThreadedCoder *coder,ExceptionInfo *exception)
+{
+  long
+    i;
+
+  MagickPassFail
+    status=MagickPass;
+
+  register unsigned int
+    j;
+
+  if (coder->count == 0)
+    return status;
+  /*
+    Earlier chunks have been written, so start each sink afresh.
+    Encoding handles append new strips or tiles at the end of the file.
+  */
+  for (j=0; j < coder->threads; j++)
+    coder->sinks[j].length=coder->sinks[j].base;
+#if defined(HAVE_OPENMP)
+#  pragma omp parallel for num_threads(coder->threads) schedule(dynamic,1)
+#endif
+  for (i=0; i < (long) coder->count; i++)
+    {
+      int
+        thread;
+
+      magick_uint64_t
+        *lengths,
+        *offsets;
+
+      TIFF
+        *encoder;
+
+      tsize_t
+        result;
+
+      unsigned char
+        *data;
+
+      thread=omp_get_thread_num();
+      (void) MagickTsdSetSpecific(tsd_key,(void *) &coder->exceptions[thread]);
+      encoder=coder->handles[thread];
+      coder->owners[i]=(unsigned int) thread;
+      data=coder->chunks+(size_t) i*coder->chunk_size;
+      if (coder->tiled)
+        result=TIFFWriteEncodedTile(encoder,coder->ids[i],data,coder->sizes[i]);
+      else
+        result=TIFFWriteEncodedStrip(encoder,coder->ids[i],data,coder->sizes[i]);
+      if ((result != -1) &&
+          (TIFFGetField(encoder,coder->tiled ? TIFFTAG_TILEOFFSETS :
+                        TIFFTAG_STRIPOFFSETS,&offsets) == 1) &&
+          (TIFFGetField(encoder,coder->tiled ? TIFFTAG_TILEBYTECOUNTS :
+                        TIFFTAG_STRIPBYTECOUNTS,&lengths) == 1) &&
+          (offsets[coder->ids[i]]+lengths[coder->ids[i]] <=
+           coder->sinks[thread].length))
+        {
+          coder->offsets[i]=offsets[coder->ids[i]];
+          coder->lengths[i]=lengths[coder->ids[i]];
+        }
+      else
+        coder->sizes[i]=-1;
+    }
+  CollectTIFFThreadedExceptions(coder,exception);
+  for (i=0; i < (long) coder->count; i++)
+    {
+      unsigned char
+        *data;
+
+      if (coder->sizes[i] == -1)
+        {
+          status=MagickFail;
+          break;
+        }
+      data=coder->sinks[coder->owners[i]].data+coder->offsets[i];
+      if (coder->tiled)
+        {
+          if (TIFFWriteRawTile(coder->tiff,coder->ids[i],data,
+                               (tsize_t) coder->lengths[i]) == -1)
+            status=MagickFail;
+        }
+      else
+        {
+          if (TIFFWriteRawStrip(coder->tiff,coder->ids[i],data,
+                                (tsize_t) coder->lengths[i]) == -1)
+            status=MagickFail;
+        }
+      if (status == MagickFail)
+        break;
+    }
+  coder->count=0;
+  return status;
+}
+
+/*
+  Return the buffer into which to store the next uncompressed strip (or
+  tile), encoding and writing the current batch first if it is full.
+*/
+static unsigned char *
+NextTIFFThreadedChunk(TIFFThreadedCoder *coder,ExceptionInfo *exception)
+{
+  if (coder->count == coder->batch)
+    if (FlushTIFFThreadedEncoder(coder,exception) == MagickFail)
+      return (unsigned char *) NULL;
+  return coder->chunks+(size_t) coder->count*coder->chunk_size;
+}
+
+/*
+  Queue the buffer returned by NextTIFFThreadedChunk() as strip (or
+  tile) number id, holding size bytes.
+*/
+static void
+QueueTIFFThreadedChunk(TIFFThreadedCoder *coder,const uint32 id,
+                       const tsize_t size)
+{
+  coder->ids[coder->count]=id;
+  coder->sizes[coder->count]=size;
+  coder->count++;
+}
+#endif /* defined(TIFF_THREADED_CODING) */
 
 /*
   Initialize the image colormap.
@@ -1875,6 +2727,11 @@ ReadTIFFImage(const ImageInfo *image_info,ExceptionInfo *exception)
   MagickPassFail
     status;
 
+#if defined(TIFF_THREADED_CODING)
+  unsigned int
+    coding_threads;
+#endif
+
   /*
     Open image.
   */
@@ -1902,6 +2759,9 @@ ReadTIFFImage(const ImageInfo *image_info,ExceptionInfo *exception)
                       TIFFGetBlobSize,TIFFMapBlob,TIFFUnmapBlob);
   if (tiff == (TIFF *) NULL)
     ThrowReaderException(FileOpenError,UnableToOpenFile,image);
+#if defined(TIFF_THREADED_CODING)
+  coding_threads=TIFFCodingThreads(image_info);
+#endif
 
   /*
     Report error if error was reported via TIFFReadErrors() while in
@@ -2461,6 +3321,12 @@ ReadTIFFImage(const ImageInfo *image_info,ExceptionInfo *exception)
               method=TiledMethod;
             else if (TIFFStripSize(tiff) <= 1024*256)
               method=StrippedMethod;
+#if defined(TIFF_THREADED_CODING)
+            else if ((coding_threads > 1) && (TIFFNumberOfStrips(tiff) > 1) &&
+                     TIFFThreadedDecodeSupported(compress_tag,photometric))
+              /* Strips are decoded concurrently by the stripped method */
+              method=StrippedMethod;
+#endif
             if (photometric == PHOTOMETRIC_MINISWHITE)
               import_options.grayscale_miniswhite=MagickTrue;
           }
@@ -2510,6 +3376,22 @@ ReadTIFFImage(const ImageInfo *image_info,ExceptionInfo *exception)
       if ((16 == bits_per_sample) || (32 == bits_per_sample) || (64 == bits_per_sample))
         import_options.endian=NativeEndian;
 
+      /*
+        Separate planes are read by revisiting each row once per
+        sample, which a stream pixel cache does not allow.
+      */
+      if ((planar_config == PLANARCONFIG_SEPARATE) && (samples_per_pixel > 1) &&
+          ((method == ScanLineMethod) || (method == StrippedMethod) ||
+           (method == TiledMethod)) &&
+          GetPixelCacheIsStream(image))
+        {
+          (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                                "Separate planes can not be read into a"
+                                " stream pixel cache");
+          ThrowTIFFReaderException(StreamError,UnableToAcquirePixelStream,
+                                   image);
+        }
+
       switch (method)
         {
         case ScanLineMethod:
@@ -2707,6 +3589,11 @@ ReadTIFFImage(const ImageInfo *image_info,ExceptionInfo *exception)
             ImportPixelAreaInfo
               import_info;
 
+#if defined(TIFF_THREADED_CODING)
+            TIFFThreadedCoder
+              *decoder = (TIFFThreadedCoder *) NULL;
+#endif
+
             if (logging)
               (void) LogMagickEvent(CoderEvent,GetMagickModule(),
                                     "Using stripped read method with %u bits per sample",
@@ -2774,6 +3661,15 @@ ReadTIFFImage(const ImageInfo *image_info,ExceptionInfo *exception)
                 ThrowTIFFReaderException(ResourceLimitError,MemoryAllocationFailed,
                                          image);
               }
+#if defined(TIFF_THREADED_CODING)
+            if ((coding_threads > 1) &&
+                TIFFThreadedDecodeSupported(compress_tag,photometric))
+              decoder=AllocateTIFFThreadedDecoder(tiff,image,coding_threads);
+            if ((decoder != (TIFFThreadedCoder *) NULL) && logging)
+              (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                                    "Decoding strips using %u threads",
+                                    decoder->threads);
+#endif
             /*
               Compute per-row stride.
             */
@@ -2818,6 +3714,20 @@ ReadTIFFImage(const ImageInfo *image_info,ExceptionInfo *exception)
                         /*
                           Obtain a strip
                         */
+                        p=strip;
+#if defined(TIFF_THREADED_CODING)
+                        if (decoder != (TIFFThreadedCoder *) NULL)
+                          {
+                            if ((p=ReadTIFFThreadedChunk(decoder,strip_id,
+                                                         &strip_size,exception))
+                                == (unsigned char *) NULL)
+                              {
+                                status=MagickFail;
+                                break;
+                              }
+                          }
+                        else
+#endif
                         if (((strip_size=TIFFReadEncodedStrip(tiff,strip_id,strip,
                                                               strip_size_max)) == -1))
                           {
@@ -2826,12 +3736,11 @@ ReadTIFFImage(const ImageInfo *image_info,ExceptionInfo *exception)
                           }
 #if !defined(WORDS_BIGENDIAN)
                         if (24 == bits_per_sample)
-                          SwabDataToBigEndian(bits_per_sample,strip,strip_size);
+                          SwabDataToBigEndian(bits_per_sample,p,strip_size);
 #endif
                         rows_remaining=rows_per_strip;
                         if (y+rows_per_strip > image->rows)
                           rows_remaining=(rows_per_strip-(y+rows_per_strip-image->rows));
-                        p=strip;
                         strip_id++;
                       }
                     /*
@@ -2885,6 +3794,9 @@ ReadTIFFImage(const ImageInfo *image_info,ExceptionInfo *exception)
                 if (status == MagickFail)
                   break;
               }
+#if defined(TIFF_THREADED_CODING)
+            DestroyTIFFThreadedCoder(decoder);
+#endif
             MagickFreeResourceLimitedMemory(strip);
             break;
           }
@@ -2918,6 +3830,11 @@ ReadTIFFImage(const ImageInfo *image_info,ExceptionInfo *exception)
               tile_num=0,
               tiles_total;
 
+#if defined(TIFF_THREADED_CODING)
+            TIFFThreadedCoder
+              *decoder = (TIFFThreadedCoder *) NULL;
+#endif
+
             if (logging)
               (void) LogMagickEvent(CoderEvent,GetMagickModule(),
                                     "Using tiled %s read method with %u bits per sample",
@@ -3026,6 +3943,15 @@ ReadTIFFImage(const ImageInfo *image_info,ExceptionInfo *exception)
               Compute per-row stride.
             */
             stride=TIFFTileRowSize(tiff);
+#if defined(TIFF_THREADED_CODING)
+            if ((coding_threads > 1) &&
+                TIFFThreadedDecodeSupported(compress_tag,photometric))
+              decoder=AllocateTIFFThreadedDecoder(tiff,image,coding_threads);
+            if ((decoder != (TIFFThreadedCoder *) NULL) && logging)
+              (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                                    "Decoding tiles using %u threads",
+                                    decoder->threads);
+#endif
 
             /*
               Process each plane.
@@ -3074,6 +4000,21 @@ ReadTIFFImage(const ImageInfo *image_info,ExceptionInfo *exception)
                           Read a tile.
                         */
                         tile_num++;
+                        p=tile;
+#if defined(TIFF_THREADED_CODING)
+                        if (decoder != (TIFFThreadedCoder *) NULL)
+                          {
+                            if ((p=ReadTIFFThreadedChunk(decoder,
+                                                         TIFFComputeTile(tiff,x,y,0,sample),
+                                                         &tile_size,exception))
+                                == (unsigned char *) NULL)
+                              {
+                                status=MagickFail;
+                                break;
+                              }
+                          }
+                        else
+#endif
                         if ((tile_size=TIFFReadTile(tiff,tile,x,y,0,sample)) == -1)
                           {
                             status=MagickFail;
@@ -3081,9 +4022,8 @@ ReadTIFFImage(const ImageInfo *image_info,ExceptionInfo *exception)
                           }
 #if !defined(WORDS_BIGENDIAN)
                         if (24 == bits_per_sample)
-                          SwabDataToBigEndian(bits_per_sample,tile,tile_size);
+                          SwabDataToBigEndian(bits_per_sample,p,tile_size);
 #endif
-                        p=tile;
                         for (yy=y; yy < (long) y+tile_set_rows; yy++)
                           {
                             /*
@@ -3155,6 +4095,9 @@ ReadTIFFImage(const ImageInfo *image_info,ExceptionInfo *exception)
                 if (status == MagickFail)
                   break;
               }
+#if defined(TIFF_THREADED_CODING)
+            DestroyTIFFThreadedCoder(decoder);
+#endif
 
             MagickFreeResourceLimitedMemory(tile);
             break;
@@ -3797,6 +4740,8 @@ RegisterTIFFImage(void)
   entry->thread_support=MagickFalse; /* libtiff uses libjpeg which is not thread safe */
   entry->decoder=(DecoderHandler) ReadTIFFImage;
   entry->encoder=(EncoderHandler) WriteTIFFImage;
+  entry->stream_encoder=(StreamEncoderHandler) WriteTIFFStream;
+  entry->stream_support=MagickTrue;
   entry->seekable_stream=MagickTrue;
   entry->description=TIFFDescription;
   if (*version != '\0')
@@ -3813,6 +4758,8 @@ RegisterTIFFImage(void)
   entry->thread_support=MagickFalse; /* libtiff uses libjpeg which is not thread safe */
   entry->decoder=(DecoderHandler) ReadTIFFImage;
   entry->encoder=(EncoderHandler) WriteTIFFImage;
+  entry->stream_encoder=(StreamEncoderHandler) WriteTIFFStream;
+  entry->stream_support=MagickTrue;
   entry->magick=(MagickHandler) IsTIFF;
   entry->seekable_stream=MagickTrue;
   entry->description=TIFFDescription;
@@ -4350,6 +5297,11 @@ WriteTIFFImage(const ImageInfo *image_info,Image *image)
   size_t
     image_list_length;
 
+#if defined(TIFF_THREADED_CODING)
+  unsigned int
+    coding_threads;
+#endif
+
   /*
     Open TIFF file.
   */
@@ -4362,6 +5314,9 @@ WriteTIFFImage(const ImageInfo *image_info,Image *image)
   status=OpenBlob(image_info,image,WriteBinaryBlobMode,&image->exception);
   if (status == MagickFail)
     ThrowWriterException(FileOpenError,UnableToOpenFile,image);
+#if defined(TIFF_THREADED_CODING)
+  coding_threads=TIFFCodingThreads(image_info);
+#endif
   (void) MagickTsdSetSpecific(tsd_key,(void *) (&image->exception));
   (void) TIFFSetErrorHandler((TIFFErrorHandler) TIFFWriteErrors);
   (void) TIFFSetWarningHandler((TIFFErrorHandler) (CheckThrowWarnings(image_info) ?
@@ -5873,6 +6828,18 @@ WriteTIFFImage(const ImageInfo *image_info,Image *image)
             QuantumType
               quantum_type;
 
+#if defined(TIFF_THREADED_CODING)
+            TIFFThreadedCoder
+              *encoder = (TIFFThreadedCoder *) NULL;
+
+            unsigned char
+              *strip = (unsigned char *) NULL;
+
+            uint32
+              strip_rows = 0,
+              strips_per_plane = 0;
+#endif
+
             /*
               Allocate memory for one scanline.
             */
@@ -5901,6 +6868,28 @@ WriteTIFFImage(const ImageInfo *image_info,Image *image)
             scanline=MagickAllocateResourceLimitedMemory(unsigned char *,(size_t) scanline_size);
             if (scanline == (unsigned char *) NULL)
               ThrowTIFFWriterException(ResourceLimitError,MemoryAllocationFailed,image);
+#if defined(TIFF_THREADED_CODING)
+            /*
+              Rows are collected into strips which are then encoded
+              concurrently.
+            */
+            if ((coding_threads > 1) &&
+                TIFFThreadedEncodeSupported(compress_tag,photometric) &&
+                (TIFFGetFieldDefaulted(tiff,TIFFTAG_ROWSPERSTRIP,&strip_rows) == 1) &&
+                (strip_rows > 0))
+              {
+                encoder=AllocateTIFFThreadedEncoder(tiff,coding_threads);
+                /*
+                  TIFFComputeStrip() can not be used here since libtiff
+                  only sets up the strips per plane on the first write.
+                */
+                strips_per_plane=(image->rows+strip_rows-1)/strip_rows;
+              }
+            if ((encoder != (TIFFThreadedCoder *) NULL) && logging)
+              (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                                    "Encoding strips using %u threads",
+                                    encoder->threads);
+#endif
             /*
               For each plane
             */
@@ -5920,6 +6909,9 @@ WriteTIFFImage(const ImageInfo *image_info,Image *image)
                   }
                 for (y=0; y < image->rows; y++)
                   {
+                    unsigned char
+                      *row;
+
                     if ((image->matte) && (alpha_type == AssociatedAlpha))
                       p=GetImagePixels(image,0,y,image->columns,1);
                     else
@@ -5935,11 +6927,25 @@ WriteTIFFImage(const ImageInfo *image_info,Image *image)
                     if ((sample == 0) && (image->matte) &&
                         (alpha_type == AssociatedAlpha))
                       AssociateAlphaRegion(image);
+                    row=scanline;
+#if defined(TIFF_THREADED_CODING)
+                    if (encoder != (TIFFThreadedCoder *) NULL)
+                      {
+                        if ((y % strip_rows) == 0)
+                          if ((strip=NextTIFFThreadedChunk(encoder,&image->exception))
+                              == (unsigned char *) NULL)
+                            {
+                              status=MagickFail;
+                              break;
+                            }
+                        row=strip+(size_t) (y % strip_rows)*scanline_size;
+                      }
+#endif
                     /*
                       Export pixels to scanline.
                     */
                     if (ExportImagePixelArea(image,quantum_type,bits_per_sample,
-                                             scanline,&export_options,&export_info)
+                                             row,&export_options,&export_info)
                         == MagickFail)
                       {
                         status=MagickFail;
@@ -5950,9 +6956,21 @@ WriteTIFFImage(const ImageInfo *image_info,Image *image)
                     */
 #if !defined(WORDS_BIGENDIAN)
                     if (24 == bits_per_sample)
-                      SwabDataToNativeEndian(bits_per_sample,scanline,scanline_size);
+                      SwabDataToNativeEndian(bits_per_sample,row,scanline_size);
 #endif
-                    if (TIFFWriteScanline(tiff, scanline,y,sample) == -1)
+#if defined(TIFF_THREADED_CODING)
+                    if (encoder != (TIFFThreadedCoder *) NULL)
+                      {
+                        if ((((y+1) % strip_rows) == 0) || (y+1 == image->rows))
+                          QueueTIFFThreadedChunk(encoder,
+                                                 y/strip_rows+
+                                                 sample*strips_per_plane,
+                                                 (tsize_t) ((y % strip_rows)+1)*
+                                                 scanline_size);
+                      }
+                    else
+#endif
+                    if (TIFFWriteScanline(tiff, row,y,sample) == -1)
                       {
                         status=MagickFail;
                         break;
@@ -5973,6 +6991,16 @@ WriteTIFFImage(const ImageInfo *image_info,Image *image)
                 if (status == MagickFail)
                   break;
               }
+#if defined(TIFF_THREADED_CODING)
+            if (encoder != (TIFFThreadedCoder *) NULL)
+              {
+                if ((status != MagickFail) &&
+                    (FlushTIFFThreadedEncoder(encoder,&image->exception)
+                     == MagickFail))
+                  status=MagickFail;
+                DestroyTIFFThreadedCoder(encoder);
+              }
+#endif
             MagickFreeResourceLimitedMemory(scanline);
             break;
           }
@@ -6004,6 +7032,11 @@ WriteTIFFImage(const ImageInfo *image_info,Image *image)
             unsigned long
               tile_total_pixels;
 
+#if defined(TIFF_THREADED_CODING)
+            TIFFThreadedCoder
+              *encoder = (TIFFThreadedCoder *) NULL;
+#endif
+
             if (logging)
               (void) LogMagickEvent(CoderEvent,GetMagickModule(),
                                     "Using tiled %s write method with %u bits "
@@ -6101,6 +7134,19 @@ WriteTIFFImage(const ImageInfo *image_info,Image *image)
               Obtain per-row stride.
             */
             stride=TIFFTileRowSize(tiff);
+#if defined(TIFF_THREADED_CODING)
+            /*
+              Tiles are collected into batches which are then encoded
+              concurrently.
+            */
+            if ((coding_threads > 1) && (status != MagickFail) &&
+                TIFFThreadedEncodeSupported(compress_tag,photometric))
+              encoder=AllocateTIFFThreadedEncoder(tiff,coding_threads);
+            if ((encoder != (TIFFThreadedCoder *) NULL) && logging)
+              (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                                    "Encoding tiles using %u threads",
+                                    encoder->threads);
+#endif
 
             /*
               Process each plane.
@@ -6131,6 +7177,7 @@ WriteTIFFImage(const ImageInfo *image_info,Image *image)
                           tile_set_rows;
 
                         unsigned char
+                          *chunk,
                           *q;
 
                         register long
@@ -6148,7 +7195,17 @@ WriteTIFFImage(const ImageInfo *image_info,Image *image)
                         else
                           tile_set_rows=tile_rows;
 
-                        q=tile;
+                        chunk=tile;
+#if defined(TIFF_THREADED_CODING)
+                        if (encoder != (TIFFThreadedCoder *) NULL)
+                          if ((chunk=NextTIFFThreadedChunk(encoder,&image->exception))
+                              == (unsigned char *) NULL)
+                            {
+                              status=MagickFail;
+                              break;
+                            }
+#endif
+                        q=chunk;
                         for (yy=y; yy < (long) y+tile_set_rows; yy++)
                           {
                             /*
@@ -6194,9 +7251,16 @@ WriteTIFFImage(const ImageInfo *image_info,Image *image)
                         */
 #if !defined(WORDS_BIGENDIAN)
                         if (24 == bits_per_sample)
-                          SwabDataToNativeEndian(bits_per_sample,tile,tile_size_max);
+                          SwabDataToNativeEndian(bits_per_sample,chunk,tile_size_max);
 #endif
-                        if ((tile_size=TIFFWriteTile(tiff,tile,x,y,0,sample)) == -1)
+#if defined(TIFF_THREADED_CODING)
+                        if (encoder != (TIFFThreadedCoder *) NULL)
+                          QueueTIFFThreadedChunk(encoder,
+                                                 TIFFComputeTile(tiff,x,y,0,sample),
+                                                 tile_size_max);
+                        else
+#endif
+                        if ((tile_size=TIFFWriteTile(tiff,chunk,x,y,0,sample)) == -1)
                           {
                             status=MagickFail;
                           }
@@ -6220,6 +7284,16 @@ WriteTIFFImage(const ImageInfo *image_info,Image *image)
                       break;
                   } /* for y */
               } /* for sample */
+#if defined(TIFF_THREADED_CODING)
+            if (encoder != (TIFFThreadedCoder *) NULL)
+              {
+                if ((status != MagickFail) &&
+                    (FlushTIFFThreadedEncoder(encoder,&image->exception)
+                     == MagickFail))
+                  status=MagickFail;
+                DestroyTIFFThreadedCoder(encoder);
+              }
+#endif
             MagickFreeResourceLimitedMemory(tile);
             break;
           }
@@ -6260,4 +7334,363 @@ WriteTIFFImage(const ImageInfo *image_info,Image *image)
 
   return(MagickPass);
 }
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   W r i t e T I F F S t r e a m                                             %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  Method WriteTIFFStream writes a single frame stripped TIFF a band of rows
+%  at a time (see StreamImage()).  Samples are contiguous, with 8 or 16 bits
+%  per sample, and the photometric is selected from the image colorspace and
+%  the is_grayscale flag rather than by inspecting the pixels.  Only LZW and
+%  Zip compression are supported.  Other compression types inherited from
+%  the input image are replaced with no compression, while explicitly
+%  requested ones are rejected by the QueryStreamEncode phase.
+%
+%  The format of the WriteTIFFStream method is:
+%
+%      MagickPassFail WriteTIFFStream(const ImageInfo *image_info,
+%        Image *image,const Image *rows,const StreamEncodePhase phase,
+%        void **state)
+%
+%  A description of each parameter follows:
+%
+%    o image_info: Specifies a pointer to a ImageInfo structure.
+%
+%    o image:  The image attributes, and the output blob.
+%
+%    o rows:  The next band of rows.
+%
+%    o phase:  The encoding phase.
+%
+%    o state:  Encoder state retained between phases.
+%
+*/
+typedef struct _TIFFStreamState
+{
+  Magick_TIFF_ClientData
+    client_data;
+
+  TIFF
+    *tiff;
+
+  QuantumType
+    quantum_type;
+
+  unsigned int
+    bits_per_sample;
+
+  ExportPixelAreaOptions
+    export_options;
+
+  unsigned char
+    *scanline;
+
+  uint32
+    row;
+} TIFFStreamState;
+
+/*
+  Select the compression used to stream image, and fail if the requested
+  compression or the image colorspace can not be streamed.
+*/
+static MagickPassFail
+QueryTIFFStream(const ImageInfo *image_info,Image *image,uint16 *compress_tag)
+{
+  char
+    compression_name[MaxTextExtent];
+
+  CompressionType
+    compression;
+
+  compression=image->compression;
+  if (image_info->compression != UndefinedCompression)
+    compression=image_info->compression;
+  switch (compression)
+    {
+    case UndefinedCompression:
+    case NoCompression:
+      *compress_tag=COMPRESSION_NONE;
+      break;
+    case LZWCompression:
+      *compress_tag=COMPRESSION_LZW;
+      break;
+    case ZipCompression:
+      *compress_tag=COMPRESSION_ADOBE_DEFLATE;
+      break;
+    default:
+      if (image_info->compression == compression)
+        ThrowBinaryException(StreamError,NoStreamHandlerIsDefined,
+                             image->filename);
+      (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                            "%s compression is not supported for streaming."
+                            "  Compression request removed",
+                            CompressionTypeToString(compression));
+      *compress_tag=COMPRESSION_NONE;
+      break;
+    }
+  if ((*compress_tag != COMPRESSION_NONE) &&
+      (CompressionSupported(compression,compression_name) != MagickTrue))
+    *compress_tag=COMPRESSION_NONE;
+  if ((image->colorspace != CMYKColorspace) &&
+      !IsRGBCompatibleColorspace(image->colorspace))
+    ThrowBinaryException(StreamError,NoStreamHandlerIsDefined,
+                         image->filename);
+  return(MagickPass);
+}
+
+static MagickPassFail
+OpenTIFFStream(const ImageInfo *image_info,Image *image,
+               TIFFStreamState *stream_state)
+{
+  char
+    open_flags[MaxTextExtent];
+
+  const ImageAttribute
+    *attribute;
+
+  TIFF
+    *tiff;
+
+  tsize_t
+    scanline_size;
+
+  uint16
+    compress_tag,
+    photometric,
+    samples_per_pixel;
+
+  uint32
+    rows_per_strip;
+
+  if (QueryTIFFStream(image_info,image,&compress_tag) == MagickFail)
+    return(MagickFail);
+  stream_state->bits_per_sample=(image->depth <= 8 ? 8 : 16);
+  if (image->colorspace == CMYKColorspace)
+    {
+      photometric=PHOTOMETRIC_SEPARATED;
+      stream_state->quantum_type=(image->matte ? CMYKAQuantum : CMYKQuantum);
+      samples_per_pixel=4;
+    }
+  else if (image->is_grayscale)
+    {
+      photometric=PHOTOMETRIC_MINISBLACK;
+      stream_state->quantum_type=(image->matte ? GrayAlphaQuantum :
+                                  GrayQuantum);
+      samples_per_pixel=1;
+    }
+  else
+    {
+      photometric=PHOTOMETRIC_RGB;
+      stream_state->quantum_type=(image->matte ? RGBAQuantum : RGBQuantum);
+      samples_per_pixel=3;
+    }
+  if (image->matte)
+    samples_per_pixel++;
+
+  (void) strlcpy(open_flags,"w",sizeof(open_flags));
+  if (image_info->endian == LSBEndian)
+    (void) strlcat(open_flags,"l",sizeof(open_flags));
+  else if (image_info->endian == MSBEndian)
+    (void) strlcat(open_flags,"b",sizeof(open_flags));
+  stream_state->client_data.image=image;
+  stream_state->client_data.image_info=image_info;
+  tiff=TIFFClientOpen(image->filename,open_flags,
+                      (thandle_t) &stream_state->client_data,
+                      TIFFReadBlob,TIFFWriteBlob,TIFFSeekBlob,
+                      TIFFCloseBlob,TIFFGetBlobSize,TIFFMapBlob,
+                      TIFFUnmapBlob);
+  if (tiff == (TIFF *) NULL)
+    return(MagickFail);
+  stream_state->tiff=tiff;
+  (void) TIFFSetField(tiff,TIFFTAG_IMAGEWIDTH,(uint32) image->columns);
+  (void) TIFFSetField(tiff,TIFFTAG_IMAGELENGTH,(uint32) image->rows);
+  if (image->orientation != UndefinedOrientation)
+    (void) TIFFSetField(tiff,TIFFTAG_ORIENTATION,(uint16) image->orientation);
+  (void) TIFFSetField(tiff,TIFFTAG_PHOTOMETRIC,photometric);
+  (void) TIFFSetField(tiff,TIFFTAG_BITSPERSAMPLE,
+                      (uint16) stream_state->bits_per_sample);
+  (void) TIFFSetField(tiff,TIFFTAG_SAMPLESPERPIXEL,samples_per_pixel);
+  (void) TIFFSetField(tiff,TIFFTAG_SAMPLEFORMAT,SAMPLEFORMAT_UINT);
+  (void) TIFFSetField(tiff,TIFFTAG_PLANARCONFIG,PLANARCONFIG_CONTIG);
+  (void) TIFFSetField(tiff,TIFFTAG_COMPRESSION,compress_tag);
+  if (photometric == PHOTOMETRIC_SEPARATED)
+    (void) TIFFSetField(tiff,TIFFTAG_INKSET,INKSET_CMYK);
+  if (image->matte)
+    {
+      uint16
+        sample_info[1];
+
+      sample_info[0]=EXTRASAMPLE_UNSPECIFIED;
+      if ((attribute=GetImageAttribute(image,"alpha")))
+        {
+          if (LocaleCompare(attribute->value,"associated") == 0)
+            sample_info[0]=EXTRASAMPLE_ASSOCALPHA;
+          else if (LocaleCompare(attribute->value,"unassociated") == 0)
+            sample_info[0]=EXTRASAMPLE_UNASSALPHA;
+        }
+      (void) TIFFSetField(tiff,TIFFTAG_EXTRASAMPLES,1,&sample_info);
+    }
+  if ((compress_tag != COMPRESSION_NONE) &&
+      (photometric != PHOTOMETRIC_SEPARATED))
+    (void) TIFFSetField(tiff,TIFFTAG_PREDICTOR,PREDICTOR_HORIZONTAL);
+  scanline_size=TIFFScanlineSize(tiff);
+  if (scanline_size <= 0)
+    ThrowBinaryException(CoderError,ImageColumnOrRowSizeIsNotSupported,
+                         image->filename);
+  rows_per_strip=TIFF_BYTES_PER_STRIP/scanline_size;
+  if (rows_per_strip == 0)
+    rows_per_strip=1;
+  (void) TIFFSetField(tiff,TIFFTAG_ROWSPERSTRIP,rows_per_strip);
+  if ((image->x_resolution != 0) && (image->y_resolution != 0))
+    {
+      uint16
+        units;
+
+      units=RESUNIT_NONE;
+      if (image->units == PixelsPerInchResolution)
+        units=RESUNIT_INCH;
+      if (image->units == PixelsPerCentimeterResolution)
+        units=RESUNIT_CENTIMETER;
+      (void) TIFFSetField(tiff,TIFFTAG_RESOLUTIONUNIT,units);
+      (void) TIFFSetField(tiff,TIFFTAG_XRESOLUTION,image->x_resolution);
+      (void) TIFFSetField(tiff,TIFFTAG_YRESOLUTION,image->y_resolution);
+    }
+  if ((attribute=GetImageAttribute(image,"comment")))
+    (void) TIFFSetField(tiff,TIFFTAG_IMAGEDESCRIPTION,attribute->value);
+  (void) TIFFSetField(tiff,TIFFTAG_SOFTWARE,
+                      GetMagickVersion((unsigned long *) NULL));
+  (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                        "Streaming %s, %u bits, %s compression,"
+                        " %u rows per strip",
+                        PhotometricTagToString(photometric),
+                        stream_state->bits_per_sample,
+                        CompressionTagToString(compress_tag),
+                        (unsigned int) rows_per_strip);
+  ExportPixelAreaOptionsInit(&stream_state->export_options);
+  stream_state->export_options.endian=NativeEndian;
+  stream_state->scanline=
+    MagickAllocateResourceLimitedMemory(unsigned char *,(size_t) scanline_size);
+  if (stream_state->scanline == (unsigned char *) NULL)
+    ThrowBinaryException(ResourceLimitError,MemoryAllocationFailed,
+                         image->filename);
+  return(MagickPass);
+}
+
+static MagickPassFail
+WriteTIFFStream(const ImageInfo *image_info,Image *image,const Image *rows,
+                const StreamEncodePhase phase,void **state)
+{
+  TIFFErrorHandler
+    error_handler,
+    warning_handler;
+
+  TIFFStreamState
+    *stream_state;
+
+  void
+    *tsd_value;
+
+  MagickPassFail
+    status;
+
+  unsigned long
+    y;
+
+  /*
+    The decoder may also be using libtiff, so restore its error
+    reporting before returning.
+  */
+  tsd_value=MagickTsdGetSpecific(tsd_key);
+  (void) MagickTsdSetSpecific(tsd_key,(void *) (&image->exception));
+  error_handler=TIFFSetErrorHandler((TIFFErrorHandler) TIFFWriteErrors);
+  warning_handler=
+    TIFFSetWarningHandler((TIFFErrorHandler) (CheckThrowWarnings(image_info) ?
+                                              TIFFWarningsThrowException :
+                                              TIFFWarningsLogOnly));
+  status=MagickPass;
+  stream_state=(TIFFStreamState *) *state;
+  switch (phase)
+    {
+    case QueryStreamEncode:
+      {
+        uint16
+          compress_tag;
+
+        status=QueryTIFFStream(image_info,image,&compress_tag);
+        break;
+      }
+    case BeginStreamEncode:
+      {
+        stream_state=MagickAllocateClearedMemory(TIFFStreamState *,
+                                                 sizeof(TIFFStreamState));
+        if (stream_state == (TIFFStreamState *) NULL)
+          {
+            ThrowException(&image->exception,ResourceLimitError,
+                           MemoryAllocationFailed,image->filename);
+            status=MagickFail;
+            break;
+          }
+        *state=stream_state;
+        status=OpenTIFFStream(image_info,image,stream_state);
+        break;
+      }
+    case RowsStreamEncode:
+      {
+        for (y=0; y < rows->rows; y++)
+          {
+            if (AcquireImagePixels(rows,0,y,rows->columns,1,&image->exception)
+                == (const PixelPacket *) NULL)
+              {
+                status=MagickFail;
+                break;
+              }
+            if (ExportImagePixelArea(rows,stream_state->quantum_type,
+                                     stream_state->bits_per_sample,
+                                     stream_state->scanline,
+                                     &stream_state->export_options,0)
+                == MagickFail)
+              {
+                status=MagickFail;
+                break;
+              }
+            if (TIFFWriteScanline(stream_state->tiff,stream_state->scanline,
+                                  stream_state->row,0) == -1)
+              {
+                status=MagickFail;
+                break;
+              }
+            stream_state->row++;
+          }
+        break;
+      }
+    case EndStreamEncode:
+      {
+        if (stream_state == (TIFFStreamState *) NULL)
+          break;
+        if (stream_state->tiff != (TIFF *) NULL)
+          {
+            if ((stream_state->row == image->rows) &&
+                !TIFFWriteDirectory(stream_state->tiff))
+              status=MagickFail;
+            TIFFClose(stream_state->tiff); /* Invokes CloseBlob(image) */
+          }
+        MagickFreeResourceLimitedMemory(stream_state->scanline);
+        MagickFreeMemory(stream_state);
+        *state=(void *) NULL;
+        break;
+      }
+    }
+  (void) TIFFSetErrorHandler(error_handler);
+  (void) TIFFSetWarningHandler(warning_handler);
+  (void) MagickTsdSetSpecific(tsd_key,tsd_value);
+  return(status);
+}
 #endif
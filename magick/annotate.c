@@ -49,6 +49,8 @@
 #include "magick/log.h"
 #include "magick/pixel_cache.h"
 #include "magick/render.h"
+#include "magick/resource.h"
+#include "magick/semaphore.h"
 #include "magick/tempfile.h"
 #include "magick/transform.h"
 #include "magick/utility.h"
@@ -94,6 +96,134 @@ static unsigned int
   RenderFreetype(Image *,const DrawInfo *,const char *,const PointInfo *,
     TypeMetric *),
   RenderX11(Image *,const DrawInfo *,const PointInfo *,TypeMetric *);
+
+#if defined(HasTTF)
+/*
+  FreeType library, face, and glyph cache.
+
+  A single FT_Library is shared by all threads.  Faces are cached by
+  font file and face index.  A face is checked out for exclusive use by
+  one thread while text is rendered and is then returned to the cache.
+  Glyph outlines and rendered glyph bitmaps are retained in an LRU cache
+  which is bounded by MAGICK_GLYPH_CACHE_LIMIT (bytes) and is charged
+  against the memory resource.
+*/
+#define FreetypeMaxIdleFaces 16
+#define FreetypeGlyphCacheBuckets 1021
+#define FreetypeGlyphCacheDefaultLimit (8*1024*1024)
+
+typedef struct _FreetypeFontInfo
+{
+  char
+    *path;                      /* font file path */
+
+  long
+    index;                      /* face index within font file */
+
+  unsigned long
+    id;                         /* unique font id used in glyph keys */
+
+  struct _FreetypeFontInfo
+    *next;
+} FreetypeFontInfo;
+
+typedef struct _FreetypeFaceInfo
+{
+  FreetypeFontInfo
+    *font;                      /* font this face was opened from */
+
+  FT_Face
+    face;                       /* FreeType face */
+
+  MagickBool
+    in_use;                     /* checked out by a thread */
+
+  struct _FreetypeFaceInfo
+    *next;
+} FreetypeFaceInfo;
+
+typedef struct _FreetypeGlyphKey
+{
+  unsigned long
+    font_id;                    /* FreetypeFontInfo id */
+
+  FT_Fixed
+    x_scale,                    /* face size scale (pointsize & density) */
+    y_scale;
+
+  FT_UInt
+    glyph_id;                   /* glyph index */
+
+  FT_Int32
+    load_flags;                 /* FT_Load_Glyph() flags (hinting) */
+
+  MagickBool
+    is_bitmap;                  /* rendered bitmap rather than outline */
+
+  FT_Matrix
+    affine;                     /* bitmap transform */
+
+  FT_Pos
+    dx,                         /* bitmap sub-pixel origin (26.6) */
+    dy;
+} FreetypeGlyphKey;
+
+typedef struct _FreetypeGlyphInfo
+{
+  FreetypeGlyphKey
+    key;
+
+  FT_Glyph
+    glyph;                      /* outline or bitmap glyph */
+
+  FT_BBox
+    bounds;                     /* exact outline bounding box */
+
+  FT_Vector
+    advance;                    /* glyph advance */
+
+  size_t
+    size;                       /* estimated memory consumption */
+
+  unsigned long
+    hash;
+
+  long
+    references;
+
+  MagickBool
+    cached;                     /* linked into the cache */
+
+  struct _FreetypeGlyphInfo
+    *hash_next,
+    *previous,
+    *next;
+} FreetypeGlyphInfo;
+
+static SemaphoreInfo
+  *freetype_semaphore = (SemaphoreInfo *) NULL;
+
+static FT_Library
+  freetype_library = (FT_Library) NULL;
+
+static FreetypeFontInfo
+  *freetype_fonts = (FreetypeFontInfo *) NULL;
+
+static FreetypeFaceInfo
+  *freetype_faces = (FreetypeFaceInfo *) NULL;
+
+static unsigned long
+  freetype_font_ids = 0;
+
+static FreetypeGlyphInfo
+  *glyph_cache_buckets[FreetypeGlyphCacheBuckets],
+  *glyph_cache_head = (FreetypeGlyphInfo *) NULL,
+  *glyph_cache_tail = (FreetypeGlyphInfo *) NULL;
+
+static magick_int64_t
+  glyph_cache_size = 0,
+  glyph_cache_limit = FreetypeGlyphCacheDefaultLimit;
+#endif /* defined(HasTTF) */
 
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -397,6 +527,68 @@ MagickExport MagickPassFail AnnotateImage(Image *image,const DrawInfo *draw_info
   return(status);
 }
 
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
++   D e s t r o y A n n o t a t e I n f o                                     %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  DestroyAnnotateInfo() releases the cached FreeType library, font faces,
+%  and glyphs.
+%
+%  The format of the DestroyAnnotateInfo method is:
+%
+%      void DestroyAnnotateInfo(void)
+%
+*/
+MagickExport void DestroyAnnotateInfo(void)
+{
+#if defined(HasTTF)
+  FreetypeFaceInfo
+    *face_info;
+
+  FreetypeFontInfo
+    *font_info;
+
+  FreetypeGlyphInfo
+    *glyph_info;
+
+  while ((glyph_info=glyph_cache_head) != (FreetypeGlyphInfo *) NULL)
+    {
+      glyph_cache_head=glyph_info->next;
+      LiberateMagickResource(MemoryResource,glyph_info->size);
+      FT_Done_Glyph(glyph_info->glyph);
+      MagickFreeMemory(glyph_info);
+    }
+  glyph_cache_tail=(FreetypeGlyphInfo *) NULL;
+  glyph_cache_size=0;
+  (void) memset(glyph_cache_buckets,0,sizeof(glyph_cache_buckets));
+  while ((face_info=freetype_faces) != (FreetypeFaceInfo *) NULL)
+    {
+      freetype_faces=face_info->next;
+      (void) FT_Done_Face(face_info->face);
+      MagickFreeMemory(face_info);
+    }
+  while ((font_info=freetype_fonts) != (FreetypeFontInfo *) NULL)
+    {
+      freetype_fonts=font_info->next;
+      MagickFreeMemory(font_info->path);
+      MagickFreeMemory(font_info);
+    }
+  if (freetype_library != (FT_Library) NULL)
+    {
+      (void) FT_Done_FreeType(freetype_library);
+      freetype_library=(FT_Library) NULL;
+    }
+  DestroySemaphoreInfo(&freetype_semaphore);
+#endif /* defined(HasTTF) */
+}
+
 #if defined(HasTTF)
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -796,6 +988,47 @@ char const *FindCommaDelimitedName
 } /*FindCommaDelimitedName*/
 
 
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
++   I n i t i a l i z e A n n o t a t e I n f o                               %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  InitializeAnnotateInfo() initializes the FreeType face and glyph cache.
+%  The glyph cache memory budget (in bytes) may be set via the
+%  MAGICK_GLYPH_CACHE_LIMIT environment variable.  A budget of zero
+%  disables glyph caching.
+%
+%  The format of the InitializeAnnotateInfo method is:
+%
+%      MagickPassFail InitializeAnnotateInfo(void)
+%
+*/
+MagickPassFail InitializeAnnotateInfo(void)
+{
+#if defined(HasTTF)
+  const char
+    *envp;
+
+  assert(freetype_semaphore == (SemaphoreInfo *) NULL);
+  freetype_semaphore=AllocateSemaphoreInfo();
+  glyph_cache_limit=FreetypeGlyphCacheDefaultLimit;
+  if ((envp=getenv("MAGICK_GLYPH_CACHE_LIMIT")))
+    glyph_cache_limit=MagickSizeStrToInt64(envp,1024);
+  if (glyph_cache_limit < 0)
+    glyph_cache_limit=0;
+  (void) LogMagickEvent(AnnotateEvent,GetMagickModule(),
+                        "Glyph cache limit %" MAGICK_INT64_F "d bytes",
+                        glyph_cache_limit);
+#endif /* defined(HasTTF) */
+  return MagickPass;
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -1057,6 +1290,458 @@ static int TraceQuadraticBezier(FT_Vector *control,FT_Vector *to,
   return(0);
 }
 
+/*
+  Check out a face for the specified font file and face index, opening
+  it if no idle face is available.  The face must be returned via
+  ReleaseFreetypeFace().
+*/
+static FreetypeFaceInfo *AcquireFreetypeFace(const char *path,const long index,
+  ExceptionInfo *exception)
+{
+  FreetypeFaceInfo
+    *face_info,
+    *previous;
+
+  FreetypeFontInfo
+    *font_info;
+
+  FT_Error
+    ft_status;
+
+  LockSemaphoreInfo(freetype_semaphore);
+  if (freetype_library == (FT_Library) NULL)
+    {
+      ft_status=FT_Init_FreeType(&freetype_library);
+      if (ft_status)
+        {
+          freetype_library=(FT_Library) NULL;
+          UnlockSemaphoreInfo(freetype_semaphore);
+          ThrowException(exception,TypeError,UnableToInitializeFreetypeLibrary,
+                         path);
+          return (FreetypeFaceInfo *) NULL;
+        }
+    }
+  for (previous=(FreetypeFaceInfo *) NULL, face_info=freetype_faces;
+       face_info != (FreetypeFaceInfo *) NULL;
+       previous=face_info, face_info=face_info->next)
+    {
+      if (!face_info->in_use && (face_info->font->index == index) &&
+          (strcmp(face_info->font->path,path) == 0))
+        {
+          /* Move to head of list so idle faces remain in MRU order */
+          if (previous != (FreetypeFaceInfo *) NULL)
+            {
+              previous->next=face_info->next;
+              face_info->next=freetype_faces;
+              freetype_faces=face_info;
+            }
+          face_info->in_use=MagickTrue;
+          UnlockSemaphoreInfo(freetype_semaphore);
+          return face_info;
+        }
+    }
+  for (font_info=freetype_fonts; font_info != (FreetypeFontInfo *) NULL;
+       font_info=font_info->next)
+    if ((font_info->index == index) && (strcmp(font_info->path,path) == 0))
+      break;
+  if (font_info == (FreetypeFontInfo *) NULL)
+    {
+      font_info=MagickAllocateMemory(FreetypeFontInfo *,sizeof(FreetypeFontInfo));
+      if (font_info == (FreetypeFontInfo *) NULL)
+        {
+          UnlockSemaphoreInfo(freetype_semaphore);
+          ThrowException(exception,ResourceLimitError,MemoryAllocationFailed,
+                         path);
+          return (FreetypeFaceInfo *) NULL;
+        }
+      font_info->path=AcquireString(path);
+      font_info->index=index;
+      font_info->id=++freetype_font_ids;
+      font_info->next=freetype_fonts;
+      freetype_fonts=font_info;
+    }
+  face_info=MagickAllocateMemory(FreetypeFaceInfo *,sizeof(FreetypeFaceInfo));
+  if (face_info == (FreetypeFaceInfo *) NULL)
+    {
+      UnlockSemaphoreInfo(freetype_semaphore);
+      ThrowException(exception,ResourceLimitError,MemoryAllocationFailed,
+                     path);
+      return (FreetypeFaceInfo *) NULL;
+    }
+  face_info->font=font_info;
+  face_info->in_use=MagickTrue;
+  ft_status=FT_New_Face(freetype_library,path,index,&face_info->face);
+  if (ft_status != 0)
+    {
+      MagickFreeMemory(face_info);
+      UnlockSemaphoreInfo(freetype_semaphore);
+      ThrowException(exception,TypeError,UnableToReadFont,path);
+      return (FreetypeFaceInfo *) NULL;
+    }
+  face_info->next=freetype_faces;
+  freetype_faces=face_info;
+  UnlockSemaphoreInfo(freetype_semaphore);
+  (void) LogMagickEvent(AnnotateEvent,GetMagickModule(),
+                        "Opened face %ld of font \"%s\"",index,path);
+  return face_info;
+}
+
+/*
+  Return a face to the cache, closing least recently used idle faces
+  in excess of FreetypeMaxIdleFaces.
+*/
+static void ReleaseFreetypeFace(FreetypeFaceInfo *face_info)
+{
+  FreetypeFaceInfo
+    *previous;
+
+  unsigned int
+    idle_faces;
+
+  LockSemaphoreInfo(freetype_semaphore);
+  face_info->in_use=MagickFalse;
+  idle_faces=0;
+  previous=(FreetypeFaceInfo *) NULL;
+  face_info=freetype_faces;
+  while (face_info != (FreetypeFaceInfo *) NULL)
+    {
+      if (!face_info->in_use && (++idle_faces > FreetypeMaxIdleFaces))
+        {
+          FreetypeFaceInfo
+            *next = face_info->next;
+
+          if (previous != (FreetypeFaceInfo *) NULL)
+            previous->next=next;
+          else
+            freetype_faces=next;
+          (void) FT_Done_Face(face_info->face);
+          MagickFreeMemory(face_info);
+          face_info=next;
+          continue;
+        }
+      previous=face_info;
+      face_info=face_info->next;
+    }
+  UnlockSemaphoreInfo(freetype_semaphore);
+}
+
+static unsigned long HashFreetypeGlyphKey(const FreetypeGlyphKey *key)
+{
+  unsigned long
+    hash;
+
+  hash=key->font_id;
+  hash=hash*31+(unsigned long) key->x_scale;
+  hash=hash*31+(unsigned long) key->y_scale;
+  hash=hash*31+(unsigned long) key->glyph_id;
+  hash=hash*31+(unsigned long) key->load_flags;
+  if (key->is_bitmap)
+    {
+      hash=hash*31+(unsigned long) key->affine.xx;
+      hash=hash*31+(unsigned long) key->affine.xy;
+      hash=hash*31+(unsigned long) key->affine.yx;
+      hash=hash*31+(unsigned long) key->affine.yy;
+      hash=hash*31+(unsigned long) key->dx;
+      hash=hash*31+(unsigned long) key->dy;
+    }
+  return hash;
+}
+
+static MagickBool EqualFreetypeGlyphKeys(const FreetypeGlyphKey *a,
+  const FreetypeGlyphKey *b)
+{
+  if ((a->font_id != b->font_id) || (a->x_scale != b->x_scale) ||
+      (a->y_scale != b->y_scale) || (a->glyph_id != b->glyph_id) ||
+      (a->load_flags != b->load_flags) || (a->is_bitmap != b->is_bitmap))
+    return MagickFalse;
+  if (a->is_bitmap &&
+      ((a->affine.xx != b->affine.xx) || (a->affine.xy != b->affine.xy) ||
+       (a->affine.yx != b->affine.yx) || (a->affine.yy != b->affine.yy) ||
+       (a->dx != b->dx) || (a->dy != b->dy)))
+    return MagickFalse;
+  return MagickTrue;
+}
+
+/*
+  Remove a glyph from the cache.  Must be called with freetype_semaphore
+  held.  The glyph is destroyed once its last reference is released.
+*/
+static void UncacheFreetypeGlyph(FreetypeGlyphInfo *glyph_info)
+{
+  FreetypeGlyphInfo
+    **bucket;
+
+  bucket=&glyph_cache_buckets[glyph_info->hash % FreetypeGlyphCacheBuckets];
+  while (*bucket != glyph_info)
+    bucket=&(*bucket)->hash_next;
+  *bucket=glyph_info->hash_next;
+  if (glyph_info->previous != (FreetypeGlyphInfo *) NULL)
+    glyph_info->previous->next=glyph_info->next;
+  else
+    glyph_cache_head=glyph_info->next;
+  if (glyph_info->next != (FreetypeGlyphInfo *) NULL)
+    glyph_info->next->previous=glyph_info->previous;
+  else
+    glyph_cache_tail=glyph_info->previous;
+  glyph_info->hash_next=glyph_info->previous=glyph_info->next=
+    (FreetypeGlyphInfo *) NULL;
+  glyph_info->cached=MagickFalse;
+  glyph_cache_size-=glyph_info->size;
+  LiberateMagickResource(MemoryResource,glyph_info->size);
+}
+
+static void DestroyFreetypeGlyph(FreetypeGlyphInfo *glyph_info)
+{
+  FT_Done_Glyph(glyph_info->glyph);
+  MagickFreeMemory(glyph_info);
+}
+
+/*
+  Look up a glyph in the cache, returning a new reference to it, or
+  NULL if it is not cached.
+*/
+static FreetypeGlyphInfo *LookupFreetypeGlyph(const FreetypeGlyphKey *key,
+  const unsigned long hash)
+{
+  FreetypeGlyphInfo
+    *glyph_info;
+
+  LockSemaphoreInfo(freetype_semaphore);
+  for (glyph_info=glyph_cache_buckets[hash % FreetypeGlyphCacheBuckets];
+       glyph_info != (FreetypeGlyphInfo *) NULL;
+       glyph_info=glyph_info->hash_next)
+    if ((glyph_info->hash == hash) && EqualFreetypeGlyphKeys(&glyph_info->key,key))
+      break;
+  if (glyph_info != (FreetypeGlyphInfo *) NULL)
+    {
+      glyph_info->references++;
+      if (glyph_info != glyph_cache_head)
+        {
+          /* Move to head of LRU list */
+          glyph_info->previous->next=glyph_info->next;
+          if (glyph_info->next != (FreetypeGlyphInfo *) NULL)
+            glyph_info->next->previous=glyph_info->previous;
+          else
+            glyph_cache_tail=glyph_info->previous;
+          glyph_info->previous=(FreetypeGlyphInfo *) NULL;
+          glyph_info->next=glyph_cache_head;
+          glyph_cache_head->previous=glyph_info;
+          glyph_cache_head=glyph_info;
+        }
+    }
+  UnlockSemaphoreInfo(freetype_semaphore);
+  return glyph_info;
+}
+
+/*
+  Add a newly created glyph (holding one reference) to the cache,
+  evicting least recently used glyphs to stay within the memory budget.
+  If an equivalent glyph was cached by another thread in the meantime,
+  the new glyph is destroyed and a reference to the cached one returned.
+*/
+static FreetypeGlyphInfo *CacheFreetypeGlyph(FreetypeGlyphInfo *glyph_info)
+{
+  FreetypeGlyphInfo
+    *cached_info;
+
+  cached_info=LookupFreetypeGlyph(&glyph_info->key,glyph_info->hash);
+  if (cached_info != (FreetypeGlyphInfo *) NULL)
+    {
+      DestroyFreetypeGlyph(glyph_info);
+      return cached_info;
+    }
+  LockSemaphoreInfo(freetype_semaphore);
+  if (((magick_int64_t) glyph_info->size <= glyph_cache_limit) &&
+      (AcquireMagickResource(MemoryResource,glyph_info->size) == MagickPass))
+    {
+      FreetypeGlyphInfo
+        **bucket;
+
+      while ((glyph_cache_tail != (FreetypeGlyphInfo *) NULL) &&
+             (glyph_cache_size+(magick_int64_t) glyph_info->size > glyph_cache_limit))
+        {
+          cached_info=glyph_cache_tail;
+          UncacheFreetypeGlyph(cached_info);
+          if (cached_info->references == 0)
+            DestroyFreetypeGlyph(cached_info);
+        }
+      bucket=&glyph_cache_buckets[glyph_info->hash % FreetypeGlyphCacheBuckets];
+      glyph_info->hash_next=*bucket;
+      *bucket=glyph_info;
+      glyph_info->previous=(FreetypeGlyphInfo *) NULL;
+      glyph_info->next=glyph_cache_head;
+      if (glyph_cache_head != (FreetypeGlyphInfo *) NULL)
+        glyph_cache_head->previous=glyph_info;
+      else
+        glyph_cache_tail=glyph_info;
+      glyph_cache_head=glyph_info;
+      glyph_cache_size+=glyph_info->size;
+      glyph_info->cached=MagickTrue;
+    }
+  UnlockSemaphoreInfo(freetype_semaphore);
+  return glyph_info;
+}
+
+static void ReleaseFreetypeGlyph(FreetypeGlyphInfo *glyph_info)
+{
+  MagickBool
+    destroy;
+
+  LockSemaphoreInfo(freetype_semaphore);
+  glyph_info->references--;
+  destroy=((glyph_info->references == 0) && !glyph_info->cached);
+  UnlockSemaphoreInfo(freetype_semaphore);
+  if (destroy)
+    DestroyFreetypeGlyph(glyph_info);
+}
+
+static FreetypeGlyphInfo *AllocateFreetypeGlyph(const FreetypeGlyphKey *key,
+  const unsigned long hash,FT_Glyph glyph,const size_t size)
+{
+  FreetypeGlyphInfo
+    *glyph_info;
+
+  glyph_info=MagickAllocateMemory(FreetypeGlyphInfo *,sizeof(FreetypeGlyphInfo));
+  if (glyph_info == (FreetypeGlyphInfo *) NULL)
+    {
+      FT_Done_Glyph(glyph);
+      return (FreetypeGlyphInfo *) NULL;
+    }
+  (void) memset(glyph_info,0,sizeof(FreetypeGlyphInfo));
+  glyph_info->key=*key;
+  glyph_info->hash=hash;
+  glyph_info->glyph=glyph;
+  glyph_info->size=sizeof(FreetypeGlyphInfo)+size;
+  glyph_info->references=1;
+  return glyph_info;
+}
+
+/*
+  Return a reference to the (untransformed) glyph for the specified
+  glyph index at the face's current size, loading it if necessary.
+*/
+static FreetypeGlyphInfo *AcquireFreetypeOutline(FreetypeFaceInfo *face_info,
+  const FT_UInt glyph_id,const FT_Int32 load_flags)
+{
+  FreetypeGlyphInfo
+    *glyph_info;
+
+  FreetypeGlyphKey
+    key;
+
+  FT_Face
+    face = face_info->face;
+
+  FT_Glyph
+    glyph;
+
+  size_t
+    size;
+
+  unsigned long
+    hash;
+
+  (void) memset(&key,0,sizeof(key));
+  key.font_id=face_info->font->id;
+  key.x_scale=face->size->metrics.x_scale;
+  key.y_scale=face->size->metrics.y_scale;
+  key.glyph_id=glyph_id;
+  key.load_flags=load_flags;
+  key.is_bitmap=MagickFalse;
+  hash=HashFreetypeGlyphKey(&key);
+  if ((glyph_info=LookupFreetypeGlyph(&key,hash)) != (FreetypeGlyphInfo *) NULL)
+    return glyph_info;
+
+  if (FT_Load_Glyph(face,glyph_id,load_flags) != 0)
+    return (FreetypeGlyphInfo *) NULL;
+  if (FT_Get_Glyph(face->glyph,&glyph) != 0)
+    return (FreetypeGlyphInfo *) NULL;
+  size=sizeof(FT_OutlineGlyphRec);
+  if (glyph->format == FT_GLYPH_FORMAT_OUTLINE)
+    {
+      FT_Outline
+        *outline = &((FT_OutlineGlyph) glyph)->outline;
+
+      size+=(size_t) outline->n_points*(sizeof(FT_Vector)+sizeof(char))+
+        (size_t) outline->n_contours*sizeof(short);
+    }
+  glyph_info=AllocateFreetypeGlyph(&key,hash,glyph,size);
+  if (glyph_info == (FreetypeGlyphInfo *) NULL)
+    return (FreetypeGlyphInfo *) NULL;
+  glyph_info->advance=face->glyph->advance;
+  if (glyph->format == FT_GLYPH_FORMAT_OUTLINE)
+    /*
+      Compute exact bounding box for scaled outline. If necessary, the
+      outline Bezier arcs are walked over to extract their extrema.
+    */
+    (void) FT_Outline_Get_BBox(&((FT_OutlineGlyph) glyph)->outline,
+                               &glyph_info->bounds);
+  else
+    FT_Glyph_Get_CBox(glyph,FT_GLYPH_BBOX_SUBPIXELS,&glyph_info->bounds);
+  return CacheFreetypeGlyph(glyph_info);
+}
+
+/*
+  Return a reference to the anti-aliased bitmap of an outline glyph
+  transformed by 'affine' and translated to 'origin' (26.6).  Bitmaps
+  are cached by sub-pixel position only; the whole pixel part of the
+  origin is returned via 'offset' and must be added to the bitmap's
+  left and top coordinates.
+*/
+static FreetypeGlyphInfo *AcquireFreetypeBitmap(FreetypeGlyphInfo *outline_info,
+  const FT_Matrix *affine,const FT_Vector *origin,FT_Vector *offset)
+{
+  FreetypeGlyphInfo
+    *glyph_info;
+
+  FreetypeGlyphKey
+    key;
+
+  FT_BitmapGlyph
+    bitmap;
+
+  FT_Glyph
+    glyph;
+
+  FT_Vector
+    delta;
+
+  unsigned long
+    hash;
+
+  delta.x=origin->x & 63;
+  delta.y=origin->y & 63;
+  offset->x=(origin->x-delta.x)/64;
+  offset->y=(origin->y-delta.y)/64;
+  key=outline_info->key;
+  key.is_bitmap=MagickTrue;
+  key.affine=*affine;
+  key.dx=delta.x;
+  key.dy=delta.y;
+  hash=HashFreetypeGlyphKey(&key);
+  if ((glyph_info=LookupFreetypeGlyph(&key,hash)) != (FreetypeGlyphInfo *) NULL)
+    return glyph_info;
+
+  if (FT_Glyph_Copy(outline_info->glyph,&glyph) != 0)
+    return (FreetypeGlyphInfo *) NULL;
+  (void) FT_Glyph_Transform(glyph,(FT_Matrix *) affine,&delta);
+  if (FT_Glyph_To_Bitmap(&glyph,ft_render_mode_normal,(FT_Vector *) NULL,
+                         True) != 0)
+    {
+      FT_Done_Glyph(glyph);
+      return (FreetypeGlyphInfo *) NULL;
+    }
+  bitmap=(FT_BitmapGlyph) glyph;
+  glyph_info=AllocateFreetypeGlyph(&key,hash,glyph,sizeof(FT_BitmapGlyphRec)+
+                                   (size_t) bitmap->bitmap.rows*
+                                   (size_t) AbsoluteValue(bitmap->bitmap.pitch));
+  if (glyph_info == (FreetypeGlyphInfo *) NULL)
+    return (FreetypeGlyphInfo *) NULL;
+  glyph_info->advance=outline_info->advance;
+  glyph_info->bounds=outline_info->bounds;
+  return CacheFreetypeGlyph(glyph_info);
+}
+
 static MagickPassFail RenderFreetype(Image *image,const DrawInfo *draw_info,
   const char *encoding,const PointInfo *offset,TypeMetric *metrics)
 {
@@ -1067,9 +1752,6 @@ static MagickPassFail RenderFreetype(Image *image,const DrawInfo *draw_info,
 
     FT_Vector
       origin;
-
-    FT_Glyph
-      image;
   } GlyphInfo;
 
   double
@@ -1078,9 +1760,6 @@ static MagickPassFail RenderFreetype(Image *image,const DrawInfo *draw_info,
   DrawInfo
     *clone_info;
 
-  FT_BBox
-    bounds;
-
   FT_BitmapGlyph
     bitmap;
 
@@ -1093,13 +1772,18 @@ static MagickPassFail RenderFreetype(Image *image,const DrawInfo *draw_info,
   FT_Face
     face;
 
-  FT_Library
-    library;
+  FreetypeFaceInfo
+    *face_info;
+
+  FreetypeGlyphInfo
+    *bitmap_info,
+    *outline_info;
 
   FT_Matrix
     affine;
 
   FT_Vector
+    bitmap_offset,
     origin;
 
   GlyphInfo
@@ -1154,25 +1838,14 @@ static MagickPassFail RenderFreetype(Image *image,const DrawInfo *draw_info,
   if (draw_info->font == (char *) NULL)
     ThrowBinaryException(TypeError,FontNotSpecified,image->filename);
 
-  glyph.image=(FT_Glyph) 0;
-  last_glyph.image=(FT_Glyph) 0;
-
   /*
-    Initialize Truetype library.
+    Obtain a cached Truetype face.
   */
-  ft_status=FT_Init_FreeType(&library);
-  if (ft_status)
-    ThrowBinaryException(TypeError,UnableToInitializeFreetypeLibrary,
-                         draw_info->font);
-  if (*draw_info->font != '@')
-    ft_status=FT_New_Face(library,draw_info->font,0,&face);
-  else
-    ft_status=FT_New_Face(library,draw_info->font+1,0,&face);
-  if (ft_status != 0)
-    {
-      (void) FT_Done_FreeType(library);
-      ThrowBinaryException(TypeError,UnableToReadFont,draw_info->font)
-    }
+  face_info=AcquireFreetypeFace(*draw_info->font != '@' ? draw_info->font :
+                                draw_info->font+1,0,&image->exception);
+  if (face_info == (FreetypeFaceInfo *) NULL)
+    return MagickFail;
+  face=face_info->face;
   /*
     Select a charmap
   */
@@ -1223,7 +1896,10 @@ static MagickPassFail RenderFreetype(Image *image,const DrawInfo *draw_info,
         encoding_type=ft_encoding_wansung;
       ft_status=FT_Select_Charmap(face,encoding_type);
       if (ft_status != 0)
-        ThrowBinaryException(TypeError,UnrecognizedFontEncoding,encoding);
+        {
+          ReleaseFreetypeFace(face_info);
+          ThrowBinaryException(TypeError,UnrecognizedFontEncoding,encoding);
+        }
     }
   /*
     Set text size.
@@ -1259,8 +1935,7 @@ static MagickPassFail RenderFreetype(Image *image,const DrawInfo *draw_info,
   */
   if ((draw_info->text == NULL) || (draw_info->text[0] == '\0'))
     {
-      (void) FT_Done_Face(face);
-      (void) FT_Done_FreeType(library);
+      ReleaseFreetypeFace(face_info);
       return status;
     }
 
@@ -1302,8 +1977,7 @@ static MagickPassFail RenderFreetype(Image *image,const DrawInfo *draw_info,
   }
   if (text == (magick_code_point_t *) NULL)
     {
-      (void) FT_Done_Face(face);
-      (void) FT_Done_FreeType(library);
+      ReleaseFreetypeFace(face_info);
       (void) LogMagickEvent(AnnotateEvent,GetMagickModule(),
                             "Text encoding failed: encoding_type=%ld "
                             "draw_info->encoding=\"%s\" draw_info->text=\"%s\" length=%ld",
@@ -1348,49 +2022,35 @@ static MagickPassFail RenderFreetype(Image *image,const DrawInfo *draw_info,
         origin.x+=kerning.x;
       }
     glyph.origin=origin;
-    glyph.image=0;
-    ft_status=FT_Load_Glyph(face,glyph.id,FT_LOAD_DEFAULT);
-    if (ft_status != False) /* 0 means success */
-      continue;
-    ft_status=FT_Get_Glyph(face->glyph,&glyph.image);
-    if (ft_status != False) /* 0 means success */
-      continue;
-#if 0
-    /*
-      Obtain glyph's control box. Usually faster than computing the
-      exact bounding box but may be slightly larger in some
-      situations.
-    */
-    (void) FT_Glyph_Get_CBox(glyph.image,FT_GLYPH_BBOX_SUBPIXELS,&bounds);
-#else
     /*
-      Compute exact bounding box for scaled outline. If necessary, the
-      outline Bezier arcs are walked over to extract their extrema.
+      Obtain the (possibly cached) glyph outline and its exact
+      bounding box.
     */
-    (void) FT_Outline_Get_BBox(&((FT_OutlineGlyph) glyph.image)->outline,&bounds);
-#endif
-    if ((i == 0) || (bounds.xMin < metrics->bounds.x1))
-      metrics->bounds.x1=bounds.xMin;
-    if ((i == 0) || (bounds.yMin < metrics->bounds.y1))
-      metrics->bounds.y1=bounds.yMin;
-    if ((i == 0) || (bounds.xMax > metrics->bounds.x2))
-      metrics->bounds.x2=bounds.xMax;
-    if ((i == 0) || (bounds.yMax > metrics->bounds.y2))
-      metrics->bounds.y2=bounds.yMax;
+    outline_info=AcquireFreetypeOutline(face_info,glyph.id,FT_LOAD_DEFAULT);
+    if (outline_info == (FreetypeGlyphInfo *) NULL)
+      continue;
+    if ((i == 0) || (outline_info->bounds.xMin < metrics->bounds.x1))
+      metrics->bounds.x1=outline_info->bounds.xMin;
+    if ((i == 0) || (outline_info->bounds.yMin < metrics->bounds.y1))
+      metrics->bounds.y1=outline_info->bounds.yMin;
+    if ((i == 0) || (outline_info->bounds.xMax > metrics->bounds.x2))
+      metrics->bounds.x2=outline_info->bounds.xMax;
+    if ((i == 0) || (outline_info->bounds.yMax > metrics->bounds.y2))
+      metrics->bounds.y2=outline_info->bounds.yMax;
     if (draw_info->render)
-      if ((draw_info->stroke.opacity != TransparentOpacity) ||
-          (draw_info->stroke_pattern != (Image *) NULL))
+      if (((draw_info->stroke.opacity != TransparentOpacity) ||
+           (draw_info->stroke_pattern != (Image *) NULL)) &&
+          (outline_info->glyph->format == FT_GLYPH_FORMAT_OUTLINE))
         {
           /*
             Trace the glyph.
           */
           clone_info->affine.tx=glyph.origin.x/64.0;
           clone_info->affine.ty=glyph.origin.y/64.0;
-          (void) FT_Outline_Decompose(&((FT_OutlineGlyph) glyph.image)->outline,
+          (void) FT_Outline_Decompose(&((FT_OutlineGlyph) outline_info->glyph)->outline,
             &OutlineMethods,clone_info);
         }
     FT_Vector_Transform(&glyph.origin,&affine);
-    (void) FT_Glyph_Transform(glyph.image,&affine,&glyph.origin);
     if (draw_info->render)
       {
         status &= ModifyCache(image,&image->exception);
@@ -1398,13 +2058,16 @@ static MagickPassFail RenderFreetype(Image *image,const DrawInfo *draw_info,
             (pattern != (Image *) NULL))
           {
             /*
-              Rasterize the glyph.
+              Rasterize the glyph (or obtain it from the cache).
             */
-            ft_status=FT_Glyph_To_Bitmap(&glyph.image,ft_render_mode_normal,
-              (FT_Vector *) NULL,True);
-            if (ft_status != False)
-              continue;
-            bitmap=(FT_BitmapGlyph) glyph.image;
+            bitmap_info=AcquireFreetypeBitmap(outline_info,&affine,
+                                              &glyph.origin,&bitmap_offset);
+            if (bitmap_info == (FreetypeGlyphInfo *) NULL)
+              {
+                ReleaseFreetypeGlyph(outline_info);
+                continue;
+              }
+            bitmap=(FT_BitmapGlyph) bitmap_info->glyph;
             image->storage_class=DirectClass;
             if (bitmap->bitmap.pixel_mode == ft_pixel_mode_mono)
               {
@@ -1412,9 +2075,9 @@ static MagickPassFail RenderFreetype(Image *image,const DrawInfo *draw_info,
               }
             else
               {
-                point.x=offset->x+bitmap->left;
+                point.x=offset->x+bitmap->left+bitmap_offset.x;
               }
-            point.y=offset->y-bitmap->top;
+            point.y=offset->y-(bitmap->top+bitmap_offset.y);
             p=bitmap->bitmap.buffer;
             /* FIXME: OpenMP */
             for (y=0; y < (long) bitmap->bitmap.rows; y++)
@@ -1513,16 +2176,13 @@ static MagickPassFail RenderFreetype(Image *image,const DrawInfo *draw_info,
               if (status == MagickFail)
                 break;
             }
+            ReleaseFreetypeGlyph(bitmap_info);
           }
       }
-    origin.x+=face->glyph->advance.x;
+    origin.x+=outline_info->advance.x;
     if (origin.x > metrics->width)
       metrics->width=origin.x;
-    if (last_glyph.image != 0)
-      {
-        FT_Done_Glyph(last_glyph.image);
-        last_glyph.image=0;
-      }
+    ReleaseFreetypeGlyph(outline_info);
     last_glyph=glyph;
   }
   metrics->width/=64.0;
@@ -1542,18 +2202,12 @@ static MagickPassFail RenderFreetype(Image *image,const DrawInfo *draw_info,
         (void) ConcatenateString(&clone_info->primitive,"'");
         (void) DrawImage(image,clone_info);
       }
-  if (glyph.image != 0)
-    {
-      FT_Done_Glyph(glyph.image);
-      glyph.image=0;
-    }
   /*
     Free resources.
   */
   MagickFreeMemory(text);
   DestroyDrawInfo(clone_info);
-  (void) FT_Done_Face(face);
-  (void) FT_Done_FreeType(library);
+  ReleaseFreetypeFace(face_info);
   return(status);
 }
 #else
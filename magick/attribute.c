@@ -50,6 +50,431 @@
   Forward declarations.
 */
 static void DestroyImageAttribute(ImageAttribute *attribute);
+
+/*
+  The public attribute list defines the iteration order of the image
+  attributes.  It is indexed by an open addressed (linear probing) hash
+  table keyed on the case-folded attribute key so that lookups do not
+  need to walk the list.  The list and its index are shared between
+  CloneImage() copies of an image by reference counting, and are copied
+  by the first modification made through a shared reference.
+*/
+#define ImageAttributeMapMinimumSlots 16
+
+typedef struct _ImageAttributeSlot
+{
+  ImageAttribute
+    *attribute;         /* Attribute, or NULL if slot is empty */
+
+  size_t
+    hash;               /* Hash of the attribute key */
+} ImageAttributeSlot;
+
+typedef struct _ImageAttributeMap
+{
+  ImageAttributeSlot
+    *slots;             /* Hash table (power of two entries) */
+
+  size_t
+    allocated,          /* Number of slots allocated */
+    count,              /* Number of slots in use */
+    duplicates;         /* Listed attributes shadowed by an equal key */
+
+  ImageAttribute
+    *tail;              /* Last attribute in the list */
+
+  unsigned long
+    references;         /* Number of images sharing the list */
+} ImageAttributeMap;
+
+/*
+  Hash a key consistently with LocaleCompare().  ASCII letters are folded
+  to lower case while all other non-ASCII characters hash the same, which
+  is a coarser equivalence than the one used by LocaleCompare().
+*/
+static size_t
+HashAttributeKey(const char *key)
+{
+  register const unsigned char
+    *p;
+
+  register size_t
+    hash;
+
+  unsigned int
+    c;
+
+  hash=2166136261U;
+  for (p=(const unsigned char *) key; *p != '\0'; p++)
+    {
+      c=*p;
+      if ((c >= 'A') && (c <= 'Z'))
+        c+='a'-'A';
+      else if (c >= 0x80)
+        c=0x80;
+      hash=(hash ^ c)*16777619U;
+    }
+  return hash;
+}
+
+static inline ImageAttributeMap *
+GetImageAttributeMap(const Image *image)
+{
+  if (image->extra == (ImageExtra *) NULL)
+    return (ImageAttributeMap *) NULL;
+  return image->extra->attribute_map;
+}
+
+static inline void
+ReferenceAttributeMap(ImageAttributeMap *map)
+{
+#if defined(__ATOMIC_ACQ_REL)
+  (void) __atomic_add_fetch(&map->references,1,__ATOMIC_RELAXED);
+#else
+#  if defined(HAVE_OPENMP)
+#    pragma omp critical (GM_ImageAttributeMap)
+#  endif
+  map->references++;
+#endif
+}
+
+static inline unsigned long
+DereferenceAttributeMap(ImageAttributeMap *map)
+{
+  unsigned long
+    references;
+
+#if defined(__ATOMIC_ACQ_REL)
+  references=__atomic_sub_fetch(&map->references,1,__ATOMIC_ACQ_REL);
+#else
+#  if defined(HAVE_OPENMP)
+#    pragma omp critical (GM_ImageAttributeMap)
+#  endif
+  references=--map->references;
+#endif
+  return references;
+}
+
+static inline MagickBool
+IsAttributeMapShared(ImageAttributeMap *map)
+{
+#if defined(__ATOMIC_ACQ_REL)
+  return (__atomic_load_n(&map->references,__ATOMIC_ACQUIRE) > 1);
+#else
+  return (map->references > 1);
+#endif
+}
+
+static ImageAttributeMap *
+AllocateAttributeMap(void)
+{
+  ImageAttributeMap
+    *map;
+
+  map=MagickAllocateClearedMemory(ImageAttributeMap *,
+                                  sizeof(ImageAttributeMap));
+  if (map == (ImageAttributeMap *) NULL)
+    return (ImageAttributeMap *) NULL;
+  map->allocated=ImageAttributeMapMinimumSlots;
+  map->slots=MagickAllocateClearedMemory(ImageAttributeSlot *,
+                                         map->allocated*
+                                         sizeof(ImageAttributeSlot));
+  if (map->slots == (ImageAttributeSlot *) NULL)
+    {
+      MagickFreeMemory(map);
+      return (ImageAttributeMap *) NULL;
+    }
+  map->references=1;
+  return map;
+}
+
+static void
+DestroyAttributeMap(ImageAttributeMap *map,ImageAttribute *attributes)
+{
+  ImageAttribute
+    *attribute;
+
+  while (attributes != (ImageAttribute *) NULL)
+    {
+      attribute=attributes;
+      attributes=attributes->next;
+      DestroyImageAttribute(attribute);
+    }
+  if (map != (ImageAttributeMap *) NULL)
+    {
+      MagickFreeMemory(map->slots);
+      MagickFreeMemory(map);
+    }
+}
+
+/*
+  Return the slot holding the attribute matching key, or the empty slot
+  where it would be inserted.
+*/
+static size_t
+FindAttributeSlot(const ImageAttributeMap *map,const char *key,
+                  const size_t hash)
+{
+  register size_t
+    i;
+
+  for (i=hash & (map->allocated-1); ; i=(i+1) & (map->allocated-1))
+    {
+      if (map->slots[i].attribute == (ImageAttribute *) NULL)
+        break;
+      if ((map->slots[i].hash == hash) &&
+          (LocaleCompare(key,map->slots[i].attribute->key) == 0))
+        break;
+    }
+  return i;
+}
+
+static MagickPassFail
+GrowAttributeMap(ImageAttributeMap *map)
+{
+  ImageAttributeSlot
+    *slots;
+
+  size_t
+    allocated,
+    i,
+    j;
+
+  allocated=map->allocated*2;
+  slots=MagickAllocateClearedMemory(ImageAttributeSlot *,
+                                    MagickArraySize(allocated,
+                                                    sizeof(ImageAttributeSlot)));
+  if (slots == (ImageAttributeSlot *) NULL)
+    return MagickFail;
+  for (i=0; i < map->allocated; i++)
+    {
+      if (map->slots[i].attribute == (ImageAttribute *) NULL)
+        continue;
+      for (j=map->slots[i].hash & (allocated-1);
+           slots[j].attribute != (ImageAttribute *) NULL;
+           j=(j+1) & (allocated-1));
+      slots[j]=map->slots[i];
+    }
+  MagickFreeMemory(map->slots);
+  map->slots=slots;
+  map->allocated=allocated;
+  return MagickPass;
+}
+
+/*
+  Index an attribute which has already been linked into the list.  If an
+  attribute with an equal key is already indexed, it continues to shadow
+  the new one.
+*/
+static MagickPassFail
+IndexImageAttribute(ImageAttributeMap *map,ImageAttribute *attribute)
+{
+  size_t
+    hash,
+    i;
+
+  if (((map->count+1)*4 > map->allocated*3) &&
+      (GrowAttributeMap(map) == MagickFail))
+    return MagickFail;
+  hash=HashAttributeKey(attribute->key);
+  i=FindAttributeSlot(map,attribute->key,hash);
+  if (map->slots[i].attribute != (ImageAttribute *) NULL)
+    {
+      map->duplicates++;
+      return MagickPass;
+    }
+  map->slots[i].attribute=attribute;
+  map->slots[i].hash=hash;
+  map->count++;
+  return MagickPass;
+}
+
+/*
+  Remove an attribute which has already been unlinked from the list
+  (headed by attributes) from the index.
+*/
+static void
+UnindexImageAttribute(ImageAttributeMap *map,ImageAttribute *attributes,
+                      const ImageAttribute *attribute)
+{
+  register ImageAttribute
+    *p;
+
+  size_t
+    hash,
+    i,
+    j,
+    k;
+
+  hash=HashAttributeKey(attribute->key);
+  i=FindAttributeSlot(map,attribute->key,hash);
+  if (map->slots[i].attribute != attribute)
+    {
+      /* A shadowed duplicate */
+      map->duplicates--;
+      return;
+    }
+  /*
+    Backward shift deletion keeps the probe sequences intact.
+  */
+  map->slots[i].attribute=(ImageAttribute *) NULL;
+  map->count--;
+  for (j=(i+1) & (map->allocated-1);
+       map->slots[j].attribute != (ImageAttribute *) NULL;
+       j=(j+1) & (map->allocated-1))
+    {
+      k=map->slots[j].hash & (map->allocated-1);
+      if (((j > i) && ((k <= i) || (k > j))) ||
+          ((j < i) && ((k <= i) && (k > j))))
+        {
+          map->slots[i]=map->slots[j];
+          map->slots[j].attribute=(ImageAttribute *) NULL;
+          i=j;
+        }
+    }
+  if (map->duplicates != 0)
+    {
+      /*
+        Expose the next attribute with an equal key (if any).
+      */
+      for (p=attributes; p != (ImageAttribute *) NULL; p=p->next)
+        if (LocaleCompare(attribute->key,p->key) == 0)
+          {
+            map->duplicates--;
+            (void) IndexImageAttribute(map,p);
+            break;
+          }
+    }
+}
+
+/*
+  Append an attribute to the end of the image attribute list.  The image
+  attributes must not be shared.
+*/
+static MagickPassFail
+AppendImageAttribute(Image *image,ImageAttribute *attribute)
+{
+  ImageAttributeMap
+    *map;
+
+  map=GetImageAttributeMap(image);
+  if (map == (ImageAttributeMap *) NULL)
+    {
+      if ((image->extra == (ImageExtra *) NULL) ||
+          (image->attributes != (ImageAttribute *) NULL))
+        return MagickFail;
+      map=AllocateAttributeMap();
+      if (map == (ImageAttributeMap *) NULL)
+        return MagickFail;
+      image->extra->attribute_map=map;
+    }
+  if (IndexImageAttribute(map,attribute) == MagickFail)
+    return MagickFail;
+  attribute->previous=map->tail;
+  attribute->next=(ImageAttribute *) NULL;
+  if (map->tail == (ImageAttribute *) NULL)
+    image->attributes=attribute;
+  else
+    map->tail->next=attribute;
+  map->tail=attribute;
+  return MagickPass;
+}
+
+/*
+  Return a copy of an attribute.
+*/
+static ImageAttribute *
+CopyImageAttribute(const ImageAttribute *attribute)
+{
+  ImageAttribute
+    *copy;
+
+  copy=MagickAllocateMemory(ImageAttribute *,sizeof(ImageAttribute));
+  if (copy == (ImageAttribute *) NULL)
+    return (ImageAttribute *) NULL;
+  copy->key=AcquireString(attribute->key);
+  copy->length=attribute->length;
+  copy->value=MagickAllocateMemory(char *,copy->length+1);
+  copy->previous=(ImageAttribute *) NULL;
+  copy->next=(ImageAttribute *) NULL;
+  if ((copy->value == (char *) NULL) ||
+      (copy->key == (char *) NULL))
+    {
+      DestroyImageAttribute(copy);
+      return (ImageAttribute *) NULL;
+    }
+  (void) memcpy(copy->value,attribute->value,copy->length+1);
+  return copy;
+}
+
+/*
+  Make sure that the image owns its attribute list (copying a shared
+  list), so that it may be modified.
+*/
+static MagickPassFail
+MakeImageAttributesWritable(Image *image)
+{
+  ImageAttributeMap
+    *map;
+
+  ImageAttribute
+    *attribute,
+    *attributes;
+
+  register const ImageAttribute
+    *p;
+
+  map=GetImageAttributeMap(image);
+  if ((map == (ImageAttributeMap *) NULL) || !IsAttributeMapShared(map))
+    return MagickPass;
+  attributes=image->attributes;
+  image->attributes=(ImageAttribute *) NULL;
+  image->extra->attribute_map=(ImageAttributeMap *) NULL;
+  for (p=attributes; p != (const ImageAttribute *) NULL; p=p->next)
+    {
+      attribute=CopyImageAttribute(p);
+      if (attribute == (ImageAttribute *) NULL)
+        break;
+      if (AppendImageAttribute(image,attribute) == MagickFail)
+        {
+          DestroyImageAttribute(attribute);
+          break;
+        }
+    }
+  if (p != (const ImageAttribute *) NULL)
+    {
+      /* Restore the shared list */
+      DestroyAttributeMap(image->extra->attribute_map,image->attributes);
+      image->extra->attribute_map=map;
+      image->attributes=attributes;
+      return MagickFail;
+    }
+  if (DereferenceAttributeMap(map) == 0)
+    DestroyAttributeMap(map,attributes);
+  return MagickPass;
+}
+
+/*
+  Return the attribute matching key, or NULL.
+*/
+static ImageAttribute *
+FindImageAttribute(const Image *image,const char *key)
+{
+  const ImageAttributeMap
+    *map;
+
+  register ImageAttribute
+    *p;
+
+  map=GetImageAttributeMap(image);
+  if (map != (const ImageAttributeMap *) NULL)
+    return map->slots[FindAttributeSlot(map,key,HashAttributeKey(key))].
+      attribute;
+  for (p=image->attributes; p != (ImageAttribute *) NULL; p=p->next)
+    if (LocaleCompare(key,p->key) == 0)
+      break;
+  return p;
+}
 
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -84,79 +509,53 @@ MagickExport MagickPassFail
 CloneImageAttributes(Image* clone_image,
                      const Image* original_image)
 {
-  MagickPassFail
-    status;
+  ImageAttributeMap
+    *map;
 
   ImageAttribute
-    *cloned_attribute,
-    *cloned_attributes;
+    *cloned_attribute;
 
   const ImageAttribute
     *attribute;
 
-  status = MagickPass;
-
-  /*
-    Search for tail of list (if any)
-  */
-  if ((cloned_attributes=clone_image->attributes))
+  map=GetImageAttributeMap(original_image);
+  if ((clone_image->attributes == (ImageAttribute *) NULL) &&
+      (map != (ImageAttributeMap *) NULL) &&
+      (clone_image->extra != (ImageExtra *) NULL) &&
+      (clone_image->extra->attribute_map == (ImageAttributeMap *) NULL))
     {
-      for( ;
-          cloned_attributes->next != (ImageAttribute *) NULL;
-          cloned_attributes=cloned_attributes->next);
+      /*
+        Share the attributes until either image modifies them.
+      */
+      ReferenceAttributeMap(map);
+      clone_image->extra->attribute_map=map;
+      clone_image->attributes=original_image->attributes;
+      return MagickPass;
     }
 
+  if (MakeImageAttributesWritable(clone_image) == MagickFail)
+    return MagickFail;
+
   attribute=GetImageAttribute(original_image,(char *) NULL);
   for ( ; attribute != (const ImageAttribute *) NULL;
         attribute=attribute->next)
     {
       /*
-        Construct AttributeInfo to append.
+        Append a copy to the destination list.
       */
-      cloned_attribute=MagickAllocateMemory(ImageAttribute *,
-                                            sizeof(ImageAttribute));
+      cloned_attribute=CopyImageAttribute(attribute);
       if (cloned_attribute == (ImageAttribute *) NULL)
-        {
-          status = MagickFail;
-          break;
-        }
-      cloned_attribute->key=AcquireString(attribute->key);
-      cloned_attribute->length=attribute->length;
-      cloned_attribute->value=
-        MagickAllocateMemory(char *,cloned_attribute->length+1);
-      cloned_attribute->previous=(ImageAttribute *) NULL;
-      cloned_attribute->next=(ImageAttribute *) NULL;
-      if ((cloned_attribute->value == (char *) NULL) ||
-          (cloned_attribute->key == (char *) NULL))
+        return MagickFail;
+      if (AppendImageAttribute(clone_image,cloned_attribute) == MagickFail)
         {
           DestroyImageAttribute(cloned_attribute);
-          status = MagickFail;
-          break;
-        }
-      strcpy(cloned_attribute->value,attribute->value);
-
-      if (cloned_attributes == (ImageAttribute *) NULL)
-        {
-          /*
-            Start list
-          */
-          cloned_attributes=cloned_attribute;
-          clone_image->attributes=cloned_attributes;
-        }
-      else
-        {
-          /*
-            Append to list
-          */
-          cloned_attributes->next=cloned_attribute;
-          cloned_attribute->previous=cloned_attributes;
-          cloned_attributes=cloned_attribute;
+          return MagickFail;
         }
     }
 
-  return status;
+  return MagickPass;
 }
-
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -193,23 +592,25 @@ DestroyImageAttribute(ImageAttribute *attribute)
 }
 MagickExport void DestroyImageAttributes(Image *image)
 {
-  ImageAttribute
-    *attribute;
-
-  register ImageAttribute
-    *p;
+  ImageAttributeMap
+    *map;
 
   assert(image != (Image *) NULL);
   assert(image->signature == MagickSignature);
-  for (p=image->attributes; p != (ImageAttribute *) NULL; )
+  map=GetImageAttributeMap(image);
+  if (map != (ImageAttributeMap *) NULL)
     {
-      attribute=p;
-      p=p->next;
-      DestroyImageAttribute(attribute);
+      image->extra->attribute_map=(ImageAttributeMap *) NULL;
+      if (DereferenceAttributeMap(map) == 0)
+        DestroyAttributeMap(map,image->attributes);
+    }
+  else
+    {
+      DestroyAttributeMap((ImageAttributeMap *) NULL,image->attributes);
     }
   image->attributes=(ImageAttribute *) NULL;
 }
-
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -2442,9 +2843,9 @@ GetImageAttribute(const Image *image,const char *key)
 
   key_length=strlen(key);
 
-  for (p=image->attributes; p != (ImageAttribute *) NULL; p=p->next)
-    if (LocaleCompare(key,p->key) == 0)
-      return(p);
+  p=FindImageAttribute(image,key);
+  if (p != (ImageAttribute *) NULL)
+    return(p);
 
   if (LocaleNCompare("IPTC:",key,5) == 0)
     {
@@ -3172,6 +3573,9 @@ SetEXIFOrientation(Image *image, const int orientation)
 MagickExport MagickPassFail
 SetImageAttribute(Image *image,const char *key,const char *value)
 {
+  ImageAttributeMap
+    *map;
+
   ImageAttribute
     *attribute;
 
@@ -3194,25 +3598,30 @@ SetImageAttribute(Image *image,const char *key,const char *value)
       /*
         Delete attribute from the image attributes list.
       */
-      for (p=image->attributes; p != (ImageAttribute *) NULL; p=p->next)
-        if (LocaleCompare(key,p->key) == 0)
-          break;
-      if (p == (ImageAttribute *) NULL)
+      if (FindImageAttribute(image,key) == (ImageAttribute *) NULL)
         return(False);
+      if (MakeImageAttributesWritable(image) == MagickFail)
+        return(MagickFail);
+      map=GetImageAttributeMap(image);
+      p=FindImageAttribute(image,key);
       if (p->previous != (ImageAttribute *) NULL)
         p->previous->next=p->next;
       else
-        {
-          image->attributes=p->next;
-          if (p->next != (ImageAttribute *) NULL)
-            p->next->previous=(ImageAttribute *) NULL;
-        }
+        image->attributes=p->next;
       if (p->next != (ImageAttribute *) NULL)
         p->next->previous=p->previous;
+      if (map != (ImageAttributeMap *) NULL)
+        {
+          if (map->tail == p)
+            map->tail=p->previous;
+          UnindexImageAttribute(map,image->attributes,p);
+        }
       attribute=p;
       DestroyImageAttribute(attribute);
       return(MagickPass);
     }
+  if (MakeImageAttributesWritable(image) == MagickFail)
+    return(MagickFail);
   attribute=MagickAllocateMemory(ImageAttribute *,sizeof(ImageAttribute));
   if (attribute == (ImageAttribute *) NULL)
     return(MagickFail);
@@ -3256,67 +3665,73 @@ SetImageAttribute(Image *image,const char *key,const char *value)
 
   attribute->previous=(ImageAttribute *) NULL;
   attribute->next=(ImageAttribute *) NULL;
-  if (image->attributes == (ImageAttribute *) NULL)
-    {
-      image->attributes=attribute;
-      return(MagickPass);
-    }
-  for (p=image->attributes; p != (ImageAttribute *) NULL; p=p->next)
+  p=FindImageAttribute(image,attribute->key);
+  if (p != (ImageAttribute *) NULL)
     {
-      if (LocaleCompare(attribute->key,p->key) == 0)
-        {
-          size_t
-            min_l,
-            realloc_l;
+      size_t
+        min_l,
+        realloc_l;
 
-          if (LocaleCompare(attribute->key,"EXIF:Orientation") == 0)
-            {
-              /*
-                Special handling for EXIF orientation tag.
-                If new value differs from existing value,
-                EXIF profile is updated as well if it exists and
-                is valid. Don't append new value to existing value,
-                replace it instead.
-              */
-              orientation = MagickAtoI(value);
-              if (orientation > 0 || orientation <= (int)LeftBottomOrientation)
-                SetEXIFOrientation(image, orientation);
-
-              /* Replace current attribute with new one */
-              attribute->next = p->next;
-              if (p->previous == (ImageAttribute *) NULL)
-                image->attributes=attribute;
-              else
-                p->previous->next = attribute;
-              DestroyImageAttribute(p);
-              return(MagickPass);
-            }
+      if (LocaleCompare(attribute->key,"EXIF:Orientation") == 0)
+        {
+          /*
+            Special handling for EXIF orientation tag.
+            If new value differs from existing value,
+            EXIF profile is updated as well if it exists and
+            is valid. Don't append new value to existing value,
+            replace it instead.
+          */
+          orientation = MagickAtoI(value);
+          if (orientation > 0 || orientation <= (int)LeftBottomOrientation)
+            SetEXIFOrientation(image, orientation);
+
+          /* Replace current attribute with new one */
+          map=GetImageAttributeMap(image);
+          attribute->previous = p->previous;
+          attribute->next = p->next;
+          if (p->previous == (ImageAttribute *) NULL)
+            image->attributes=attribute;
           else
+            p->previous->next = attribute;
+          if (p->next != (ImageAttribute *) NULL)
+            p->next->previous = attribute;
+          if (map != (ImageAttributeMap *) NULL)
             {
-              /*
-                Extend existing text string.
-              */
-              min_l=p->length+attribute->length+1;
-              for (realloc_l=2; realloc_l <= min_l; realloc_l *= 2)
-                    { /* nada */};
-              MagickReallocMemory(char *,p->value,realloc_l);
-              if (p->value != (char *) NULL)
-                (void) strcat(p->value+p->length,attribute->value);
-              p->length += attribute->length;
-              DestroyImageAttribute(attribute);
+              map->slots[FindAttributeSlot(map,p->key,
+                                           HashAttributeKey(p->key))].
+                attribute=attribute;
+              if (map->tail == p)
+                map->tail=attribute;
             }
+          DestroyImageAttribute(p);
+          return(MagickPass);
+        }
+      else
+        {
+          /*
+            Extend existing text string.
+          */
+          min_l=p->length+attribute->length+1;
+          for (realloc_l=2; realloc_l <= min_l; realloc_l *= 2)
+                { /* nada */};
+          MagickReallocMemory(char *,p->value,realloc_l);
           if (p->value != (char *) NULL)
-            return(MagickPass);
-          (void) SetImageAttribute(image,key,NULL);
-          return(MagickFail);
+            (void) strcat(p->value+p->length,attribute->value);
+          p->length += attribute->length;
+          DestroyImageAttribute(attribute);
         }
-      if (p->next == (ImageAttribute *) NULL)
-        break;
+      if (p->value != (char *) NULL)
+        return(MagickPass);
+      (void) SetImageAttribute(image,key,NULL);
+      return(MagickFail);
     }
   /*
     Place new attribute at the end of the attribute list.
   */
-  attribute->previous=p;
-  p->next=attribute;
+  if (AppendImageAttribute(image,attribute) == MagickFail)
+    {
+      DestroyImageAttribute(attribute);
+      return(MagickFail);
+    }
   return(MagickPass);
 }
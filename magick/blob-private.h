@@ -0,0 +1,38 @@
+/*
+  Copyright (C) 2026 GraphicsMagick Group
+
+  This program is covered by multiple licenses, which are described in
+  Copyright.txt. You should have received a copy of Copyright.txt with this
+  package; otherwise see http://www.graphicsmagick.org/www/Copyright.html.
+
+  GraphicsMagick Binary Large OBjects Private Methods.
+*/
+
+/*
+  Initialize blob spill accounting.
+*/
+extern MagickPassFail
+  InitializeBlobSpillInfo(void);
+
+/*
+  Destroy blob spill accounting.
+*/
+extern void
+  DestroyBlobSpillInfo(void);
+
+/*
+  Record that 'length' bytes of data in format 'magick' had to be
+  copied to a temporary file because the consumer could not read it
+  from memory.  Used by BlobToImage(), ImageToBlob(), ImageToFile(),
+  and by coders which hand their input to an external program.
+*/
+extern MagickExport void
+  RecordBlobSpill(const char *magick,const magick_uint64_t length);
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * fill-column: 78
+ * End:
+ */
@@ -167,6 +167,29 @@ typedef union _MagickInt16Union
 
 } MagickInt16Union;
 
+/*
+  Per-format accounting of data which had to be copied to a temporary
+  file because it could not be read or written directly from memory.
+*/
+typedef struct _BlobSpillInfo
+{
+  char
+    magick[MaxTextExtent];  /* Format which spilled */
+
+  magick_uint64_t
+    spills,                 /* Number of temporary files written */
+    bytes;                  /* Total bytes written to temporary files */
+
+  struct _BlobSpillInfo
+    *next;
+} BlobSpillInfo;
+
+static BlobSpillInfo
+  *blob_spill_list = (BlobSpillInfo *) NULL;
+
+static SemaphoreInfo
+  *blob_spill_semaphore = (SemaphoreInfo *) NULL;
+
 /*
   Forward Declarations
 */
@@ -793,6 +816,7 @@ MagickExport Image *BlobToImage(const ImageInfo *image_info,const void *blob,
       {
         if (BlobToFile(temporary_file,blob,length,exception) != MagickFail)
           {
+            RecordBlobSpill(clone_info->magick,length);
             clone_info->filename[0]='\0';
             if (clone_info->magick[0] != '\0')
               {
@@ -1231,6 +1255,45 @@ MagickExport void DestroyBlobInfo(BlobInfo *blob)
     }
 }
 
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
++   D e s t r o y B l o b S p i l l I n f o                                   %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  DestroyBlobSpillInfo() logs the accumulated blob spill counts and then
+%  releases the spill accounting list.
+%
+%  The format of the DestroyBlobSpillInfo method is:
+%
+%      void DestroyBlobSpillInfo(void)
+%
+%
+*/
+void DestroyBlobSpillInfo(void)
+{
+  BlobSpillInfo
+    *entry;
+
+  while (blob_spill_list != (BlobSpillInfo *) NULL)
+    {
+      entry=blob_spill_list;
+      blob_spill_list=entry->next;
+      (void) LogMagickEvent(BlobEvent,GetMagickModule(),
+                            "Format %s spilled %" MAGICK_UINT64_F
+                            "u times (%" MAGICK_UINT64_F
+                            "u bytes) to temporary files",
+                            entry->magick,entry->spills,entry->bytes);
+      MagickFreeMemory(entry);
+    }
+  DestroySemaphoreInfo(&blob_spill_semaphore);
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -2316,6 +2379,8 @@ MagickExport void *ImageToBlob(const ImageInfo *image_info,Image *image,
     Read image from disk as blob.
   */
   blob=(unsigned char *) FileToBlob(image->filename,length,exception);
+  if (blob != (unsigned char *) NULL)
+    RecordBlobSpill(image->magick,*length);
   if (image->logging)
     (void) LogMagickEvent(BlobEvent,GetMagickModule(),
                           "Liberating temporary file \"%s\"",image->filename);
@@ -2389,6 +2454,9 @@ MagickExport MagickPassFail ImageToFile(Image *image,const char *filename,
     block_size,
     length;
 
+  magick_uint64_t
+    total;
+
   assert(image != (Image *) NULL);
   assert(image->signature == MagickSignature);
   assert(filename != (const char *) NULL);
@@ -2414,6 +2482,7 @@ MagickExport MagickPassFail ImageToFile(Image *image,const char *filename,
         filename);
       return(MagickFail);
     }
+  total=0;
   for (i=0; (length=ReadBlob(image,block_size,buffer)) > 0; )
   {
     for (i=0; i < length; i+=count)
@@ -2422,17 +2491,106 @@ MagickExport MagickPassFail ImageToFile(Image *image,const char *filename,
       if (count <= 0)
         break;
     }
+    total+=i;
     if (i < length)
       break;
   }
   (void) close(file);
+  RecordBlobSpill(image->magick,total);
   if (image->logging)
     (void) LogMagickEvent(BlobEvent,GetMagickModule(),
-                          "Copyied %"MAGICK_SIZE_T_F"u bytes from Blob stream to \"%s\"",(MAGICK_SIZE_T) i,filename);
+                          "Copied %" MAGICK_UINT64_F "u bytes from Blob stream to \"%s\"",total,filename);
   MagickFreeMemory(buffer);
   return (i < length ? MagickFail : MagickPass);
 }
 
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
++   I n i t i a l i z e B l o b S p i l l I n f o                             %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  InitializeBlobSpillInfo() initializes the blob spill accounting facility.
+%
+%  The format of the InitializeBlobSpillInfo method is:
+%
+%      MagickPassFail InitializeBlobSpillInfo(void)
+%
+%
+*/
+MagickPassFail InitializeBlobSpillInfo(void)
+{
+  assert(blob_spill_semaphore == (SemaphoreInfo *) NULL);
+  blob_spill_semaphore=AllocateSemaphoreInfo();
+  return MagickPass;
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   L i s t B l o b S p i l l I n f o                                         %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  ListBlobSpillInfo() lists the formats which had to be copied to a
+%  temporary file since they could not be read from, or written to, a
+%  memory blob directly.  For each format the number of temporary files
+%  and the total number of bytes copied are reported.  Nothing is printed
+%  if no data has spilled to disk.
+%
+%  The format of the ListBlobSpillInfo method is:
+%
+%      MagickPassFail ListBlobSpillInfo(FILE *file,ExceptionInfo *exception)
+%
+%  A description of each parameter follows.
+%
+%    o file:  An pointer to a FILE.
+%
+%    o exception: Return any errors or warnings in this structure.
+%
+%
+*/
+MagickExport MagickPassFail ListBlobSpillInfo(FILE *file,
+  ExceptionInfo *exception)
+{
+  const BlobSpillInfo
+    *entry;
+
+  ARG_NOT_USED(exception);
+
+  if (file == (FILE *) NULL)
+    file=stdout;
+
+  LockSemaphoreInfo(blob_spill_semaphore);
+  if (blob_spill_list != (BlobSpillInfo *) NULL)
+    {
+      fprintf(file,"\nBlob Spills To Temporary Files\n");
+      fprintf(file,"----------------------------------------------------\n");
+      for (entry=blob_spill_list; entry != (BlobSpillInfo *) NULL;
+           entry=entry->next)
+        {
+          char
+            bytes[MaxTextExtent];
+
+          FormatSize((magick_int64_t) entry->bytes,bytes);
+          fprintf(file,"%10s: %" MAGICK_UINT64_F "u spills, %sB\n",
+                  entry->magick,entry->spills,bytes);
+        }
+    }
+  UnlockSemaphoreInfo(blob_spill_semaphore);
+  (void) fflush(file);
+  return(MagickPass);
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -4477,6 +4635,69 @@ MagickExport char *ReadBlobString(Image *image,char *string)
   return(string);
 }
 
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
++   R e c o r d B l o b S p i l l                                             %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  RecordBlobSpill() records that data in the specified format had to be
+%  copied to a temporary file rather than being accessed directly from
+%  memory.  The counts are reported by ListBlobSpillInfo().
+%
+%  The format of the RecordBlobSpill method is:
+%
+%      void RecordBlobSpill(const char *magick,const magick_uint64_t length)
+%
+%  A description of each parameter follows:
+%
+%    o magick: The format which spilled.
+%
+%    o length: The number of bytes written to the temporary file.
+%
+%
+*/
+MagickExport void RecordBlobSpill(const char *magick,
+  const magick_uint64_t length)
+{
+  BlobSpillInfo
+    *entry;
+
+  if ((magick == (const char *) NULL) || (magick[0] == '\0'))
+    magick="UNKNOWN";
+  (void) LogMagickEvent(BlobEvent,GetMagickModule(),
+                        "Format %s spilled %" MAGICK_UINT64_F
+                        "u bytes to a temporary file",magick,length);
+  LockSemaphoreInfo(blob_spill_semaphore);
+  for (entry=blob_spill_list; entry != (BlobSpillInfo *) NULL;
+       entry=entry->next)
+    if (LocaleCompare(entry->magick,magick) == 0)
+      break;
+  if (entry == (BlobSpillInfo *) NULL)
+    {
+      entry=MagickAllocateMemory(BlobSpillInfo *,sizeof(BlobSpillInfo));
+      if (entry != (BlobSpillInfo *) NULL)
+        {
+          (void) strlcpy(entry->magick,magick,sizeof(entry->magick));
+          entry->spills=0;
+          entry->bytes=0;
+          entry->next=blob_spill_list;
+          blob_spill_list=entry;
+        }
+    }
+  if (entry != (BlobSpillInfo *) NULL)
+    {
+      entry->spills++;
+      entry->bytes+=length;
+    }
+  UnlockSemaphoreInfo(blob_spill_semaphore);
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -562,6 +562,17 @@ extern "C" {
   */
   extern MagickExport void DisassociateBlob(Image *);
 
+  /*
+    Lists the formats which had to be copied to temporary files because
+    they could not be read or written directly from memory.
+  */
+  extern MagickExport MagickPassFail ListBlobSpillInfo(FILE *file,
+                                                       ExceptionInfo *exception);
+
+#if defined(MAGICK_IMPLEMENTATION)
+#  include "magick/blob-private.h"
+#endif /* defined(MAGICK_IMPLEMENTATION) */
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }
 #endif
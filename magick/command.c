@@ -4298,6 +4298,114 @@ static MagickPassFail ConcatenateImages(const int argc,char **argv,
   return(MagickPass);
 }
 
+/*
+  Options which convert -stream may apply to a band of rows rather than
+  to the whole image, since they only read and write settings or only
+  transform pixels within a row.
+*/
+static MagickBool IsConvertStreamOption(const char *option)
+{
+  static const char
+    *options[] =
+    {
+      "asc-cdl",
+      "black-threshold",
+      "channel",
+      "colorspace",
+      "compress",
+      "contrast",
+      "debug",
+      "define",
+      "density",
+      "depth",
+      "endian",
+      "flop",
+      "gamma",
+      "level",
+      "limit",
+      "modulate",
+      "negate",
+      "operator",
+      "quality",
+      "quiet",
+      "size",
+      "solarize",
+      "stream",
+      "strip",
+      "threshold",
+      "units",
+      "white-threshold"
+    };
+
+  register unsigned int
+    i;
+
+  for (i=0; i < ArraySize(options); i++)
+    if (LocaleCompare(options[i],option+1) == 0)
+      return(MagickTrue);
+  return(MagickFalse);
+}
+
+typedef struct _ConvertStreamOptions
+{
+  const ImageInfo
+    *image_info;
+
+  int
+    argc;
+
+  char
+    **argv;
+} ConvertStreamOptions;
+
+static MagickPassFail ConvertStreamTransform(void *client_data,Image **rows,
+  ExceptionInfo *exception)
+{
+  const ConvertStreamOptions
+    *options = (const ConvertStreamOptions *) client_data;
+
+  MagickPassFail
+    status;
+
+  if (options->argc <= 0)
+    return(MagickPass);
+  status=MogrifyImage(options->image_info,options->argc,options->argv,rows);
+  if ((*rows)->exception.severity > exception->severity)
+    CopyException(exception,&(*rows)->exception);
+  return(status);
+}
+
+/*
+  Read an input which convert deferred for streaming, and apply the
+  options which preceded it if further options followed it, as would
+  have happened had it been read immediately.  Argument i is the index
+  of the next input (or of the output), and k is the index of the
+  deferred input.
+*/
+static Image *ReadConvertStreamInput(const ImageInfo *image_info,
+  ImageInfo **stream_info,char **argv,const long i,long *j,const long k,
+  Image **image_list,ExceptionInfo *exception)
+{
+  Image
+    *image;
+
+  (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                        "Reading \"%.1024s\" without streaming",
+                        (*stream_info)->filename);
+  image=ReadImage(*stream_info,exception);
+  DestroyImageInfo(*stream_info);
+  *stream_info=(ImageInfo *) NULL;
+  if ((image != (Image *) NULL) && (i > (k+1)))
+    {
+      (void) MogrifyImages(image_info,(int) (k+1-*j),argv+*j,&image);
+      GetImageException(image,exception);
+      AppendImageToList(image_list,image);
+      image=NewImageList();
+      *j=k+1;
+    }
+  return(image);
+}
+
 #define NotInitialized  (unsigned int) (~0)
 
 #define ThrowConvertException(code,reason,description) \
@@ -4329,6 +4437,9 @@ MagickExport MagickPassFail ConvertImageCommand(ImageInfo *image_info,
     *image_list = (Image *) NULL,
     *next_image = (Image *) NULL;
 
+  ImageInfo
+    *stream_info = (ImageInfo *) NULL;
+
   long
     j,
     k,
@@ -4337,6 +4448,10 @@ MagickExport MagickPassFail ConvertImageCommand(ImageInfo *image_info,
   register int
     i;
 
+  MagickBool
+    stream = MagickFalse,
+    stream_options = MagickTrue;
+
   unsigned int
     ping,
     status = 0;
@@ -4384,6 +4499,9 @@ MagickExport MagickPassFail ConvertImageCommand(ImageInfo *image_info,
   */
   if ((argc > 2) && (LocaleCompare("-concatenate",argv[1]) == 0))
     return(ConcatenateImages(argc,argv,exception));
+  for (i=1; i < (argc-1); i++)
+    if (LocaleCompare("-stream",argv[i]) == 0)
+      stream=MagickTrue;
   j=1;
   k=0;
   for (i=1; i < (argc-1); i++)
@@ -4394,12 +4512,35 @@ MagickExport MagickPassFail ConvertImageCommand(ImageInfo *image_info,
         ((option[0] == '-') && (option[1] == '[')) ||
         ((option[0] != '-') && option[0] != '+'))
       {
+        if (stream_info != (ImageInfo *) NULL)
+          {
+            /*
+              Only a single input may be streamed, so read the
+              deferred input now.
+            */
+            image=ReadConvertStreamInput(image_info,&stream_info,argv,i,&j,k,
+                                         &image_list,exception);
+            status&=(image != (Image *) NULL) ||
+              (image_list != (Image *) NULL);
+            status&=(exception->severity < ErrorException);
+          }
         /*
           Read input image.
         */
         k=i;
         filename=argv[i];
         (void) strlcpy(image_info->filename,filename,MaxTextExtent);
+        if (stream && !ping && (image == (Image *) NULL) &&
+            (image_list == (Image *) NULL))
+          {
+            /*
+              Defer reading the input until all of the options are
+              known, since it may be streamed.
+            */
+            stream=MagickFalse;
+            stream_info=CloneImageInfo(image_info);
+            continue;
+          }
         if (ping)
           next_image=PingImage(image_info,exception);
         else
@@ -4424,6 +4565,8 @@ MagickExport MagickPassFail ConvertImageCommand(ImageInfo *image_info,
         image=NewImageList();
         j=k+1;
       }
+    if (!IsConvertStreamOption(option))
+      stream_options=MagickFalse;
     switch (*(option+1))
     {
       case 'a':
@@ -5878,6 +6021,10 @@ MagickExport MagickPassFail ConvertImageCommand(ImageInfo *image_info,
               }
             break;
           }
+        if (LocaleCompare("stream",option+1) == 0)
+          {
+            break;
+          }
         if (LocaleCompare("strip",option+1) == 0)
           {
             break;
@@ -6136,6 +6283,48 @@ MagickExport MagickPassFail ConvertImageCommand(ImageInfo *image_info,
         }
     }
   }
+  if (stream_info != (ImageInfo *) NULL)
+    {
+      ImageInfo
+        *write_info;
+
+      MagickBool
+        streamable;
+
+      /*
+        Stream the deferred input to the output if only row-local
+        options were given, otherwise read it as usual.
+      */
+      write_info=CloneImageInfo(image_info);
+      (void) strlcpy(write_info->filename,argv[argc-1],MaxTextExtent);
+      streamable=(stream_options && (i == (argc-1)) &&
+                  (metadata == (char **) NULL) &&
+                  IsImageStreamable(stream_info,write_info,exception));
+      if (streamable)
+        {
+          ConvertStreamOptions
+            stream_options_info;
+
+          stream_options_info.image_info=image_info;
+          stream_options_info.argc=i-j;
+          stream_options_info.argv=argv+j;
+          status&=StreamImage(stream_info,write_info,ConvertStreamTransform,
+                              &stream_options_info,exception);
+        }
+      else
+        {
+          image=ReadConvertStreamInput(image_info,&stream_info,argv,i,&j,k,
+                                       &image_list,exception);
+          status&=(image != (Image *) NULL) || (image_list != (Image *) NULL);
+          status&=(exception->severity < ErrorException);
+        }
+      DestroyImageInfo(write_info);
+      if (stream_info != (ImageInfo *) NULL)
+        DestroyImageInfo(stream_info);
+      stream_info=(ImageInfo *) NULL;
+      if (streamable)
+        goto convert_cleanup_and_return;
+    }
   if ((image == (Image *) NULL) && (image_list == (Image *) NULL))
     {
       if (exception->severity == UndefinedException)
@@ -6176,6 +6365,8 @@ MagickExport MagickPassFail ConvertImageCommand(ImageInfo *image_info,
       MagickFreeMemory(text);
     }
  convert_cleanup_and_return:
+  if (stream_info != (ImageInfo *) NULL)
+    DestroyImageInfo(stream_info);
   DestroyImageList(image_list);
   LiberateArgumentList(argc,argv);
   return(status);
@@ -6350,6 +6541,7 @@ static void ConvertUsage(void)
   (void) puts("  -solarize threshold  negate all pixels above the threshold level");
   (void) puts("  -spread amount       displace image pixels by a random amount");
   (void) puts("  -stroke color        graphic primitive stroke color");
+  (void) puts("  -stream              convert without holding the whole image in memory");
   (void) puts("  -strokewidth value   graphic primitive stroke width");
   (void) puts("  -strip               strip all profiles and text attributes from image");
   (void) puts("  -swirl degrees       swirl image pixels about the center");
@@ -11378,6 +11570,120 @@ MagickExport MagickPassFail MogrifyImage(const ImageInfo *image_info,
   return((*image)->exception.severity == UndefinedException);
 }
 
+/*
+  Options which MogrifyImages may apply to several frames at once, since
+  they only read and write settings of their own ImageInfo or only
+  transform the frame they are applied to.  Options which read or write
+  files, draw text, or consume random numbers are not listed, so that the
+  result never depends on the order in which frames are processed.
+*/
+static MagickBool IsFrameIndependentOption(const char *option)
+{
+  static const char
+    *options[] =
+    {
+      "antialias",
+      "auto-orient",
+      "background",
+      "black-threshold",
+      "blur",
+      "border",
+      "bordercolor",
+      "channel",
+      "charcoal",
+      "chop",
+      "colorize",
+      "colors",
+      "colorspace",
+      "compose",
+      "compress",
+      "contrast",
+      "convolve",
+      "crop",
+      "cycle",
+      "delay",
+      "density",
+      "depth",
+      "despeckle",
+      "dispose",
+      "dither",
+      "edge",
+      "emboss",
+      "encoding",
+      "endian",
+      "enhance",
+      "equalize",
+      "extent",
+      "filter",
+      "flip",
+      "flop",
+      "frame",
+      "fuzz",
+      "gamma",
+      "gaussian",
+      "gaussian-blur",
+      "geometry",
+      "gravity",
+      "implode",
+      "interlace",
+      "lat",
+      "level",
+      "loop",
+      "magnify",
+      "matte",
+      "mattecolor",
+      "median",
+      "minify",
+      "modulate",
+      "monochrome",
+      "motion-blur",
+      "negate",
+      "normalize",
+      "opaque",
+      "operator",
+      "ordered-dither",
+      "page",
+      "quality",
+      "quantize",
+      "raise",
+      "recolor",
+      "repage",
+      "resample",
+      "resize",
+      "roll",
+      "rotate",
+      "sample",
+      "scale",
+      "scene",
+      "shade",
+      "sharpen",
+      "shave",
+      "shear",
+      "solarize",
+      "strip",
+      "swirl",
+      "threshold",
+      "thumbnail",
+      "transparent",
+      "treedepth",
+      "trim",
+      "type",
+      "units",
+      "unsharp",
+      "virtual-pixel",
+      "wave",
+      "white-threshold"
+    };
+
+  register unsigned int
+    i;
+
+  for (i=0; i < ArraySize(options); i++)
+    if (LocaleCompare(options[i],option+1) == 0)
+      return(MagickTrue);
+  return(MagickFalse);
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -11476,6 +11782,91 @@ MagickExport MagickPassFail MogrifyImages(const ImageInfo *image_info,
   */
   status=MagickPass;
   mogrify_images=NewImageList();
+#if defined(HAVE_OPENMP)
+  {
+    Image
+      **frames;
+
+    long
+      number_frames,
+      scene_offset;
+
+    int
+      frame_threads;
+
+    /*
+      Sequences of many small frames gain little from processing the rows
+      of each frame in parallel, so when every option only affects the
+      frame it is applied to, process whole frames concurrently instead.
+      Each frame is then processed by a single thread.
+    */
+    number_frames=(long) GetImageListLength(*images);
+    frame_threads=(int) Min(GetMagickResourceLimit(ThreadsResource),
+                            (magick_int64_t) number_frames);
+    frames=(Image **) NULL;
+    if (frame_threads > 1)
+      {
+        for (i=0; i < argc; i++)
+          {
+            option=argv[i];
+            if ((strlen(option) <= 1) ||
+                ((*option != '-') && (*option != '+')))
+              continue;
+            if (!IsFrameIndependentOption(option))
+              break;
+          }
+        if (i == argc)
+          frames=MagickAllocateArray(Image **,(size_t) number_frames,
+                                     sizeof(Image *));
+      }
+    if (frames != (Image **) NULL)
+      {
+        if (IsEventLogging())
+          (void) LogMagickEvent(TransformEvent,GetMagickModule(),
+                                "Processing %ld frames using %d threads",
+                                number_frames,frame_threads);
+        for (i=0; i < number_frames; i++)
+          frames[i]=RemoveFirstImageFromList(images);
+#  if defined(TUNE_OPENMP)
+#    pragma omp parallel for num_threads(frame_threads) schedule(runtime) shared(status)
+#  else
+#    pragma omp parallel for num_threads(frame_threads) schedule(dynamic,1) shared(status)
+#  endif
+        for (i=0; i < number_frames; i++)
+          {
+            MagickPassFail
+              thread_status;
+
+            thread_status=MogrifyImage(image_info,argc,argv,&frames[i]);
+            if (thread_status == MagickFail)
+              {
+                status=MagickFail;
+#  pragma omp flush (status)
+              }
+          }
+        /*
+          Restore the frames in their original order.
+        */
+        scene_offset=0;
+        for (i=0; i < number_frames; i++)
+          {
+            Image
+              *p;
+
+            for (p=frames[i]; p != (Image *) NULL; p=p->next)
+              {
+                if (scene)
+                  p->scene += scene_offset;
+                if (image_info->verbose)
+                  (void) DescribeImage(p,stderr,MagickFalse);
+                scene_offset++;
+              }
+            AppendImageToList(&mogrify_images,frames[i]);
+          }
+        MagickFreeMemory(frames);
+      }
+  }
+#endif /* HAVE_OPENMP */
   i=0;
   while ((image=RemoveFirstImageFromList(images)) != (Image *) NULL)
     {
@@ -43,10 +43,25 @@
 #include "magick/composite.h"
 #include "magick/enum_strings.h"
 #include "magick/gem.h"
+#include "magick/monitor.h"
+#include "magick/omp_data_view.h"
 #include "magick/pixel_cache.h"
 #include "magick/pixel_iterator.h"
 #include "magick/utility.h"
 
+/*
+  Vectorized composition kernels are provided for 8 and 16 bit
+  quantums.  AVX2 is selected at run time via CPU feature detection.
+*/
+#if (QuantumDepth == 8) || (QuantumDepth == 16)
+#  if defined(__SSE2__) && defined(__GNUC__) && !defined(__STRICT_ANSI__) && \
+  (defined(__clang__) || (__GNUC__ >= 5))
+#    define COMPOSITE_AVX2_KERNELS 1
+#    define COMPOSITE_AVX2_FUNC MAGICK_ATTRIBUTE((__target__("avx2")))
+#    include <immintrin.h>
+#  endif
+#endif
+
 
 /*
   Structure to pass any necessary options to composition callbacks.
@@ -136,6 +151,615 @@ ApplyPacketUpdates(PixelPacket * restrict update_pixels,
 }
 
 
+/*
+  Vectorized composition kernels.
+
+  Each kernel composites as many whole groups of four pixels of a row
+  as possible, and returns the number of pixels it has processed.  The
+  caller composites any remaining pixels.  Kernels are only used when
+  neither image is CMYK, so that opacity is always stored in the
+  PixelPacket.  The kernels evaluate the same double precision
+  expressions, in the same order, as the scalar code so results are
+  identical.
+*/
+typedef long (*CompositeKernelMethod)(const PixelPacket * restrict source,
+                                      const MagickBool source_matte,
+                                      PixelPacket * restrict update,
+                                      const MagickBool update_matte,
+                                      const long npixels);
+
+typedef struct _CompositeKernelInfo
+{
+  const char
+    *name;
+
+  CompositeKernelMethod
+    over,
+    multiply,
+    screen,
+    plus,
+    minus,
+    copy_opacity;
+} CompositeKernelInfo;
+
+#if defined(COMPOSITE_AVX2_KERNELS)
+/*
+  Bit offset of a quantum within the PixelPacket.
+*/
+#define CompositeShift(member) \
+  ((int) (offsetof(PixelPacket,member)/sizeof(Quantum))*QuantumDepth)
+
+/*
+  Four pixels as loaded from memory.
+*/
+#if QuantumDepth == 8
+typedef __m128i CompositePixelsAVX2;
+#else
+typedef __m256i CompositePixelsAVX2;
+#endif
+
+/*
+  Four pixels as double precision channels.
+*/
+typedef struct _CompositeLanesAVX2
+{
+  __m256d
+    red,
+    green,
+    blue,
+    opacity;
+} CompositeLanesAVX2;
+
+static inline COMPOSITE_AVX2_FUNC CompositePixelsAVX2
+CompositeLoadAVX2(const PixelPacket *p)
+{
+#if QuantumDepth == 8
+  return _mm_loadu_si128((const __m128i *) p);
+#else
+  return _mm256_loadu_si256((const __m256i *) p);
+#endif
+}
+
+static inline COMPOSITE_AVX2_FUNC void
+CompositeStoreAVX2(PixelPacket *q,const CompositePixelsAVX2 pixels)
+{
+#if QuantumDepth == 8
+  _mm_storeu_si128((__m128i *) q,pixels);
+#else
+  _mm256_storeu_si256((__m256i *) q,pixels);
+#endif
+}
+
+/*
+  Extract one quantum of each pixel as 32 bit integers.
+*/
+static inline COMPOSITE_AVX2_FUNC __m128i
+CompositeQuantumsAVX2(const CompositePixelsAVX2 pixels,const int shift)
+{
+#if QuantumDepth == 8
+  return _mm_and_si128(_mm_srli_epi32(pixels,shift),_mm_set1_epi32(0xff));
+#else
+  __m256i
+    v;
+
+  v=_mm256_and_si256(_mm256_srli_epi64(pixels,shift),
+                     _mm256_set1_epi64x(0xffff));
+  v=_mm256_permutevar8x32_epi32(v,_mm256_setr_epi32(0,2,4,6,0,2,4,6));
+  return _mm256_castsi256_si128(v);
+#endif
+}
+
+/*
+  Combine four 32 bit integer quantums per pixel into pixels.
+*/
+static inline COMPOSITE_AVX2_FUNC CompositePixelsAVX2
+CompositePackAVX2(const __m128i red,const __m128i green,const __m128i blue,
+                  const __m128i opacity)
+{
+#if QuantumDepth == 8
+  return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(red,CompositeShift(red)),
+                                   _mm_slli_epi32(green,CompositeShift(green))),
+                      _mm_or_si128(_mm_slli_epi32(blue,CompositeShift(blue)),
+                                   _mm_slli_epi32(opacity,
+                                                  CompositeShift(opacity))));
+#else
+  return _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi64(_mm256_cvtepu32_epi64(red),
+                                                           CompositeShift(red)),
+                                         _mm256_slli_epi64(_mm256_cvtepu32_epi64(green),
+                                                           CompositeShift(green))),
+                         _mm256_or_si256(_mm256_slli_epi64(_mm256_cvtepu32_epi64(blue),
+                                                           CompositeShift(blue)),
+                                         _mm256_slli_epi64(_mm256_cvtepu32_epi64(opacity),
+                                                           CompositeShift(opacity))));
+#endif
+}
+
+/*
+  Replace the opacity quantum of each pixel.
+*/
+static inline COMPOSITE_AVX2_FUNC CompositePixelsAVX2
+CompositeSetOpacityAVX2(const CompositePixelsAVX2 pixels,const __m128i opacity)
+{
+#if QuantumDepth == 8
+  return _mm_or_si128(_mm_andnot_si128(_mm_set1_epi32(0xff << CompositeShift(opacity)),
+                                       pixels),
+                      _mm_slli_epi32(opacity,CompositeShift(opacity)));
+#else
+  return _mm256_or_si256(_mm256_andnot_si256(_mm256_set1_epi64x((magick_int64_t) 0xffff <<
+                                                                CompositeShift(opacity)),
+                                             pixels),
+                         _mm256_slli_epi64(_mm256_cvtepu32_epi64(opacity),
+                                           CompositeShift(opacity)));
+#endif
+}
+
+/*
+  Convert pixels to channels, treating pixels without matte as opaque
+  in the same way as PrepareSourcePacket() and
+  PrepareDestinationPacket().
+*/
+static inline COMPOSITE_AVX2_FUNC void
+CompositeLanesFromPixelsAVX2(const CompositePixelsAVX2 pixels,
+                             const MagickBool matte,
+                             CompositeLanesAVX2 *lanes)
+{
+  lanes->red=_mm256_cvtepi32_pd(CompositeQuantumsAVX2(pixels,CompositeShift(red)));
+  lanes->green=_mm256_cvtepi32_pd(CompositeQuantumsAVX2(pixels,CompositeShift(green)));
+  lanes->blue=_mm256_cvtepi32_pd(CompositeQuantumsAVX2(pixels,CompositeShift(blue)));
+  if (matte)
+    lanes->opacity=
+      _mm256_cvtepi32_pd(CompositeQuantumsAVX2(pixels,CompositeShift(opacity)));
+  else
+    lanes->opacity=_mm256_set1_pd((double) OpaqueOpacity);
+}
+
+/*
+  Vector equivalent of RoundDoubleToQuantum().
+*/
+static inline COMPOSITE_AVX2_FUNC __m128i
+CompositeRoundAVX2(const __m256d value)
+{
+  return _mm256_cvttpd_epi32(_mm256_add_pd(_mm256_min_pd(_mm256_max_pd(value,_mm256_setzero_pd()),
+                                                         _mm256_set1_pd(MaxRGBDouble)),
+                                           _mm256_set1_pd(0.5)));
+}
+
+static inline COMPOSITE_AVX2_FUNC CompositePixelsAVX2
+CompositePixelsFromLanesAVX2(const CompositeLanesAVX2 *lanes)
+{
+  return CompositePackAVX2(CompositeRoundAVX2(lanes->red),
+                           CompositeRoundAVX2(lanes->green),
+                           CompositeRoundAVX2(lanes->blue),
+                           CompositeRoundAVX2(lanes->opacity));
+}
+
+/*
+  Return non-zero if all four quantums equal value.
+*/
+static inline COMPOSITE_AVX2_FUNC int
+CompositeAllEqualAVX2(const __m128i quantums,const int value)
+{
+  return (_mm_movemask_epi8(_mm_cmpeq_epi32(quantums,_mm_set1_epi32(value)))
+          == 0xffff);
+}
+
+static COMPOSITE_AVX2_FUNC long
+OverCompositeAVX2(const PixelPacket * restrict source,
+                  const MagickBool source_matte,
+                  PixelPacket * restrict update,
+                  const MagickBool update_matte,
+                  const long npixels)
+{
+  CompositeLanesAVX2
+    change,
+    base;
+
+  CompositePixelsAVX2
+    source_pixels;
+
+  __m128i
+    source_opacity;
+
+  __m256d
+    base_alpha,
+    change_alpha,
+    delta,
+    keep,
+    one,
+    value;
+
+  long
+    i;
+
+  one=_mm256_set1_pd(1.0);
+  for (i=0; i+4 <= npixels; i+=4)
+    {
+      source_pixels=CompositeLoadAVX2(&source[i]);
+      source_opacity=CompositeQuantumsAVX2(source_pixels,CompositeShift(opacity));
+      if (!source_matte ||
+          CompositeAllEqualAVX2(source_opacity,OpaqueOpacity))
+        {
+          /*
+            Opaque change pixels replace the canvas pixels.
+          */
+          CompositeStoreAVX2(&update[i],
+                             CompositeSetOpacityAVX2(source_pixels,
+                                                     _mm_setzero_si128()));
+          continue;
+        }
+      if (CompositeAllEqualAVX2(source_opacity,TransparentOpacity))
+        {
+          /*
+            Transparent change pixels leave the canvas pixels unchanged.
+          */
+          if (!update_matte)
+            CompositeStoreAVX2(&update[i],
+                               CompositeSetOpacityAVX2(CompositeLoadAVX2(&update[i]),
+                                                       _mm_setzero_si128()));
+          continue;
+        }
+      CompositeLanesFromPixelsAVX2(source_pixels,MagickTrue,&change);
+      CompositeLanesFromPixelsAVX2(CompositeLoadAVX2(&update[i]),update_matte,&base);
+      /*
+        As for AlphaCompositePixel().
+      */
+      change_alpha=_mm256_div_pd(change.opacity,_mm256_set1_pd(MaxRGBDouble));
+      base_alpha=_mm256_div_pd(base.opacity,_mm256_set1_pd(MaxRGBDouble));
+      keep=_mm256_cmp_pd(change.opacity,_mm256_set1_pd((double) TransparentOpacity),
+                         _CMP_EQ_OQ);
+      delta=_mm256_sub_pd(one,_mm256_mul_pd(change_alpha,base_alpha));
+      value=_mm256_mul_pd(_mm256_set1_pd(MaxRGBDouble),_mm256_sub_pd(one,delta));
+      base.opacity=_mm256_blendv_pd(value,base.opacity,keep);
+      delta=_mm256_div_pd(one,
+                          _mm256_blendv_pd(delta,one,
+                                           _mm256_cmp_pd(delta,
+                                                         _mm256_set1_pd(MagickEpsilon),
+                                                         _CMP_LE_OQ)));
+#define CompositeOverChannelAVX2(channel)                               \
+      value=_mm256_mul_pd(delta,                                        \
+                          _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(one,change_alpha), \
+                                                      change.channel),  \
+                                        _mm256_mul_pd(_mm256_mul_pd(_mm256_sub_pd(one,base_alpha), \
+                                                                    base.channel), \
+                                                      change_alpha)));  \
+      base.channel=_mm256_blendv_pd(value,base.channel,keep);
+      CompositeOverChannelAVX2(red);
+      CompositeOverChannelAVX2(green);
+      CompositeOverChannelAVX2(blue);
+#undef CompositeOverChannelAVX2
+      CompositeStoreAVX2(&update[i],CompositePixelsFromLanesAVX2(&base));
+    }
+  return i;
+}
+
+/*
+  Compute the composite opacity, and the reciprocal of the composite
+  alpha, for the Multiply and Screen operators.
+*/
+static inline COMPOSITE_AVX2_FUNC __m256d
+CompositeGammaAVX2(const __m256d source_alpha,const __m256d dest_alpha,
+                   __m256d *opacity)
+{
+  __m256d
+    gamma,
+    one;
+
+  one=_mm256_set1_pd(1.0);
+  gamma=_mm256_sub_pd(_mm256_add_pd(_mm256_sub_pd(one,source_alpha),
+                                    _mm256_sub_pd(one,dest_alpha)),
+                      _mm256_mul_pd(_mm256_sub_pd(one,source_alpha),
+                                    _mm256_sub_pd(one,dest_alpha)));
+  gamma=_mm256_min_pd(_mm256_max_pd(gamma,_mm256_setzero_pd()),one);
+  *opacity=_mm256_mul_pd(_mm256_set1_pd(MaxRGBDouble),_mm256_sub_pd(one,gamma));
+  return _mm256_div_pd(one,
+                       _mm256_blendv_pd(gamma,_mm256_set1_pd(MagickEpsilon),
+                                        _mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0),
+                                                                       gamma),
+                                                      _mm256_set1_pd(MagickEpsilon),
+                                                      _CMP_LT_OQ)));
+}
+
+static COMPOSITE_AVX2_FUNC long
+MultiplyCompositeAVX2(const PixelPacket * restrict source,
+                      const MagickBool source_matte,
+                      PixelPacket * restrict update,
+                      const MagickBool update_matte,
+                      const long npixels)
+{
+  CompositeLanesAVX2
+    change,
+    base;
+
+  __m256d
+    dest_alpha,
+    gamma,
+    one,
+    source_alpha;
+
+  long
+    i;
+
+  one=_mm256_set1_pd(1.0);
+  for (i=0; i+4 <= npixels; i+=4)
+    {
+      CompositeLanesFromPixelsAVX2(CompositeLoadAVX2(&source[i]),source_matte,&change);
+      CompositeLanesFromPixelsAVX2(CompositeLoadAVX2(&update[i]),update_matte,&base);
+      source_alpha=_mm256_div_pd(change.opacity,_mm256_set1_pd(MaxRGBDouble));
+      dest_alpha=_mm256_div_pd(base.opacity,_mm256_set1_pd(MaxRGBDouble));
+      gamma=CompositeGammaAVX2(source_alpha,dest_alpha,&base.opacity);
+#define CompositeMultiplyChannelAVX2(channel)                           \
+      base.channel=                                                     \
+        _mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(_mm256_div_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(change.channel, \
+                                                                                                          _mm256_sub_pd(one,source_alpha)), \
+                                                                                            base.channel), \
+                                                                              _mm256_sub_pd(one,dest_alpha)), \
+                                                                _mm256_set1_pd(MaxRGBDouble)), \
+                                                  _mm256_mul_pd(_mm256_mul_pd(change.channel, \
+                                                                              _mm256_sub_pd(one,source_alpha)), \
+                                                                dest_alpha)), \
+                                    _mm256_mul_pd(_mm256_mul_pd(base.channel, \
+                                                                _mm256_sub_pd(one,dest_alpha)), \
+                                                  source_alpha)),       \
+                      gamma);
+      CompositeMultiplyChannelAVX2(red);
+      CompositeMultiplyChannelAVX2(green);
+      CompositeMultiplyChannelAVX2(blue);
+#undef CompositeMultiplyChannelAVX2
+      CompositeStoreAVX2(&update[i],CompositePixelsFromLanesAVX2(&base));
+    }
+  return i;
+}
+
+static COMPOSITE_AVX2_FUNC long
+ScreenCompositeAVX2(const PixelPacket * restrict source,
+                    const MagickBool source_matte,
+                    PixelPacket * restrict update,
+                    const MagickBool update_matte,
+                    const long npixels)
+{
+  CompositeLanesAVX2
+    change,
+    base;
+
+  __m256d
+    dest_alpha,
+    gamma,
+    one,
+    source_alpha;
+
+  long
+    i;
+
+  one=_mm256_set1_pd(1.0);
+  for (i=0; i+4 <= npixels; i+=4)
+    {
+      CompositeLanesFromPixelsAVX2(CompositeLoadAVX2(&source[i]),source_matte,&change);
+      CompositeLanesFromPixelsAVX2(CompositeLoadAVX2(&update[i]),update_matte,&base);
+      source_alpha=_mm256_div_pd(change.opacity,_mm256_set1_pd(MaxRGBDouble));
+      dest_alpha=_mm256_div_pd(base.opacity,_mm256_set1_pd(MaxRGBDouble));
+      gamma=CompositeGammaAVX2(source_alpha,dest_alpha,&base.opacity);
+#define CompositeScreenChannelAVX2(channel)                             \
+      base.channel=                                                     \
+        _mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_add_pd(change.channel, \
+                                                                                                          base.channel), \
+                                                                                            _mm256_div_pd(_mm256_mul_pd(change.channel, \
+                                                                                                                        base.channel), \
+                                                                                                          _mm256_set1_pd(MaxRGBDouble))), \
+                                                                              _mm256_sub_pd(one,source_alpha)), \
+                                                                _mm256_sub_pd(one,dest_alpha)), \
+                                                  _mm256_mul_pd(_mm256_mul_pd(change.channel, \
+                                                                              _mm256_sub_pd(one,source_alpha)), \
+                                                                dest_alpha)), \
+                                    _mm256_mul_pd(_mm256_mul_pd(base.channel, \
+                                                                _mm256_sub_pd(one,dest_alpha)), \
+                                                  source_alpha)),       \
+                      gamma);
+      CompositeScreenChannelAVX2(red);
+      CompositeScreenChannelAVX2(green);
+      CompositeScreenChannelAVX2(blue);
+#undef CompositeScreenChannelAVX2
+      CompositeStoreAVX2(&update[i],CompositePixelsFromLanesAVX2(&base));
+    }
+  return i;
+}
+
+static COMPOSITE_AVX2_FUNC long
+PlusCompositeAVX2(const PixelPacket * restrict source,
+                  const MagickBool source_matte,
+                  PixelPacket * restrict update,
+                  const MagickBool update_matte,
+                  const long npixels)
+{
+  CompositeLanesAVX2
+    change,
+    base;
+
+  __m256d
+    base_weight,
+    change_weight;
+
+  long
+    i;
+
+  for (i=0; i+4 <= npixels; i+=4)
+    {
+      CompositeLanesFromPixelsAVX2(CompositeLoadAVX2(&source[i]),source_matte,&change);
+      CompositeLanesFromPixelsAVX2(CompositeLoadAVX2(&update[i]),update_matte,&base);
+      change_weight=_mm256_sub_pd(_mm256_set1_pd(MaxRGBDouble),change.opacity);
+      base_weight=_mm256_sub_pd(_mm256_set1_pd(MaxRGBDouble),base.opacity);
+#define CompositePlusChannelAVX2(channel)                               \
+      _mm256_div_pd(_mm256_add_pd(_mm256_mul_pd(change_weight,change.channel), \
+                                  _mm256_mul_pd(base_weight,base.channel)), \
+                    _mm256_set1_pd(MaxRGBDouble))
+      CompositeStoreAVX2(&update[i],
+                         CompositePackAVX2(CompositeRoundAVX2(CompositePlusChannelAVX2(red)),
+                                           CompositeRoundAVX2(CompositePlusChannelAVX2(green)),
+                                           CompositeRoundAVX2(CompositePlusChannelAVX2(blue)),
+                                           _mm_sub_epi32(_mm_set1_epi32(MaxRGB),
+                                                         CompositeRoundAVX2(_mm256_div_pd(_mm256_add_pd(change_weight,
+                                                                                                        base_weight),
+                                                                                          _mm256_set1_pd(MaxRGBDouble))))));
+#undef CompositePlusChannelAVX2
+    }
+  return i;
+}
+
+static COMPOSITE_AVX2_FUNC long
+MinusCompositeAVX2(const PixelPacket * restrict source,
+                   const MagickBool source_matte,
+                   PixelPacket * restrict update,
+                   const MagickBool update_matte,
+                   const long npixels)
+{
+  CompositeLanesAVX2
+    change,
+    base;
+
+  __m256d
+    base_weight,
+    change_weight;
+
+  long
+    i;
+
+  for (i=0; i+4 <= npixels; i+=4)
+    {
+      CompositeLanesFromPixelsAVX2(CompositeLoadAVX2(&source[i]),source_matte,&change);
+      CompositeLanesFromPixelsAVX2(CompositeLoadAVX2(&update[i]),update_matte,&base);
+      change_weight=_mm256_sub_pd(_mm256_set1_pd(MaxRGBDouble),change.opacity);
+      base_weight=_mm256_sub_pd(_mm256_set1_pd(MaxRGBDouble),base.opacity);
+#define CompositeMinusChannelAVX2(channel)                              \
+      _mm256_div_pd(_mm256_sub_pd(_mm256_mul_pd(base_weight,base.channel), \
+                                  _mm256_mul_pd(change_weight,change.channel)), \
+                    _mm256_set1_pd(MaxRGBDouble))
+      CompositeStoreAVX2(&update[i],
+                         CompositePackAVX2(CompositeRoundAVX2(CompositeMinusChannelAVX2(red)),
+                                           CompositeRoundAVX2(CompositeMinusChannelAVX2(green)),
+                                           CompositeRoundAVX2(CompositeMinusChannelAVX2(blue)),
+                                           _mm_sub_epi32(_mm_set1_epi32(MaxRGB),
+                                                         CompositeRoundAVX2(_mm256_div_pd(_mm256_sub_pd(base_weight,
+                                                                                                        change_weight),
+                                                                                          _mm256_set1_pd(MaxRGBDouble))))));
+#undef CompositeMinusChannelAVX2
+    }
+  return i;
+}
+
+static COMPOSITE_AVX2_FUNC long
+CopyOpacityCompositeAVX2(const PixelPacket * restrict source,
+                         const MagickBool source_matte,
+                         PixelPacket * restrict update,
+                         const MagickBool update_matte,
+                         const long npixels)
+{
+  CompositePixelsAVX2
+    source_pixels;
+
+  __m128i
+    opacity;
+
+  long
+    i;
+
+  ARG_NOT_USED(update_matte);
+
+  for (i=0; i+4 <= npixels; i+=4)
+    {
+      source_pixels=CompositeLoadAVX2(&source[i]);
+      if (source_matte)
+        {
+          opacity=CompositeQuantumsAVX2(source_pixels,CompositeShift(opacity));
+        }
+      else
+        {
+          /*
+            MaxRGB-PixelIntensityToQuantum()
+          */
+          opacity=_mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(CompositeQuantumsAVX2(source_pixels,
+                                                                                    CompositeShift(red)),
+                                                              _mm_set1_epi32(306)),
+                                              _mm_mullo_epi32(CompositeQuantumsAVX2(source_pixels,
+                                                                                    CompositeShift(green)),
+                                                              _mm_set1_epi32(601))),
+                                _mm_mullo_epi32(CompositeQuantumsAVX2(source_pixels,
+                                                                      CompositeShift(blue)),
+                                                _mm_set1_epi32(117)));
+          opacity=_mm_sub_epi32(_mm_set1_epi32(MaxRGB),_mm_srli_epi32(opacity,10));
+        }
+      CompositeStoreAVX2(&update[i],
+                         CompositeSetOpacityAVX2(CompositeLoadAVX2(&update[i]),
+                                                 opacity));
+    }
+  return i;
+}
+
+static const CompositeKernelInfo
+  composite_avx2_kernel =
+  {
+    "AVX2",
+    OverCompositeAVX2,
+    MultiplyCompositeAVX2,
+    ScreenCompositeAVX2,
+    PlusCompositeAVX2,
+    MinusCompositeAVX2,
+    CopyOpacityCompositeAVX2
+  };
+#endif /* defined(COMPOSITE_AVX2_KERNELS) */
+
+/*
+  Select the best vectorized kernel supported by the CPU, or NULL to
+  use the scalar code.  The MAGICK_COMPOSITE_SIMD environment variable
+  may be set to "scalar" to disable the vectorized kernels.
+*/
+static const CompositeKernelInfo *SelectCompositeKernel(void)
+{
+  const CompositeKernelInfo
+    *kernel = (const CompositeKernelInfo *) NULL;
+
+  const char
+    *limit;
+
+  limit=getenv("MAGICK_COMPOSITE_SIMD");
+  if ((limit != (const char *) NULL) &&
+      ((LocaleCompare(limit,"scalar") == 0) ||
+       (LocaleCompare(limit,"none") == 0) ||
+       (LocaleCompare(limit,"false") == 0)))
+    return kernel;
+#if defined(COMPOSITE_AVX2_KERNELS)
+  if (__builtin_cpu_supports("avx2"))
+    kernel=&composite_avx2_kernel;
+#endif
+  return kernel;
+}
+
+/*
+  Return the vectorized kernel to use for compositing source_image onto
+  update_image, or NULL.  The selection is made once, since it depends
+  only on the CPU and the environment.  A thread racing the first
+  selection may see NULL, which is harmless since the kernels produce
+  the same results as the scalar code.
+*/
+static const CompositeKernelInfo *
+GetCompositeKernel(const Image *source_image,const Image *update_image)
+{
+  static const CompositeKernelInfo
+    *kernel = (const CompositeKernelInfo *) NULL;
+
+  static MagickBool
+    initialized = MagickFalse;
+
+  if ((source_image->colorspace == CMYKColorspace) ||
+      (update_image->colorspace == CMYKColorspace))
+    return (const CompositeKernelInfo *) NULL;
+  if (!initialized)
+    {
+      kernel=SelectCompositeKernel();
+      initialized=MagickTrue;
+    }
+  return kernel;
+}
+
+
 static MagickPassFail
 OverCompositePixels(void *mutable_data,                /* User provided mutable data */
                     const void *immutable_data,        /* User provided immutable data */
@@ -152,6 +776,9 @@ OverCompositePixels(void *mutable_data,                /* User provided mutable
   register long
     i;
 
+  const CompositeKernelInfo
+    *kernel;
+
   PixelPacket
     destination,
     source;
@@ -165,9 +792,23 @@ OverCompositePixels(void *mutable_data,                /* User provided mutable
     opaque areas of change-image obscuring base-image in the
     region of overlap.
   */
-  for (i=0; i < npixels; i++)
+  i=0;
+  kernel=GetCompositeKernel(source_image,update_image);
+  if (kernel != (const CompositeKernelInfo *) NULL)
+    i=kernel->over(source_pixels,source_image->matte,update_pixels,
+                   update_image->matte,npixels);
+  for ( ; i < npixels; i++)
     {
       PrepareSourcePacket(&source,source_pixels,source_image,source_indexes,i);
+      if (source.opacity == OpaqueOpacity)
+        {
+          /*
+            Opaque change pixels replace the canvas pixels without
+            blending.
+          */
+          ApplyPacketUpdates(update_pixels,update_indexes,update_image,&source,i);
+          continue;
+        }
       PrepareDestinationPacket(&destination,update_pixels,update_image,update_indexes,i);
 
       AlphaCompositePixel(&destination,&source,source.opacity,&destination,destination.opacity);
@@ -451,6 +1092,9 @@ PlusCompositePixels(void *mutable_data,                /* User provided mutable
   register long
     i;
 
+  const CompositeKernelInfo
+    *kernel;
+
   PixelPacket
     destination,
     source;
@@ -464,7 +1108,12 @@ PlusCompositePixels(void *mutable_data,                /* User provided mutable
     cropped to MaxRGB (no overflow). This operation is independent of
     the matte channels.
   */
-  for (i=0; i < npixels; i++)
+  i=0;
+  kernel=GetCompositeKernel(source_image,update_image);
+  if (kernel != (const CompositeKernelInfo *) NULL)
+    i=kernel->plus(source_pixels,source_image->matte,update_pixels,
+                   update_image->matte,npixels);
+  for ( ; i < npixels; i++)
     {
       double
         value;
@@ -511,6 +1160,9 @@ MinusCompositePixels(void *mutable_data,                /* User provided mutable
   register long
     i;
 
+  const CompositeKernelInfo
+    *kernel;
+
   PixelPacket
     destination,
     source;
@@ -523,7 +1175,12 @@ MinusCompositePixels(void *mutable_data,                /* User provided mutable
     The result of change-image - base-image, with underflow cropped to
     zero. The matte channel is ignored (set to opaque, full coverage).
   */
-  for (i=0; i < npixels; i++)
+  i=0;
+  kernel=GetCompositeKernel(source_image,update_image);
+  if (kernel != (const CompositeKernelInfo *) NULL)
+    i=kernel->minus(source_pixels,source_image->matte,update_pixels,
+                    update_image->matte,npixels);
+  for ( ; i < npixels; i++)
     {
       double
         value;
@@ -759,6 +1416,9 @@ MultiplyCompositePixels(void *mutable_data,                /* User provided muta
   register long
     i;
 
+  const CompositeKernelInfo
+    *kernel;
+
   PixelPacket
     destination,
     source;
@@ -773,7 +1433,12 @@ MultiplyCompositePixels(void *mutable_data,                /* User provided muta
   */
 
 
-  for (i=0; i < npixels; i++)
+  i=0;
+  kernel=GetCompositeKernel(source_image,update_image);
+  if (kernel != (const CompositeKernelInfo *) NULL)
+    i=kernel->multiply(source_pixels,source_image->matte,update_pixels,
+                       update_image->matte,npixels);
+  for ( ; i < npixels; i++)
     {
       double gamma;
       double source_alpha;
@@ -1078,9 +1743,17 @@ CopyOpacityCompositePixels(void *mutable_data,                /* User provided m
     }
   else
     {
+      const CompositeKernelInfo
+        *kernel;
+
+      i=0;
+      kernel=GetCompositeKernel(source_image,update_image);
+      if (kernel != (const CompositeKernelInfo *) NULL)
+        i=kernel->copy_opacity(source_pixels,source_image->matte,update_pixels,
+                               update_image->matte,npixels);
       if (!source_image->matte)
         {
-          for (i=0; i < npixels; i++)
+          for ( ; i < npixels; i++)
             {
               update_pixels[i].opacity =
                 (Quantum) (MaxRGB-PixelIntensityToQuantum(&source_pixels[i]));
@@ -1088,7 +1761,7 @@ CopyOpacityCompositePixels(void *mutable_data,                /* User provided m
         }
       else
         {
-          for (i=0; i < npixels; i++)
+          for ( ; i < npixels; i++)
             {
               update_pixels[i].opacity = source_pixels[i].opacity;
             }
@@ -1734,6 +2407,9 @@ ScreenCompositePixels(void *mutable_data,                /* User provided mutabl
   register long
     i;
 
+  const CompositeKernelInfo
+    *kernel;
+
   PixelPacket
     destination,
     source;
@@ -1747,7 +2423,12 @@ ScreenCompositePixels(void *mutable_data,                /* User provided mutabl
   */
 
 
-  for (i=0; i < npixels; i++)
+  i=0;
+  kernel=GetCompositeKernel(source_image,update_image);
+  if (kernel != (const CompositeKernelInfo *) NULL)
+    i=kernel->screen(source_pixels,source_image->matte,update_pixels,
+                     update_image->matte,npixels);
+  for ( ; i < npixels; i++)
     {
       double gamma;
       double source_alpha;
@@ -2962,6 +3643,10 @@ HardMixCompositePixels(void *mutable_data,                /* User provided mutab
 %  CompositeImage() composites the second image (composite_image) onto the
 %  first (canvas_image) at the specified offsets.
 %
+%  When the CPU supports it, the Over, Multiply, Screen, Plus, Minus, and
+%  CopyOpacity operators composite four pixels at a time using AVX2, with
+%  the same result as the scalar code.
+%
 %  The format of the CompositeImage method is:
 %
 %      MagickPassFail CompositeImage(Image *canvas_image,
@@ -3172,6 +3857,165 @@ GetCompositionPixelIteratorCallback(const CompositeOperator compose,
   *clear=clear_flag;
   return call_back;
 }
+
+/*
+  Composite Over or Copy on a canvas which uses FloatPixelFormat.  The
+  result is neither rounded nor clamped so that values outside of the
+  quantum range in either image are retained.  CMYK images are not
+  supported here since their opacity is stored in the indexes.
+*/
+static MagickPassFail
+FloatCompositePixels(const CompositeOperator compose,
+                     const char *description,
+                     const unsigned long columns,
+                     const unsigned long rows,
+                     const Image * restrict change_image,
+                     const long change_x,
+                     const long change_y,
+                     Image * restrict canvas_image,
+                     const long canvas_x,
+                     const long canvas_y,
+                     ExceptionInfo *exception)
+{
+  ThreadViewDataSet
+    *change_set,
+    *canvas_set;
+
+  long
+    y;
+
+  unsigned long
+    row_count=0;
+
+  MagickBool
+    monitor_active;
+
+  MagickPassFail
+    status=MagickPass;
+
+  const MagickBool
+    change_matte=change_image->matte,
+    canvas_matte=canvas_image->matte;
+
+  change_set=AllocateThreadViewDataArray(canvas_image,exception,columns,
+                                         sizeof(FloatPixelPacket));
+  canvas_set=AllocateThreadViewDataArray(canvas_image,exception,columns,
+                                         sizeof(FloatPixelPacket));
+  if ((change_set == (ThreadViewDataSet *) NULL) ||
+      (canvas_set == (ThreadViewDataSet *) NULL))
+    {
+      DestroyThreadViewDataSet(change_set);
+      DestroyThreadViewDataSet(canvas_set);
+      return MagickFail;
+    }
+
+  monitor_active=MagickMonitorActive();
+
+#if defined(HAVE_OPENMP)
+#  if defined(TUNE_OPENMP)
+#    pragma omp parallel for schedule(runtime) shared(row_count, status)
+#  else
+#    pragma omp parallel for schedule(static,4) shared(row_count, status)
+#  endif
+#endif
+  for (y=0; y < (long) rows; y++)
+    {
+      FloatPixelPacket
+        * restrict p,
+        * restrict q;
+
+      register long
+        x;
+
+      MagickBool
+        thread_status;
+
+      thread_status=status;
+      if (thread_status == MagickFail)
+        continue;
+
+      p=AccessThreadViewData(change_set);
+      q=AccessThreadViewData(canvas_set);
+      if (!AcquireImageFloatPixels(change_image,change_x,change_y+y,columns,
+                                   1,p,exception))
+        thread_status=MagickFail;
+      if ((thread_status != MagickFail) && (compose == OverCompositeOp))
+        if (!AcquireImageFloatPixels(canvas_image,canvas_x,canvas_y+y,
+                                     columns,1,q,exception))
+          thread_status=MagickFail;
+      if (thread_status != MagickFail)
+        {
+          if (compose == CopyCompositeOp)
+            {
+              (void) memcpy(q,p,columns*sizeof(FloatPixelPacket));
+            }
+          else
+            {
+              for (x=0; x < (long) columns; x++)
+                {
+                  double
+                    canvas_alpha,
+                    change_alpha,
+                    delta;
+
+                  /*
+                    Same as AlphaCompositePixel() but on unclamped floats.
+                  */
+                  change_alpha=(change_matte ? p[x].opacity/MaxRGBDouble : 0.0);
+                  canvas_alpha=(canvas_matte ? q[x].opacity/MaxRGBDouble : 0.0);
+                  if (change_alpha == 1.0)
+                    continue;
+                  delta=1.0-change_alpha*canvas_alpha;
+                  q[x].opacity=(float) (MaxRGBDouble*(1.0-delta));
+                  delta=1.0/(delta <= MagickEpsilon ? 1.0 : delta);
+                  q[x].red=(float) (delta*((1.0-change_alpha)*p[x].red+
+                                           (1.0-canvas_alpha)*q[x].red*
+                                           change_alpha));
+                  q[x].green=(float) (delta*((1.0-change_alpha)*p[x].green+
+                                             (1.0-canvas_alpha)*q[x].green*
+                                             change_alpha));
+                  q[x].blue=(float) (delta*((1.0-change_alpha)*p[x].blue+
+                                            (1.0-canvas_alpha)*q[x].blue*
+                                            change_alpha));
+                }
+            }
+          if (!StoreImageFloatPixels(canvas_image,canvas_x,canvas_y+y,columns,
+                                     1,q,exception))
+            thread_status=MagickFail;
+        }
+
+      if (monitor_active)
+        {
+          unsigned long
+            thread_row_count;
+
+#if defined(HAVE_OPENMP)
+#  pragma omp atomic
+#endif
+          row_count++;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (row_count)
+#endif
+          thread_row_count=row_count;
+          if (QuantumTick(thread_row_count,rows))
+            if (!MagickMonitorFormatted(thread_row_count,rows,exception,
+                                        description,canvas_image->filename))
+              thread_status=MagickFail;
+        }
+
+      if (thread_status == MagickFail)
+        {
+          status=MagickFail;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (status)
+#endif
+        }
+    }
+  DestroyThreadViewDataSet(change_set);
+  DestroyThreadViewDataSet(canvas_set);
+  return status;
+}
+
 MagickExport MagickPassFail
 CompositeImage(Image *canvas_image,
                const CompositeOperator compose,
@@ -3459,18 +4303,37 @@ CompositeImage(Image *canvas_image,
           call_back = (PixelIteratorDualModifyCallback) NULL;
 
         MagickBool
-          clear_pixels = MagickFalse;
+          clear_pixels = MagickFalse,
+          float_pixels;
 
         columns = Min(canvas_image->columns - canvas_x,
                       change_image->columns - composite_x);
         rows = Min(canvas_image->rows - canvas_y,
                    change_image->rows - composite_y);
 
-        call_back=GetCompositionPixelIteratorCallback(compose,
-                                                      canvas_image->matte,
-                                                      change_image->matte,
-                                                      &clear_pixels);
-        if (call_back != (PixelIteratorDualModifyCallback) NULL)
+        float_pixels=(((compose == OverCompositeOp) ||
+                       (compose == CopyCompositeOp)) &&
+                      (canvas_image->colorspace != CMYKColorspace) &&
+                      (change_image->colorspace != CMYKColorspace) &&
+                      (GetImagePixelFormat(canvas_image) == FloatPixelFormat));
+        if (!float_pixels)
+          call_back=GetCompositionPixelIteratorCallback(compose,
+                                                        canvas_image->matte,
+                                                        change_image->matte,
+                                                        &clear_pixels);
+        if (float_pixels)
+          {
+            char
+              description[MaxTextExtent];
+
+            FormatString(description,"[%%s] Composite %s float pixels ...",
+                         CompositeOperatorToString(compose));
+            status=FloatCompositePixels(compose,description,columns,rows,
+                                        change_image,composite_x,composite_y,
+                                        canvas_image,canvas_x,canvas_y,
+                                        &canvas_image->exception);
+          }
+        else if (call_back != (PixelIteratorDualModifyCallback) NULL)
           {
             char
               description[MaxTextExtent];
@@ -0,0 +1,117 @@
+/*
+  Copyright (C) 2026 GraphicsMagick Group
+
+  This program is covered by multiple licenses, which are described in
+  Copyright.txt. You should have received a copy of Copyright.txt with this
+  package; otherwise see http://www.graphicsmagick.org/www/Copyright.html.
+
+  GraphicsMagick Compression Private Methods.
+*/
+
+/*
+  Parallel deflate.  Input is divided into blocks which are compressed
+  concurrently, each primed with the last 32K of the preceding block,
+  and joined using sync flushes into one standard zlib stream.  The
+  compressed stream is passed in order to the writer callback.
+*/
+typedef struct _ParallelDeflateInfo ParallelDeflateInfo;
+
+typedef MagickPassFail
+  (*ParallelDeflateWriter)(void *context,const magick_uint8_t *data,
+                           const size_t length);
+
+/*
+  Return the block size requested via -define <magick>:deflate-block-size,
+  or zero if parallel deflate was not requested.
+*/
+extern MagickExport size_t
+  GetParallelDeflateBlockSize(const ImageInfo *image_info,const char *magick);
+
+extern MagickExport ParallelDeflateInfo
+  *AllocateParallelDeflate(const int level,const int strategy,
+                           const size_t block_size,
+                           ParallelDeflateWriter writer,void *context);
+
+extern MagickExport MagickPassFail
+  ParallelDeflateWrite(ParallelDeflateInfo *info,const magick_uint8_t *data,
+                       size_t length),
+  FinishParallelDeflate(ParallelDeflateInfo *info);
+
+extern MagickExport void
+  DestroyParallelDeflate(ParallelDeflateInfo *info);
+
+/*
+  LZW encoder and decoder.  Codes are at most 12 bits wide.  GIF packs
+  codes least significant bit first and widens them once the string
+  table reaches the next power of two.  TIFF and the PostScript/PDF
+  LZWDecode filter pack codes most significant bit first and widen them
+  one code earlier.
+*/
+typedef enum
+{
+  GIFLZWFlavor,
+  TIFFLZWFlavor
+} LZWFlavor;
+
+typedef struct _LZWEncodeInfo LZWEncodeInfo;
+
+typedef struct _LZWDecodeInfo LZWDecodeInfo;
+
+typedef MagickPassFail
+  (*LZWEncodeWriter)(void *context,const magick_uint8_t *data,
+                     const size_t length);
+
+/*
+  Return up to length bytes of compressed data, or zero at the end of
+  the data.
+*/
+typedef size_t
+  (*LZWDecodeReader)(void *context,magick_uint8_t *data,const size_t length);
+
+/*
+  Allocate an LZW encoder for symbols of data_size bits.  If
+  match_strings is false, every symbol is written as a separate code.
+  If costs is not NULL, it is a 256x256 table of the cost of writing
+  symbol b in place of symbol a at costs[(a << 8) | b], with 255
+  meaning never, and strings which differ from the input by such
+  substitutions are matched when no exact match is in the table.
+*/
+extern MagickExport LZWEncodeInfo
+  *AllocateLZWEncoder(const LZWFlavor flavor,const unsigned int data_size,
+                      const MagickBool match_strings,
+                      const magick_uint8_t *costs,LZWEncodeWriter writer,
+                      void *context);
+
+extern MagickExport MagickPassFail
+  LZWEncode(LZWEncodeInfo *info,const magick_uint8_t *data,
+            const size_t length),
+  FinishLZWEncoder(LZWEncodeInfo *info);
+
+extern MagickExport void
+  DestroyLZWEncoder(LZWEncodeInfo *info);
+
+extern MagickExport LZWDecodeInfo
+  *AllocateLZWDecoder(const LZWFlavor flavor,const unsigned int data_size,
+                      LZWDecodeReader reader,void *context);
+
+/*
+  Decode up to length symbols into data, returning the number decoded.
+  Fewer symbols are returned only at the end of the data, or if the
+  data is corrupt, in which case LZWDecodeStatus() returns MagickFail.
+*/
+extern MagickExport size_t
+  LZWDecode(LZWDecodeInfo *info,magick_uint8_t *data,const size_t length);
+
+extern MagickExport MagickPassFail
+  LZWDecodeStatus(const LZWDecodeInfo *info);
+
+extern MagickExport void
+  DestroyLZWDecoder(LZWDecodeInfo *info);
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * fill-column: 78
+ * End:
+ */
@@ -39,9 +39,14 @@
 #include "magick/studio.h"
 #include "magick/blob.h"
 #include "magick/compress.h"
+#include "magick/compress-private.h"
 #include "magick/monitor.h"
 #include "magick/pixel_cache.h"
+#include "magick/resource.h"
 #include "magick/utility.h"
+#if defined(HasZLIB)
+#  include "zlib.h"
+#endif /* defined(HasZLIB) */
 
 /*
   Define declarations.
@@ -1091,136 +1096,64 @@ ImageToJPEGBlob(const Image *image,const ImageInfo *image_info,
 %
 %
 */
-#define LZWClr  256  /* Clear Table Marker */
-#define LZWEod  257  /* End of Data marker */
-#define OutputCode(code) \
-{ \
-    accumulator+=((long) code) << (32-code_width-number_bits); \
-    number_bits+=code_width; \
-    while (number_bits >= 8) \
-    { \
-        (void) (*write_byte)(image,(magick_uint8_t) (accumulator >> 24),info); \
-        accumulator=accumulator << 8; \
-        number_bits-=8; \
-    } \
-}
-
-MagickExport MagickPassFail LZWEncode2Image(Image *image,
-  const size_t length,magick_uint8_t *pixels,WriteByteHook write_byte,void *info)
+/*
+  Passes LZW encoder output to a WriteByteHook.
+*/
+typedef struct _LZWWriteByteHookInfo
 {
-  typedef struct _TableType
-  {
-    short
-      prefix,
-      suffix,
-      next;
-  } TableType;
+  Image
+    *image;
 
-  int
-    index;
+  WriteByteHook
+    write_byte;
 
-  register long
+  void
+    *info;
+} LZWWriteByteHookInfo;
+
+static MagickPassFail
+LZWWriteByteHook(void *context,const magick_uint8_t *data,
+                 const size_t length)
+{
+  LZWWriteByteHookInfo
+    *hook_info=(LZWWriteByteHookInfo *) context;
+
+  register size_t
     i;
 
-  short
-    number_bits,
-    code_width,
-    last_code,
-    next_index;
+  for (i=0; i < length; i++)
+    (void) (*hook_info->write_byte)(hook_info->image,data[i],hook_info->info);
+  return MagickPass;
+}
 
-  TableType
-    *table;
+MagickExport MagickPassFail LZWEncode2Image(Image *image,
+  const size_t length,magick_uint8_t *pixels,WriteByteHook write_byte,void *info)
+{
+  LZWEncodeInfo
+    *encoder;
 
-  unsigned long
-    accumulator;
+  LZWWriteByteHookInfo
+    hook_info;
+
+  MagickPassFail
+    status;
 
-  /*
-    Allocate string table.
-  */
   assert(image != (Image *) NULL);
   assert(image->signature == MagickSignature);
   assert(pixels != (unsigned char *) NULL);
-  table=MagickAllocateMemory(TableType *,(1 << 12)*sizeof(TableType));
-  if (table == (TableType *) NULL)
-    return(False);
-  /*
-    Initialize variables.
-  */
-  accumulator=0;
-  code_width=9;
-  number_bits=0;
-  last_code=0;
-  OutputCode(LZWClr);
-  for (index=0; index < 256; index++)
-  {
-    table[index].prefix=(-1);
-    table[index].suffix=index;
-    table[index].next=(-1);
-  }
-  next_index=LZWEod+1;
-  code_width=9;
-  last_code=pixels[0];
-  for (i=1; i < (long) length; i++)
-  {
-    /*
-      Find string.
-    */
-    index=last_code;
-    while (index != -1)
-      if ((table[index].prefix != last_code) ||
-          (table[index].suffix != pixels[i]))
-        index=table[index].next;
-      else
-        {
-          last_code=index;
-          break;
-        }
-    if (last_code != index)
-      {
-        /*
-          Add string.
-        */
-        OutputCode(last_code);
-        table[next_index].prefix=last_code;
-        table[next_index].suffix=pixels[i];
-        table[next_index].next=table[last_code].next;
-        table[last_code].next=next_index;
-        next_index++;
-        /*
-          Did we just move up to next bit width?
-        */
-        if ((next_index >> code_width) != 0)
-          {
-            code_width++;
-            if (code_width > 12)
-              {
-                /*
-                  Did we overflow the max bit width?
-                */
-                code_width--;
-                OutputCode(LZWClr);
-                for (index=0; index < 256; index++)
-                {
-                  table[index].prefix=(-1);
-                  table[index].suffix=index;
-                  table[index].next=(-1);
-                }
-                next_index=LZWEod+1;
-                code_width=9;
-              }
-            }
-          last_code=pixels[i];
-      }
-  }
-  /*
-    Flush tables.
-  */
-  OutputCode(last_code);
-  OutputCode(LZWEod);
-  if (number_bits != 0)
-    (void) (*write_byte)(image,(magick_uint8_t)(accumulator >> 24),info);
-  MagickFreeMemory(table);
-  return(MagickPass);
+  hook_info.image=image;
+  hook_info.write_byte=write_byte;
+  hook_info.info=info;
+  encoder=AllocateLZWEncoder(TIFFLZWFlavor,8,MagickTrue,
+                             (const magick_uint8_t *) NULL,
+                             LZWWriteByteHook,&hook_info);
+  if (encoder == (LZWEncodeInfo *) NULL)
+    return(MagickFail);
+  status=LZWEncode(encoder,pixels,length);
+  if (FinishLZWEncoder(encoder) == MagickFail)
+    status=MagickFail;
+  DestroyLZWEncoder(encoder);
+  return(status);
 }
 
 MagickExport MagickPassFail LZWEncodeImage(Image *image, const size_t length,
@@ -1373,3 +1306,1548 @@ MagickExport MagickPassFail PackbitsEncodeImage(Image *image,const size_t length
 {
   return(PackbitsEncode2Image(image,length,pixels,BlobWriteByteHook,(void *)NULL));
 }
+
+#if defined(HasZLIB)
+/*
+  State of a parallel deflate stream.
+*/
+#define ParallelDeflateWindow 32768U
+#define ParallelDeflateMinimumBlock ParallelDeflateWindow
+
+struct _ParallelDeflateInfo
+{
+  int
+    level,
+    strategy;
+
+  unsigned int
+    threads,            /* Number of compression threads */
+    batch;              /* Number of blocks compressed at a time */
+
+  size_t
+    block_size,         /* Uncompressed bytes per block */
+    output_size,        /* Bytes allocated per compressed block */
+    filled,             /* Uncompressed bytes in the batch */
+    dictionary_length;  /* Bytes of input preceding the batch */
+
+  magick_uint8_t
+    *input,             /* Uncompressed batch */
+    *output,            /* Compressed blocks */
+    dictionary[ParallelDeflateWindow];
+
+  size_t
+    *output_length;     /* Compressed length of each block */
+
+  uLong
+    *block_adler,       /* Adler-32 of each block */
+    adler;              /* Adler-32 of the stream so far */
+
+  z_stream
+    *streams;           /* Raw deflate stream of each thread */
+
+  MagickBool
+    *initialized,       /* Deflate stream of thread is initialized */
+    started,            /* zlib header has been written */
+    finished;
+
+  ParallelDeflateWriter
+    writer;
+
+  void
+    *context;
+};
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   G e t P a r a l l e l D e f l a t e B l o c k S i z e                     %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  GetParallelDeflateBlockSize() returns the block size in bytes requested
+%  via -define <magick>:deflate-block-size=<value>, or zero if the define
+%  is not present.  The value may have a 'k' or 'm' suffix, and is raised
+%  to at least 32K.
+%
+%  The format of the GetParallelDeflateBlockSize method is:
+%
+%      size_t GetParallelDeflateBlockSize(const ImageInfo *image_info,
+%                                         const char *magick)
+%
+%  A description of each parameter follows:
+%
+%    o image_info: The image info.
+%
+%    o magick: The format (e.g. "png") which the define applies to.
+%
+*/
+MagickExport size_t
+GetParallelDeflateBlockSize(const ImageInfo *image_info,const char *magick)
+{
+  const char
+    *value;
+
+  char
+    *end;
+
+  double
+    block_size;
+
+  if ((value=AccessDefinition(image_info,magick,"deflate-block-size")) ==
+      (const char *) NULL)
+    return 0;
+  block_size=strtod(value,&end);
+  if ((*end == 'k') || (*end == 'K'))
+    block_size*=1024.0;
+  else if ((*end == 'm') || (*end == 'M'))
+    block_size*=1024.0*1024.0;
+  if (block_size > 256.0*1024.0*1024.0)
+    block_size=256.0*1024.0*1024.0;
+  if (!(block_size >= ParallelDeflateMinimumBlock))
+    block_size=ParallelDeflateMinimumBlock;
+  return (size_t) block_size;
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   A l l o c a t e P a r a l l e l D e f l a t e                             %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  AllocateParallelDeflate() prepares to compress a zlib stream using as
+%  many threads as the threads resource limit allows.  Input passed to
+%  ParallelDeflateWrite() is divided into blocks of block_size bytes which
+%  are compressed concurrently, each primed with the last 32K of input
+%  preceding it.  Blocks end with a sync flush so that their raw deflate
+%  data may be concatenated into one stream.  The stream (including the
+%  zlib header and trailer) is passed in order to the writer callback.
+%  NULL is returned if memory could not be allocated.
+%
+%  The format of the AllocateParallelDeflate method is:
+%
+%      ParallelDeflateInfo *AllocateParallelDeflate(const int level,
+%        const int strategy,const size_t block_size,
+%        ParallelDeflateWriter writer,void *context)
+%
+%  A description of each parameter follows:
+%
+%    o level: The zlib compression level.
+%
+%    o strategy: The zlib compression strategy.
+%
+%    o block_size: The number of uncompressed bytes per block.
+%
+%    o writer: Callback which writes compressed data.
+%
+%    o context: Value passed to the writer callback.
+%
+*/
+MagickExport ParallelDeflateInfo *
+AllocateParallelDeflate(const int level,const int strategy,
+                        const size_t block_size,
+                        ParallelDeflateWriter writer,void *context)
+{
+  ParallelDeflateInfo
+    *info;
+
+  magick_int64_t
+    threads;
+
+  info=MagickAllocateClearedMemory(ParallelDeflateInfo *,
+                                   sizeof(ParallelDeflateInfo));
+  if (info == (ParallelDeflateInfo *) NULL)
+    return info;
+  info->level=level;
+  info->strategy=strategy;
+  info->block_size=Max(block_size,ParallelDeflateMinimumBlock);
+  info->writer=writer;
+  info->context=context;
+  info->adler=adler32(0L,Z_NULL,0);
+  threads=1;
+#if defined(HAVE_OPENMP)
+  threads=GetMagickResourceLimit(ThreadsResource);
+  if (threads > 256)
+    threads=256;
+  if (threads < 1)
+    threads=1;
+#endif
+  info->threads=(unsigned int) threads;
+  info->batch=2*info->threads;
+  /*
+    Room for a block whose data does not compress, plus the sync flush
+    marker.
+  */
+  info->output_size=info->block_size+(info->block_size >> 10)+
+    5*((info->block_size >> 14)+1)+64;
+  info->input=MagickAllocateResourceLimitedArray(magick_uint8_t *,
+                                                 info->batch,info->block_size);
+  info->output=MagickAllocateResourceLimitedArray(magick_uint8_t *,
+                                                  info->batch,
+                                                  info->output_size);
+  info->output_length=MagickAllocateArray(size_t *,info->batch,
+                                          sizeof(size_t));
+  info->block_adler=MagickAllocateArray(uLong *,info->batch,sizeof(uLong));
+  info->streams=MagickAllocateClearedArray(z_stream *,info->threads,
+                                           sizeof(z_stream));
+  info->initialized=MagickAllocateClearedArray(MagickBool *,info->threads,
+                                               sizeof(MagickBool));
+  if ((info->input == (magick_uint8_t *) NULL) ||
+      (info->output == (magick_uint8_t *) NULL) ||
+      (info->output_length == (size_t *) NULL) ||
+      (info->block_adler == (uLong *) NULL) ||
+      (info->streams == (z_stream *) NULL) ||
+      (info->initialized == (MagickBool *) NULL))
+    {
+      DestroyParallelDeflate(info);
+      return (ParallelDeflateInfo *) NULL;
+    }
+  return info;
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   D e s t r o y P a r a l l e l D e f l a t e                               %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  DestroyParallelDeflate() deallocates memory associated with a parallel
+%  deflate stream.  Input which has not been compressed is discarded.
+%
+%  The format of the DestroyParallelDeflate method is:
+%
+%      void DestroyParallelDeflate(ParallelDeflateInfo *info)
+%
+%  A description of each parameter follows:
+%
+%    o info: The parallel deflate stream.
+%
+*/
+MagickExport void
+DestroyParallelDeflate(ParallelDeflateInfo *info)
+{
+  unsigned int
+    i;
+
+  if (info == (ParallelDeflateInfo *) NULL)
+    return;
+  if ((info->streams != (z_stream *) NULL) &&
+      (info->initialized != (MagickBool *) NULL))
+    for (i=0; i < info->threads; i++)
+      if (info->initialized[i])
+        (void) deflateEnd(&info->streams[i]);
+  MagickFreeResourceLimitedMemory(info->input);
+  MagickFreeResourceLimitedMemory(info->output);
+  MagickFreeMemory(info->output_length);
+  MagickFreeMemory(info->block_adler);
+  MagickFreeMemory(info->streams);
+  MagickFreeMemory(info->initialized);
+  MagickFreeMemory(info);
+}
+
+/*
+  Compress the blocks of the current batch concurrently and pass them to
+  the writer.  The last block of the stream is finished rather than
+  flushed if 'final' is set.
+*/
+static MagickPassFail
+CompressParallelDeflateBatch(ParallelDeflateInfo *info,const MagickBool final)
+{
+  long
+    block,
+    blocks;
+
+  MagickPassFail
+    status=MagickPass;
+
+  blocks=(long) ((info->filled+info->block_size-1)/info->block_size);
+  if (final && (blocks == 0))
+    blocks=1;
+#if defined(HAVE_OPENMP)
+#  pragma omp parallel for num_threads(info->threads) schedule(static,1)
+#endif
+  for (block=0; block < blocks; block++)
+    {
+      const magick_uint8_t
+        *data,
+        *dictionary;
+
+      int
+        code,
+        thread;
+
+      size_t
+        dictionary_length,
+        length;
+
+      z_stream
+        *stream;
+
+      MagickPassFail
+        thread_status;
+
+      thread_status=status;
+      if (thread_status == MagickFail)
+        continue;
+
+      thread=omp_get_thread_num();
+      stream=&info->streams[thread];
+      data=info->input+(size_t) block*info->block_size;
+      length=Min(info->block_size,info->filled-(size_t) block*info->block_size);
+      if (block == 0)
+        {
+          dictionary=info->dictionary;
+          dictionary_length=info->dictionary_length;
+        }
+      else
+        {
+          dictionary=data-ParallelDeflateWindow;
+          dictionary_length=ParallelDeflateWindow;
+        }
+      if (!info->initialized[thread])
+        {
+          code=deflateInit2(stream,info->level,Z_DEFLATED,-MAX_WBITS,9,
+                            info->strategy);
+          if (code == Z_OK)
+            info->initialized[thread]=MagickTrue;
+        }
+      else
+        {
+          code=deflateReset(stream);
+        }
+      if ((code == Z_OK) && (dictionary_length != 0))
+        code=deflateSetDictionary(stream,dictionary,(uInt) dictionary_length);
+      if (code == Z_OK)
+        {
+          int
+            flush;
+
+          flush=(final && (block == blocks-1)) ? Z_FINISH : Z_SYNC_FLUSH;
+          stream->next_in=(Bytef *) data;
+          stream->avail_in=(uInt) length;
+          stream->next_out=info->output+(size_t) block*info->output_size;
+          stream->avail_out=(uInt) info->output_size;
+          code=deflate(stream,flush);
+          if (flush == Z_FINISH)
+            code=(code == Z_STREAM_END) ? Z_OK : Z_BUF_ERROR;
+          else if ((stream->avail_in != 0) || (stream->avail_out == 0))
+            code=Z_BUF_ERROR;
+          info->output_length[block]=info->output_size-stream->avail_out;
+          info->block_adler[block]=adler32(adler32(0L,Z_NULL,0),data,
+                                           (uInt) length);
+        }
+      if (code != Z_OK)
+        thread_status=MagickFail;
+
+      if (thread_status == MagickFail)
+        {
+          status=MagickFail;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (status)
+#endif
+        }
+    }
+  if (status == MagickFail)
+    return status;
+  if (!info->started)
+    {
+      int
+        level;
+
+      magick_uint8_t
+        header[2];
+
+      unsigned int
+        level_flags;
+
+      /*
+        zlib header, as produced by deflateInit().
+      */
+      level=(info->level == Z_DEFAULT_COMPRESSION) ? 6 : info->level;
+      if ((info->strategy >= Z_HUFFMAN_ONLY) || (level < 2))
+        level_flags=0;
+      else if (level < 6)
+        level_flags=1;
+      else if (level == 6)
+        level_flags=2;
+      else
+        level_flags=3;
+      header[0]=0x78;
+      header[1]=(magick_uint8_t) (level_flags << 6);
+      header[1]+=(magick_uint8_t) (31-((header[0]*256U+header[1]) % 31));
+      status=(info->writer)(info->context,header,sizeof(header));
+      info->started=MagickTrue;
+    }
+  for (block=0; (status != MagickFail) && (block < blocks); block++)
+    {
+      size_t
+        length;
+
+      length=Min(info->block_size,info->filled-(size_t) block*info->block_size);
+      info->adler=adler32_combine(info->adler,info->block_adler[block],
+                                  (z_off_t) length);
+      status=(info->writer)(info->context,
+                            info->output+(size_t) block*info->output_size,
+                            info->output_length[block]);
+    }
+  if (info->filled >= ParallelDeflateWindow)
+    {
+      info->dictionary_length=ParallelDeflateWindow;
+      (void) memcpy(info->dictionary,info->input+info->filled-
+                    ParallelDeflateWindow,ParallelDeflateWindow);
+    }
+  info->filled=0;
+  return status;
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   P a r a l l e l D e f l a t e W r i t e                                   %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  ParallelDeflateWrite() adds data to a parallel deflate stream.  Data
+%  is compressed (and passed to the writer) once enough has been added to
+%  keep all threads busy.
+%
+%  The format of the ParallelDeflateWrite method is:
+%
+%      MagickPassFail ParallelDeflateWrite(ParallelDeflateInfo *info,
+%        const magick_uint8_t *data,size_t length)
+%
+%  A description of each parameter follows:
+%
+%    o info: The parallel deflate stream.
+%
+%    o data: The data to compress.
+%
+%    o length: The number of bytes to compress.
+%
+*/
+MagickExport MagickPassFail
+ParallelDeflateWrite(ParallelDeflateInfo *info,const magick_uint8_t *data,
+                     size_t length)
+{
+  MagickPassFail
+    status=MagickPass;
+
+  if (info->finished)
+    return MagickFail;
+  while ((length != 0) && (status != MagickFail))
+    {
+      size_t
+        count;
+
+      count=Min(length,(size_t) info->batch*info->block_size-info->filled);
+      (void) memcpy(info->input+info->filled,data,count);
+      info->filled+=count;
+      data+=count;
+      length-=count;
+      /*
+        The batch is only compressed once more data arrives, since the
+        last block of the stream must be finished rather than flushed.
+      */
+      if ((length != 0) && (info->filled == (size_t) info->batch*info->block_size))
+        status=CompressParallelDeflateBatch(info,MagickFalse);
+    }
+  return status;
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   F i n i s h P a r a l l e l D e f l a t e                                 %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  FinishParallelDeflate() compresses any remaining data, and writes the
+%  end of the stream and the zlib trailer.
+%
+%  The format of the FinishParallelDeflate method is:
+%
+%      MagickPassFail FinishParallelDeflate(ParallelDeflateInfo *info)
+%
+%  A description of each parameter follows:
+%
+%    o info: The parallel deflate stream.
+%
+*/
+MagickExport MagickPassFail
+FinishParallelDeflate(ParallelDeflateInfo *info)
+{
+  magick_uint8_t
+    trailer[4];
+
+  MagickPassFail
+    status;
+
+  if (info->finished)
+    return MagickFail;
+  info->finished=MagickTrue;
+  status=CompressParallelDeflateBatch(info,MagickTrue);
+  if (status != MagickFail)
+    {
+      trailer[0]=(magick_uint8_t) (info->adler >> 24);
+      trailer[1]=(magick_uint8_t) (info->adler >> 16);
+      trailer[2]=(magick_uint8_t) (info->adler >> 8);
+      trailer[3]=(magick_uint8_t) info->adler;
+      status=(info->writer)(info->context,trailer,sizeof(trailer));
+    }
+  return status;
+}
+#endif /* defined(HasZLIB) */
+
+/*
+  State of an LZW encoder or decoder.
+*/
+#define LZWMaximumBits 12U
+#define LZWTableSize (1U << LZWMaximumBits)
+#define LZWHashBits 13U
+#define LZWHashSize (1U << LZWHashBits)
+#define LZWNullCode 0xFFFFU
+#define LZWBufferSize 4096U
+#define LZWWindowSize 65536U
+#define LZWWindowKeep 16384U
+#define LZWNullPosition (~(magick_uint32_t) 0U)
+
+struct _LZWEncodeInfo
+{
+  LZWFlavor
+    flavor;
+
+  unsigned int
+    data_size,          /* Bits per symbol */
+    clear_code,
+    end_code,
+    next_code,          /* Next free string table entry */
+    code_width,         /* Bits per code */
+    waiting_code,       /* String matched so far */
+    bits;               /* Bits held in accumulator */
+
+  magick_uint32_t
+    accumulator;
+
+  MagickBool
+    match_strings,
+    finished;
+
+  MagickPassFail
+    status;
+
+  const magick_uint8_t
+    *costs;             /* Symbol substitution costs */
+
+  magick_uint32_t
+    hash[LZWHashSize],          /* String prefix, suffix, and code */
+    last_child[LZWTableSize];   /* Suffix and code of string last matched */
+
+  magick_uint16_t
+    first_child[LZWTableSize],  /* Most recent string extending entry */
+    next_sibling[LZWTableSize]; /* Next string with the same prefix */
+
+  magick_uint8_t
+    suffix[LZWTableSize],
+    output[LZWBufferSize];
+
+  size_t
+    output_length;
+
+  LZWEncodeWriter
+    writer;
+
+  void
+    *context;
+};
+
+typedef struct _LZWString
+{
+  magick_uint32_t
+    position;           /* Window offset of the string less its last symbol */
+
+  magick_uint16_t
+    prefix,             /* Code of the string less its last symbol */
+    length;
+
+  magick_uint8_t
+    suffix,             /* Last symbol */
+    first;              /* First symbol */
+} LZWString;
+
+struct _LZWDecodeInfo
+{
+  LZWFlavor
+    flavor;
+
+  unsigned int
+    data_size,          /* Bits per symbol */
+    clear_code,
+    end_code,
+    next_code,          /* Next free string table entry */
+    code_width,         /* Bits per code */
+    early_change,       /* Widen codes this many entries early */
+    old_code,           /* Previous code */
+    bits;               /* Bits held in accumulator */
+
+  magick_uint32_t
+    accumulator,
+    old_position,       /* Window offset of the previous string */
+    window_length,      /* Symbols decoded into the window */
+    window_offset;      /* Symbols of the window returned */
+
+  MagickBool
+    finished;
+
+  MagickPassFail
+    status;
+
+  LZWString
+    table[LZWTableSize];
+
+  magick_uint8_t
+    input[LZWBufferSize],
+    window[LZWWindowSize];      /* Recently decoded symbols */
+
+  size_t
+    input_length,
+    input_offset;
+
+  LZWDecodeReader
+    reader;
+
+  void
+    *context;
+};
+
+static inline unsigned int
+LZWHash(const magick_uint32_t key)
+{
+  return (unsigned int) (((magick_uint32_t) (key*0x9E3779B1U)) >>
+                         (32U-LZWHashBits));
+}
+
+static void
+ResetLZWEncoder(LZWEncodeInfo *info)
+{
+  unsigned int
+    code;
+
+  if (info->match_strings)
+    {
+      (void) memset(info->hash,0,sizeof(info->hash));
+      (void) memset(info->last_child,0xff,sizeof(info->last_child));
+    }
+  for (code=0; code < info->clear_code; code++)
+    info->first_child[code]=LZWNullCode;
+  info->next_code=info->clear_code+2;
+  info->code_width=info->data_size+1;
+}
+
+static inline void
+LZWPutByte(LZWEncodeInfo *info,const unsigned int byte)
+{
+  info->output[info->output_length++]=(magick_uint8_t) byte;
+  if (info->output_length == LZWBufferSize)
+    {
+      if (info->status != MagickFail)
+        info->status=(info->writer)(info->context,info->output,
+                                    info->output_length);
+      info->output_length=0;
+    }
+}
+
+static inline void
+LZWPutCode(LZWEncodeInfo *info,const unsigned int code)
+{
+  if (info->flavor == GIFLZWFlavor)
+    {
+      info->accumulator|=(magick_uint32_t) code << info->bits;
+      info->bits+=info->code_width;
+      while (info->bits >= 8)
+        {
+          LZWPutByte(info,info->accumulator & 0xff);
+          info->accumulator>>=8;
+          info->bits-=8;
+        }
+    }
+  else
+    {
+      info->accumulator=(info->accumulator << info->code_width) | code;
+      info->bits+=info->code_width;
+      while (info->bits >= 8)
+        {
+          info->bits-=8;
+          LZWPutByte(info,(info->accumulator >> info->bits) & 0xff);
+        }
+      info->accumulator&=(1U << info->bits)-1U;
+    }
+}
+
+static inline void
+LZWAddString(LZWEncodeInfo *info,const unsigned int code,
+             const unsigned int prefix,const unsigned int suffix,
+             const unsigned int slot)
+{
+  if (info->match_strings)
+    info->hash[slot]=(((prefix << 8) | suffix) << LZWMaximumBits) | code;
+  if (info->costs != (const magick_uint8_t *) NULL)
+    {
+      info->suffix[code]=(magick_uint8_t) suffix;
+      info->first_child[code]=LZWNullCode;
+      info->next_sibling[code]=info->first_child[prefix];
+      info->first_child[prefix]=(magick_uint16_t) code;
+    }
+}
+
+/*
+  Append a code to the output of LZWEncode(), whose state is held in
+  local variables.
+*/
+#define LZWOutputCode(code) \
+{ \
+  if (flavor == GIFLZWFlavor) \
+    { \
+      accumulator|=(magick_uint32_t) (code) << bits; \
+      bits+=code_width; \
+      while (bits >= 8) \
+        { \
+          *q++=(magick_uint8_t) accumulator; \
+          accumulator>>=8; \
+          bits-=8; \
+        } \
+    } \
+  else \
+    { \
+      accumulator=(accumulator << code_width) | (code); \
+      bits+=code_width; \
+      while (bits >= 8) \
+        { \
+          bits-=8; \
+          *q++=(magick_uint8_t) (accumulator >> bits); \
+        } \
+      accumulator&=(1U << bits)-1U; \
+    } \
+  if (q >= q_limit) \
+    { \
+      if (info->status != MagickFail) \
+        info->status=(info->writer)(info->context,info->output, \
+                                    (size_t) (q-info->output)); \
+      q=info->output; \
+    } \
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   A l l o c a t e L Z W E n c o d e r                                       %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  AllocateLZWEncoder() allocates an LZW encoder for symbols of data_size
+%  bits.  Strings are found via a hash of their prefix and suffix, and the
+%  string last matched after each string is remembered, so that runs of
+%  repeated content cost one table lookup per symbol.  Compressed data is
+%  passed to the writer callback in chunks of up to 4K.  NULL is returned
+%  if memory could not be allocated.
+%
+%  If costs is not NULL, LZWEncode() may write a string from the table
+%  which differs from the input when the table holds no exact match.  The
+%  string chosen extends the string matched so far by the symbol which
+%  costs the least to substitute for the input symbol, according to
+%  costs[(input << 8) | substitute].  A cost of 255 forbids the
+%  substitution.  Longer strings are matched this way, trading accuracy
+%  for smaller output.
+%
+%  The format of the AllocateLZWEncoder method is:
+%
+%      LZWEncodeInfo *AllocateLZWEncoder(const LZWFlavor flavor,
+%        const unsigned int data_size,const MagickBool match_strings,
+%        const magick_uint8_t *costs,LZWEncodeWriter writer,void *context)
+%
+%  A description of each parameter follows:
+%
+%    o flavor: GIFLZWFlavor or TIFFLZWFlavor.
+%
+%    o data_size: The number of bits per symbol (2 to 8).  TIFF uses 8.
+%
+%    o match_strings: If MagickFalse, each symbol is written as its own
+%      code.
+%
+%    o costs: NULL, or a 256x256 table of symbol substitution costs.
+%
+%    o writer: Callback which writes compressed data.
+%
+%    o context: Value passed to the writer callback.
+%
+*/
+MagickExport LZWEncodeInfo *
+AllocateLZWEncoder(const LZWFlavor flavor,const unsigned int data_size,
+                   const MagickBool match_strings,
+                   const magick_uint8_t *costs,LZWEncodeWriter writer,
+                   void *context)
+{
+  LZWEncodeInfo
+    *info;
+
+  if ((data_size < 2) || (data_size > 8))
+    return (LZWEncodeInfo *) NULL;
+  info=MagickAllocateMemory(LZWEncodeInfo *,sizeof(LZWEncodeInfo));
+  if (info == (LZWEncodeInfo *) NULL)
+    return info;
+  info->flavor=flavor;
+  info->data_size=data_size;
+  info->clear_code=1U << data_size;
+  info->end_code=info->clear_code+1;
+  info->waiting_code=LZWNullCode;
+  info->bits=0;
+  info->accumulator=0;
+  info->match_strings=match_strings;
+  info->finished=MagickFalse;
+  info->status=MagickPass;
+  info->costs=(match_strings ? costs : (const magick_uint8_t *) NULL);
+  info->output_length=0;
+  info->writer=writer;
+  info->context=context;
+  ResetLZWEncoder(info);
+  LZWPutCode(info,info->clear_code);
+  return info;
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   L Z W E n c o d e                                                         %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  LZWEncode() compresses symbols.  It may be called any number of times
+%  before FinishLZWEncoder().
+%
+%  The format of the LZWEncode method is:
+%
+%      MagickPassFail LZWEncode(LZWEncodeInfo *info,
+%        const magick_uint8_t *data,const size_t length)
+%
+%  A description of each parameter follows:
+%
+%    o info: The LZW encoder.
+%
+%    o data: The symbols to compress.
+%
+%    o length: The number of symbols.
+%
+*/
+MagickExport MagickPassFail
+LZWEncode(LZWEncodeInfo *info,const magick_uint8_t *data,const size_t length)
+{
+  const magick_uint8_t
+    *costs;
+
+  LZWFlavor
+    flavor;
+
+  magick_uint8_t
+    *q,
+    *q_limit;
+
+  magick_uint32_t
+    accumulator,
+    entry,
+    key,
+    *hash,
+    *last_child;
+
+  MagickBool
+    clear,
+    match_strings,
+    matched;
+
+  register size_t
+    i;
+
+  unsigned int
+    best_cost,
+    best_code,
+    bits,
+    code,
+    code_width,
+    cost,
+    next_code,
+    slot,
+    symbol,
+    waiting;
+
+  if (info->finished)
+    return MagickFail;
+  flavor=info->flavor;
+  match_strings=info->match_strings;
+  costs=info->costs;
+  hash=info->hash;
+  last_child=info->last_child;
+  waiting=info->waiting_code;
+  next_code=info->next_code;
+  code_width=info->code_width;
+  accumulator=info->accumulator;
+  bits=info->bits;
+  q=info->output+info->output_length;
+  q_limit=info->output+LZWBufferSize-4;
+  slot=0;
+  i=0;
+  if ((waiting == LZWNullCode) && (length != 0))
+    waiting=data[i++];
+  for ( ; i < length; i++)
+    {
+      symbol=data[i];
+      if (match_strings)
+        {
+          /*
+            Find the string extended by this symbol.
+          */
+          entry=last_child[waiting];
+          if ((entry >> LZWMaximumBits) == symbol)
+            {
+              waiting=entry & (LZWTableSize-1);
+              continue;
+            }
+          matched=MagickFalse;
+          key=(waiting << 8) | symbol;
+          for (slot=LZWHash(key); (entry=hash[slot]) != 0;
+               slot=(slot+1) & (LZWHashSize-1))
+            if ((entry >> LZWMaximumBits) == key)
+              {
+                matched=MagickTrue;
+                break;
+              }
+          if (matched)
+            {
+              last_child[waiting]=(symbol << LZWMaximumBits) |
+                (entry & (LZWTableSize-1));
+              waiting=entry & (LZWTableSize-1);
+              continue;
+            }
+          if (costs != (const magick_uint8_t *) NULL)
+            {
+              /*
+                Find the closest string extended by another symbol.
+              */
+              best_code=LZWNullCode;
+              best_cost=255;
+              for (code=info->first_child[waiting]; code != LZWNullCode;
+                   code=info->next_sibling[code])
+                {
+                  cost=costs[(symbol << 8) | info->suffix[code]];
+                  if (cost < best_cost)
+                    {
+                      best_cost=cost;
+                      best_code=code;
+                    }
+                }
+              if (best_code != LZWNullCode)
+                {
+                  waiting=best_code;
+                  continue;
+                }
+            }
+        }
+      /*
+        Write the string and add it extended by this symbol to the table.
+        GIF widens codes before adding, TIFF after, and TIFF starts over
+        rather than fill the last table entry.
+      */
+      LZWOutputCode(waiting);
+      clear=MagickFalse;
+      if (flavor == GIFLZWFlavor)
+        {
+          if ((next_code == (1U << code_width)) &&
+              (code_width < LZWMaximumBits))
+            code_width++;
+          if (next_code < LZWTableSize)
+            LZWAddString(info,next_code++,waiting,symbol,slot);
+          else
+            clear=MagickTrue;
+        }
+      else
+        {
+          LZWAddString(info,next_code++,waiting,symbol,slot);
+          if ((next_code >> code_width) != 0)
+            {
+              if (code_width < LZWMaximumBits)
+                code_width++;
+              else
+                clear=MagickTrue;
+            }
+        }
+      if (clear)
+        {
+          LZWOutputCode(info->clear_code);
+          ResetLZWEncoder(info);
+          next_code=info->next_code;
+          code_width=info->code_width;
+        }
+      waiting=symbol;
+    }
+  info->waiting_code=waiting;
+  info->next_code=next_code;
+  info->code_width=code_width;
+  info->accumulator=accumulator;
+  info->bits=bits;
+  info->output_length=(size_t) (q-info->output);
+  return info->status;
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   F i n i s h L Z W E n c o d e r                                           %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  FinishLZWEncoder() writes the pending string, the end of information
+%  code, and any buffered data.
+%
+%  The format of the FinishLZWEncoder method is:
+%
+%      MagickPassFail FinishLZWEncoder(LZWEncodeInfo *info)
+%
+%  A description of each parameter follows:
+%
+%    o info: The LZW encoder.
+%
+*/
+MagickExport MagickPassFail
+FinishLZWEncoder(LZWEncodeInfo *info)
+{
+  if (info->finished)
+    return MagickFail;
+  info->finished=MagickTrue;
+  if (info->waiting_code != LZWNullCode)
+    {
+      LZWPutCode(info,info->waiting_code);
+      if ((info->flavor == GIFLZWFlavor) &&
+          (info->next_code == (1U << info->code_width)) &&
+          (info->code_width < LZWMaximumBits))
+        info->code_width++;
+    }
+  LZWPutCode(info,info->end_code);
+  if (info->bits != 0)
+    {
+      if (info->flavor == GIFLZWFlavor)
+        LZWPutByte(info,info->accumulator & 0xff);
+      else
+        LZWPutByte(info,(info->accumulator << (8-info->bits)) & 0xff);
+      info->bits=0;
+    }
+  if ((info->output_length != 0) && (info->status != MagickFail))
+    info->status=(info->writer)(info->context,info->output,
+                                info->output_length);
+  info->output_length=0;
+  return info->status;
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   D e s t r o y L Z W E n c o d e r                                         %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  DestroyLZWEncoder() releases an LZW encoder.
+%
+%  The format of the DestroyLZWEncoder method is:
+%
+%      void DestroyLZWEncoder(LZWEncodeInfo *info)
+%
+%  A description of each parameter follows:
+%
+%    o info: The LZW encoder.
+%
+*/
+MagickExport void
+DestroyLZWEncoder(LZWEncodeInfo *info)
+{
+  MagickFreeMemory(info);
+}
+
+static void
+ResetLZWDecoder(LZWDecodeInfo *info)
+{
+  info->next_code=info->clear_code+2;
+  info->code_width=info->data_size+1;
+  info->old_code=LZWNullCode;
+}
+
+/*
+  Discard all but the most recent symbols in the window.
+*/
+static void
+SlideLZWWindow(LZWDecodeInfo *info)
+{
+  magick_uint32_t
+    delta;
+
+  unsigned int
+    code;
+
+  delta=info->window_length-LZWWindowKeep;
+  (void) memmove(info->window,info->window+delta,LZWWindowKeep);
+  for (code=info->clear_code+2; code < LZWTableSize; code++)
+    if (info->table[code].position != LZWNullPosition)
+      {
+        if (info->table[code].position >= delta)
+          info->table[code].position-=delta;
+        else
+          info->table[code].position=LZWNullPosition;
+      }
+  info->old_position-=delta;
+  info->window_length-=delta;
+  info->window_offset-=delta;
+}
+
+/*
+  Decode strings into the window until it holds at least needed more
+  symbols.  A string is copied from where it, or its prefix, was last
+  decoded if that is still in the window.
+*/
+static void
+DecodeLZWStrings(LZWDecodeInfo *info,const size_t needed)
+{
+  const magick_uint8_t
+    *p,
+    *p_end;
+
+  LZWFlavor
+    flavor;
+
+  LZWString
+    *table;
+
+  magick_uint32_t
+    accumulator,
+    old_position,
+    window_limit,
+    window_target;
+
+  MagickBool
+    finished;
+
+  register magick_uint8_t
+    *q;
+
+  register const magick_uint8_t
+    *r;
+
+  register unsigned int
+    i;
+
+  magick_uint8_t
+    block[16];
+
+  size_t
+    count;
+
+  unsigned int
+    bits,
+    clear_code,
+    code,
+    code_width,
+    early_change,
+    end_code,
+    next_code,
+    old_code,
+    string_code,
+    string_length,
+    w;
+
+  flavor=info->flavor;
+  table=info->table;
+  clear_code=info->clear_code;
+  end_code=info->end_code;
+  early_change=info->early_change;
+  finished=info->finished;
+  accumulator=info->accumulator;
+  bits=info->bits;
+  code_width=info->code_width;
+  next_code=info->next_code;
+  old_code=info->old_code;
+  old_position=info->old_position;
+  p=info->input+info->input_offset;
+  p_end=info->input+info->input_length;
+  w=info->window_length;
+  window_limit=LZWWindowSize-LZWTableSize;
+  window_target=w+(magick_uint32_t) Min(needed,LZWWindowSize);
+  while ((w < window_target) && (w <= window_limit) && !finished)
+    {
+      /*
+        Get the next code, reading more data only when its bits are
+        needed.
+      */
+      while (bits < code_width)
+        {
+          if (p == p_end)
+            {
+              count=(info->reader)(info->context,info->input,
+                                   sizeof(info->input));
+              if (count == 0)
+                break;
+              p=info->input;
+              p_end=p+count;
+            }
+          do
+            {
+              if (flavor == GIFLZWFlavor)
+                accumulator|=(magick_uint32_t) (*p++) << bits;
+              else
+                accumulator=(accumulator << 8) | (*p++);
+              bits+=8;
+            } while ((bits <= 24) && (p != p_end));
+        }
+      if (bits < code_width)
+        {
+          finished=MagickTrue;
+          break;
+        }
+      bits-=code_width;
+      if (flavor == GIFLZWFlavor)
+        {
+          code=accumulator & ((1U << code_width)-1U);
+          accumulator>>=code_width;
+        }
+      else
+        {
+          code=accumulator >> bits;
+          accumulator&=(1U << bits)-1U;
+        }
+      /*
+        Interpret the code.
+      */
+      if (code == end_code)
+        {
+          finished=MagickTrue;
+          break;
+        }
+      if (code == clear_code)
+        {
+          next_code=clear_code+2;
+          code_width=info->data_size+1;
+          old_code=LZWNullCode;
+          continue;
+        }
+      if (old_code == LZWNullCode)
+        {
+          if (code > clear_code)
+            {
+              info->status=MagickFail;
+              finished=MagickTrue;
+              break;
+            }
+          old_code=code;
+          old_position=w;
+          info->window[w++]=(magick_uint8_t) code;
+          continue;
+        }
+      if (next_code < LZWTableSize)
+        {
+          /*
+            Add the previous string extended by the first symbol of this
+            one.
+          */
+          string_code=code;
+          if (code > next_code)
+            {
+              info->status=MagickFail;
+              finished=MagickTrue;
+              break;
+            }
+          if (code == next_code)
+            string_code=old_code;
+          table[next_code].position=old_position;
+          table[next_code].prefix=(magick_uint16_t) old_code;
+          table[next_code].length=table[old_code].length+1;
+          table[next_code].suffix=table[string_code].first;
+          table[next_code].first=table[old_code].first;
+          next_code++;
+          if (((next_code+early_change) >= (1U << code_width)) &&
+              (code_width < LZWMaximumBits))
+            code_width++;
+        }
+      old_code=code;
+      old_position=w;
+      /*
+        Copy the string to the window.
+      */
+      q=info->window+w;
+      string_length=table[code].length;
+      w+=string_length;
+      if (string_length > 1)
+        {
+          if (table[code].position != LZWNullPosition)
+            {
+              r=info->window+table[code].position;
+              if (string_length <= sizeof(block))
+                {
+                  /*
+                    Copy short strings as a fixed size block.  The
+                    window always has room past the string.
+                  */
+                  (void) memcpy(block,r,sizeof(block));
+                  (void) memcpy(q,block,sizeof(block));
+                }
+              else
+                (void) memcpy(q,r,string_length-1);
+              q+=string_length-1;
+            }
+          else
+            {
+              string_code=table[code].prefix;
+              q+=string_length-1;
+              for (i=string_length-1; i != 0; i--)
+                {
+                  *--q=table[string_code].suffix;
+                  string_code=table[string_code].prefix;
+                }
+              q+=string_length-1;
+            }
+          table[code].position=old_position;
+        }
+      *q=table[code].suffix;
+    }
+  info->finished=finished;
+  info->accumulator=accumulator;
+  info->bits=bits;
+  info->code_width=code_width;
+  info->next_code=next_code;
+  info->old_code=old_code;
+  info->old_position=old_position;
+  info->input_offset=(size_t) (p-info->input);
+  info->input_length=(size_t) (p_end-info->input);
+  info->window_length=w;
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   A l l o c a t e L Z W D e c o d e r                                       %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  AllocateLZWDecoder() allocates an LZW decoder for symbols of data_size
+%  bits.  Decoded symbols pass through a 64K window, and the string table
+%  records where in the window each string was last decoded, so that a
+%  whole string is copied per code rather than gathered one symbol at a
+%  time.  Compressed data is requested from the reader callback only when
+%  the bits of the next code are needed.  NULL is returned if memory could
+%  not be allocated.
+%
+%  The format of the AllocateLZWDecoder method is:
+%
+%      LZWDecodeInfo *AllocateLZWDecoder(const LZWFlavor flavor,
+%        const unsigned int data_size,LZWDecodeReader reader,void *context)
+%
+%  A description of each parameter follows:
+%
+%    o flavor: GIFLZWFlavor or TIFFLZWFlavor.
+%
+%    o data_size: The number of bits per symbol (1 to 8).  TIFF uses 8.
+%
+%    o reader: Callback which reads compressed data.
+%
+%    o context: Value passed to the reader callback.
+%
+*/
+MagickExport LZWDecodeInfo *
+AllocateLZWDecoder(const LZWFlavor flavor,const unsigned int data_size,
+                   LZWDecodeReader reader,void *context)
+{
+  LZWDecodeInfo
+    *info;
+
+  unsigned int
+    code;
+
+  if ((data_size < 1) || (data_size > 8))
+    return (LZWDecodeInfo *) NULL;
+  info=MagickAllocateMemory(LZWDecodeInfo *,sizeof(LZWDecodeInfo));
+  if (info == (LZWDecodeInfo *) NULL)
+    return info;
+  info->flavor=flavor;
+  info->data_size=data_size;
+  info->clear_code=1U << data_size;
+  info->end_code=info->clear_code+1;
+  info->early_change=(flavor == TIFFLZWFlavor ? 1U : 0U);
+  info->bits=0;
+  info->accumulator=0;
+  info->old_position=0;
+  info->window_length=0;
+  info->window_offset=0;
+  info->finished=MagickFalse;
+  info->status=MagickPass;
+  info->input_length=0;
+  info->input_offset=0;
+  info->reader=reader;
+  info->context=context;
+  for (code=0; code < info->clear_code; code++)
+    {
+      info->table[code].position=LZWNullPosition;
+      info->table[code].prefix=LZWNullCode;
+      info->table[code].length=1;
+      info->table[code].suffix=(magick_uint8_t) code;
+      info->table[code].first=(magick_uint8_t) code;
+    }
+  ResetLZWDecoder(info);
+  return info;
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   L Z W D e c o d e                                                         %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  LZWDecode() decompresses up to length symbols and returns the number
+%  decompressed.  Fewer symbols are returned only at the end of the data
+%  or if the data is corrupt, which may be told apart via
+%  LZWDecodeStatus().
+%
+%  The format of the LZWDecode method is:
+%
+%      size_t LZWDecode(LZWDecodeInfo *info,magick_uint8_t *data,
+%        const size_t length)
+%
+%  A description of each parameter follows:
+%
+%    o info: The LZW decoder.
+%
+%    o data: The decompressed symbols are returned here.
+%
+%    o length: The number of symbols to decompress.
+%
+*/
+MagickExport size_t
+LZWDecode(LZWDecodeInfo *info,magick_uint8_t *data,const size_t length)
+{
+  size_t
+    count,
+    n;
+
+  count=0;
+  for ( ; ; )
+    {
+      if (info->window_offset < info->window_length)
+        {
+          n=Min((size_t) (info->window_length-info->window_offset),
+                length-count);
+          (void) memcpy(data+count,info->window+info->window_offset,n);
+          info->window_offset+=(magick_uint32_t) n;
+          count+=n;
+        }
+      if ((count == length) || info->finished)
+        break;
+      if (info->window_length > LZWWindowSize-LZWTableSize)
+        SlideLZWWindow(info);
+      DecodeLZWStrings(info,length-count);
+    }
+  return count;
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   L Z W D e c o d e S t a t u s                                             %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  LZWDecodeStatus() returns MagickFail if the decoder has met corrupt
+%  data.
+%
+%  The format of the LZWDecodeStatus method is:
+%
+%      MagickPassFail LZWDecodeStatus(const LZWDecodeInfo *info)
+%
+%  A description of each parameter follows:
+%
+%    o info: The LZW decoder.
+%
+*/
+MagickExport MagickPassFail
+LZWDecodeStatus(const LZWDecodeInfo *info)
+{
+  return info->status;
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   D e s t r o y L Z W D e c o d e r                                         %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  DestroyLZWDecoder() releases an LZW decoder.
+%
+%  The format of the DestroyLZWDecoder method is:
+%
+%      void DestroyLZWDecoder(LZWDecodeInfo *info)
+%
+%  A description of each parameter follows:
+%
+%    o info: The LZW decoder.
+%
+*/
+MagickExport void
+DestroyLZWDecoder(LZWDecodeInfo *info)
+{
+  MagickFreeMemory(info);
+}
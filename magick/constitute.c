@@ -47,6 +47,7 @@
 #include "magick/attribute.h"
 #include "magick/blob.h"
 #include "magick/colormap.h"
+#include "magick/colorspace.h"
 #include "magick/constitute.h"
 #include "magick/delegate.h"
 #include "magick/describe.h"
@@ -1339,6 +1340,145 @@ InitializeConstitute(void)
   return MagickPass;
 }
 
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   I s I m a g e S t r e a m a b l e                                         %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  IsImageStreamable() tests whether the image described by read_info may be
+%  converted to the file described by write_info with StreamImage(), without
+%  holding the whole image in memory.  This requires an input file which
+%  holds a single frame (or of which the first frame is requested), stored
+%  with interleaved samples and read by a decoder which supports a stream
+%  pixel cache, and an output format with a row streaming encoder which
+%  supports the output settings.  The input is pinged to check this.  As a
+%  side effect, the format of read_info is resolved as if by ReadImage(),
+%  which may copy standard input or a pipe to a temporary file (otherwise
+%  they are not streamable).  Pass the same read_info to StreamImage(), or
+%  to ReadImage() if the image is not streamable.
+%
+%  The format of the IsImageStreamable method is:
+%
+%      MagickBool IsImageStreamable(ImageInfo *read_info,
+%        const ImageInfo *write_info,ExceptionInfo *exception)
+%
+%  A description of each parameter follows:
+%
+%    o read_info: The input image info.
+%
+%    o write_info: The output image info.
+%
+%    o exception: Return any errors or warnings in this structure.
+%
+%
+*/
+MagickExport MagickBool IsImageStreamable(ImageInfo *read_info,
+  const ImageInfo *write_info,ExceptionInfo *exception)
+{
+  const MagickInfo
+    *magick_info;
+
+  ImageInfo
+    *clone_info;
+
+  MagickBool
+    streamable;
+
+  assert(read_info != (ImageInfo *) NULL);
+  assert(read_info->signature == MagickSignature);
+  assert(write_info != (const ImageInfo *) NULL);
+  assert(write_info->signature == MagickSignature);
+  assert(exception != (ExceptionInfo *) NULL);
+  if ((*read_info->filename == '@') || read_info->ping)
+    return(MagickFalse);
+  if (SetImageInfo(read_info,SETMAGICK_READ,exception) == MagickFail)
+    return(MagickFalse);
+  /*
+    Only the first frame may be selected, and no region.
+  */
+  if ((read_info->subimage != 0) || (read_info->subrange > 1) ||
+      ((read_info->tile != (char *) NULL) &&
+       !IsSubimage(read_info->tile,False)))
+    return(MagickFalse);
+  magick_info=GetMagickInfo(read_info->magick,exception);
+  if ((magick_info == (const MagickInfo *) NULL) ||
+      (magick_info->decoder == (DecoderHandler) NULL) ||
+      (!magick_info->stream_support))
+    return(MagickFalse);
+  if ((*read_info->filename == '|') ||
+      (strcmp(read_info->filename,"-") == 0))
+    return(MagickFalse);
+  clone_info=CloneImageInfo(write_info);
+  streamable=MagickFalse;
+  if ((SetImageInfo(clone_info,SETMAGICK_WRITE,exception) != MagickFail) &&
+      (*clone_info->filename != '|'))
+    {
+      magick_info=GetMagickInfo(clone_info->magick,exception);
+      streamable=((magick_info != (const MagickInfo *) NULL) &&
+                  (magick_info->stream_encoder !=
+                   (StreamEncoderHandler) NULL));
+    }
+  if (streamable)
+    {
+      ExceptionInfo
+        ping_exception;
+
+      Image
+        *image;
+
+      ImageInfo
+        *ping_info;
+
+      void
+        *state = (void *) NULL;
+
+      /*
+        Ping the input to make sure that it provides a single frame
+        (StreamImage() only decodes one), with interleaved samples
+        (separate planes are decoded by revisiting each row, which a
+        stream pixel cache does not allow), and then ask the encoder
+        whether it supports the output settings for the attributes of
+        that frame.  Since the transform may change the colorspace, the
+        colorspace of write_info takes precedence.
+      */
+      GetExceptionInfo(&ping_exception);
+      ping_info=CloneImageInfo(read_info);
+      ping_info->temporary=MagickFalse;
+      if (ping_info->subrange == 0)
+        ping_info->subrange=2;
+      image=PingImage(ping_info,&ping_exception);
+      DestroyImageInfo(ping_info);
+      streamable=((image != (Image *) NULL) &&
+                  (image->next == (Image *) NULL) &&
+                  (image->interlace != PlaneInterlace) &&
+                  (ping_exception.severity < ErrorException));
+      if (streamable)
+        {
+          if (clone_info->colorspace != UndefinedColorspace)
+            image->colorspace=clone_info->colorspace;
+          streamable=((magick_info->stream_encoder)(clone_info,image,
+                                                    (const Image *) NULL,
+                                                    QueryStreamEncode,
+                                                    &state) != MagickFail);
+        }
+      if (image != (Image *) NULL)
+        DestroyImageList(image);
+      DestroyExceptionInfo(&ping_exception);
+    }
+  DestroyImageInfo(clone_info);
+  (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                        "%.1024s to %.1024s is %sstreamable",
+                        read_info->magick,write_info->filename,
+                        streamable ? "" : "not ");
+  return(streamable);
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -2112,6 +2252,388 @@ MagickExport Image *ReadInlineImage(const ImageInfo *image_info,
   return(image);
 }
 
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   S t r e a m I m a g e                                                     %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  StreamImage() converts the image described by read_info to the file
+%  described by write_info while holding only a few rows of the image in
+%  memory.  The decoder writes into a stream pixel cache, which passes
+%  completed rows on in order.  Rows are gathered into small bands, each
+%  band is passed to the transform (which must only apply row-local
+%  operations, such as MogrifyImage() with the quantum operators, levels,
+%  or colorspace transforms), and the transformed band is passed to the
+%  row streaming encoder of the output format.  Peak memory is therefore
+%  proportional to the image width rather than to its area.
+%
+%  Use IsImageStreamable() to find out if the conversion is possible.  If
+%  the decoder returns fewer rows than it declared, the missing rows are
+%  written as black.
+%
+%  The format of the StreamImage method is:
+%
+%      MagickPassFail StreamImage(const ImageInfo *read_info,
+%        const ImageInfo *write_info,StreamTransformHandler transform,
+%        void *client_data,ExceptionInfo *exception)
+%
+%  A description of each parameter follows:
+%
+%    o read_info: The input image info.
+%
+%    o write_info: The output image info.
+%
+%    o transform: Applied to each band of rows (may be NULL).  The
+%      band image may be replaced, but its width must be preserved.
+%
+%    o client_data: Opaque data passed to the transform.
+%
+%    o exception: Return any errors or warnings in this structure.
+%
+%
+*/
+typedef struct _StreamImageState
+{
+  const ImageInfo
+    *write_info;
+
+  StreamEncoderHandler
+    encoder;
+
+  StreamTransformHandler
+    transform;
+
+  void
+    *client_data;
+
+  const Image
+    *source;            /* image which passes rows to us */
+
+  Image
+    *band,              /* rows gathered for the next transform */
+    *header;            /* attributes of the output image (no pixels) */
+
+  unsigned long
+    band_rows,          /* maximum rows in a band */
+    band_fill,          /* rows gathered in the current band */
+    rows;               /* rows passed to the encoder so far */
+
+  void
+    *encoder_state;
+
+  MagickBool
+    begun;              /* encoder BeginStreamEncode phase was invoked */
+
+  ExceptionInfo
+    exception;
+} StreamImageState;
+
+static MagickPassFail FlushStreamBand(StreamImageState *state)
+{
+  Image
+    *band;
+
+  MagickPassFail
+    status;
+
+  band=state->band;
+  state->band=(Image *) NULL;
+  state->band_fill=0;
+  status=MagickPass;
+  if (state->transform != (StreamTransformHandler) NULL)
+    {
+      unsigned long
+        columns;
+
+      columns=band->columns;
+      status=(state->transform)(state->client_data,&band,&state->exception);
+      if ((status != MagickFail) && (band->columns != columns))
+        {
+          ThrowException(&state->exception,StreamError,
+                         ImageDoesNotContainTheStreamGeometry,
+                         band->filename);
+          status=MagickFail;
+        }
+    }
+  if ((status != MagickFail) && !state->begun)
+    {
+      /*
+        The transformed first band determines the output attributes.
+      */
+      state->header=CloneImage(band,band->columns,state->source->rows,
+                               MagickTrue,&state->exception);
+      if (state->header == (Image *) NULL)
+        status=MagickFail;
+      if (status != MagickFail)
+        {
+          (void) strlcpy(state->header->filename,state->write_info->filename,
+                         MaxTextExtent);
+          (void) strlcpy(state->header->magick,state->write_info->magick,
+                         MaxTextExtent);
+          if ((IsGrayColorspace(band->colorspace)) ||
+              ((band->storage_class == PseudoClass) &&
+               IsGrayImage(band,&state->exception)))
+            state->header->is_grayscale=MagickTrue;
+          status=OpenBlob(state->write_info,state->header,
+                          WriteBinaryBlobMode,&state->exception);
+        }
+      if (status != MagickFail)
+        {
+          state->begun=MagickTrue;
+          status=(state->encoder)(state->write_info,state->header,
+                                  (const Image *) NULL,BeginStreamEncode,
+                                  &state->encoder_state);
+        }
+    }
+  if (status != MagickFail)
+    status=(state->encoder)(state->write_info,state->header,band,
+                            RowsStreamEncode,&state->encoder_state);
+  if (status != MagickFail)
+    state->rows+=band->rows;
+  if ((state->header != (Image *) NULL) &&
+      (state->header->exception.severity > state->exception.severity))
+    CopyException(&state->exception,&state->header->exception);
+  DestroyImage(band);
+  return(status);
+}
+
+static MagickPassFail StreamImageRows(void *client_data,const Image *image,
+  const long y,const unsigned long rows,const PixelPacket *pixels,
+  const IndexPacket *indexes,ExceptionInfo *exception)
+{
+  StreamImageState
+    *state = (StreamImageState *) client_data;
+
+  unsigned long
+    count,
+    row;
+
+  MagickPassFail
+    status;
+
+  ARG_NOT_USED(y);
+  if (state->source == (const Image *) NULL)
+    {
+      /*
+        Bands of up to 64 rows, limited to about 4MB.
+      */
+      state->source=image;
+      state->band_rows=(4*1024*1024)/(image->columns*sizeof(PixelPacket));
+      state->band_rows=Max(1,Min(64,state->band_rows));
+    }
+  if (image != state->source)
+    return(MagickPass); /* Rows of some other image allocated by the decoder */
+  status=MagickPass;
+  for (row=0; (status != MagickFail) && (row < rows); row+=count)
+    {
+      PixelPacket
+        *q;
+
+      if (state->band == (Image *) NULL)
+        {
+          state->band=CloneImage(image,image->columns,
+                                 Min(state->band_rows,
+                                     image->rows-state->rows),
+                                 MagickTrue,&state->exception);
+          if (state->band == (Image *) NULL)
+            {
+              status=MagickFail;
+              break;
+            }
+        }
+      count=Min(rows-row,state->band->rows-state->band_fill);
+      q=SetImagePixelsEx(state->band,0,state->band_fill,image->columns,count,
+                         &state->exception);
+      if (q == (PixelPacket *) NULL)
+        {
+          status=MagickFail;
+          break;
+        }
+      (void) memcpy(q,pixels+(size_t) row*image->columns,
+                    (size_t) count*image->columns*sizeof(PixelPacket));
+      if (indexes != (const IndexPacket *) NULL)
+        {
+          IndexPacket
+            *band_indexes;
+
+          band_indexes=AccessMutableIndexes(state->band);
+          if (band_indexes != (IndexPacket *) NULL)
+            (void) memcpy(band_indexes,indexes+(size_t) row*image->columns,
+                          (size_t) count*image->columns*sizeof(IndexPacket));
+        }
+      status=SyncImagePixelsEx(state->band,&state->exception);
+      state->band_fill+=count;
+      if ((status != MagickFail) && (state->band_fill == state->band->rows))
+        status=FlushStreamBand(state);
+    }
+  if (status == MagickFail)
+    CopyException(exception,&state->exception);
+  return(status);
+}
+
+MagickExport MagickPassFail StreamImage(const ImageInfo *read_info,
+  const ImageInfo *write_info,StreamTransformHandler transform,
+  void *client_data,ExceptionInfo *exception)
+{
+  const MagickInfo
+    *magick_info = (const MagickInfo *) NULL;
+
+  Image
+    *image;
+
+  ImageInfo
+    *clone_info,
+    *encode_info;
+
+  MagickPassFail
+    status;
+
+  StreamImageState
+    state;
+
+  assert(read_info != (const ImageInfo *) NULL);
+  assert(read_info->signature == MagickSignature);
+  assert(write_info != (const ImageInfo *) NULL);
+  assert(write_info->signature == MagickSignature);
+  assert(exception != (ExceptionInfo *) NULL);
+  clone_info=CloneImageInfo(read_info);
+  encode_info=CloneImageInfo(write_info);
+  (void) memset(&state,0,sizeof(state));
+  GetExceptionInfo(&state.exception);
+  status=MagickPass;
+  if (!IsImageStreamable(clone_info,encode_info,exception))
+    {
+      if (exception->severity < ErrorException)
+        ThrowException(exception,StreamError,NoStreamHandlerIsDefined,
+                       clone_info->filename);
+      status=MagickFail;
+    }
+  if (status != MagickFail)
+    status=SetImageInfo(encode_info,SETMAGICK_WRITE,exception);
+  if (status != MagickFail)
+    {
+      magick_info=GetMagickInfo(encode_info->magick,exception);
+      state.write_info=encode_info;
+      state.encoder=magick_info->stream_encoder;
+      state.transform=transform;
+      state.client_data=client_data;
+      magick_info=GetMagickInfo(clone_info->magick,exception);
+      /*
+        Route the pixels of the image allocated by the decoder (see
+        AllocateImage()) to us.
+      */
+      clone_info->subimage=0;
+      clone_info->subrange=1;
+      if (clone_info->cache != (void *) NULL)
+        DestroyCacheInfo(clone_info->cache);
+      GetCacheInfo(&clone_info->cache);
+      status=SetStreamCacheHandler(clone_info->cache,StreamImageRows,&state);
+    }
+  if (status != MagickFail)
+    {
+      if (!magick_info->thread_support)
+        LockSemaphoreInfo(constitute_semaphore);
+      (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+        "Invoking \"%.1024s\" decoder (%.1024s) with stream pixel cache",
+                            magick_info->name,magick_info->description);
+      image=(magick_info->decoder)(clone_info,exception);
+      if (!magick_info->thread_support)
+        UnlockSemaphoreInfo(constitute_semaphore);
+      if (image == (Image *) NULL)
+        {
+          if (exception->severity < ErrorException)
+            ThrowException(exception,CoderError,DecodedImageNotReturned,
+                           clone_info->filename);
+          status=MagickFail;
+        }
+      else
+        {
+          GetImageException(image,exception);
+          if (exception->severity >= ErrorException)
+            status=MagickFail;
+        }
+      if ((status != MagickFail) &&
+          ((state.source == (const Image *) NULL) ||
+           (state.source != image)))
+        {
+          /*
+            The decoder did not write the rows of the returned image
+            through the stream cache.
+          */
+          ThrowException(exception,StreamError,UnableToAcquirePixelStream,
+                         clone_info->filename);
+          status=MagickFail;
+        }
+      if ((status != MagickFail) && (state.rows < image->rows))
+        {
+          IndexPacket
+            *indexes;
+
+          PixelPacket
+            *pixels;
+
+          /*
+            Write any rows which the decoder did not supply as black.
+          */
+          (void) LogMagickEvent(CoderEvent,GetMagickModule(),
+                                "Decoder supplied %lu of %lu rows",
+                                state.rows+state.band_fill,image->rows);
+          pixels=MagickAllocateClearedArray(PixelPacket *,image->columns,
+                                            sizeof(PixelPacket));
+          indexes=MagickAllocateClearedArray(IndexPacket *,image->columns,
+                                             sizeof(IndexPacket));
+          if ((pixels == (PixelPacket *) NULL) ||
+              (indexes == (IndexPacket *) NULL))
+            {
+              ThrowException(exception,ResourceLimitError,
+                             MemoryAllocationFailed,clone_info->filename);
+              status=MagickFail;
+            }
+          while ((status != MagickFail) && (state.rows < image->rows))
+            status=StreamImageRows(&state,image,
+                                   (long) (state.rows+state.band_fill),1,
+                                   pixels,
+                                   (image->storage_class == PseudoClass) ||
+                                   (image->colorspace == CMYKColorspace) ?
+                                   indexes : (IndexPacket *) NULL,
+                                   exception);
+          MagickFreeMemory(pixels);
+          MagickFreeMemory(indexes);
+        }
+      if (image != (Image *) NULL)
+        DestroyImageList(image);
+    }
+  if (state.band != (Image *) NULL)
+    DestroyImage(state.band);
+  if (state.begun)
+    {
+      if ((state.encoder)(encode_info,state.header,(const Image *) NULL,
+                          EndStreamEncode,&state.encoder_state) == MagickFail)
+        status=MagickFail;
+      CloseBlob(state.header);
+      if (state.header->exception.severity > state.exception.severity)
+        CopyException(&state.exception,&state.header->exception);
+    }
+  if (state.header != (Image *) NULL)
+    DestroyImage(state.header);
+  if (state.exception.severity > exception->severity)
+    CopyException(exception,&state.exception);
+  if (exception->severity >= ErrorException)
+    status=MagickFail;
+  DestroyExceptionInfo(&state.exception);
+  if (clone_info->temporary)
+    RemoveTemporaryInputFile(clone_info);
+  DestroyImageInfo(clone_info);
+  DestroyImageInfo(encode_info);
+  return(status);
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
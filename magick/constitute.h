@@ -138,6 +138,14 @@ typedef struct _ImportPixelAreaInfo
 
 } ImportPixelAreaInfo;
 
+/*
+  Transform applied to each band of rows by StreamImage().  The image
+  may be replaced, but must retain its width.
+*/
+typedef MagickPassFail
+  (*StreamTransformHandler)(void *client_data,Image **rows,
+                            ExceptionInfo *exception);
+
 extern MagickExport const char
   *StorageTypeToString(const StorageType storage_type),
   *QuantumSampleTypeToString(const QuantumSampleType sample_type),
@@ -178,6 +186,15 @@ extern MagickExport MagickPassFail
   WriteImagesFile(const ImageInfo *image_info,Image *image,FILE * file,
     ExceptionInfo *exception);
 
+extern MagickExport MagickBool
+  IsImageStreamable(ImageInfo *read_info,const ImageInfo *write_info,
+    ExceptionInfo *exception);
+
+extern MagickExport MagickPassFail
+  StreamImage(const ImageInfo *read_info,const ImageInfo *write_info,
+    StreamTransformHandler transform,void *client_data,
+    ExceptionInfo *exception);
+
 extern MagickExport void
   ExportPixelAreaOptionsInit(ExportPixelAreaOptions *options),
   ImportPixelAreaOptionsInit(ImportPixelAreaOptions *options);
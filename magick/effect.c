@@ -1288,6 +1288,176 @@ MagickExport MagickPassFail ChannelThresholdImage(Image *image,
 %
 */
 #define ConvolveImageText "[%s] Convolve: order %u..."
+/*
+  Convolve an image which uses FloatPixelFormat.  Sums are neither
+  rounded nor clamped so that values outside of the quantum range, and
+  fractional values, are retained in the result.
+*/
+static MagickPassFail
+ConvolveFloatPixels(const Image *image,Image *convolve_image,
+                    const long width,const double *kernel,
+                    const unsigned int order,ExceptionInfo *exception)
+{
+  double
+    normalize;
+
+  float
+    *normal_kernel;
+
+  long
+    i,
+    y;
+
+  ThreadViewDataSet
+    *rows_set,
+    *result_set;
+
+  unsigned long
+    row_count=0;
+
+  MagickBool
+    monitor_active;
+
+  MagickPassFail
+    status=MagickPass;
+
+  const MagickBool
+    matte=((image->matte) || (image->colorspace == CMYKColorspace));
+
+  normal_kernel=MagickAllocateArray(float *,(size_t) width*width,
+                                    sizeof(float));
+  rows_set=AllocateThreadViewDataArray(image,exception,
+                                       ((size_t) image->columns+width)*width,
+                                       sizeof(FloatPixelPacket));
+  result_set=AllocateThreadViewDataArray(image,exception,image->columns,
+                                         sizeof(FloatPixelPacket));
+  if ((normal_kernel == (float *) NULL) ||
+      (rows_set == (ThreadViewDataSet *) NULL) ||
+      (result_set == (ThreadViewDataSet *) NULL))
+    {
+      MagickFreeMemory(normal_kernel);
+      DestroyThreadViewDataSet(rows_set);
+      DestroyThreadViewDataSet(result_set);
+      ThrowException(exception,ResourceLimitError,MemoryAllocationFailed,
+                     MagickMsg(OptionError,UnableToConvolveImage));
+      return MagickFail;
+    }
+  normalize=0.0;
+  for (i=0; i < (width*width); i++)
+    normalize+=kernel[i];
+  if (AbsoluteValue(normalize) <= MagickEpsilon)
+    normalize=1.0;
+  normalize=1.0/normalize;
+  for (i=0; i < (width*width); i++)
+    normal_kernel[i]=(float) (normalize*kernel[i]);
+
+  monitor_active=MagickMonitorActive();
+
+#if defined(HAVE_OPENMP)
+#  if defined(TUNE_OPENMP)
+#    pragma omp parallel for schedule(runtime) shared(row_count, status)
+#  else
+#    pragma omp parallel for schedule(guided) shared(row_count, status)
+#  endif
+#endif
+  for (y=0; y < (long) convolve_image->rows; y++)
+    {
+      FloatPixelPacket
+        * restrict p,
+        * restrict q;
+
+      long
+        x;
+
+      MagickBool
+        thread_status;
+
+      thread_status=status;
+      if (thread_status == MagickFail)
+        continue;
+
+      p=AccessThreadViewData(rows_set);
+      q=AccessThreadViewData(result_set);
+      if (!AcquireImageFloatPixels(image,-width/2,y-width/2,
+                                   image->columns+width,width,p,exception))
+        thread_status=MagickFail;
+
+      if (thread_status != MagickFail)
+        {
+          for (x=0; x < (long) convolve_image->columns; x++)
+            {
+              FloatPixelPacket
+                pixel;
+
+              const FloatPixelPacket
+                * restrict r;
+
+              const float
+                * restrict k;
+
+              long
+                u,
+                v;
+
+              r=p+x;
+              k=normal_kernel;
+              pixel.red=pixel.green=pixel.blue=pixel.opacity=0.0f;
+              for (v=0; v < width; v++)
+                {
+                  for (u=0; u < width; u++)
+                    {
+                      pixel.red+=k[u]*r[u].red;
+                      pixel.green+=k[u]*r[u].green;
+                      pixel.blue+=k[u]*r[u].blue;
+                      pixel.opacity+=k[u]*r[u].opacity;
+                    }
+                  k+=width;
+                  r+=(size_t) image->columns+width;
+                }
+              if (!matte)
+                pixel.opacity=(float) OpaqueOpacity;
+              q[x]=pixel;
+            }
+          if (!StoreImageFloatPixels(convolve_image,0,y,convolve_image->columns,
+                                     1,q,exception))
+            thread_status=MagickFail;
+        }
+
+      if (monitor_active)
+        {
+          unsigned long
+            thread_row_count;
+
+#if defined(HAVE_OPENMP)
+#  pragma omp atomic
+#endif
+          row_count++;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (row_count)
+#endif
+          thread_row_count=row_count;
+          if (QuantumTick(thread_row_count,image->rows))
+            if (!MagickMonitorFormatted(thread_row_count,image->rows,exception,
+                                        ConvolveImageText,
+                                        convolve_image->filename,
+                                        order))
+              thread_status=MagickFail;
+        }
+
+      if (thread_status == MagickFail)
+        {
+          status=MagickFail;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (status)
+#endif
+        }
+    }
+  DestroyThreadViewDataSet(rows_set);
+  DestroyThreadViewDataSet(result_set);
+  MagickFreeMemory(normal_kernel);
+  return status;
+}
+
 MagickExport Image *ConvolveImage(const Image * restrict image,const unsigned int order,
                                   const double * restrict kernel,ExceptionInfo *exception)
 {
@@ -1422,6 +1592,10 @@ MagickExport Image *ConvolveImage(const Image * restrict image,const unsigned in
   /*
     Convolve image.
   */
+  if (GetImagePixelFormat(image) == FloatPixelFormat)
+    status=ConvolveFloatPixels(image,convolve_image,width,kernel,order,
+                               exception);
+  else
   {
     unsigned long
       row_count=0;
@@ -2259,165 +2433,902 @@ MagickExport Image *EnhanceImage(const Image *image,ExceptionInfo *exception)
 }
 
 /*
-%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
-%                                                                             %
-%                                                                             %
-%     G a u s s i a n B l u r I m a g e                                       %
-%                                                                             %
-%                                                                             %
-%                                                                             %
-%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
-%
-%  GaussianBlurImage() blurs an image.  We convolve the image with a
-%  Gaussian operator of the given radius and standard deviation (sigma).
-%  For reasonable results, the radius should be larger than sigma.  Use a
-%  radius of 0 and GaussianBlurImage() selects a suitable radius for you
-%
-%  The format of the GaussianBlurImage method is:
-%
-%      Image *GaussianBlurImage(const Image *image,const double radius,
-%        const double sigma,ExceptionInfo *exception)
-%
-%  A description of each parameter follows:
-%
-%    o blur_image: Method GaussianBlurImage returns a pointer to the image
-%      after it is blur.  A null image is returned if there is a memory
-%      shortage.
-%
-%    o image: Image to blur.
-%
-%    o radius: the radius of the Gaussian, in pixels, not counting the center
-%      pixel.
-%
-%    o sigma: the standard deviation of the Gaussian, in pixels.
-%
-%    o exception: Return any errors or warnings in this structure.
-%
-%
+  Gaussian convolution.  The two dimensional Gaussian is the product of
+  two one dimensional Gaussians, so it is applied as a horizontal pass
+  followed by a vertical pass, at a cost of 2*width rather than
+  width*width operations per pixel.  The image is processed in tiles so
+  that each thread only needs a small intermediate buffer.  Edges are
+  handled with virtual pixels, so the results match ConvolveImage()
+  with the equivalent two dimensional kernel.
+
+  The result is center_weight*pixel+blur_weight*blurred_pixel, which
+  allows SharpenImage() to use the same code.
+
+  The MAGICK_GAUSSIAN_METHOD environment variable selects "separable"
+  (the default), "recursive" for the Young/van Vliet recursive (IIR)
+  approximation whose cost does not depend on sigma, or "convolve" for
+  the original two dimensional convolution.
 */
-MagickExport Image *GaussianBlurImage(const Image *image,const double radius,
-  const double sigma,ExceptionInfo *exception)
-{
-  double
-    alpha,
-    *kernel;
+#define GaussianBlurImageText "[%s] Gaussian blur: order %ld..."
+#define GaussianTileColumns 128
+#define GaussianTileRows 64
 
-  Image
-    *blur_image;
+#if QuantumDepth < 32
+typedef float gaussian_quantum_t;
+#  define RoundGaussianToQuantum(value) RoundFloatToQuantum(value)
+#else
+typedef double gaussian_quantum_t;
+#  define RoundGaussianToQuantum(value) RoundDoubleToQuantum(value)
+#endif
 
-  int
-    width;
+typedef enum
+{
+  SeparableGaussianMethod,
+  RecursiveGaussianMethod,
+  ConvolveGaussianMethod
+} GaussianMethod;
 
-  register long
-    i,
-    u,
-    v;
+static GaussianMethod GetGaussianMethod(const double sigma)
+{
+  const char
+    *method;
 
-  assert(image != (const Image *) NULL);
-  assert(image->signature == MagickSignature);
-  assert(exception != (ExceptionInfo *) NULL);
-  assert(exception->signature == MagickSignature);
-  width=GetOptimalKernelWidth2D(radius,sigma);
-  if (((long) image->columns < width) || ((long) image->rows < width))
-    ThrowImageException3(OptionError,UnableToBlurImage,
-      ImageSmallerThanRadius);
-  kernel=MagickAllocateArray(double *,MagickArraySize(width,width),sizeof(double));
-  if (kernel == (double *) NULL)
-    ThrowImageException(ResourceLimitError,MemoryAllocationFailed,
-      MagickMsg(OptionError,UnableToBlurImage));
-  i=0;
-  for (v=(-(width)/2); v <= (width/2); v++)
-  {
-    for (u=(-width/2); u <= (width/2); u++)
+  method=getenv("MAGICK_GAUSSIAN_METHOD");
+  if (method != (const char *) NULL)
     {
-      alpha=exp(-((double) u*u+(double) v*v)/(2.0*sigma*sigma));
-      kernel[i]=alpha/(2.0*MagickPI*sigma*sigma);
-      i++;
+      if (LocaleCompare(method,"convolve") == 0)
+        return ConvolveGaussianMethod;
+      /*
+        The recursive filter coefficients are only valid for sigma >= 0.5.
+      */
+      if (((LocaleCompare(method,"recursive") == 0) ||
+           (LocaleCompare(method,"iir") == 0)) && (sigma >= 0.5))
+        return RecursiveGaussianMethod;
     }
-  }
-  blur_image=ConvolveImage(image,width,kernel,exception);
-  MagickFreeMemory(kernel);
-  if (blur_image != (Image *) NULL)
-    blur_image->is_grayscale=image->is_grayscale;
-  return(blur_image);
+  return SeparableGaussianMethod;
 }
-
+
 /*
-%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
-%                                                                             %
-%                                                                             %
-%     G a u s s i a n B l u r I m a g e C h a n n e l                         %
-%                                                                             %
-%                                                                             %
-%                                                                             %
-%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
-%
-%  GaussianBlurImageChannel() blurs an image channel.  We convolve the image
-%  with a Gaussian operator of the given radius and standard deviation
-%  (sigma).  For reasonable results, the radius should be larger than sigma.
-%  Use a radius of 0 and GaussianBlurImage() selects a suitable radius for
-%  you.
-%
-%  The format of the GaussianBlurImageChannel method is:
-%
-%      Image *GaussianBlurImageChannel(const Image *image,
-%        const ChannelType channel,const double radius,
-%        const double sigma,ExceptionInfo *exception)
-%
-%  A description of each parameter follows:
-%
-%    o blur_image: Method GaussianBlurImage returns a pointer to the image
-%      after it is blur.  A null image is returned if there is a memory
-%      shortage.
-%
-%    o image: Image to blur.
-%
-%    o channel: Channel to blur in image.
-%
-%    o radius: the radius of the Gaussian, in pixels, not counting the center
-%      pixel.
-%
-%    o sigma: the standard deviation of the Gaussian, in pixels.
-%
-%    o exception: Return any errors or warnings in this structure.
-%
-%
+  Number of floating point channels needed to blur the image.
 */
-MagickExport Image *GaussianBlurImageChannel(const Image *image,
-  const ChannelType channel,const double radius,const double sigma,
-  ExceptionInfo *exception)
+static unsigned int GetGaussianChannels(const Image *image)
 {
-  Image
-    *blur_image;
-
-  blur_image=GaussianBlurImage(image,radius,sigma,exception);
-  if (blur_image != (Image *) NULL)
-    (void) ImportImageChannelsMasked(image,blur_image,channel);
-
-  return blur_image;
+  if ((image->matte) || (image->colorspace == CMYKColorspace))
+    return 4;
+  if (image->is_grayscale)
+    return 1;
+  return 3;
 }
-
+
 /*
-%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
-%                                                                             %
-%                                                                             %
-%     M e d i a n F i l t e r I m a g e                                       %
-%                                                                             %
-%                                                                             %
-%                                                                             %
-%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
-%
-%  MedianFilterImage() applies a digital filter that improves the quality
-%  of a noisy image.  Each pixel is replaced by the median in a set of
-%  neighboring pixels as defined by radius.
-%
-%  The algorithm was contributed by Mike Edmonds and implements an insertion
-%  sort for selecting median color-channel values.  For more on this algorithm
-%  see "Skip Lists: A probabilistic Alternative to Balanced Trees" by William
-%  Pugh in the June 1990 of Communications of the ACM.
-%
-%  The format of the MedianFilterImage method is:
-%
+  Store a blurred pixel, combining it with the original pixel if
+  required.
+*/
+static inline void
+StoreGaussianPixel(const gaussian_quantum_t * restrict blur,
+                   const PixelPacket * restrict center,
+                   const unsigned int channels,
+                   const double center_weight,const double blur_weight,
+                   PixelPacket * restrict q)
+{
+  if (center_weight == 0.0)
+    {
+      if (channels == 1)
+        {
+          q->red=q->green=q->blue=RoundGaussianToQuantum(blur[0]);
+          q->opacity=OpaqueOpacity;
+          return;
+        }
+      q->red=RoundGaussianToQuantum(blur[0]);
+      q->green=RoundGaussianToQuantum(blur[1]);
+      q->blue=RoundGaussianToQuantum(blur[2]);
+      q->opacity=(channels == 4 ? RoundGaussianToQuantum(blur[3]) :
+                  OpaqueOpacity);
+      return;
+    }
+  if (channels == 1)
+    {
+      q->red=q->green=q->blue=RoundGaussianToQuantum(blur_weight*blur[0]+
+                                                     center_weight*
+                                                     center->red);
+      q->opacity=OpaqueOpacity;
+      return;
+    }
+  q->red=RoundGaussianToQuantum(blur_weight*blur[0]+
+                                center_weight*center->red);
+  q->green=RoundGaussianToQuantum(blur_weight*blur[1]+
+                                  center_weight*center->green);
+  q->blue=RoundGaussianToQuantum(blur_weight*blur[2]+
+                                 center_weight*center->blue);
+  q->opacity=(channels == 4 ?
+              RoundGaussianToQuantum(blur_weight*blur[3]+
+                                     center_weight*center->opacity) :
+              OpaqueOpacity);
+}
+
+static MagickPassFail
+SeparableGaussianImage(const Image *image,Image *blur_image,const long width,
+                       const double sigma,const double center_weight,
+                       const double blur_weight,ExceptionInfo *exception)
+{
+  gaussian_quantum_t
+    *kernel;
+
+  ThreadViewDataSet
+    *data_set;
+
+  unsigned long
+    tile_columns,
+    tile_count,
+    tile_rows,
+    tiles_across;
+
+  unsigned int
+    channels;
+
+  MagickPassFail
+    status=MagickPass;
+
+  /*
+    Build normalized one dimensional kernel.
+  */
+  kernel=MagickAllocateArray(gaussian_quantum_t *,width,
+                             sizeof(gaussian_quantum_t));
+  if (kernel == (gaussian_quantum_t *) NULL)
+    {
+      ThrowException(exception,ResourceLimitError,MemoryAllocationFailed,
+                     MagickMsg(OptionError,UnableToBlurImage));
+      return MagickFail;
+    }
+  {
+    double
+      normalize=0.0;
+
+    register long
+      u;
+
+    for (u=0; u < width; u++)
+      normalize+=exp(-((double) (u-width/2)*(u-width/2))/(2.0*sigma*sigma));
+    for (u=0; u < width; u++)
+      kernel[u]=(gaussian_quantum_t)
+        (exp(-((double) (u-width/2)*(u-width/2))/(2.0*sigma*sigma))/
+         normalize);
+  }
+  channels=GetGaussianChannels(image);
+  tile_columns=Min(image->columns,GaussianTileColumns);
+  tile_rows=Min(image->rows,Max(GaussianTileRows,(unsigned long) width));
+  tiles_across=(image->columns+tile_columns-1)/tile_columns;
+  tile_count=tiles_across*((image->rows+tile_rows-1)/tile_rows);
+  /*
+    Each thread needs the horizontally blurred rows of a tile, and an
+    accumulator for one output row.
+  */
+  data_set=AllocateThreadViewDataArray(image,exception,
+                                       (tile_rows+width)*tile_columns*
+                                       channels,
+                                       sizeof(gaussian_quantum_t));
+  if (data_set == (ThreadViewDataSet *) NULL)
+    status=MagickFail;
+
+  if (status != MagickFail)
+    {
+      unsigned long
+        tiles_done=0;
+
+      MagickBool
+        monitor_active;
+
+      long
+        tile;
+
+      monitor_active=MagickMonitorActive();
+
+#if defined(HAVE_OPENMP)
+#  if defined(TUNE_OPENMP)
+#    pragma omp parallel for schedule(runtime) shared(tiles_done, status)
+#  else
+#    pragma omp parallel for schedule(dynamic) shared(tiles_done, status)
+#  endif
+#endif
+      for (tile=0; tile < (long) tile_count; tile++)
+        {
+          const PixelPacket
+            * restrict p;
+
+          PixelPacket
+            * restrict q;
+
+          gaussian_quantum_t
+            * restrict accumulator,
+            * restrict scratch;
+
+          long
+            x,
+            x0,
+            y,
+            y0;
+
+          unsigned long
+            input_columns,
+            input_rows,
+            row_length,
+            tile_height,
+            tile_width;
+
+          MagickBool
+            thread_status;
+
+          thread_status=status;
+          if (thread_status == MagickFail)
+            continue;
+
+          x0=(long) ((tile % tiles_across)*tile_columns);
+          y0=(long) ((tile / tiles_across)*tile_rows);
+          tile_width=Min(tile_columns,image->columns-x0);
+          tile_height=Min(tile_rows,image->rows-y0);
+          input_columns=tile_width+width-1;
+          input_rows=tile_height+width-1;
+          row_length=tile_width*channels;
+          scratch=AccessThreadViewData(data_set);
+          accumulator=scratch+input_rows*row_length;
+          p=AcquireImagePixels(image,x0-width/2,y0-width/2,input_columns,
+                               input_rows,exception);
+          q=SetImagePixelsEx(blur_image,x0,y0,tile_width,tile_height,
+                             exception);
+          if ((p == (const PixelPacket *) NULL) ||
+              (q == (PixelPacket *) NULL))
+            thread_status=MagickFail;
+
+          if (thread_status != MagickFail)
+            {
+              /*
+                Blur rows.
+              */
+              for (y=0; y < (long) input_rows; y++)
+                {
+                  const PixelPacket
+                    * restrict r;
+
+                  gaussian_quantum_t
+                    * restrict h;
+
+                  register long
+                    u;
+
+                  r=p+(size_t) y*input_columns;
+                  h=scratch+(size_t) y*row_length;
+                  if (channels == 1)
+                    {
+                      for (x=0; x < (long) tile_width; x++)
+                        {
+                          gaussian_quantum_t
+                            red=0.0;
+
+                          for (u=0; u < width; u++)
+                            red+=kernel[u]*r[x+u].red;
+                          h[x]=red;
+                        }
+                    }
+                  else if (channels == 3)
+                    {
+                      for (x=0; x < (long) tile_width; x++)
+                        {
+                          gaussian_quantum_t
+                            red=0.0,
+                            green=0.0,
+                            blue=0.0;
+
+                          for (u=0; u < width; u++)
+                            {
+                              red+=kernel[u]*r[x+u].red;
+                              green+=kernel[u]*r[x+u].green;
+                              blue+=kernel[u]*r[x+u].blue;
+                            }
+                          h[3*x]=red;
+                          h[3*x+1]=green;
+                          h[3*x+2]=blue;
+                        }
+                    }
+                  else
+                    {
+                      for (x=0; x < (long) tile_width; x++)
+                        {
+                          gaussian_quantum_t
+                            red=0.0,
+                            green=0.0,
+                            blue=0.0,
+                            opacity=0.0;
+
+                          for (u=0; u < width; u++)
+                            {
+                              red+=kernel[u]*r[x+u].red;
+                              green+=kernel[u]*r[x+u].green;
+                              blue+=kernel[u]*r[x+u].blue;
+                              opacity+=kernel[u]*r[x+u].opacity;
+                            }
+                          h[4*x]=red;
+                          h[4*x+1]=green;
+                          h[4*x+2]=blue;
+                          h[4*x+3]=opacity;
+                        }
+                    }
+                }
+              /*
+                Blur columns.
+              */
+              for (y=0; y < (long) tile_height; y++)
+                {
+                  const PixelPacket
+                    *center;
+
+                  register unsigned long
+                    i;
+
+                  register long
+                    v;
+
+                  for (i=0; i < row_length; i++)
+                    accumulator[i]=0.0;
+                  for (v=0; v < width; v++)
+                    {
+                      const gaussian_quantum_t
+                        * restrict h;
+
+                      const gaussian_quantum_t
+                        weight=kernel[v];
+
+                      h=scratch+(size_t) (y+v)*row_length;
+                      for (i=0; i < row_length; i++)
+                        accumulator[i]+=weight*h[i];
+                    }
+                  center=p+(size_t) (y+width/2)*input_columns+width/2;
+                  for (x=0; x < (long) tile_width; x++)
+                    StoreGaussianPixel(accumulator+(size_t) x*channels,
+                                       center+x,channels,center_weight,
+                                       blur_weight,
+                                       q+(size_t) y*tile_width+x);
+                }
+              if (!SyncImagePixelsEx(blur_image,exception))
+                thread_status=MagickFail;
+            }
+
+          if (monitor_active)
+            {
+              unsigned long
+                thread_tiles_done;
+
+#if defined(HAVE_OPENMP)
+#  pragma omp atomic
+#endif
+              tiles_done++;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (tiles_done)
+#endif
+              thread_tiles_done=tiles_done;
+              if (QuantumTick(thread_tiles_done,tile_count))
+                if (!MagickMonitorFormatted(thread_tiles_done,tile_count,
+                                            exception,GaussianBlurImageText,
+                                            image->filename,width))
+                  thread_status=MagickFail;
+            }
+
+          if (thread_status == MagickFail)
+            {
+              status=MagickFail;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (status)
+#endif
+            }
+        }
+    }
+
+  DestroyThreadViewDataSet(data_set);
+  MagickFreeMemory(kernel);
+  return status;
+}
+
+/*
+  Recursive Gaussian filter coefficients from I.T. Young and L.J. van
+  Vliet, "Recursive implementation of the Gaussian filter", Signal
+  Processing 44 (1995).  The feedback coefficients are pre-divided by
+  b0.
+*/
+typedef struct _RecursiveGaussianInfo
+{
+  double
+    B,
+    b1,
+    b2,
+    b3;
+} RecursiveGaussianInfo;
+
+static void GetRecursiveGaussianInfo(const double sigma,
+                                     RecursiveGaussianInfo *info)
+{
+  double
+    b0,
+    q;
+
+  if (sigma >= 2.5)
+    q=0.98711*sigma-0.96330;
+  else
+    q=3.97156-4.14554*sqrt(1.0-0.26891*sigma);
+  b0=1.57825+2.44413*q+1.4281*q*q+0.422205*q*q*q;
+  info->b1=(2.44413*q+2.85619*q*q+1.26661*q*q*q)/b0;
+  info->b2=(-(1.4281*q*q+1.26661*q*q*q))/b0;
+  info->b3=(0.422205*q*q*q)/b0;
+  info->B=1.0-(info->b1+info->b2+info->b3);
+}
+
+/*
+  Filter a line of samples separated by stride, forward and then
+  backward.  Samples beyond the ends are treated as copies of the end
+  samples.
+*/
+static void RecursiveGaussianLine(gaussian_quantum_t * restrict line,
+                                  const size_t length,const size_t stride,
+                                  const RecursiveGaussianInfo *info)
+{
+  double
+    w1,
+    w2,
+    w3,
+    w;
+
+  register size_t
+    i;
+
+  w1=w2=w3=line[0];
+  for (i=0; i < length; i++)
+    {
+      w=info->B*line[i*stride]+info->b1*w1+info->b2*w2+info->b3*w3;
+      line[i*stride]=(gaussian_quantum_t) w;
+      w3=w2;
+      w2=w1;
+      w1=w;
+    }
+  w1=w2=w3=line[(length-1)*stride];
+  for (i=length; i != 0; i--)
+    {
+      w=info->B*line[(i-1)*stride]+info->b1*w1+info->b2*w2+info->b3*w3;
+      line[(i-1)*stride]=(gaussian_quantum_t) w;
+      w3=w2;
+      w2=w1;
+      w1=w;
+    }
+}
+
+static MagickPassFail
+RecursiveGaussianImage(const Image *image,Image *blur_image,
+                       const double sigma,const double center_weight,
+                       const double blur_weight,ExceptionInfo *exception)
+{
+  gaussian_quantum_t
+    *pixels;
+
+  RecursiveGaussianInfo
+    info;
+
+  size_t
+    row_length;
+
+  unsigned long
+    row_count=0;
+
+  unsigned int
+    channels;
+
+  long
+    lane_block,
+    y;
+
+  MagickBool
+    monitor_active;
+
+  MagickPassFail
+    status=MagickPass;
+
+  GetRecursiveGaussianInfo(sigma,&info);
+  channels=GetGaussianChannels(image);
+  row_length=(size_t) image->columns*channels;
+  pixels=MagickAllocateResourceLimitedArray(gaussian_quantum_t *,
+                                            MagickArraySize(image->rows,
+                                                            row_length),
+                                            sizeof(gaussian_quantum_t));
+  if (pixels == (gaussian_quantum_t *) NULL)
+    {
+      ThrowException(exception,ResourceLimitError,MemoryAllocationFailed,
+                     MagickMsg(OptionError,UnableToBlurImage));
+      return MagickFail;
+    }
+  monitor_active=MagickMonitorActive();
+  /*
+    Blur rows.
+  */
+#if defined(HAVE_OPENMP)
+#  if defined(TUNE_OPENMP)
+#    pragma omp parallel for schedule(runtime) shared(status)
+#  else
+#    pragma omp parallel for schedule(guided) shared(status)
+#  endif
+#endif
+  for (y=0; y < (long) image->rows; y++)
+    {
+      const PixelPacket
+        * restrict p;
+
+      gaussian_quantum_t
+        * restrict line;
+
+      register unsigned long
+        x;
+
+      unsigned int
+        i;
+
+      if (status == MagickFail)
+        continue;
+      p=AcquireImagePixels(image,0,y,image->columns,1,exception);
+      if (p == (const PixelPacket *) NULL)
+        {
+          status=MagickFail;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (status)
+#endif
+          continue;
+        }
+      line=pixels+(size_t) y*row_length;
+      for (x=0; x < image->columns; x++)
+        {
+          line[(size_t) x*channels]=p[x].red;
+          if (channels > 1)
+            {
+              line[(size_t) x*channels+1]=p[x].green;
+              line[(size_t) x*channels+2]=p[x].blue;
+            }
+          if (channels > 3)
+            line[(size_t) x*channels+3]=p[x].opacity;
+        }
+      for (i=0; i < channels; i++)
+        RecursiveGaussianLine(line+i,image->columns,channels,&info);
+    }
+  /*
+    Blur columns, a block of adjacent samples at a time.
+  */
+#if defined(HAVE_OPENMP)
+#  pragma omp parallel for schedule(static)
+#endif
+  for (lane_block=0; lane_block < (long) ((row_length+63)/64); lane_block++)
+    {
+      double
+        w[4][64];
+
+      gaussian_quantum_t
+        * restrict line;
+
+      size_t
+        lane,
+        lanes;
+
+      register size_t
+        i;
+
+      long
+        row;
+
+      if (status == MagickFail)
+        continue;
+      lane=(size_t) lane_block*64;
+      lanes=Min(64,row_length-lane);
+      line=pixels+lane;
+      for (i=0; i < lanes; i++)
+        w[1][i]=w[2][i]=w[3][i]=line[i];
+      for (row=0; row < (long) image->rows; row++)
+        {
+          line=pixels+(size_t) row*row_length+lane;
+          for (i=0; i < lanes; i++)
+            {
+              w[0][i]=info.B*line[i]+info.b1*w[1][i]+info.b2*w[2][i]+
+                info.b3*w[3][i];
+              line[i]=(gaussian_quantum_t) w[0][i];
+              w[3][i]=w[2][i];
+              w[2][i]=w[1][i];
+              w[1][i]=w[0][i];
+            }
+        }
+      line=pixels+(size_t) (image->rows-1)*row_length+lane;
+      for (i=0; i < lanes; i++)
+        w[1][i]=w[2][i]=w[3][i]=line[i];
+      for (row=(long) image->rows-1; row >= 0; row--)
+        {
+          line=pixels+(size_t) row*row_length+lane;
+          for (i=0; i < lanes; i++)
+            {
+              w[0][i]=info.B*line[i]+info.b1*w[1][i]+info.b2*w[2][i]+
+                info.b3*w[3][i];
+              line[i]=(gaussian_quantum_t) w[0][i];
+              w[3][i]=w[2][i];
+              w[2][i]=w[1][i];
+              w[1][i]=w[0][i];
+            }
+        }
+    }
+  /*
+    Store the result.
+  */
+#if defined(HAVE_OPENMP)
+#  if defined(TUNE_OPENMP)
+#    pragma omp parallel for schedule(runtime) shared(row_count, status)
+#  else
+#    pragma omp parallel for schedule(guided) shared(row_count, status)
+#  endif
+#endif
+  for (y=0; y < (long) image->rows; y++)
+    {
+      const PixelPacket
+        * restrict p;
+
+      PixelPacket
+        * restrict q;
+
+      register unsigned long
+        x;
+
+      MagickBool
+        thread_status;
+
+      thread_status=status;
+      if (thread_status == MagickFail)
+        continue;
+
+      p=(const PixelPacket *) NULL;
+      if (center_weight != 0.0)
+        p=AcquireImagePixels(image,0,y,image->columns,1,exception);
+      q=SetImagePixelsEx(blur_image,0,y,blur_image->columns,1,exception);
+      if (((center_weight != 0.0) && (p == (const PixelPacket *) NULL)) ||
+          (q == (PixelPacket *) NULL))
+        thread_status=MagickFail;
+
+      if (thread_status != MagickFail)
+        {
+          for (x=0; x < image->columns; x++)
+            StoreGaussianPixel(pixels+(size_t) y*row_length+
+                               (size_t) x*channels,
+                               (p != (const PixelPacket *) NULL ? p+x : q+x),
+                               channels,center_weight,blur_weight,q+x);
+          if (!SyncImagePixelsEx(blur_image,exception))
+            thread_status=MagickFail;
+        }
+
+      if (monitor_active)
+        {
+          unsigned long
+            thread_row_count;
+
+#if defined(HAVE_OPENMP)
+#  pragma omp atomic
+#endif
+          row_count++;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (row_count)
+#endif
+          thread_row_count=row_count;
+          if (QuantumTick(thread_row_count,image->rows))
+            if (!MagickMonitorFormatted(thread_row_count,image->rows,exception,
+                                        GaussianBlurImageText,image->filename,
+                                        0L))
+              thread_status=MagickFail;
+        }
+
+      if (thread_status == MagickFail)
+        {
+          status=MagickFail;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (status)
+#endif
+        }
+    }
+
+  MagickFreeResourceLimitedMemory(pixels);
+  return status;
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%     G a u s s i a n B l u r I m a g e                                       %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  GaussianBlurImage() blurs an image.  We convolve the image with a
+%  Gaussian operator of the given radius and standard deviation (sigma).
+%  For reasonable results, the radius should be larger than sigma.  Use a
+%  radius of 0 and GaussianBlurImage() selects a suitable radius for you
+%
+%  The Gaussian is applied as separate horizontal and vertical passes, so
+%  the cost grows linearly rather than quadratically with the radius.  Set
+%  the MAGICK_GAUSSIAN_METHOD environment variable to "recursive" to use
+%  a recursive approximation whose cost does not depend on the radius.
+%
+%  The format of the GaussianBlurImage method is:
+%
+%      Image *GaussianBlurImage(const Image *image,const double radius,
+%        const double sigma,ExceptionInfo *exception)
+%
+%  A description of each parameter follows:
+%
+%    o blur_image: Method GaussianBlurImage returns a pointer to the image
+%      after it is blur.  A null image is returned if there is a memory
+%      shortage.
+%
+%    o image: Image to blur.
+%
+%    o radius: the radius of the Gaussian, in pixels, not counting the center
+%      pixel.
+%
+%    o sigma: the standard deviation of the Gaussian, in pixels.
+%
+%    o exception: Return any errors or warnings in this structure.
+%
+%
+*/
+MagickExport Image *GaussianBlurImage(const Image *image,const double radius,
+  const double sigma,ExceptionInfo *exception)
+{
+  double
+    alpha,
+    *kernel;
+
+  GaussianMethod
+    method;
+
+  Image
+    *blur_image;
+
+  int
+    width;
+
+  register long
+    i,
+    u,
+    v;
+
+  assert(image != (const Image *) NULL);
+  assert(image->signature == MagickSignature);
+  assert(exception != (ExceptionInfo *) NULL);
+  assert(exception->signature == MagickSignature);
+  width=GetOptimalKernelWidth2D(radius,sigma);
+  if (((long) image->columns < width) || ((long) image->rows < width))
+    ThrowImageException3(OptionError,UnableToBlurImage,
+      ImageSmallerThanRadius);
+  method=GetGaussianMethod(sigma);
+  if (method != ConvolveGaussianMethod)
+    {
+      MagickPassFail
+        status;
+
+      blur_image=CloneImage(image,image->columns,image->rows,MagickTrue,
+                            exception);
+      if (blur_image == (Image *) NULL)
+        return((Image *) NULL);
+      blur_image->storage_class=DirectClass;
+      (void) LogMagickEvent(TransformEvent,GetMagickModule(),
+                            "  GaussianBlurImage %s, order %d, sigma %g",
+                            (method == RecursiveGaussianMethod ?
+                             "recursive" : "separable"),width,sigma);
+      if (method == RecursiveGaussianMethod)
+        status=RecursiveGaussianImage(image,blur_image,sigma,0.0,1.0,
+                                      exception);
+      else
+        status=SeparableGaussianImage(image,blur_image,width,sigma,0.0,1.0,
+                                      exception);
+      if (status == MagickFail)
+        {
+          DestroyImage(blur_image);
+          return((Image *) NULL);
+        }
+      blur_image->is_grayscale=image->is_grayscale;
+      return(blur_image);
+    }
+  kernel=MagickAllocateArray(double *,MagickArraySize(width,width),sizeof(double));
+  if (kernel == (double *) NULL)
+    ThrowImageException(ResourceLimitError,MemoryAllocationFailed,
+      MagickMsg(OptionError,UnableToBlurImage));
+  i=0;
+  for (v=(-(width)/2); v <= (width/2); v++)
+  {
+    for (u=(-width/2); u <= (width/2); u++)
+    {
+      alpha=exp(-((double) u*u+(double) v*v)/(2.0*sigma*sigma));
+      kernel[i]=alpha/(2.0*MagickPI*sigma*sigma);
+      i++;
+    }
+  }
+  blur_image=ConvolveImage(image,width,kernel,exception);
+  MagickFreeMemory(kernel);
+  if (blur_image != (Image *) NULL)
+    blur_image->is_grayscale=image->is_grayscale;
+  return(blur_image);
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%     G a u s s i a n B l u r I m a g e C h a n n e l                         %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  GaussianBlurImageChannel() blurs an image channel.  We convolve the image
+%  with a Gaussian operator of the given radius and standard deviation
+%  (sigma).  For reasonable results, the radius should be larger than sigma.
+%  Use a radius of 0 and GaussianBlurImage() selects a suitable radius for
+%  you.
+%
+%  The format of the GaussianBlurImageChannel method is:
+%
+%      Image *GaussianBlurImageChannel(const Image *image,
+%        const ChannelType channel,const double radius,
+%        const double sigma,ExceptionInfo *exception)
+%
+%  A description of each parameter follows:
+%
+%    o blur_image: Method GaussianBlurImage returns a pointer to the image
+%      after it is blur.  A null image is returned if there is a memory
+%      shortage.
+%
+%    o image: Image to blur.
+%
+%    o channel: Channel to blur in image.
+%
+%    o radius: the radius of the Gaussian, in pixels, not counting the center
+%      pixel.
+%
+%    o sigma: the standard deviation of the Gaussian, in pixels.
+%
+%    o exception: Return any errors or warnings in this structure.
+%
+%
+*/
+MagickExport Image *GaussianBlurImageChannel(const Image *image,
+  const ChannelType channel,const double radius,const double sigma,
+  ExceptionInfo *exception)
+{
+  Image
+    *blur_image;
+
+  blur_image=GaussianBlurImage(image,radius,sigma,exception);
+  if (blur_image != (Image *) NULL)
+    (void) ImportImageChannelsMasked(image,blur_image,channel);
+
+  return blur_image;
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%     M e d i a n F i l t e r I m a g e                                       %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  MedianFilterImage() applies a digital filter that improves the quality
+%  of a noisy image.  Each pixel is replaced by the median in a set of
+%  neighboring pixels as defined by radius.
+%
+%  The median is selected from sliding histograms of the neighborhood (see
+%  RankFilterImage()), so the cost does not grow with the square of the
+%  radius.
+%
+%  The format of the MedianFilterImage method is:
+%
 %      Image *MedianFilterImage(const Image *image,const double radius,
 %        ExceptionInfo *exception)
 %
@@ -2432,258 +3343,500 @@ MagickExport Image *GaussianBlurImageChannel(const Image *image,
 %
 */
 
-typedef struct _MedianListNode
+/*
+  Rank filters (median, minimum, maximum, or any percentile) are computed
+  with sliding histograms rather than by sorting the neighborhood of each
+  pixel.  Channel values are counted in two level histograms: one coarse
+  bin for each group of fine bins.  Selecting a rank scans the coarse
+  bins and then the fine bins of a single coarse bin.
+
+  For 8-bit quanta the image is processed in tiles using the
+  Perreault/Hebert algorithm: a histogram is kept for each column of the
+  tile (over the rows of the neighborhood), and the neighborhood
+  histogram is updated by adding and subtracting column histograms as it
+  slides along a row.  Fine bins are only brought up to date for the
+  coarse bin containing the selected rank, so the cost per pixel does
+  not depend on the radius.
+
+  For 16-bit quanta (larger quanta are reduced to 16 bits) column
+  histograms would be too large, so the neighborhood histogram slides
+  along a serpentine path through each tile (Huang's algorithm), adding
+  and removing one row or column of the neighborhood at each step.  The
+  cost per pixel grows linearly with the radius.
+*/
+#if QuantumDepth == 8
+#  define RankFineShift 4
+#  define RankQuantumToBin(quantum) ((unsigned int) (quantum))
+#  define RankBinToQuantum(bin) ((Quantum) (bin))
+#else
+#  define RankFineShift 8
+#  define RankQuantumToBin(quantum) ((unsigned int) ScaleQuantumToShort(quantum))
+#  define RankBinToQuantum(bin) ScaleShortToQuantum(bin)
+#endif
+#define RankCoarseBins (1U << RankFineShift)
+#define RankBins (RankCoarseBins*RankCoarseBins)
+#define RankTileColumns 128
+#define RankTileRows 64
+
+/*
+  Use column histograms if they are reasonably small.
+*/
+#define RankColumnHistograms (RankBins <= 256)
+
+typedef struct _RankColumnHistogram
+{
+  unsigned short
+    coarse[RankCoarseBins],
+    fine[RankBins];
+} RankColumnHistogram;
+
+typedef struct _RankHistogram
 {
   unsigned int
-    next[9],
-    count,
-    signature;
-} MedianListNode;
+    coarse[RankCoarseBins],
+    fine[RankBins];
+
+  /*
+    Neighborhood position at which the fine bins of each coarse bin
+    were last brought up to date from the column histograms, or -1.
+  */
+  long
+    synchronized[RankCoarseBins];
+} RankHistogram;
 
-typedef struct _MedianSkipList
+typedef struct _RankFilterScratch
 {
-  MedianListNode
-    *nodes;
+  RankHistogram
+    histograms[4];
 
-  int
-    level;
-} MedianSkipList;
+  RankColumnHistogram
+    *columns;
+} RankFilterScratch;
 
-typedef struct _MedianPixelList
+typedef struct _RankFilterOptions
 {
-  MedianSkipList
-    lists[4];
+  long
+    width;
+
+  unsigned long
+    count,
+    rank;
 
   unsigned int
-    center,
-    seed,
-    signature;
-} MedianPixelList;
-
-static void AddNodeMedianList(MedianPixelList *pixel_list,
-                              const unsigned int channel,
-                              const unsigned int color)
+    channels,
+    offsets[4];
+
+  MagickBool
+    is_grayscale,
+    matte,
+    nonpeak;
+} RankFilterOptions;
+
+static void DestroyRankFilterScratch(void *scratch)
 {
-  register MedianSkipList
-    *list;
+  RankFilterScratch
+    *rank_scratch;
 
-  register int
-    level;
+  rank_scratch=(RankFilterScratch *) scratch;
+  if (rank_scratch != (RankFilterScratch *) NULL)
+    MagickFreeAlignedMemory(rank_scratch->columns);
+  MagickFreeAlignedMemory(rank_scratch);
+}
 
-  unsigned int
-    search,
-    update[9];
+static RankFilterScratch *AllocateRankFilterScratch(const long width)
+{
+  RankFilterScratch
+    *scratch;
 
-  /*
-    Initialize the node.
-  */
-  list=pixel_list->lists+channel;
-  list->nodes[color].signature=pixel_list->signature;
-  list->nodes[color].count=1;
-  /*
-    Determine where it belongs in the list.
-    This loop consumes most of the time.
-  */
-  search=65536UL;
-  for (level=list->level; level >= 0; level--)
-    {
-      while (list->nodes[search].next[level] < color)
-        search=list->nodes[search].next[level];
-      update[level]=search;
-    }
-  /*
-    Generate a pseudo-random level for this node.
-  */
-  for (level=0; ; level++)
-    {
-      pixel_list->seed=(pixel_list->seed*42893621U)+1U;
-      if ((pixel_list->seed & 0x300) != 0x300)
-        break;
-    }
-  if (level > 8)
-    level=8;
-  if (level > (list->level+2))
-    level=list->level+2;
-  /*
-    If we're raising the list's level, link back to the root node.
-  */
-  while (level > list->level)
-    {
-      list->level++;
-      update[list->level]=65536U;
-    }
-  /*
-    Link the node into the skip-list.
-  */
-  do
+  scratch=MagickAllocateAlignedMemory(RankFilterScratch *,
+                                      MAGICK_CACHE_LINE_SIZE,
+                                      sizeof(RankFilterScratch));
+  if (scratch != (RankFilterScratch *) NULL)
     {
-      list->nodes[color].next[level]=list->nodes[update[level]].next[level];
-      list->nodes[update[level]].next[level]=color;
+      (void) memset(scratch,0,sizeof(RankFilterScratch));
+      if (RankColumnHistograms)
+        {
+          size_t
+            size;
+
+          size=MagickArraySize(MagickArraySize(RankTileColumns+width,4),
+                               sizeof(RankColumnHistogram));
+          if (size != 0)
+            scratch->columns=
+              MagickAllocateAlignedMemory(RankColumnHistogram *,
+                                          MAGICK_CACHE_LINE_SIZE,size);
+          if (scratch->columns == (RankColumnHistogram *) NULL)
+            {
+              DestroyRankFilterScratch(scratch);
+              scratch=(RankFilterScratch *) NULL;
+            }
+        }
     }
-  while (level-- > 0);
+  return scratch;
 }
 
-static void GetMedianList(MedianPixelList * restrict pixel_list,PixelPacket *median_pixel)
+static inline unsigned int
+RankChannelBin(const PixelPacket *pixel,const unsigned int offset)
+{
+  return RankQuantumToBin(((const Quantum *) pixel)[offset]);
+}
+
+/*
+  Bring the fine bins of a coarse bin of the neighborhood histogram up
+  to date for the neighborhood starting at column x.
+*/
+static void
+SynchronizeRankHistogram(RankHistogram * restrict histogram,
+                         const RankColumnHistogram * restrict columns,
+                         const unsigned int channel,const unsigned int coarse,
+                         const long x,const long width)
 {
-  register MedianSkipList
-    *list;
+  unsigned int
+    * restrict fine;
 
   register unsigned int
-    channel;
+    i;
 
-  unsigned int
-    center,
-    color,
-    count;
+  register long
+    column;
 
-  unsigned short
-    channels[4];
+  fine=histogram->fine+((size_t) coarse << RankFineShift);
+  column=histogram->synchronized[coarse];
+  if ((column < 0) || ((x-column) >= width))
+    {
+      for (i=0; i < RankCoarseBins; i++)
+        fine[i]=0;
+      for (column=x; column < x+width; column++)
+        {
+          const unsigned short
+            * restrict add;
 
-  /*
-    Find the median value for each of the colors.
-  */
-  center=pixel_list->center;
-  for (channel=0; channel < 4U; channel++)
+          add=columns[4*column+channel].fine+((size_t) coarse << RankFineShift);
+          for (i=0; i < RankCoarseBins; i++)
+            fine[i]+=add[i];
+        }
+    }
+  else
     {
-      list=pixel_list->lists+channel;
-      color=65536L;
-      count=0;
-      do
+      for ( ; column < x; column++)
         {
-          color=list->nodes[color].next[0];
-          count+=list->nodes[color].count;
+          const unsigned short
+            * restrict add,
+            * restrict subtract;
+
+          subtract=columns[4*column+channel].fine+
+            ((size_t) coarse << RankFineShift);
+          add=columns[4*(column+width)+channel].fine+
+            ((size_t) coarse << RankFineShift);
+          for (i=0; i < RankCoarseBins; i++)
+            fine[i]+=add[i]-subtract[i];
         }
-      while (count <= center); /* IM now uses count <= (center >> 1) */
-      channels[channel]=color;
     }
-  median_pixel->red=ScaleShortToQuantum(channels[0]);
-  median_pixel->green=ScaleShortToQuantum(channels[1]);
-  median_pixel->blue=ScaleShortToQuantum(channels[2]);
-  median_pixel->opacity=ScaleShortToQuantum(channels[3]);
+  histogram->synchronized[coarse]=x;
 }
 
-static inline void InsertMedianListChannel(MedianPixelList *pixel_list,
-                                           const unsigned int channel,
-                                           const Quantum quantum)
+/*
+  Return the bin holding the value of the specified rank (counting from
+  zero), and the number of values in lower bins.
+*/
+static unsigned int
+SelectRankHistogram(RankHistogram * restrict histogram,
+                    const RankColumnHistogram * restrict columns,
+                    const unsigned int channel,const long x,const long width,
+                    const unsigned long rank,unsigned long *below)
 {
-  register unsigned int
-    index;
+  unsigned long
+    count;
 
-  index=ScaleQuantumToShort(quantum);
-  if (pixel_list->lists[channel].nodes[index].signature == pixel_list->signature)
-    pixel_list->lists[channel].nodes[index].count++;
-  else
-    AddNodeMedianList(pixel_list,channel,index);
+  unsigned int
+    bin,
+    coarse;
+
+  count=0;
+  for (coarse=0; count+histogram->coarse[coarse] <= rank; coarse++)
+    count+=histogram->coarse[coarse];
+  if (columns != (const RankColumnHistogram *) NULL)
+    SynchronizeRankHistogram(histogram,columns,channel,coarse,x,width);
+  bin=coarse << RankFineShift;
+  for ( ; count+histogram->fine[bin] <= rank; bin++)
+    count+=histogram->fine[bin];
+  *below=count;
+  return bin;
 }
 
-static inline void InsertMedianList(MedianPixelList *pixel_list,
-                                    const PixelPacket *pixel)
+/*
+  Compute an output pixel from the neighborhood histograms.
+*/
+static void GetRankPixel(RankFilterScratch * restrict scratch,
+                         const RankFilterOptions *options,const long x,
+                         PixelPacket * restrict q)
 {
-  InsertMedianListChannel(pixel_list,0,pixel->red);
-  InsertMedianListChannel(pixel_list,1,pixel->green);
-  InsertMedianListChannel(pixel_list,2,pixel->blue);
-  InsertMedianListChannel(pixel_list,3,pixel->opacity);
+  unsigned int
+    channel;
+
+  for (channel=0; channel < options->channels; channel++)
+    {
+      RankHistogram
+        *histogram;
+
+      unsigned long
+        below;
+
+      unsigned int
+        bin;
+
+      histogram=scratch->histograms+channel;
+      bin=SelectRankHistogram(histogram,scratch->columns,channel,x,
+                              options->width,options->rank,&below);
+      if (options->nonpeak)
+        {
+          unsigned long
+            through;
+
+          /*
+            Do not let the result be the lowest or highest value in the
+            neighborhood, unless all values are the same.
+          */
+          through=below+histogram->fine[bin];
+          if ((below == 0) && (through < options->count))
+            bin=SelectRankHistogram(histogram,scratch->columns,channel,x,
+                                    options->width,through,&below);
+          else if ((below != 0) && (through == options->count))
+            bin=SelectRankHistogram(histogram,scratch->columns,channel,x,
+                                    options->width,below-1,&below);
+        }
+      ((Quantum *) q)[options->offsets[channel]]=RankBinToQuantum(bin);
+    }
+  if (options->is_grayscale)
+    q->green=q->blue=q->red;
+  if (!options->matte)
+    q->opacity=OpaqueOpacity;
 }
 
-static void ResetMedianList(MedianPixelList *pixel_list)
+static inline void
+AddRankPixel(RankFilterScratch * restrict scratch,
+             const RankFilterOptions *options,const PixelPacket *pixel)
 {
-  register MedianListNode
-    *root;
+  unsigned int
+    bin,
+    channel;
 
-  register MedianSkipList
-    *list;
+  for (channel=0; channel < options->channels; channel++)
+    {
+      bin=RankChannelBin(pixel,options->offsets[channel]);
+      scratch->histograms[channel].coarse[bin >> RankFineShift]++;
+      scratch->histograms[channel].fine[bin]++;
+    }
+}
 
-  register long
+static inline void
+RemoveRankPixel(RankFilterScratch * restrict scratch,
+                const RankFilterOptions *options,const PixelPacket *pixel)
+{
+  unsigned int
+    bin,
     channel;
 
-  int
-    level;
-
-  /*
-    Reset the skip-list.
-  */
-  for (channel=0; channel < 4; channel++)
+  for (channel=0; channel < options->channels; channel++)
     {
-      list=pixel_list->lists+channel;
-      root=list->nodes+65536UL;
-      list->level=0;
-      for (level=0; level < 9; level++)
-        root->next[level]=65536UL;
+      bin=RankChannelBin(pixel,options->offsets[channel]);
+      scratch->histograms[channel].coarse[bin >> RankFineShift]--;
+      scratch->histograms[channel].fine[bin]--;
     }
-  pixel_list->seed=pixel_list->signature++;
 }
 
-static void DestroyMedianList(void *pixel_list)
+/*
+  Filter a tile using column histograms.  The input pixels p are
+  (tile_width+width-1) by (tile_height+width-1).
+*/
+static void RankFilterTileColumns(RankFilterScratch * restrict scratch,
+                                  const RankFilterOptions *options,
+                                  const PixelPacket * restrict p,
+                                  const unsigned long tile_width,
+                                  const unsigned long tile_height,
+                                  PixelPacket * restrict q)
 {
-  MedianPixelList
-    *skiplist;
+  RankColumnHistogram
+    * restrict columns;
+
+  const long
+    width=options->width;
 
-  skiplist=(MedianPixelList *) pixel_list;
+  const unsigned long
+    input_columns=tile_width+width-1;
+
+  unsigned int
+    bin,
+    channel;
+
+  long
+    column,
+    x,
+    y;
 
-  if (skiplist != (void *) NULL)
+  columns=scratch->columns;
+  (void) memset(columns,0,input_columns*4*sizeof(RankColumnHistogram));
+  for (y=0; y < width; y++)
+    for (column=0; column < (long) input_columns; column++)
+      for (channel=0; channel < options->channels; channel++)
+        {
+          bin=RankChannelBin(p+(size_t) y*input_columns+column,
+                             options->offsets[channel]);
+          columns[4*column+channel].coarse[bin >> RankFineShift]++;
+          columns[4*column+channel].fine[bin]++;
+        }
+  for (y=0; y < (long) tile_height; y++)
     {
-      unsigned int
-        i;
+      if (y > 0)
+        {
+          /*
+            Move the column histograms down one row.
+          */
+          for (column=0; column < (long) input_columns; column++)
+            for (channel=0; channel < options->channels; channel++)
+              {
+                bin=RankChannelBin(p+(size_t) (y-1)*input_columns+column,
+                                   options->offsets[channel]);
+                columns[4*column+channel].coarse[bin >> RankFineShift]--;
+                columns[4*column+channel].fine[bin]--;
+                bin=RankChannelBin(p+(size_t) (y+width-1)*input_columns+
+                                   column,options->offsets[channel]);
+                columns[4*column+channel].coarse[bin >> RankFineShift]++;
+                columns[4*column+channel].fine[bin]++;
+              }
+        }
+      for (channel=0; channel < options->channels; channel++)
+        {
+          RankHistogram
+            *histogram;
+
+          histogram=scratch->histograms+channel;
+          for (bin=0; bin < RankCoarseBins; bin++)
+            {
+              histogram->coarse[bin]=0;
+              histogram->synchronized[bin]=(-1);
+            }
+          for (column=0; column < width; column++)
+            for (bin=0; bin < RankCoarseBins; bin++)
+              histogram->coarse[bin]+=columns[4*column+channel].coarse[bin];
+        }
+      for (x=0; x < (long) tile_width; x++)
+        {
+          if (x > 0)
+            for (channel=0; channel < options->channels; channel++)
+              {
+                const unsigned short
+                  * restrict add,
+                  * restrict subtract;
 
-      for (i=0; i < 4U; i++)
-        MagickFreeAlignedMemory(skiplist->lists[i].nodes);
+                unsigned int
+                  * restrict coarse;
+
+                coarse=scratch->histograms[channel].coarse;
+                subtract=columns[4*(x-1)+channel].coarse;
+                add=columns[4*(x+width-1)+channel].coarse;
+                for (bin=0; bin < RankCoarseBins; bin++)
+                  coarse[bin]+=add[bin]-subtract[bin];
+              }
+          GetRankPixel(scratch,options,x,q+(size_t) y*tile_width+x);
+        }
     }
-  MagickFreeAlignedMemory(skiplist);
 }
 
-static MedianPixelList *AllocateMedianList(const long width)
+/*
+  Filter a tile by sliding the neighborhood histogram along a
+  serpentine path.  The histograms are empty on entry and on exit.
+*/
+static void RankFilterTileSerpentine(RankFilterScratch * restrict scratch,
+                                     const RankFilterOptions *options,
+                                     const PixelPacket * restrict p,
+                                     const unsigned long tile_width,
+                                     const unsigned long tile_height,
+                                     PixelPacket * restrict q)
 {
-  MedianPixelList
-    *skiplist;
+  const long
+    width=options->width;
 
-  skiplist=MagickAllocateAlignedMemory(MedianPixelList *,
-                                       MAGICK_CACHE_LINE_SIZE,
-                                       sizeof(MedianPixelList));
-  if (skiplist != (MedianPixelList *) NULL)
-    {
-      unsigned int
-        i;
+  const unsigned long
+    input_columns=tile_width+width-1;
 
-      const size_t
-        node_list_size = 65537U*sizeof(MedianListNode);
+  long
+    i,
+    u,
+    v,
+    x,
+    y;
 
-      (void) memset(skiplist,0,sizeof(MedianPixelList));
-      skiplist->center=width*width/2;
-      skiplist->signature=MagickSignature;
-      for (i=0; i < 4U; i++)
+  for (v=0; v < width; v++)
+    for (u=0; u < width; u++)
+      AddRankPixel(scratch,options,p+(size_t) v*input_columns+u);
+  x=0;
+  for (y=0; y < (long) tile_height; y++)
+    {
+      if (y > 0)
+        for (u=x; u < x+width; u++)
+          {
+            RemoveRankPixel(scratch,options,p+(size_t) (y-1)*input_columns+u);
+            AddRankPixel(scratch,options,
+                         p+(size_t) (y+width-1)*input_columns+u);
+          }
+      for (i=0; i < (long) tile_width; i++)
         {
-          skiplist->lists[i].nodes =
-            MagickAllocateAlignedMemory(MedianListNode *,MAGICK_CACHE_LINE_SIZE,
-                                        node_list_size);
-          if (skiplist->lists[i].nodes == (MedianListNode *) NULL)
+          if (i > 0)
             {
-              DestroyMedianList(skiplist);
-              skiplist=(MedianPixelList *) NULL;
-              break;
+              long
+                add,
+                remove;
+
+              if ((y % 2) == 0)
+                {
+                  remove=x;
+                  add=x+width;
+                  x++;
+                }
+              else
+                {
+                  remove=x+width-1;
+                  add=x-1;
+                  x--;
+                }
+              for (v=y; v < y+width; v++)
+                {
+                  RemoveRankPixel(scratch,options,
+                                  p+(size_t) v*input_columns+remove);
+                  AddRankPixel(scratch,options,p+(size_t) v*input_columns+add);
+                }
             }
-          (void) memset(skiplist->lists[i].nodes,0,node_list_size);
+          GetRankPixel(scratch,options,x,q+(size_t) y*tile_width+x);
         }
     }
-  return skiplist;
+  for (v=y-1; v < y-1+width; v++)
+    for (u=x; u < x+width; u++)
+      RemoveRankPixel(scratch,options,p+(size_t) v*input_columns+u);
 }
 
-MagickExport Image *MedianFilterImage(const Image *image,const double radius,
-                                      ExceptionInfo *exception)
+static Image *RankFilter(const Image *image,const double radius,
+                         const double percentile,const MagickBool nonpeak,
+                         const char *format,ExceptionInfo *exception)
 {
-#define MedianFilterImageText "[%s] Filter with neighborhood ranking..."
-
   Image
-    *median_image;
+    *rank_image;
 
-  long
-    width,
-    y;
+  RankFilterOptions
+    options;
 
   ThreadViewDataSet
     *data_set;
 
   unsigned long
-    row_count=0;
+    tile_columns,
+    tile_count,
+    tile_rows,
+    tiles_across,
+    tiles_done=0;
+
+  long
+    tile;
 
   MagickBool
     monitor_active;
@@ -2691,26 +3844,47 @@ MagickExport Image *MedianFilterImage(const Image *image,const double radius,
   MagickPassFail
     status=MagickPass;
 
-  /*
-    Initialize median image attributes.
-  */
   assert(image != (Image *) NULL);
   assert(image->signature == MagickSignature);
   assert(exception != (ExceptionInfo *) NULL);
   assert(exception->signature == MagickSignature);
-  width=GetOptimalKernelWidth2D(radius,0.5);
-  if (((long) image->columns < width) || ((long) image->rows < width))
+  options.width=GetOptimalKernelWidth2D(radius,0.5);
+  if (((long) image->columns < options.width) ||
+      ((long) image->rows < options.width))
     ThrowImageException3(OptionError,UnableToFilterImage,
                          ImageSmallerThanRadius);
-  median_image=CloneImage(image,image->columns,image->rows,MagickTrue,exception);
-  if (median_image == (Image *) NULL)
+  options.count=(unsigned long) options.width*options.width;
+  if (!(percentile > 0.0))
+    options.rank=0; /* Also NaN */
+  else if (percentile >= 100.0)
+    options.rank=options.count-1;
+  else
+    options.rank=(unsigned long) (percentile*(options.count-1)/100.0+0.5);
+  options.is_grayscale=image->is_grayscale;
+  options.matte=((image->matte) || (image->colorspace == CMYKColorspace));
+  options.nonpeak=nonpeak;
+  options.channels=0;
+  options.offsets[options.channels++]=
+    offsetof(PixelPacket,red)/sizeof(Quantum);
+  if (!options.is_grayscale)
+    {
+      options.offsets[options.channels++]=
+        offsetof(PixelPacket,green)/sizeof(Quantum);
+      options.offsets[options.channels++]=
+        offsetof(PixelPacket,blue)/sizeof(Quantum);
+    }
+  if (options.matte)
+    options.offsets[options.channels++]=
+      offsetof(PixelPacket,opacity)/sizeof(Quantum);
+  rank_image=CloneImage(image,image->columns,image->rows,MagickTrue,exception);
+  if (rank_image == (Image *) NULL)
     return ((Image *) NULL);
-
-  median_image->storage_class=DirectClass;
+  rank_image->storage_class=DirectClass;
   /*
-    Allocate skip-lists.
+    Allocate histograms.
   */
-  data_set=AllocateThreadViewDataSet(DestroyMedianList,image,exception);
+  data_set=AllocateThreadViewDataSet(DestroyRankFilterScratch,image,
+                                     exception);
   if (data_set != (ThreadViewDataSet *) NULL)
     {
       unsigned int
@@ -2720,13 +3894,13 @@ MagickExport Image *MedianFilterImage(const Image *image,const double radius,
       views=GetThreadViewDataSetAllocatedViews(data_set);
       for (i=0; i < views; i++)
         {
-          MedianPixelList
-            *skiplist;
+          RankFilterScratch
+            *scratch;
 
-          skiplist=AllocateMedianList(width);
-          if (skiplist != (MedianPixelList *) NULL)
+          scratch=AllocateRankFilterScratch(options.width);
+          if (scratch != (RankFilterScratch *) NULL)
             {
-              AssignThreadViewData(data_set,i,skiplist);
+              AssignThreadViewData(data_set,i,scratch);
               continue;
             }
 
@@ -2737,102 +3911,114 @@ MagickExport Image *MedianFilterImage(const Image *image,const double radius,
     }
   if (data_set == (ThreadViewDataSet *) NULL)
     {
-      DestroyImage(median_image);
-      return ((Image *) NULL);
+      DestroyImage(rank_image);
+      ThrowImageException(ResourceLimitError,MemoryAllocationFailed,
+                          MagickMsg(OptionError,UnableToFilterImage));
     }
+  tile_columns=Min(image->columns,RankTileColumns);
+  tile_rows=Min(image->rows,Max(RankTileRows,(unsigned long) options.width));
+  tiles_across=(image->columns+tile_columns-1)/tile_columns;
+  tile_count=tiles_across*((image->rows+tile_rows-1)/tile_rows);
   monitor_active=MagickMonitorActive();
-  {
+
 #if defined(HAVE_OPENMP)
 #  if defined(TUNE_OPENMP)
-#    pragma omp parallel for schedule(runtime) shared(row_count, status)
+#    pragma omp parallel for schedule(runtime) shared(tiles_done, status)
 #  else
-#    pragma omp parallel for schedule(guided) shared(row_count, status)
+#    pragma omp parallel for schedule(dynamic) shared(tiles_done, status)
 #  endif
 #endif
-    for (y=0; y < (long) median_image->rows; y++)
-      {
-        register MedianPixelList
-          *skiplist;
-
-        const PixelPacket
-          *p;
-
-        PixelPacket
-          *q;
+  for (tile=0; tile < (long) tile_count; tile++)
+    {
+      RankFilterScratch
+        *scratch;
 
-        long
-          x;
+      const PixelPacket
+        *p;
 
-        MagickBool
-          thread_status;
+      PixelPacket
+        *q;
 
-        thread_status=status;
-        if (thread_status == MagickFail)
-          continue;
+      long
+        x0,
+        y0;
 
-        skiplist=AccessThreadViewData(data_set);
-        p=AcquireImagePixels(image,-width/2,y-width/2,
-                             image->columns+width,width,exception);
-        q=SetImagePixelsEx(median_image,0,y,median_image->columns,1,exception);
-        if ((p == (const PixelPacket *) NULL) || (q == (PixelPacket *) NULL))
-          thread_status=MagickFail;
-        if (thread_status != MagickFail)
-          {
-            for (x=0; x < (long) median_image->columns; x++)
-              {
-                register const PixelPacket
-                  *r;
+      unsigned long
+        tile_height,
+        tile_width;
 
-                register long
-                  u,
-                  v;
+      MagickBool
+        thread_status;
 
-                ResetMedianList(skiplist);
-                r=&p[x];
-                for (v=0; v < width; v++)
-                  {
-                    for (u=0; u < width; u++)
-                      InsertMedianList(skiplist,&r[u]);
-                    r+=(size_t) image->columns+width;
-                  }
-                GetMedianList(skiplist,&q[x]);
-              }
-            if (!SyncImagePixelsEx(median_image,exception))
-              thread_status=MagickFail;
-          }
-        if (monitor_active)
-          {
-            unsigned long
-              thread_row_count;
+      thread_status=status;
+      if (thread_status == MagickFail)
+        continue;
+
+      x0=(long) ((tile % tiles_across)*tile_columns);
+      y0=(long) ((tile / tiles_across)*tile_rows);
+      tile_width=Min(tile_columns,image->columns-x0);
+      tile_height=Min(tile_rows,image->rows-y0);
+      scratch=AccessThreadViewData(data_set);
+      p=AcquireImagePixels(image,x0-options.width/2,y0-options.width/2,
+                           tile_width+options.width-1,
+                           tile_height+options.width-1,exception);
+      q=SetImagePixelsEx(rank_image,x0,y0,tile_width,tile_height,exception);
+      if ((p == (const PixelPacket *) NULL) || (q == (PixelPacket *) NULL))
+        thread_status=MagickFail;
+      if (thread_status != MagickFail)
+        {
+          if (scratch->columns != (RankColumnHistogram *) NULL)
+            RankFilterTileColumns(scratch,&options,p,tile_width,tile_height,q);
+          else
+            RankFilterTileSerpentine(scratch,&options,p,tile_width,
+                                     tile_height,q);
+          if (!SyncImagePixelsEx(rank_image,exception))
+            thread_status=MagickFail;
+        }
+      if (monitor_active)
+        {
+          unsigned long
+            thread_tiles_done;
 
 #if defined(HAVE_OPENMP)
 #  pragma omp atomic
 #endif
-            row_count++;
+          tiles_done++;
 #if defined(HAVE_OPENMP)
-#  pragma omp flush (row_count)
+#  pragma omp flush (tiles_done)
 #endif
-            thread_row_count=row_count;
-            if (QuantumTick(thread_row_count,median_image->rows))
-              if (!MagickMonitorFormatted(thread_row_count,median_image->rows,exception,
-                                          MedianFilterImageText,
-                                          median_image->filename))
-                thread_status=MagickFail;
-          }
+          thread_tiles_done=tiles_done;
+          if (QuantumTick(thread_tiles_done,tile_count))
+            if (!MagickMonitorFormatted(thread_tiles_done,tile_count,exception,
+                                        format,image->filename))
+              thread_status=MagickFail;
+        }
 
-        if (thread_status == MagickFail)
-          {
-            status=MagickFail;
+      if (thread_status == MagickFail)
+        {
+          status=MagickFail;
 #if defined(HAVE_OPENMP)
 #  pragma omp flush (status)
 #endif
-          }
-      }
-  }
+        }
+    }
   DestroyThreadViewDataSet(data_set);
-  if (median_image != (Image *) NULL)
-    median_image->is_grayscale=image->is_grayscale;
-  return(median_image);
+  if (status == MagickFail)
+    {
+      DestroyImage(rank_image);
+      return ((Image *) NULL);
+    }
+  rank_image->is_grayscale=image->is_grayscale;
+  return(rank_image);
+}
+
+MagickExport Image *MedianFilterImage(const Image *image,const double radius,
+                                      ExceptionInfo *exception)
+{
+#define MedianFilterImageText "[%s] Filter with neighborhood ranking..."
+
+  return RankFilter(image,radius,50.0,MagickFalse,MedianFilterImageText,
+                    exception);
 }
 
 /*
@@ -3620,6 +4806,50 @@ RandomChannelThresholdImage(Image *image,const char *channel,
   return (status);
 }
 
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%     R a n k F i l t e r I m a g e                                           %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  RankFilterImage() replaces each pixel by the value of the given
+%  percentile of the values of each channel in a set of neighboring pixels
+%  as defined by radius.  A percentile of 50 selects the median (as does
+%  MedianFilterImage()), 0 selects the minimum, and 100 selects the
+%  maximum.
+%
+%  The format of the RankFilterImage method is:
+%
+%      Image *RankFilterImage(const Image *image,const double radius,
+%        const double percentile,ExceptionInfo *exception)
+%
+%  A description of each parameter follows:
+%
+%    o image: The image.
+%
+%    o radius: The radius of the pixel neighborhood.
+%
+%    o percentile: The percentile (0 to 100) of the neighborhood values
+%      to select.
+%
+%    o exception: Return any errors or warnings in this structure.
+%
+%
+*/
+MagickExport Image *RankFilterImage(const Image *image,const double radius,
+                                    const double percentile,
+                                    ExceptionInfo *exception)
+{
+#define RankFilterImageText "[%s] Filter with neighborhood ranking..."
+
+  return RankFilter(image,radius,percentile,MagickFalse,RankFilterImageText,
+                    exception);
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -3651,227 +4881,13 @@ RandomChannelThresholdImage(Image *image,const char *channel,
 %
 */
 
-static PixelPacket GetNonpeakMedianList(MedianPixelList *pixel_list) MAGICK_FUNC_PURE;
-
-static PixelPacket GetNonpeakMedianList(MedianPixelList *pixel_list)
-{
-  PixelPacket
-    pixel;
-
-  register MedianSkipList
-    *list;
-
-  register long
-    channel;
-
-  unsigned long
-    channels[4],
-    center,
-    color,
-    count,
-    previous,
-    next;
-
-  /*
-    Finds the median value for each of the color.
-  */
-  center=pixel_list->center;
-  for (channel=0; channel < 4; channel++)
-  {
-    list=pixel_list->lists+channel;
-    color=65536L;
-    next=list->nodes[color].next[0];
-    count=0;
-    do
-    {
-      previous=color;
-      color=next;
-      next=list->nodes[color].next[0];
-      count+=list->nodes[color].count;
-    }
-    while (count <= center);
-    if ((previous == 65536L) && (next != 65536L))
-      color=next;
-    else
-      if ((previous != 65536L) && (next == 65536L))
-        color=previous;
-    channels[channel]=color;
-  }
-  pixel.red=ScaleShortToQuantum(channels[0]);
-  pixel.green=ScaleShortToQuantum(channels[1]);
-  pixel.blue=ScaleShortToQuantum(channels[2]);
-  pixel.opacity=ScaleShortToQuantum(channels[3]);
-  return(pixel);
-}
-
 MagickExport Image *ReduceNoiseImage(const Image *image,const double radius,
                                      ExceptionInfo *exception)
 {
 #define ReduceNoiseImageText "[%s] Reduce noise...  "
 
-  Image
-    *noise_image;
-
-  long
-    width,
-    y;
-
-  ThreadViewDataSet
-    *data_set;
-
-  unsigned long
-    row_count=0;
-
-  MagickBool
-    monitor_active;
-
-  MagickPassFail
-    status=MagickPass;
-
-  /*
-    Initialize noise image attributes.
-  */
-  assert(image != (Image *) NULL);
-  assert(image->signature == MagickSignature);
-  assert(exception != (ExceptionInfo *) NULL);
-  assert(exception->signature == MagickSignature);
-  width=GetOptimalKernelWidth2D(radius,0.5);
-  if (((long) image->columns < width) || ((long) image->rows < width))
-    ThrowImageException3(OptionError,UnableToFilterImage,
-                         ImageSmallerThanRadius);
-  noise_image=CloneImage(image,image->columns,image->rows,True,exception);
-  if (noise_image == (Image *) NULL)
-    return ((Image *) NULL);
-
-  noise_image->storage_class=DirectClass;
-  /*
-    Allocate and initialize skip-lists.
-  */
-  data_set=AllocateThreadViewDataSet(DestroyMedianList,image,exception);
-  if (data_set != (ThreadViewDataSet *) NULL)
-    {
-      unsigned int
-        i,
-        views;
-
-      views=GetThreadViewDataSetAllocatedViews(data_set);
-      for (i=0; i < views; i++)
-        {
-          MedianPixelList
-            *skiplist;
-
-          skiplist=AllocateMedianList(width);
-          if (skiplist != (MedianPixelList *) NULL)
-            {
-              AssignThreadViewData(data_set,i,skiplist);
-              continue;
-            }
-
-          DestroyThreadViewDataSet(data_set);
-          data_set=(ThreadViewDataSet *) NULL;
-          break;
-        }
-    }
-  if (data_set == (ThreadViewDataSet *) NULL)
-    {
-      DestroyImage(noise_image);
-      return ((Image *) NULL);
-    }
-
-  monitor_active=MagickMonitorActive();
-
-#if defined(HAVE_OPENMP)
-#  if defined(TUNE_OPENMP)
-#    pragma omp parallel for schedule(runtime) shared(row_count, status)
-#  else
-#    pragma omp parallel for schedule(guided) shared(row_count, status)
-#  endif
-#endif
-  for (y=0; y < (long) noise_image->rows; y++)
-    {
-      const PixelPacket
-        *p;
-
-      PixelPacket
-        *q;
-
-      long
-        x;
-
-      MedianPixelList
-        *skiplist;
-
-      MagickBool
-        thread_status;
-
-      thread_status=status;
-      if (thread_status == MagickFail)
-        continue;
-
-      skiplist=AccessThreadViewData(data_set);
-      p=AcquireImagePixels(image,-width/2,y-width/2,
-                           image->columns+width,width,exception);
-      q=SetImagePixelsEx(noise_image,0,y,noise_image->columns,1,exception);
-      if ((p == (const PixelPacket *) NULL) || (q == (PixelPacket *) NULL))
-        thread_status=MagickFail;
-      if (thread_status != MagickFail)
-        {
-          for (x=0; x < (long) noise_image->columns; x++)
-            {
-              register const PixelPacket
-                *r;
-
-              register long
-                u,
-                v;
-
-              r=p;
-              ResetMedianList(skiplist);
-              for (v=width; v > 0; v--)
-                {
-                  for (u=0; u < width; u++)
-                    InsertMedianList(skiplist,&r[u]);
-                  r+=(size_t) image->columns+width;
-                }
-              q[x]=GetNonpeakMedianList(skiplist);
-              p++;
-            }
-          if (!SyncImagePixelsEx(noise_image,exception))
-            thread_status=MagickFail;
-        }
-
-      if (monitor_active)
-        {
-          unsigned long
-            thread_row_count;
-
-#if defined(HAVE_OPENMP)
-#  pragma omp atomic
-#endif
-          row_count++;
-#if defined(HAVE_OPENMP)
-#  pragma omp flush (row_count)
-#endif
-          thread_row_count=row_count;
-          if (QuantumTick(thread_row_count,noise_image->rows))
-            if (!MagickMonitorFormatted(thread_row_count,noise_image->rows,exception,
-                                        ReduceNoiseImageText,
-                                        noise_image->filename))
-              thread_status=MagickFail;
-        }
-
-      if (thread_status == MagickFail)
-        {
-          status=MagickFail;
-#if defined(HAVE_OPENMP)
-#  pragma omp flush (status)
-#endif
-        }
-    }
-  DestroyThreadViewDataSet(data_set);
-  if (noise_image != (Image *) NULL)
-    noise_image->is_grayscale=image->is_grayscale;
-  return(noise_image);
+  return RankFilter(image,radius,50.0,MagickTrue,ReduceNoiseImageText,
+                    exception);
 }
 
 /*
@@ -4131,6 +5147,9 @@ MagickExport Image *SharpenImage(const Image *image,const double radius,
     *kernel,
     normalize;
 
+  GaussianMethod
+    method;
+
   Image
     *sharp_image;
 
@@ -4150,6 +5169,46 @@ MagickExport Image *SharpenImage(const Image *image,const double radius,
   if (((long) image->columns < width) || ((long) image->rows < width))
     ThrowImageException3(OptionError,UnableToSharpenImage,
       ImageSmallerThanRadius);
+  method=GetGaussianMethod(sigma);
+  if ((method != ConvolveGaussianMethod) && (sigma >= MagickEpsilon))
+    {
+      double
+        center;
+
+      MagickPassFail
+        status;
+
+      /*
+        The sharpen kernel is the Gaussian with its center weight
+        replaced by -2 times the kernel sum, so the normalized result
+        is ((2+center)*pixel-blurred_pixel)/(1+center), where center is
+        the center weight of the normalized Gaussian.
+      */
+      center=0.0;
+      for (u=(-width/2); u <= (width/2); u++)
+        center+=exp(-((double) u*u)/(2.0*sigma*sigma));
+      center=1.0/(center*center);
+      sharp_image=CloneImage(image,image->columns,image->rows,MagickTrue,
+                             exception);
+      if (sharp_image == (Image *) NULL)
+        return((Image *) NULL);
+      sharp_image->storage_class=DirectClass;
+      if (method == RecursiveGaussianMethod)
+        status=RecursiveGaussianImage(image,sharp_image,sigma,
+                                      (2.0+center)/(1.0+center),
+                                      -1.0/(1.0+center),exception);
+      else
+        status=SeparableGaussianImage(image,sharp_image,width,sigma,
+                                      (2.0+center)/(1.0+center),
+                                      -1.0/(1.0+center),exception);
+      if (status == MagickFail)
+        {
+          DestroyImage(sharp_image);
+          return((Image *) NULL);
+        }
+      sharp_image->is_grayscale=image->is_grayscale;
+      return(sharp_image);
+    }
   kernel=MagickAllocateArray(double *,MagickArraySize(width,width),sizeof(double));
   if (kernel == (double *) NULL)
     ThrowImageException3(ResourceLimitError,MemoryAllocationFailed,
@@ -37,6 +37,7 @@ extern MagickExport Image
   *MedianFilterImage(const Image *,const double,ExceptionInfo *),
   *MotionBlurImage(const Image *,const double,const double,const double,
      ExceptionInfo *),
+  *RankFilterImage(const Image *,const double,const double,ExceptionInfo *),
   *ReduceNoiseImage(const Image *,const double,ExceptionInfo *),
   *ShadeImage(const Image *,const unsigned int,double,double,ExceptionInfo *),
   *SharpenImage(const Image *,const double,const double,ExceptionInfo *),
@@ -47,6 +47,8 @@
 #include "magick/pixel_iterator.h"
 #include "magick/log.h"
 #include "magick/monitor.h"
+#include "magick/omp_data_view.h"
+#include "magick/pixel_cache.h"
 #include "magick/utility.h"
 
 static MagickPassFail
@@ -528,6 +530,144 @@ GammaCorrect(const double value, const double gamma)
   return pow(value,1.0/gamma);
 }
 
+/*
+  Levels transfer function for images which use FloatPixelFormat.  Each
+  channel with a non-zero gamma is mapped so that black becomes zero and
+  white becomes MaxRGB, with the gamma applied in between.  The function
+  is evaluated directly rather than via a look-up table and the result
+  is neither rounded nor clamped, so values outside of black and white
+  are extrapolated (mirrored through the origin when negative).
+*/
+typedef struct _FloatLevels_t
+{
+  double
+    black,
+    white;
+
+  DoublePixelPacket
+    gamma;  /* Zero leaves the channel unchanged */
+} FloatLevels_t;
+
+static inline float
+FloatLevel(const float value,const double black,const double white,
+           const double gamma)
+{
+  double
+    normalized;
+
+  normalized=((double) value-black)/(white-black);
+  if (normalized < 0.0)
+    return (float) (-MaxRGBDouble*pow(-normalized,1.0/gamma));
+  return (float) (MaxRGBDouble*pow(normalized,1.0/gamma));
+}
+
+static MagickPassFail
+FloatLevelImage(Image *image,const FloatLevels_t *levels,
+                const char *description)
+{
+  ThreadViewDataSet
+    *row_set;
+
+  long
+    y;
+
+  unsigned long
+    row_count=0;
+
+  MagickBool
+    monitor_active;
+
+  MagickPassFail
+    status=MagickPass;
+
+  row_set=AllocateThreadViewDataArray(image,&image->exception,image->columns,
+                                      sizeof(FloatPixelPacket));
+  if (row_set == (ThreadViewDataSet *) NULL)
+    return MagickFail;
+
+  monitor_active=MagickMonitorActive();
+
+#if defined(HAVE_OPENMP)
+#  if defined(TUNE_OPENMP)
+#    pragma omp parallel for schedule(runtime) shared(row_count, status)
+#  else
+#    pragma omp parallel for schedule(static,4) shared(row_count, status)
+#  endif
+#endif
+  for (y=0; y < (long) image->rows; y++)
+    {
+      FloatPixelPacket
+        * restrict pixels;
+
+      register long
+        x;
+
+      MagickBool
+        thread_status;
+
+      thread_status=status;
+      if (thread_status == MagickFail)
+        continue;
+
+      pixels=AccessThreadViewData(row_set);
+      if (!AcquireImageFloatPixels(image,0,y,image->columns,1,pixels,
+                                   &image->exception))
+        thread_status=MagickFail;
+      if (thread_status != MagickFail)
+        {
+          for (x=0; x < (long) image->columns; x++)
+            {
+              if (levels->gamma.red != 0.0)
+                pixels[x].red=FloatLevel(pixels[x].red,levels->black,
+                                         levels->white,levels->gamma.red);
+              if (levels->gamma.green != 0.0)
+                pixels[x].green=FloatLevel(pixels[x].green,levels->black,
+                                           levels->white,levels->gamma.green);
+              if (levels->gamma.blue != 0.0)
+                pixels[x].blue=FloatLevel(pixels[x].blue,levels->black,
+                                          levels->white,levels->gamma.blue);
+              if (levels->gamma.opacity != 0.0)
+                pixels[x].opacity=FloatLevel(pixels[x].opacity,levels->black,
+                                             levels->white,
+                                             levels->gamma.opacity);
+            }
+          if (!StoreImageFloatPixels(image,0,y,image->columns,1,pixels,
+                                     &image->exception))
+            thread_status=MagickFail;
+        }
+
+      if (monitor_active)
+        {
+          unsigned long
+            thread_row_count;
+
+#if defined(HAVE_OPENMP)
+#  pragma omp atomic
+#endif
+          row_count++;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (row_count)
+#endif
+          thread_row_count=row_count;
+          if (QuantumTick(thread_row_count,image->rows))
+            if (!MagickMonitorFormatted(thread_row_count,image->rows,
+                                        &image->exception,description,
+                                        image->filename))
+              thread_status=MagickFail;
+        }
+
+      if (thread_status == MagickFail)
+        {
+          status=MagickFail;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (status)
+#endif
+        }
+    }
+  DestroyThreadViewDataSet(row_set);
+  return status;
+}
+
 #if MaxMap != MaxRGB
 typedef DoublePixelPacket GammaCorrectPixelsOptions_t;
 
@@ -648,6 +788,25 @@ MagickExport MagickPassFail GammaImage(Image *image,const char *level)
   if (!level_color && !level_red && !level_green && !level_blue)
     return(MagickPass);
 
+  if ((image->storage_class == DirectClass) &&
+      (GetImagePixelFormat(image) == FloatPixelFormat))
+    {
+      FloatLevels_t
+        levels;
+
+      /*
+        Apply gamma to floating point pixels.
+      */
+      levels.black=0.0;
+      levels.white=MaxRGBDouble;
+      levels.gamma.red=(level_color || level_red ? gamma_red : 0.0);
+      levels.gamma.green=(level_color || level_green ? gamma_green : 0.0);
+      levels.gamma.blue=(level_color || level_blue ? gamma_blue : 0.0);
+      levels.gamma.opacity=0.0;
+      status=FloatLevelImage(image,&levels,
+                             "[%s] Applying gamma correction...");
+    }
+  else
 #if MaxMap == MaxRGB
   {
     ApplyLevelsDiscrete_t
@@ -933,11 +1092,56 @@ MagickExport MagickPassFail LevelImageChannel(Image *image,
   MagickPassFail
     status=MagickPass;
 
+  assert(image != (Image *) NULL);
+  assert(image->signature == MagickSignature);
+  if ((image->storage_class == DirectClass) &&
+      (GetImagePixelFormat(image) == FloatPixelFormat))
+    {
+      FloatLevels_t
+        float_levels;
+
+      /*
+        Level floating point pixels.
+      */
+      float_levels.black=black_point;
+      float_levels.white=white_point;
+      float_levels.gamma.red=float_levels.gamma.green=
+        float_levels.gamma.blue=float_levels.gamma.opacity=0.0;
+      switch (channel)
+        {
+        case RedChannel:
+        case CyanChannel:
+          float_levels.gamma.red=mid_point;
+          break;
+        case GreenChannel:
+        case MagentaChannel:
+          float_levels.gamma.green=mid_point;
+          break;
+        case BlueChannel:
+        case YellowChannel:
+          float_levels.gamma.blue=mid_point;
+          break;
+        case OpacityChannel:
+        case BlackChannel:
+          float_levels.gamma.opacity=mid_point;
+          break;
+        case AllChannels:
+          float_levels.gamma.red=float_levels.gamma.green=
+            float_levels.gamma.blue=mid_point;
+          is_grayscale=image->is_grayscale;
+          break;
+        default:
+          break;
+        }
+      if (white_point == black_point)
+        float_levels.white=black_point+1.0;
+      status=FloatLevelImage(image,&float_levels,"[%s] Leveling channels...");
+      image->is_grayscale=is_grayscale;
+      return(status);
+    }
   /*
     Allocate and initialize levels map.
   */
-  assert(image != (Image *) NULL);
-  assert(image->signature == MagickSignature);
   levels.map=MagickAllocateArray(PixelPacket *,(MaxMap+1),sizeof(PixelPacket));
   if (levels.map == (PixelPacket *) NULL)
     ThrowBinaryException3(ResourceLimitError,MemoryAllocationFailed,
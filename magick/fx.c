@@ -882,6 +882,7 @@ MagickExport Image *MorphImages(const Image *image,
     i;
 
   unsigned long
+    image_list_length,
     scene;
 
   /*
@@ -921,6 +922,7 @@ MagickExport Image *MorphImages(const Image *image,
     Morph image sequence.
   */
   scene=0;
+  image_list_length=GetImageListLength(image);
   for (next=image; next->next != (Image *) NULL; next=next->next)
   {
     handler=SetMonitorHandler((MonitorHandler) NULL);
@@ -965,7 +967,7 @@ MagickExport Image *MorphImages(const Image *image,
     morph_images->next->previous=morph_images;
     morph_images=morph_images->next;
     (void) SetMonitorHandler(handler);
-    if (!MagickMonitorFormatted(scene,GetImageListLength(image),exception,
+    if (!MagickMonitorFormatted(scene,image_list_length,exception,
                                 MorphImageText,image->filename))
       break;
     scene++;
@@ -8,6 +8,8 @@
   GraphicsMagick Image Private declarations.
 */
 
+struct _ImageAttributeMap;
+
 /*
   ImageExtra allows for expansion of Image without increasing its
   size.  The internals are defined only in this private header file.
@@ -19,6 +21,17 @@ typedef struct _ImageExtra
   Image
     *clip_mask,       /* Private, clipping mask to apply when updating pixels */
     *composite_mask;  /* Private, compositing mask to apply when updating pixels */
+
+  CachePixelFormat
+    pixel_format;     /* Private, requested pixel cache storage format */
+  struct _ImageAttributeMap
+    *attribute_map;   /* Private, shared hash index of image->attributes */
+  magick_uint64_t
+    signature_generation; /* Private, pixel cache generation of signature */
+  unsigned int
+    signature_state;  /* Private, method and layout used for signature */
+  char
+    signature[65];    /* Private, signature computed for the generation */
 } ImageExtra;
 
 #define ImageGetClipMaskInlined(i) (&i->extra->clip_mask)
@@ -376,6 +376,17 @@ MagickExport Image *AllocateImage(const ImageInfo *image_info)
       MagickFatalError3(ResourceLimitError,MemoryAllocationFailed,
                         UnableToAllocateImage);
     }
+  {
+    const char
+      *pixel_format;
+
+    /*
+      Select floating point pixel cache storage if requested.
+    */
+    if (((pixel_format=getenv("MAGICK_CACHE_PIXEL_FORMAT")) != (const char *) NULL) &&
+        (LocaleCompare(pixel_format,"float") == 0))
+      allocate_image->extra->pixel_format=FloatPixelFormat;
+  }
   allocate_image->blob=CloneBlobInfo((BlobInfo *) NULL);
   allocate_image->logging=IsEventLogging();
   allocate_image->is_monochrome=MagickTrue;
@@ -390,6 +401,10 @@ MagickExport Image *AllocateImage(const ImageInfo *image_info)
     }
   if (image_info == (ImageInfo *) NULL)
     return(allocate_image);
+  /*
+    Images allocated for a streaming read pass their rows on.
+  */
+  CopyStreamCacheHandler(allocate_image->cache,image_info->cache);
   /*
     Transfer image info.
   */
@@ -647,6 +662,7 @@ MagickExport Image *AppendImages(const Image *image,const unsigned int stack,
 
   unsigned long
     height,
+    number_images,
     scene,
     width;
 
@@ -662,8 +678,10 @@ MagickExport Image *AppendImages(const Image *image,const unsigned int stack,
 
   width=image->columns;
   height=image->rows;
+  number_images=1;
   for (next=image->next; next != (Image *) NULL; next=next->next)
   {
+    number_images++;
     if (stack)
       {
         if (next->columns > width)
@@ -697,7 +715,7 @@ MagickExport Image *AppendImages(const Image *image,const unsigned int stack,
                               append_image->columns-next->columns,next->rows,
                               &append_image->background_color);
         y+=next->rows;
-        status=MagickMonitorFormatted(scene,GetImageListLength(image),
+        status=MagickMonitorFormatted(scene,number_images,
                                       exception,AppendImageText,
                                       image->filename);
         if (status == MagickFail)
@@ -719,7 +737,7 @@ MagickExport Image *AppendImages(const Image *image,const unsigned int stack,
                           append_image->rows-next->rows,
                           &append_image->background_color);
     x+=next->columns;
-    status=MagickMonitorFormatted(scene++,GetImageListLength(image),
+    status=MagickMonitorFormatted(scene++,number_images,
                                   exception,AppendImageText,
                                   image->filename);
     if (status == MagickFail)
@@ -1224,6 +1242,11 @@ MagickExport Image *CloneImage(const Image *image,const unsigned long columns,
   clone_image->next=(Image *) NULL;
   clone_image->extra->clip_mask=(Image *) NULL;
   clone_image->extra->composite_mask=(Image *) NULL;
+  clone_image->extra->pixel_format=image->extra->pixel_format;
+  clone_image->extra->signature_generation=image->extra->signature_generation;
+  clone_image->extra->signature_state=image->extra->signature_state;
+  (void) memcpy(clone_image->extra->signature,image->extra->signature,
+                sizeof(clone_image->extra->signature));
   if (orphan)
     clone_image->blob=CloneBlobInfo((BlobInfo *) NULL);
   else
@@ -1469,6 +1492,10 @@ MagickExport void DestroyImage(Image *image)
     Destroy image pixel cache.
   */
   DestroyImagePixels(image);
+  /*
+    Destroy image attributes (these may refer to ImageExtra).
+  */
+  DestroyImageAttributes(image);
   /*
     Destroy ImageExtra
    */
@@ -1494,7 +1521,6 @@ MagickExport void DestroyImage(Image *image)
       MagickMapDeallocateMap(image->profiles);
       image->profiles=0;
     }
-  DestroyImageAttributes(image);
   DestroyExceptionInfo(&image->exception);
   MagickFreeMemory(image->ascii85);
   DestroyBlob(image);
@@ -169,6 +169,16 @@ typedef enum
   UnassociatedAlpha
 } AlphaType;
 
+/*
+  Pixel cache storage format.  Float storage retains values outside of
+  the quantum range as well as fractional intermediate values.
+*/
+typedef enum
+{
+  QuantumPixelFormat,  /* PixelPacket at QuantumDepth (default) */
+  FloatPixelFormat     /* FloatPixelPacket (32-bit float per channel) */
+} CachePixelFormat;
+
 typedef enum
 {
   UndefinedChannel,
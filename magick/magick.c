@@ -58,6 +58,7 @@
 #include "magick/registry.h"
 #include "magick/resource.h"
 #include "magick/render.h"
+#include "magick/resize.h"
 #include "magick/semaphore.h"
 #include "magick/tempfile.h"
 #include "magick/utility.h"
@@ -181,9 +182,12 @@ DestroyMagick(void)
   DestroyColorInfo();           /* Color database */
   DestroyDelegateInfo();        /* External delegate information */
   DestroyTypeInfo();            /* Font information */
+  DestroyAnnotateInfo();        /* Font face & glyph cache */
+  DestroyResizeInfo();          /* Resize contribution tables */
   /*DestroyMagicInfo();*/       /* File format detection */
   DestroyMagickInfoList();      /* Coder registrations + modules */
   DestroyConstitute();          /* Constitute semaphore */
+  DestroyBlobSpillInfo();       /* Blob spill accounting */
   DestroyMagickRegistry();      /* Registered images */
   DestroyMagickResources();     /* Resource semaphore */
   DestroyMagickRandomGenerator(); /* Random number generator */
@@ -1292,9 +1296,12 @@ InitializeMagickEx(const char *path, unsigned int options,
   InitializeMagickResources();      /* Resources */
   InitializeMagickRegistry();       /* Image/blob registry */
   InitializeConstitute();           /* Constitute semaphore */
+  InitializeBlobSpillInfo();        /* Blob spill accounting */
   InitializeMagickInfoList();       /* Coder registrations + modules */
   /*InitializeMagicInfo();*/        /* File format detection */
   InitializeTypeInfo();             /* Font information */
+  InitializeAnnotateInfo();         /* Font face & glyph cache */
+  InitializeResizeInfo();           /* Resize contribution tables */
   InitializeDelegateInfo();         /* External delegate information */
   InitializeColorInfo();            /* Color database */
   InitializeMagickMonitor();        /* Progress monitor */
@@ -28,6 +28,35 @@ typedef unsigned int
   (*EncoderHandler)(const ImageInfo *,Image *),
   (*MagickHandler)(const unsigned char *,const size_t);
 
+/*
+  Phases of a row streaming encoder (see StreamImage()).
+*/
+typedef enum
+{
+  QueryStreamEncode,       /* Report whether image may be streamed */
+  BeginStreamEncode,       /* Write the header described by image */
+  RowsStreamEncode,        /* Write all of the rows in the rows image */
+  EndStreamEncode          /* Write the trailer and release state */
+} StreamEncodePhase;
+
+/*
+  Row streaming encoder.  The image provides the attributes and
+  dimensions of the output but has no pixels.  Pixels are supplied in
+  order as a sequence of images of the same width, which hold the next
+  rows.  The blob of image is opened and closed by the caller.  State
+  may be used to retain data between phases and must be released by
+  the EndStreamEncode phase, which is always invoked if the
+  BeginStreamEncode phase was invoked.  The QueryStreamEncode phase is
+  invoked by IsImageStreamable() with the attributes of the input, and
+  must fail if the settings in image_info (such as the compression) or
+  the attributes (such as the colorspace) can not be streamed.  It does
+  not write anything, and leaves state alone.
+*/
+typedef MagickPassFail
+  (*StreamEncoderHandler)(const ImageInfo *image_info,Image *image,
+                          const Image *rows,const StreamEncodePhase phase,
+                          void **state);
+
 /*
   Stability and usefulness of the coder.
 */
@@ -97,6 +126,16 @@ typedef struct _MagickInfo
   ExtensionTreatment
     extension_treatment; /* How much faith should be placed on file extension? */
 
+  MagickBool
+    stream_support;     /* decoder writes each row once, in roughly ascending
+                         *   order, and never reads rows back, so that it may
+                         *   decode into a stream pixel cache (default MagickFalse)
+                         */
+
+  StreamEncoderHandler
+    stream_encoder;     /* function vector to row streaming encoding routine
+                           (default NULL) */
+
   unsigned long
     signature;          /* private, structure validator */
 
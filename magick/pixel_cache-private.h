@@ -75,6 +75,15 @@
   extern MagickBool
   GetPixelCacheInCore(const Image *image) MAGICK_FUNC_PURE;
 
+  /*
+    GetPixelCacheGeneration() returns a number which changes whenever
+    the pixels of the image may have been modified, or zero if the
+    image has no pixel cache.  Used to validate cached results such
+    as the image signature.
+  */
+  extern magick_uint64_t
+  GetPixelCacheGeneration(const Image *image);
+
   /*
     GetPixelCachePresent() tests to see the pixel cache is present
     and contains pixels.
@@ -82,6 +91,15 @@
   extern MagickExport MagickBool
   GetPixelCachePresent(const Image *image) MAGICK_FUNC_PURE;
 
+  /*
+    GetPixelCacheIsStream() tests to see if the pixel cache is a
+    stream cache, which passes completed rows on rather than storing
+    them.  Decoders may use this to reject layouts (e.g. separate
+    planes) which must revisit rows.
+  */
+  extern MagickExport MagickBool
+  GetPixelCacheIsStream(const Image *image) MAGICK_FUNC_PURE;
+
   /*
     Obtain an interpolated pixel value via bi-linear interpolation.
   */
@@ -125,3 +143,62 @@
   */
   extern MagickExport MagickPassFail
   CheckImagePixelLimits(const Image *image, ExceptionInfo *exception);
+
+  /*
+    Process-wide disk pixel cache I/O counters.
+  */
+  typedef struct _PixelCacheIOStatistics
+  {
+    magick_uint64_t
+      read_requests,      /* Row reads requested from disk caches */
+      read_hits,          /* Row reads served from a read-ahead buffer */
+      reads,              /* Read system calls issued */
+      bytes_read,         /* Bytes read from cache files */
+      write_requests,     /* Row writes requested to disk caches */
+      writes_coalesced,   /* Row writes merged into a write-behind buffer */
+      writes,             /* Write system calls issued */
+      bytes_written,      /* Bytes written to cache files */
+      tile_hits,          /* Tiled cache accesses to a resident tile */
+      tile_misses;        /* Tiled cache accesses which loaded a tile */
+  } PixelCacheIOStatistics;
+
+  /*
+    GetPixelCacheIOStatistics() returns a snapshot of the disk pixel
+    cache I/O counters.
+
+    Used only by ListMagickResourceInfo().
+  */
+  extern void
+  GetPixelCacheIOStatistics(PixelCacheIOStatistics *statistics);
+
+  /*
+    Receives rows written to a stream pixel cache.  Rows are passed in
+    order, starting at row y.  Indexes are NULL unless the image is
+    PseudoClass or CMYK.
+  */
+  typedef MagickPassFail
+  (*StreamCacheHandler)(void *client_data,const Image *image,const long y,
+                        const unsigned long rows,const PixelPacket *pixels,
+                        const IndexPacket *indexes,ExceptionInfo *exception);
+
+  /*
+    SetStreamCacheHandler() converts a pixel cache which has not yet
+    been opened into a stream cache.  A stream cache does not retain
+    the image.  Completed rows are passed to the handler and
+    discarded.
+
+    Used only by StreamImage().
+  */
+  extern MagickPassFail
+  SetStreamCacheHandler(Cache cache,StreamCacheHandler handler,
+                        void *client_data);
+
+  /*
+    CopyStreamCacheHandler() converts cache into a stream cache using
+    the same handler as stream_cache, if stream_cache is a stream
+    cache.
+
+    Used only by AllocateImage().
+  */
+  extern void
+  CopyStreamCacheHandler(Cache cache,const Cache stream_cache);
@@ -133,9 +133,151 @@ typedef enum
   PingCache,      /* Cache is ignored */
   MemoryCache,    /* Cache is a heap memory allocation */
   DiskCache,      /* Cache is a file accessed via read/write */
-  MapCache        /* Cache is a file accessed via memory map */
+  MapCache,       /* Cache is a file accessed via memory map */
+  StreamCache     /* Cache passes completed rows to a handler */
 } CacheType;
 
+/*
+  CacheTile represents one tile of a tiled disk pixel cache which is
+  currently resident in memory.
+*/
+typedef struct _CacheTile
+{
+  /* Tile number (row-major order within the tile grid) */
+  magick_uint64_t number;
+
+  /* Tile pixels */
+  PixelPacket *pixels;
+
+  /* Tile indexes (follow pixels in the same allocation) */
+  IndexPacket *indexes;
+
+  /* Tile has been modified since it was read from the cache file */
+  MagickBool dirty;
+
+  /* Least recently used list (most recently used first) */
+  struct _CacheTile *previous;
+  struct _CacheTile *next;
+} CacheTile;
+
+/*
+  TileCache describes the layout of a tiled disk pixel cache and
+  retains recently used tiles in memory.  The cache file stores all of
+  the pixel tiles, followed by all of the index tiles.  Edge tiles are
+  padded to the full tile size.  Protected by CacheInfo file_semaphore.
+*/
+typedef struct _TileCache
+{
+  /* Image dimensions */
+  unsigned long columns;
+  unsigned long rows;
+
+  /* Tile dimensions */
+  unsigned long tile_columns;
+  unsigned long tile_rows;
+
+  /* Tile grid dimensions */
+  unsigned long tiles_across;
+  unsigned long tiles_down;
+
+  /* Total number of tiles */
+  magick_uint64_t number_tiles;
+
+  /* Tiles contain indexes */
+  MagickBool indexes_valid;
+
+  /* Resident tile for each tile number (or NULL) */
+  CacheTile **tiles;
+
+  /* Flag for each tile number indicating if it was ever written */
+  unsigned char *on_disk;
+
+  /* Least recently used list */
+  CacheTile *head;
+  CacheTile *tail;
+
+  /* Number of resident tiles, and maximum allowed */
+  size_t resident;
+  size_t limit;
+
+  /* Statistics */
+  magick_uint64_t hits;
+  magick_uint64_t misses;
+  magick_uint64_t tile_reads;
+  magick_uint64_t tile_writes;
+} TileCache;
+
+/*
+  DiskCacheIO buffers the file I/O of a row-major disk pixel cache.
+  Read requests which proceed forward through the file are satisfied
+  from a read-ahead buffer which is refilled using one large read,
+  while the operating system is asked to prefetch the following
+  window in the background.  Consecutive write requests are coalesced
+  into a write-behind buffer which is written using one large write.
+  Protected by CacheInfo file_semaphore.
+*/
+typedef struct _DiskCacheIO
+{
+  /* Size of each buffer */
+  size_t buffer_size;
+
+  /* Read-ahead buffer, its file offset, and number of valid bytes */
+  unsigned char *read_buffer;
+  magick_uint64_t read_offset;
+  size_t read_length;
+
+  /* End offset of the previous read request */
+  magick_uint64_t last_read_end;
+
+  /* Number of consecutive forward read requests */
+  unsigned int forward_reads;
+
+  /* Write-behind buffer, its file offset, and number of pending bytes */
+  unsigned char *write_buffer;
+  magick_uint64_t write_offset;
+  size_t write_length;
+
+  /* Statistics */
+  magick_uint64_t read_requests;
+  magick_uint64_t read_hits;
+  magick_uint64_t reads;
+  magick_uint64_t write_requests;
+  magick_uint64_t writes_coalesced;
+  magick_uint64_t writes;
+} DiskCacheIO;
+
+/*
+  StreamCacheInfo holds the rows of a stream cache which have been
+  written but not yet passed to the row handler.  Rows are passed to
+  the handler strictly in order, once all of their pixels have been
+  written.  Rows written ahead of the next row (e.g. by a decoder
+  which decodes rows in parallel, or a row of tiles) are held until
+  the rows before them are complete.
+*/
+typedef struct _StreamCacheInfo
+{
+  /* Receives completed rows, and its opaque data */
+  StreamCacheHandler handler;
+  void *client_data;
+
+  /* Next row to pass to the handler */
+  long next_row;
+
+  /* Number of rows allocated in the pending buffers */
+  unsigned long pending_rows;
+
+  /* One past the highest pending row written (relative to next_row) */
+  unsigned long high_row;
+
+  /* Pending rows, their indexes, and the pixels written to each row */
+  PixelPacket *pixels;
+  IndexPacket *indexes;
+  unsigned long *written;
+
+  /* Serializes writes from multiple threads */
+  SemaphoreInfo *semaphore;
+} StreamCacheInfo;
+
 /*
   CacheInfo represents the underlying raster image.
 */
@@ -156,6 +298,9 @@ typedef struct _CacheInfo
   /* Image pixels if memory resident */
   PixelPacket *pixels;
 
+  /* Image pixels if memory resident in FloatPixelFormat (pixels is NULL) */
+  FloatPixelPacket *float_pixels;
+
   /* Image indexes if memory resident */
   IndexPacket *indexes;
 
@@ -199,6 +344,22 @@ typedef struct _CacheInfo
   /* Open file handle for disk cache */
   int file;
 
+  /* Tile layout and resident tiles if disk cache is tiled (else NULL) */
+  TileCache *tile_cache;
+
+  /* Read-ahead and write-behind buffers for row-major disk cache */
+  DiskCacheIO *disk_io;
+
+  /* Row handler and pending rows if cache is a stream cache */
+  StreamCacheInfo *stream_info;
+
+  /* Cache file is a persistent (MPC) cache which must be row-major */
+  MagickBool persistent;
+
+  /* Changes whenever pixels may have been modified (see
+     GetPixelCacheGeneration()) */
+  magick_uint64_t generation;
+
   /* Image file name in form "filename[index]" (for use in logging) */
   char filename[MaxTextExtent];
 
@@ -209,6 +370,29 @@ typedef struct _CacheInfo
   unsigned long signature;
 } CacheInfo;
 
+/*
+  Source of pixel cache generation numbers.  Numbers are never reused
+  so a generation number identifies a particular state of the pixels
+  of a particular cache.
+*/
+static magick_uint64_t
+  cache_generation = 0;
+
+static inline void
+UpdateCacheGeneration(CacheInfo *cache_info)
+{
+#if defined(__ATOMIC_ACQ_REL)
+  __atomic_store_n(&cache_info->generation,
+                   __atomic_add_fetch(&cache_generation,1,__ATOMIC_RELAXED),
+                   __ATOMIC_RELEASE);
+#else
+#  if defined(HAVE_OPENMP)
+#    pragma omp critical (GM_CacheGeneration)
+#  endif
+  cache_info->generation=++cache_generation;
+#endif
+}
+
 /*
   NexusInfo represents a selected region of pixels.
 */
@@ -417,7 +601,1103 @@ FilePositionWrite(int file, const void *buffer,size_t length,magick_off_t offset
     return (ssize_t)-1;
   return (ssize_t) total_count;
 }
-
+
+/*
+  Conversions between PixelPacket and the FloatPixelFormat cache
+  representation.  Float channels use the same scale as Quantum
+  (0 to MaxRGB) but are not clamped.
+*/
+static inline void
+FloatToPixelPacket(const FloatPixelPacket * restrict float_pixel,
+                   PixelPacket * restrict pixel)
+{
+  pixel->red=RoundFloatToQuantum(float_pixel->red);
+  pixel->green=RoundFloatToQuantum(float_pixel->green);
+  pixel->blue=RoundFloatToQuantum(float_pixel->blue);
+  pixel->opacity=RoundFloatToQuantum(float_pixel->opacity);
+}
+
+static inline void
+PixelPacketToFloat(const PixelPacket * restrict pixel,
+                   FloatPixelPacket * restrict float_pixel)
+{
+  float_pixel->red=(float) pixel->red;
+  float_pixel->green=(float) pixel->green;
+  float_pixel->blue=(float) pixel->blue;
+  float_pixel->opacity=(float) pixel->opacity;
+}
+
+/*
+  Process-wide disk pixel cache I/O statistics (see
+  GetPixelCacheIOStatistics()).
+*/
+static PixelCacheIOStatistics
+  pixel_cache_io_statistics;
+
+static inline void
+AddCacheIOStatistic(magick_uint64_t *counter,const magick_uint64_t value)
+{
+#if defined(HAVE_OPENMP)
+#  pragma omp atomic
+#endif
+  *counter+=value;
+}
+
+/*
+  Default size of each of the disk pixel cache read-ahead and
+  write-behind buffers.
+*/
+#define DiskCacheIODefaultBufferSize (2*1024*1024)
+
+/*
+
+  Allocate read-ahead and write-behind buffers for a row-major disk
+  pixel cache.  The buffer size may be set using the
+  MAGICK_CACHE_IO_BUFFER_SIZE environment variable.  NULL is returned
+  if buffering is disabled or memory is not available, in which case
+  file I/O is performed directly.
+
+*/
+static DiskCacheIO *
+AllocateDiskCacheIO(void)
+{
+  DiskCacheIO
+    *disk_io;
+
+  const char
+    *value;
+
+  magick_int64_t
+    buffer_size;
+
+  buffer_size=DiskCacheIODefaultBufferSize;
+  if (((value=getenv("MAGICK_CACHE_IO_BUFFER_SIZE")) != (const char *) NULL) &&
+      (*value != '\0'))
+    buffer_size=MagickSizeStrToInt64(value,1024);
+  if ((buffer_size < 4096) || (buffer_size != (magick_int64_t) ((size_t) buffer_size)))
+    return((DiskCacheIO *) NULL);
+  disk_io=MagickAllocateMemory(DiskCacheIO *,sizeof(DiskCacheIO));
+  if (disk_io == (DiskCacheIO *) NULL)
+    return((DiskCacheIO *) NULL);
+  (void) memset(disk_io,0,sizeof(DiskCacheIO));
+  disk_io->buffer_size=(size_t) buffer_size;
+  disk_io->read_buffer=MagickAllocateMemory(unsigned char *,
+                                            disk_io->buffer_size);
+  disk_io->write_buffer=MagickAllocateMemory(unsigned char *,
+                                             disk_io->buffer_size);
+  if ((disk_io->read_buffer == (unsigned char *) NULL) ||
+      (disk_io->write_buffer == (unsigned char *) NULL))
+    {
+      MagickFreeMemory(disk_io->read_buffer);
+      MagickFreeMemory(disk_io->write_buffer);
+      MagickFreeMemory(disk_io);
+    }
+  return(disk_io);
+}
+
+/*
+
+  Write any pending write-behind data to the cache file.  The caller
+  must hold the cache file semaphore, or otherwise have exclusive
+  access to the cache.
+
+*/
+static MagickPassFail
+FlushDiskCacheIO(CacheInfo *cache_info)
+{
+  DiskCacheIO
+    *disk_io;
+
+  ssize_t
+    count;
+
+  disk_io=cache_info->disk_io;
+  if ((disk_io == (DiskCacheIO *) NULL) || (disk_io->write_length == 0))
+    return(MagickPass);
+  count=FilePositionWrite(cache_info->file,disk_io->write_buffer,
+                          disk_io->write_length,
+                          (magick_off_t) disk_io->write_offset);
+  if (count < (ssize_t) disk_io->write_length)
+    {
+      (void) LogMagickEvent(CacheEvent,GetMagickModule(),
+                            "Failed to write %" MAGICK_SIZE_T_F "u bytes"
+                            " at file offset %" MAGICK_UINT64_F "u (%s).",
+                            (MAGICK_SIZE_T) disk_io->write_length,
+                            disk_io->write_offset,strerror(errno));
+      return(MagickFail);
+    }
+  disk_io->writes++;
+  AddCacheIOStatistic(&pixel_cache_io_statistics.writes,1);
+  AddCacheIOStatistic(&pixel_cache_io_statistics.bytes_written,
+                      disk_io->write_length);
+  disk_io->write_length=0;
+  return(MagickPass);
+}
+
+/*
+
+  Destroy the read-ahead and write-behind buffers of a disk pixel
+  cache, writing any pending data first.
+
+*/
+static MagickPassFail
+DestroyDiskCacheIO(CacheInfo *cache_info)
+{
+  DiskCacheIO
+    *disk_io;
+
+  MagickPassFail
+    status;
+
+  disk_io=cache_info->disk_io;
+  if (disk_io == (DiskCacheIO *) NULL)
+    return(MagickPass);
+  status=FlushDiskCacheIO(cache_info);
+  (void) LogMagickEvent(CacheEvent,GetMagickModule(),
+                        "disk I/O %.1024s: %" MAGICK_UINT64_F "u reads"
+                        " (%" MAGICK_UINT64_F "u read-ahead hits,"
+                        " %" MAGICK_UINT64_F "u system calls),"
+                        " %" MAGICK_UINT64_F "u writes"
+                        " (%" MAGICK_UINT64_F "u coalesced,"
+                        " %" MAGICK_UINT64_F "u system calls)",
+                        cache_info->filename,
+                        disk_io->read_requests,disk_io->read_hits,
+                        disk_io->reads,disk_io->write_requests,
+                        disk_io->writes_coalesced,disk_io->writes);
+  MagickFreeMemory(disk_io->read_buffer);
+  MagickFreeMemory(disk_io->write_buffer);
+  MagickFreeMemory(disk_io);
+  cache_info->disk_io=(DiskCacheIO *) NULL;
+  return(status);
+}
+
+/*
+
+  Read 'length' bytes at 'offset' from the disk pixel cache file
+  'file' into 'buffer'.  If the file is the cache's own open file
+  handle and the request continues a forward scan through the file,
+  then the request is satisfied from the read-ahead buffer.  Returns
+  the number of bytes read, or -1 on error.
+
+*/
+static ssize_t
+CacheFileRead(CacheInfo *cache_info,int file,void *buffer,size_t length,
+              magick_uint64_t offset)
+{
+  DiskCacheIO
+    *disk_io;
+
+  ssize_t
+    count;
+
+  disk_io=cache_info->disk_io;
+  if ((disk_io == (DiskCacheIO *) NULL) || (file != cache_info->file))
+    {
+      count=FilePositionRead(file,buffer,length,(magick_off_t) offset);
+      AddCacheIOStatistic(&pixel_cache_io_statistics.read_requests,1);
+      AddCacheIOStatistic(&pixel_cache_io_statistics.reads,1);
+      if (count > 0)
+        AddCacheIOStatistic(&pixel_cache_io_statistics.bytes_read,
+                            (magick_uint64_t) count);
+      return(count);
+    }
+  disk_io->read_requests++;
+  AddCacheIOStatistic(&pixel_cache_io_statistics.read_requests,1);
+  if ((offset >= disk_io->read_offset) &&
+      (offset+length <= disk_io->read_offset+disk_io->read_length))
+    {
+      /*
+        Satisfy request from the read-ahead buffer.
+      */
+      (void) memcpy(buffer,disk_io->read_buffer+
+                    (size_t) (offset-disk_io->read_offset),length);
+      disk_io->last_read_end=offset+length;
+      disk_io->read_hits++;
+      AddCacheIOStatistic(&pixel_cache_io_statistics.read_hits,1);
+      return((ssize_t) length);
+    }
+  /*
+    Detect a forward scan which uses most of the data it passes over.
+  */
+  if ((offset >= disk_io->last_read_end) &&
+      (offset-disk_io->last_read_end <= length))
+    disk_io->forward_reads++;
+  else
+    disk_io->forward_reads=0;
+  disk_io->last_read_end=offset+length;
+  if ((disk_io->forward_reads >= 2) && (length <= disk_io->buffer_size/2))
+    {
+      magick_uint64_t
+        end;
+
+      size_t
+        fill;
+
+      /*
+        Refill the read-ahead buffer starting at this request.
+      */
+      end=cache_info->offset+cache_info->length;
+      fill=disk_io->buffer_size;
+      if ((offset < end) && (end-offset < fill))
+        fill=(size_t) (end-offset);
+      if (fill < length)
+        fill=length;
+      if ((disk_io->write_length != 0) &&
+          (offset < disk_io->write_offset+disk_io->write_length) &&
+          (offset+fill > disk_io->write_offset))
+        if (FlushDiskCacheIO(cache_info) == MagickFail)
+          return(-1);
+      disk_io->read_length=0;
+      count=FilePositionRead(file,disk_io->read_buffer,fill,
+                             (magick_off_t) offset);
+      disk_io->reads++;
+      AddCacheIOStatistic(&pixel_cache_io_statistics.reads,1);
+      if (count > 0)
+        AddCacheIOStatistic(&pixel_cache_io_statistics.bytes_read,
+                            (magick_uint64_t) count);
+      if (count < (ssize_t) length)
+        return(-1);
+      disk_io->read_offset=offset;
+      disk_io->read_length=(size_t) count;
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+      /*
+        Ask the operating system to read the following window in the
+        background while this one is being processed.
+      */
+      (void) posix_fadvise(file,(off_t) (offset+count),
+                           (off_t) disk_io->buffer_size,POSIX_FADV_WILLNEED);
+#endif /* defined(HAVE_POSIX_FADVISE) */
+      (void) memcpy(buffer,disk_io->read_buffer,length);
+      return((ssize_t) length);
+    }
+  /*
+    Random access, or request too large to buffer.
+  */
+  if ((disk_io->write_length != 0) &&
+      (offset < disk_io->write_offset+disk_io->write_length) &&
+      (offset+length > disk_io->write_offset))
+    if (FlushDiskCacheIO(cache_info) == MagickFail)
+      return(-1);
+  count=FilePositionRead(file,buffer,length,(magick_off_t) offset);
+  disk_io->reads++;
+  AddCacheIOStatistic(&pixel_cache_io_statistics.reads,1);
+  if (count > 0)
+    AddCacheIOStatistic(&pixel_cache_io_statistics.bytes_read,
+                        (magick_uint64_t) count);
+  return(count);
+}
+
+/*
+
+  Write 'length' bytes from 'buffer' to the disk pixel cache file
+  'file' at 'offset'.  If the file is the cache's own open file handle,
+  then the request is appended to the write-behind buffer when it
+  directly follows the pending data.  Returns the number of bytes
+  written (or buffered), or -1 on error.
+
+*/
+static ssize_t
+CacheFileWrite(CacheInfo *cache_info,int file,const void *buffer,
+               size_t length,magick_uint64_t offset)
+{
+  DiskCacheIO
+    *disk_io;
+
+  ssize_t
+    count;
+
+  disk_io=cache_info->disk_io;
+  AddCacheIOStatistic(&pixel_cache_io_statistics.write_requests,1);
+  if ((disk_io == (DiskCacheIO *) NULL) || (file != cache_info->file))
+    {
+      count=FilePositionWrite(file,buffer,length,(magick_off_t) offset);
+      AddCacheIOStatistic(&pixel_cache_io_statistics.writes,1);
+      if (count > 0)
+        AddCacheIOStatistic(&pixel_cache_io_statistics.bytes_written,
+                            (magick_uint64_t) count);
+      return(count);
+    }
+  disk_io->write_requests++;
+  /*
+    Keep the read-ahead buffer coherent.
+  */
+  if ((disk_io->read_length != 0) &&
+      (offset < disk_io->read_offset+disk_io->read_length) &&
+      (offset+length > disk_io->read_offset))
+    {
+      magick_uint64_t
+        first,
+        last;
+
+      first=Max(offset,disk_io->read_offset);
+      last=Min(offset+length,disk_io->read_offset+disk_io->read_length);
+      (void) memcpy(disk_io->read_buffer+(size_t) (first-disk_io->read_offset),
+                    (const unsigned char *) buffer+(size_t) (first-offset),
+                    (size_t) (last-first));
+    }
+  if ((disk_io->write_length != 0) &&
+      (offset == disk_io->write_offset+disk_io->write_length) &&
+      (disk_io->write_length+length <= disk_io->buffer_size))
+    {
+      /*
+        Coalesce with pending data.
+      */
+      (void) memcpy(disk_io->write_buffer+disk_io->write_length,buffer,
+                    length);
+      disk_io->write_length+=length;
+      disk_io->writes_coalesced++;
+      AddCacheIOStatistic(&pixel_cache_io_statistics.writes_coalesced,1);
+      return((ssize_t) length);
+    }
+  if (FlushDiskCacheIO(cache_info) == MagickFail)
+    return(-1);
+  if (length > disk_io->buffer_size/2)
+    {
+      count=FilePositionWrite(file,buffer,length,(magick_off_t) offset);
+      disk_io->writes++;
+      AddCacheIOStatistic(&pixel_cache_io_statistics.writes,1);
+      if (count > 0)
+        AddCacheIOStatistic(&pixel_cache_io_statistics.bytes_written,
+                            (magick_uint64_t) count);
+      return(count);
+    }
+  (void) memcpy(disk_io->write_buffer,buffer,length);
+  disk_io->write_offset=offset;
+  disk_io->write_length=length;
+  return((ssize_t) length);
+}
+
+/*
+  Default memory budget for the resident tiles of a tiled disk pixel
+  cache.
+*/
+#define CacheTileDefaultLimit (64*1024*1024)
+
+/*
+
+  Obtain the tiled disk pixel cache configuration from the
+  environment.  The disk pixel cache is row-major (tile dimensions
+  are returned as zero) unless MAGICK_CACHE_TILE_GEOMETRY is set.
+
+*/
+static void
+GetCacheTileConfiguration(unsigned long *tile_columns,
+                          unsigned long *tile_rows,
+                          magick_int64_t *limit)
+{
+  const char
+    *value;
+
+  double
+    height,
+    width;
+
+  *tile_columns=0;
+  *tile_rows=0;
+  *limit=CacheTileDefaultLimit;
+  if ((value=getenv("MAGICK_CACHE_TILE_GEOMETRY")) == (const char *) NULL)
+    return;
+  switch (GetMagickDimension(value,&width,&height,NULL,NULL))
+    {
+    case 1:
+      height=width;
+      break;
+    case 2:
+      break;
+    default:
+      return;
+    }
+  if ((width < 1.0) || (width > 65536.0) ||
+      (height < 1.0) || (height > 65536.0))
+    return;
+  *tile_columns=(unsigned long) width;
+  *tile_rows=(unsigned long) height;
+  if ((value=getenv("MAGICK_CACHE_TILE_LIMIT")) != (const char *) NULL)
+    *limit=MagickSizeStrToInt64(value,1024);
+}
+
+/*
+
+  Destroy a tile cache, discarding any resident tiles (modified or
+  not).
+
+*/
+static void
+DestroyTileCache(TileCache *tile_cache)
+{
+  CacheTile
+    *next,
+    *tile;
+
+  if (tile_cache == (TileCache *) NULL)
+    return;
+  for (tile=tile_cache->head; tile != (CacheTile *) NULL; tile=next)
+    {
+      next=tile->next;
+      MagickFreeMemory(tile->pixels);
+      MagickFreeMemory(tile);
+    }
+  MagickFreeMemory(tile_cache->tiles);
+  MagickFreeMemory(tile_cache->on_disk);
+  MagickFreeMemory(tile_cache);
+}
+
+/*
+
+  Allocate a tile cache for an image of size 'columns' by 'rows'
+  stored as tiles of size 'tile_columns' by 'tile_rows'.  At most
+  'limit' bytes of tiles are kept resident, but never fewer than
+  enough tiles to hold a complete row or column of tiles so that
+  scanning the image by rows or by columns reads each tile only once.
+  If 'on_disk' is true, then the cache file already contains valid
+  tiles.
+
+*/
+static TileCache *
+AllocateTileCache(const unsigned long columns,const unsigned long rows,
+                  const unsigned long tile_columns,
+                  const unsigned long tile_rows,
+                  const MagickBool indexes_valid,
+                  const magick_int64_t limit,const MagickBool on_disk)
+{
+  TileCache
+    *tile_cache;
+
+  size_t
+    minimum_tiles,
+    tile_size;
+
+  tile_cache=MagickAllocateMemory(TileCache *,sizeof(TileCache));
+  if (tile_cache == (TileCache *) NULL)
+    return((TileCache *) NULL);
+  (void) memset(tile_cache,0,sizeof(TileCache));
+  tile_cache->columns=columns;
+  tile_cache->rows=rows;
+  tile_cache->tile_columns=tile_columns;
+  tile_cache->tile_rows=tile_rows;
+  tile_cache->tiles_across=(columns+tile_columns-1)/tile_columns;
+  tile_cache->tiles_down=(rows+tile_rows-1)/tile_rows;
+  tile_cache->number_tiles=(magick_uint64_t) tile_cache->tiles_across*
+    tile_cache->tiles_down;
+  tile_cache->indexes_valid=indexes_valid;
+  if (tile_cache->number_tiles != (size_t) tile_cache->number_tiles)
+    {
+      DestroyTileCache(tile_cache);
+      return((TileCache *) NULL);
+    }
+  tile_cache->tiles=MagickAllocateArray(CacheTile **,
+                                        (size_t) tile_cache->number_tiles,
+                                        sizeof(CacheTile *));
+  tile_cache->on_disk=MagickAllocateMemory(unsigned char *,
+                                           (size_t) tile_cache->number_tiles);
+  if ((tile_cache->tiles == (CacheTile **) NULL) ||
+      (tile_cache->on_disk == (unsigned char *) NULL))
+    {
+      DestroyTileCache(tile_cache);
+      return((TileCache *) NULL);
+    }
+  (void) memset(tile_cache->tiles,0,(size_t) tile_cache->number_tiles*
+                sizeof(CacheTile *));
+  (void) memset(tile_cache->on_disk,on_disk ? 1 : 0,
+                (size_t) tile_cache->number_tiles);
+  tile_size=(size_t) tile_columns*tile_rows*sizeof(PixelPacket);
+  if (indexes_valid)
+    tile_size+=(size_t) tile_columns*tile_rows*sizeof(IndexPacket);
+  tile_cache->limit=(size_t) (limit > 0 ? (magick_uint64_t) limit/tile_size : 0);
+  minimum_tiles=Max(tile_cache->tiles_across,tile_cache->tiles_down)+1;
+  if (tile_cache->limit < minimum_tiles)
+    tile_cache->limit=minimum_tiles;
+  return(tile_cache);
+}
+
+/*
+
+  Read a tile from the cache file.  Tiles which have never been
+  written are returned as zeros without reading the file.
+
+*/
+static MagickPassFail
+ReadCacheTile(const CacheInfo *cache_info,TileCache *tile_cache,
+              CacheTile *tile,int file)
+{
+  magick_uint64_t
+    offset;
+
+  size_t
+    length,
+    tile_pixels;
+
+  tile_pixels=(size_t) tile_cache->tile_columns*tile_cache->tile_rows;
+  if (!tile_cache->on_disk[tile->number])
+    {
+      (void) memset(tile->pixels,0,tile_pixels*sizeof(PixelPacket));
+      if (tile_cache->indexes_valid)
+        (void) memset(tile->indexes,0,tile_pixels*sizeof(IndexPacket));
+      return(MagickPass);
+    }
+  length=tile_pixels*sizeof(PixelPacket);
+  offset=cache_info->offset+tile->number*length;
+  if (FilePositionRead(file,tile->pixels,length,(magick_off_t) offset) <
+      (ssize_t) length)
+    return(MagickFail);
+  if (tile_cache->indexes_valid)
+    {
+      offset=cache_info->offset+tile_cache->number_tiles*length;
+      length=tile_pixels*sizeof(IndexPacket);
+      offset+=tile->number*length;
+      if (FilePositionRead(file,tile->indexes,length,(magick_off_t) offset) <
+          (ssize_t) length)
+        return(MagickFail);
+      AddCacheIOStatistic(&pixel_cache_io_statistics.reads,1);
+      AddCacheIOStatistic(&pixel_cache_io_statistics.bytes_read,length);
+    }
+  AddCacheIOStatistic(&pixel_cache_io_statistics.reads,1);
+  AddCacheIOStatistic(&pixel_cache_io_statistics.bytes_read,
+                      tile_pixels*sizeof(PixelPacket));
+  tile_cache->tile_reads++;
+  return(MagickPass);
+}
+
+/*
+
+  Write a modified tile to the cache file.
+
+*/
+static MagickPassFail
+WriteCacheTile(const CacheInfo *cache_info,TileCache *tile_cache,
+               CacheTile *tile,int file)
+{
+  magick_uint64_t
+    offset;
+
+  size_t
+    length,
+    tile_pixels;
+
+  if (!tile->dirty)
+    return(MagickPass);
+  tile_pixels=(size_t) tile_cache->tile_columns*tile_cache->tile_rows;
+  length=tile_pixels*sizeof(PixelPacket);
+  offset=cache_info->offset+tile->number*length;
+  if (FilePositionWrite(file,tile->pixels,length,(magick_off_t) offset) <
+      (ssize_t) length)
+    return(MagickFail);
+  if (tile_cache->indexes_valid)
+    {
+      offset=cache_info->offset+tile_cache->number_tiles*length;
+      length=tile_pixels*sizeof(IndexPacket);
+      offset+=tile->number*length;
+      if (FilePositionWrite(file,tile->indexes,length,(magick_off_t) offset) <
+          (ssize_t) length)
+        return(MagickFail);
+      AddCacheIOStatistic(&pixel_cache_io_statistics.writes,1);
+      AddCacheIOStatistic(&pixel_cache_io_statistics.bytes_written,length);
+    }
+  AddCacheIOStatistic(&pixel_cache_io_statistics.writes,1);
+  AddCacheIOStatistic(&pixel_cache_io_statistics.bytes_written,
+                      tile_pixels*sizeof(PixelPacket));
+  tile->dirty=MagickFalse;
+  tile_cache->on_disk[tile->number]=1;
+  tile_cache->tile_writes++;
+  return(MagickPass);
+}
+
+/*
+
+  Return the resident tile with number 'number', reading it from the
+  cache file if necessary.  The least recently used tile is written
+  back (if modified) and recycled once the tile budget is reached.  If
+  'load' is false, then the caller is about to replace the entire tile
+  so its existing content is not read.
+
+*/
+static CacheTile *
+AccessCacheTile(const CacheInfo *cache_info,TileCache *tile_cache,
+                const magick_uint64_t number,const MagickBool load,int file)
+{
+  CacheTile
+    *tile;
+
+  tile=tile_cache->tiles[number];
+  if (tile != (CacheTile *) NULL)
+    {
+      tile_cache->hits++;
+      AddCacheIOStatistic(&pixel_cache_io_statistics.tile_hits,1);
+      if (tile != tile_cache->head)
+        {
+          /*
+            Move tile to the front of the LRU list.
+          */
+          tile->previous->next=tile->next;
+          if (tile->next != (CacheTile *) NULL)
+            tile->next->previous=tile->previous;
+          else
+            tile_cache->tail=tile->previous;
+          tile->previous=(CacheTile *) NULL;
+          tile->next=tile_cache->head;
+          tile_cache->head->previous=tile;
+          tile_cache->head=tile;
+        }
+      return(tile);
+    }
+  tile_cache->misses++;
+  AddCacheIOStatistic(&pixel_cache_io_statistics.tile_misses,1);
+  if ((tile_cache->resident < tile_cache->limit) ||
+      (tile_cache->tail == (CacheTile *) NULL))
+    {
+      size_t
+        tile_pixels;
+
+      tile_pixels=(size_t) tile_cache->tile_columns*tile_cache->tile_rows;
+      tile=MagickAllocateMemory(CacheTile *,sizeof(CacheTile));
+      if (tile == (CacheTile *) NULL)
+        return((CacheTile *) NULL);
+      (void) memset(tile,0,sizeof(CacheTile));
+      tile->pixels=MagickAllocateArray(PixelPacket *,tile_pixels,
+                                       sizeof(PixelPacket)+
+                                       (tile_cache->indexes_valid ?
+                                        sizeof(IndexPacket) : 0));
+      if (tile->pixels == (PixelPacket *) NULL)
+        {
+          MagickFreeMemory(tile);
+          return((CacheTile *) NULL);
+        }
+      if (tile_cache->indexes_valid)
+        tile->indexes=(IndexPacket *) (tile->pixels+tile_pixels);
+    }
+  else
+    {
+      /*
+        Recycle the least recently used tile.
+      */
+      tile=tile_cache->tail;
+      if (WriteCacheTile(cache_info,tile_cache,tile,file) == MagickFail)
+        return((CacheTile *) NULL);
+      tile_cache->tail=tile->previous;
+      if (tile_cache->tail != (CacheTile *) NULL)
+        tile_cache->tail->next=(CacheTile *) NULL;
+      else
+        tile_cache->head=(CacheTile *) NULL;
+      tile_cache->tiles[tile->number]=(CacheTile *) NULL;
+      tile_cache->resident--;
+    }
+  tile->number=number;
+  tile->dirty=MagickFalse;
+  if (load && (ReadCacheTile(cache_info,tile_cache,tile,file) == MagickFail))
+    {
+      MagickFreeMemory(tile->pixels);
+      MagickFreeMemory(tile);
+      return((CacheTile *) NULL);
+    }
+  tile->previous=(CacheTile *) NULL;
+  tile->next=tile_cache->head;
+  if (tile_cache->head != (CacheTile *) NULL)
+    tile_cache->head->previous=tile;
+  tile_cache->head=tile;
+  if (tile_cache->tail == (CacheTile *) NULL)
+    tile_cache->tail=tile;
+  tile_cache->tiles[number]=tile;
+  tile_cache->resident++;
+  return(tile);
+}
+
+/*
+
+  Transfer pixels (or indexes if 'indexes' is true) for the rectangular
+  region 'region' between the tiled disk cache and 'buffer', which
+  stores the region contiguously.  Data is written to the cache if
+  'write' is true, and read from the cache otherwise.
+
+*/
+static MagickPassFail
+TransferCacheTiles(CacheInfo *cache_info,const RectangleInfo *region,
+                   void *buffer,const MagickBool indexes,
+                   const MagickBool write)
+{
+  TileCache
+    *tile_cache;
+
+  MagickPassFail
+    status;
+
+  size_t
+    packet_size;
+
+  unsigned long
+    tile_x,
+    tile_y;
+
+  int
+    file;
+
+  tile_cache=cache_info->tile_cache;
+  if ((region->x < 0) || (region->y < 0) ||
+      (region->x+region->width > tile_cache->columns) ||
+      (region->y+region->height > tile_cache->rows))
+    return(MagickFail);
+  packet_size=(indexes ? sizeof(IndexPacket) : sizeof(PixelPacket));
+  status=MagickPass;
+  LockSemaphoreInfo(cache_info->file_semaphore);
+  {
+    file=(cache_info->file != -1 ? cache_info->file :
+          open(cache_info->cache_filename,O_RDWR | O_BINARY));
+    if (file == -1)
+      status=MagickFail;
+    for (tile_y=region->y/tile_cache->tile_rows;
+         (status != MagickFail) &&
+           (tile_y <= (region->y+region->height-1)/tile_cache->tile_rows);
+         tile_y++)
+      for (tile_x=region->x/tile_cache->tile_columns;
+           (status != MagickFail) &&
+             (tile_x <= (region->x+region->width-1)/tile_cache->tile_columns);
+           tile_x++)
+        {
+          CacheTile
+            *tile;
+
+          MagickBool
+            load;
+
+          register char
+            *q,
+            *t;
+
+          unsigned long
+            x0,
+            x1,
+            y,
+            y0,
+            y1;
+
+          /*
+            Intersect the region with this tile.
+          */
+          x0=tile_x*tile_cache->tile_columns;
+          y0=tile_y*tile_cache->tile_rows;
+          x1=Min(x0+tile_cache->tile_columns,tile_cache->columns);
+          y1=Min(y0+tile_cache->tile_rows,tile_cache->rows);
+          load=(!write ||
+                ((unsigned long) region->x > x0) ||
+                ((unsigned long) region->y > y0) ||
+                (region->x+region->width < x1) ||
+                (region->y+region->height < y1));
+          x0=Max(x0,(unsigned long) region->x);
+          y0=Max(y0,(unsigned long) region->y);
+          x1=Min(x1,region->x+region->width);
+          y1=Min(y1,region->y+region->height);
+          tile=AccessCacheTile(cache_info,tile_cache,(magick_uint64_t)
+                               tile_y*tile_cache->tiles_across+tile_x,
+                               load,file);
+          if (tile == (CacheTile *) NULL)
+            {
+              status=MagickFail;
+              break;
+            }
+          t=(indexes ? (char *) tile->indexes : (char *) tile->pixels)+
+            ((size_t) (y0-tile_y*tile_cache->tile_rows)*
+             tile_cache->tile_columns+
+             (x0-tile_x*tile_cache->tile_columns))*packet_size;
+          q=(char *) buffer+((size_t) (y0-region->y)*region->width+
+                             (x0-region->x))*packet_size;
+          for (y=y0; y < y1; y++)
+            {
+              if (write)
+                (void) memcpy(t,q,(x1-x0)*packet_size);
+              else
+                (void) memcpy(q,t,(x1-x0)*packet_size);
+              t+=tile_cache->tile_columns*packet_size;
+              q+=region->width*packet_size;
+            }
+          if (write)
+            tile->dirty=MagickTrue;
+        }
+    if ((file != -1) && (cache_info->file == -1))
+      (void) close(file);
+  }
+  UnlockSemaphoreInfo(cache_info->file_semaphore);
+  return(status);
+}
+
+/*
+
+  Write all modified resident tiles back to the cache file.
+
+*/
+static MagickPassFail
+FlushTileCache(CacheInfo *cache_info)
+{
+  CacheTile
+    *tile;
+
+  MagickPassFail
+    status;
+
+  int
+    file;
+
+  status=MagickPass;
+  LockSemaphoreInfo(cache_info->file_semaphore);
+  {
+    file=(cache_info->file != -1 ? cache_info->file :
+          open(cache_info->cache_filename,O_RDWR | O_BINARY));
+    if (file == -1)
+      status=MagickFail;
+    else
+      {
+        for (tile=cache_info->tile_cache->head; tile != (CacheTile *) NULL;
+             tile=tile->next)
+          status&=WriteCacheTile(cache_info,cache_info->tile_cache,tile,file);
+        if (cache_info->file == -1)
+          (void) close(file);
+      }
+  }
+  UnlockSemaphoreInfo(cache_info->file_semaphore);
+  return(status);
+}
+
+/*
+
+  Release the pending rows of a stream cache.
+
+*/
+static void
+FreeStreamCacheRows(StreamCacheInfo *stream_info)
+{
+  MagickFreeResourceLimitedMemory(stream_info->pixels);
+  MagickFreeResourceLimitedMemory(stream_info->indexes);
+  MagickFreeResourceLimitedMemory(stream_info->written);
+  stream_info->pending_rows=0;
+  stream_info->high_row=0;
+}
+
+static void
+DestroyStreamCacheInfo(CacheInfo *cache_info)
+{
+  StreamCacheInfo
+    *stream_info;
+
+  stream_info=cache_info->stream_info;
+  if (stream_info == (StreamCacheInfo *) NULL)
+    return;
+  FreeStreamCacheRows(stream_info);
+  DestroySemaphoreInfo(&stream_info->semaphore);
+  MagickFreeMemory(stream_info);
+  cache_info->stream_info=(StreamCacheInfo *) NULL;
+}
+
+/*
+
+  Ensure that the stream cache is able to hold 'rows' pending rows.
+  Existing pending rows are retained.
+
+*/
+static MagickPassFail
+ReserveStreamCacheRows(const CacheInfo *cache_info,unsigned long rows)
+{
+  StreamCacheInfo
+    *stream_info;
+
+  size_t
+    count;
+
+  void
+    *buffer;
+
+  stream_info=cache_info->stream_info;
+  if (rows <= stream_info->pending_rows)
+    return(MagickPass);
+  rows=Max(rows,Max(8,2*stream_info->pending_rows));
+  count=MagickArraySize(cache_info->columns,rows);
+  if (count == 0)
+    return(MagickFail);
+  buffer=MagickReallocateResourceLimitedArray(PixelPacket *,
+                                              stream_info->pixels,count,
+                                              sizeof(PixelPacket));
+  if (buffer == (void *) NULL)
+    return(MagickFail);
+  stream_info->pixels=(PixelPacket *) buffer;
+  if (cache_info->indexes_valid)
+    {
+      buffer=MagickReallocateResourceLimitedArray(IndexPacket *,
+                                                  stream_info->indexes,count,
+                                                  sizeof(IndexPacket));
+      if (buffer == (void *) NULL)
+        return(MagickFail);
+      stream_info->indexes=(IndexPacket *) buffer;
+    }
+  buffer=MagickReallocateResourceLimitedArray(unsigned long *,
+                                              stream_info->written,rows,
+                                              sizeof(unsigned long));
+  if (buffer == (void *) NULL)
+    return(MagickFail);
+  stream_info->written=(unsigned long *) buffer;
+  (void) memset(stream_info->written+stream_info->pending_rows,0,
+                (rows-stream_info->pending_rows)*sizeof(unsigned long));
+  stream_info->pending_rows=rows;
+  return(MagickPass);
+}
+
+/*
+
+  Transfer a region from the cache nexus to a stream cache, and then
+  pass any rows which are now complete to the row handler.  The region
+  may not include rows which were already passed to the handler, and
+  each pixel may only be written once.
+
+*/
+static MagickPassFail
+WriteStreamCache(Image *image,const CacheInfo *cache_info,
+                 const NexusInfo *nexus_info,ExceptionInfo *exception)
+{
+  StreamCacheInfo
+    *stream_info;
+
+  MagickPassFail
+    status;
+
+  size_t
+    count;
+
+  unsigned long
+    offset,
+    row,
+    rows;
+
+  stream_info=cache_info->stream_info;
+  status=MagickPass;
+  LockSemaphoreInfo(stream_info->semaphore);
+  if ((nexus_info->region.x < 0) ||
+      (nexus_info->region.x+nexus_info->region.width > cache_info->columns) ||
+      (nexus_info->region.y < stream_info->next_row) ||
+      (nexus_info->region.y+nexus_info->region.height > cache_info->rows))
+    {
+      (void) LogMagickEvent(CacheEvent,GetMagickModule(),
+                            "stream %.1024s: region %lux%lu%+ld%+ld is outside"
+                            " of the pending rows (next row %ld)",
+                            cache_info->filename,nexus_info->region.width,
+                            nexus_info->region.height,nexus_info->region.x,
+                            nexus_info->region.y,stream_info->next_row);
+      ThrowException(exception,StreamError,UnableToSyncPixelStream,
+                     image->filename);
+      status=MagickFail;
+    }
+  if (status != MagickFail)
+    {
+      offset=(unsigned long) (nexus_info->region.y-stream_info->next_row);
+      rows=offset+nexus_info->region.height;
+      if (ReserveStreamCacheRows(cache_info,rows) == MagickFail)
+        {
+          ThrowException(exception,ResourceLimitError,MemoryAllocationFailed,
+                         image->filename);
+          status=MagickFail;
+        }
+    }
+  if (status != MagickFail)
+    {
+      for (row=0; row < nexus_info->region.height; row++)
+        {
+          count=(size_t) (offset+row)*cache_info->columns+nexus_info->region.x;
+          (void) memcpy(stream_info->pixels+count,nexus_info->pixels+
+                        (size_t) row*nexus_info->region.width,
+                        nexus_info->region.width*sizeof(PixelPacket));
+          if (cache_info->indexes_valid &&
+              (nexus_info->indexes != (IndexPacket *) NULL))
+            (void) memcpy(stream_info->indexes+count,nexus_info->indexes+
+                          (size_t) row*nexus_info->region.width,
+                          nexus_info->region.width*sizeof(IndexPacket));
+          stream_info->written[offset+row]+=nexus_info->region.width;
+        }
+      if (rows > stream_info->high_row)
+        stream_info->high_row=rows;
+      /*
+        Pass the rows which are complete to the handler.
+      */
+      for (rows=0; (rows < stream_info->high_row) &&
+             (stream_info->written[rows] >= cache_info->columns); rows++)
+        ;
+      if (rows != 0)
+        {
+          status=(stream_info->handler)(stream_info->client_data,image,
+                                        stream_info->next_row,rows,
+                                        stream_info->pixels,
+                                        (cache_info->indexes_valid ?
+                                         stream_info->indexes :
+                                         (IndexPacket *) NULL),exception);
+          count=stream_info->high_row-rows;
+          if (count != 0)
+            {
+              (void) memmove(stream_info->pixels,stream_info->pixels+
+                             (size_t) rows*cache_info->columns,
+                             count*cache_info->columns*sizeof(PixelPacket));
+              if (cache_info->indexes_valid)
+                (void) memmove(stream_info->indexes,stream_info->indexes+
+                               (size_t) rows*cache_info->columns,
+                               count*cache_info->columns*sizeof(IndexPacket));
+              (void) memmove(stream_info->written,stream_info->written+rows,
+                             count*sizeof(unsigned long));
+            }
+          (void) memset(stream_info->written+count,0,
+                        rows*sizeof(unsigned long));
+          stream_info->high_row=(unsigned long) count;
+          stream_info->next_row+=rows;
+        }
+    }
+  UnlockSemaphoreInfo(stream_info->semaphore);
+  return(status);
+}
+
+/*
+
+  Transfer rows from a stream cache to the cache nexus.  Rows which
+  were already passed to the row handler are no longer available.
+  Pending rows are returned as written, and the content of pixels
+  which have not been written yet is undefined.
+
+*/
+static MagickPassFail
+ReadStreamCache(const CacheInfo *cache_info,const NexusInfo *nexus_info)
+{
+  StreamCacheInfo
+    *stream_info;
+
+  MagickPassFail
+    status;
+
+  unsigned long
+    offset,
+    row;
+
+  size_t
+    index;
+
+  stream_info=cache_info->stream_info;
+  status=MagickPass;
+  LockSemaphoreInfo(stream_info->semaphore);
+  if (nexus_info->region.y < stream_info->next_row)
+    status=MagickFail;
+  else
+    for (row=0; row < nexus_info->region.height; row++)
+      {
+        offset=(unsigned long) (nexus_info->region.y-stream_info->next_row)+
+          row;
+        if ((offset >= stream_info->high_row) ||
+            (stream_info->written[offset] == 0))
+          continue;
+        index=(size_t) offset*cache_info->columns+nexus_info->region.x;
+        (void) memcpy(nexus_info->pixels+(size_t) row*nexus_info->region.width,
+                      stream_info->pixels+index,
+                      nexus_info->region.width*sizeof(PixelPacket));
+        if (cache_info->indexes_valid &&
+            (nexus_info->indexes != (IndexPacket *) NULL))
+          (void) memcpy(nexus_info->indexes+
+                        (size_t) row*nexus_info->region.width,
+                        stream_info->indexes+index,
+                        nexus_info->region.width*sizeof(IndexPacket));
+      }
+  UnlockSemaphoreInfo(stream_info->semaphore);
+  return(status);
+}
+
 static NexusInfo *InitializeCacheNexus(NexusInfo * restrict nexus_info)
 {
   if (nexus_info != ((NexusInfo *) NULL))
@@ -637,6 +1917,7 @@ SetNexus(const Image * restrict image,const long x,const long y,
 
   if ((cache_info->type != PingCache) &&
       (cache_info->type != DiskCache) &&
+      (cache_info->type != StreamCache) &&
       (/* Region must entirely be in bounds of image raster */
        (x >= 0) && (y >= 0) && ((y+rows) <= cache_info->rows)
        ) &&
@@ -648,7 +1929,8 @@ SetNexus(const Image * restrict image,const long x,const long y,
         (x == 0) && (columns == cache_info->columns)
         )) &&
       (*ImageGetClipMaskInlined(image) == (const Image *) NULL) &&
-      (*ImageGetCompositeMaskInlined(image) == (const Image *) NULL))
+      (*ImageGetCompositeMaskInlined(image) == (const Image *) NULL) &&
+      (cache_info->float_pixels == (FloatPixelPacket *) NULL))
     {
       /*
         Pixels are accessed directly from memory.
@@ -1007,6 +2289,8 @@ ReadCacheIndexes(const Cache cache,const NexusInfo *nexus_info,
     return(MagickFail);
   if (nexus_info->in_core)
     return(MagickPass);
+  if (cache_info->type == StreamCache)
+    return(MagickPass); /* Indexes are read by ReadStreamCache() */
   offset=nexus_info->region.y*(magick_off_t) cache_info->columns+nexus_info->region.x;
   length=nexus_info->region.width*sizeof(IndexPacket);
   rows=nexus_info->region.height;
@@ -1051,6 +2335,9 @@ ReadCacheIndexes(const Cache cache,const NexusInfo *nexus_info,
         }
       return(MagickPass);
     }
+  if (cache_info->tile_cache != (TileCache *) NULL)
+    return(TransferCacheTiles(cache_info,&nexus_info->region,
+                              nexus_info->indexes,MagickTrue,MagickFalse));
   /*
     Read indexes from disk.
   */
@@ -1063,9 +2350,10 @@ ReadCacheIndexes(const Cache cache,const NexusInfo *nexus_info,
         number_pixels=(magick_uint64_t) cache_info->columns*cache_info->rows;
         for (y=0; y < (long) rows; y++)
           {
-            if ((FilePositionRead(file,indexes,length,cache_info->offset+
-                                  number_pixels*sizeof(PixelPacket)+offset*
-                                  sizeof(IndexPacket))) <= 0)
+            if ((CacheFileRead(cache_info,file,indexes,length,
+                               cache_info->offset+
+                               number_pixels*sizeof(PixelPacket)+offset*
+                               sizeof(IndexPacket))) <= 0)
               break;
             indexes+=nexus_info->region.width;
             offset+=cache_info->columns;
@@ -1150,6 +2438,8 @@ ReadCachePixels(const Cache cache,const NexusInfo *nexus_info,
   assert(cache_info->signature == MagickSignature);
   if (nexus_info->in_core)
     return(MagickPass);
+  if (cache_info->type == StreamCache)
+    return(ReadStreamCache(cache_info,nexus_info));
   offset=nexus_info->region.y*(magick_off_t) cache_info->columns;
   if ((long) (offset/cache_info->columns) != nexus_info->region.y)
     return MagickFail;
@@ -1169,6 +2459,26 @@ ReadCachePixels(const Cache cache,const NexusInfo *nexus_info,
     }
   y=0;
   pixels=nexus_info->pixels;
+  if (cache_info->float_pixels != (FloatPixelPacket *) NULL)
+    {
+      /*
+        Read pixels from floating point memory.
+      */
+      register const FloatPixelPacket
+        *float_pixels;
+
+      float_pixels=cache_info->float_pixels+offset;
+      for (y=0; y < (long) nexus_info->region.height; y++)
+        {
+          register long
+            x;
+
+          for (x=0; x < (long) nexus_info->region.width; x++)
+            FloatToPixelPacket(&float_pixels[x],pixels++);
+          float_pixels+=cache_info->columns;
+        }
+      return(MagickPass);
+    }
   if (cache_info->type != DiskCache)
     {
       /*
@@ -1201,6 +2511,9 @@ ReadCachePixels(const Cache cache,const NexusInfo *nexus_info,
         }
       return(MagickPass);
     }
+  if (cache_info->tile_cache != (TileCache *) NULL)
+    return(TransferCacheTiles(cache_info,&nexus_info->region,
+                              nexus_info->pixels,MagickFalse,MagickFalse));
   /*
     Read pixels from disk.
   */
@@ -1212,9 +2525,9 @@ ReadCachePixels(const Cache cache,const NexusInfo *nexus_info,
       {
         for (y=0; y < (long) rows; y++)
           {
-            if ((FilePositionRead(file,pixels,length,
-                                  cache_info->offset+offset*
-                                  sizeof(PixelPacket))) < (ssize_t) length)
+            if ((CacheFileRead(cache_info,file,pixels,length,
+                               cache_info->offset+offset*
+                               sizeof(PixelPacket))) < (ssize_t) length)
               break;
             pixels+=nexus_info->region.width;
             offset+=cache_info->columns;
@@ -1344,6 +2657,9 @@ WriteCacheIndexes(Cache cache,const NexusInfo *nexus_info)
         }
       return(MagickPass);
     }
+  if (cache_info->tile_cache != (TileCache *) NULL)
+    return(TransferCacheTiles(cache_info,&nexus_info->region,
+                              nexus_info->indexes,MagickTrue,MagickTrue));
   /*
     Write indexes to disk.
   */
@@ -1366,12 +2682,12 @@ WriteCacheIndexes(Cache cache,const NexusInfo *nexus_info)
           bytes_written;
 
         number_pixels=(magick_uint64_t) cache_info->columns*cache_info->rows;
-        row_offset=cache_info->offset+number_pixels*sizeof(PixelPacket)+offset
-          *sizeof(IndexPacket);
         for (y=0; y < (long) rows; y++)
           {
-            if ((bytes_written=FilePositionWrite(file,indexes,length,row_offset))
-                < (long) length)
+            row_offset=cache_info->offset+number_pixels*sizeof(PixelPacket)+
+              offset*sizeof(IndexPacket);
+            if ((bytes_written=CacheFileWrite(cache_info,file,indexes,length,
+                                              row_offset)) < (long) length)
               {
                 (void) LogMagickEvent(CacheEvent,GetMagickModule(),
                                       "Failed to write row %ld at file offset %" MAGICK_OFF_F
@@ -1468,6 +2784,26 @@ WriteCachePixels(Cache cache,const NexusInfo *nexus_info)
   number_pixels=(magick_uint64_t) length*rows;
   y=0;
   pixels=nexus_info->pixels;
+  if (cache_info->float_pixels != (FloatPixelPacket *) NULL)
+    {
+      /*
+        Write pixels to floating point memory.
+      */
+      register FloatPixelPacket
+        *float_pixels;
+
+      float_pixels=cache_info->float_pixels+offset;
+      for (y=0; y < (long) rows; y++)
+        {
+          register long
+            x;
+
+          for (x=0; x < (long) nexus_info->region.width; x++)
+            PixelPacketToFloat(pixels++,&float_pixels[x]);
+          float_pixels+=cache_info->columns;
+        }
+      return(MagickPass);
+    }
   if (cache_info->type != DiskCache)
     {
       register PixelPacket
@@ -1510,6 +2846,9 @@ WriteCachePixels(Cache cache,const NexusInfo *nexus_info)
         }
       return(MagickPass);
     }
+  if (cache_info->tile_cache != (TileCache *) NULL)
+    return(TransferCacheTiles(cache_info,&nexus_info->region,
+                              nexus_info->pixels,MagickFalse,MagickTrue));
   /*
     Write pixels to disk.
   */
@@ -1533,8 +2872,8 @@ WriteCachePixels(Cache cache,const NexusInfo *nexus_info)
               bytes_written;
 
             row_offset=cache_info->offset+offset*sizeof(PixelPacket);
-            if ((bytes_written=FilePositionWrite(file,pixels,length,row_offset))
-                < (ssize_t) length)
+            if ((bytes_written=CacheFileWrite(cache_info,file,pixels,length,
+                                              row_offset)) < (ssize_t) length)
               {
                 (void) LogMagickEvent(CacheEvent,GetMagickModule(),
                                       "Failed to write row %ld at file offset %"
@@ -2270,10 +3609,16 @@ SyncCacheNexus(Image *image,const NexusInfo *nexus_info,
     }
   else if (nexus_info->in_core)
     {
+      /*
+        Pixels were updated in place through the pointer returned
+        by SetCacheNexus().
+      */
+      UpdateCacheGeneration(cache_info);
       status=MagickPass;
     }
   else
     {
+      UpdateCacheGeneration(cache_info);
       if (*ImageGetClipMaskInlined(image) != (Image *) NULL)
         if (!ClipCacheNexus(image,nexus_info))
           status=MagickFail;
@@ -2288,6 +3633,13 @@ SyncCacheNexus(Image *image,const NexusInfo *nexus_info,
             }
         }
 
+      if (cache_info->type == StreamCache)
+        {
+          if (status != MagickFail)
+            status=WriteStreamCache(image,cache_info,nexus_info,exception);
+          return(status);
+        }
+
       if (status != MagickFail)
         if ((status=WriteCachePixels(cache_info,nexus_info)) == MagickFail)
           ThrowException(exception,CacheError,UnableToSyncCache,
@@ -2377,12 +3729,22 @@ OpenCache(Image *image,const MapMode mode,ExceptionInfo *exception)
   int
     file;
 
+  magick_int64_t
+    tile_limit;
+
+  MagickBool
+    tiles_on_disk;
+
   PixelPacket
     *pixels;
 
   size_t
     packet_size;
 
+  unsigned long
+    tile_columns,
+    tile_rows;
+
   assert(image != (Image *) NULL);
   assert(image->signature == MagickSignature);
   assert(image->cache != (void *) NULL);
@@ -2407,6 +3769,8 @@ OpenCache(Image *image,const MapMode mode,ExceptionInfo *exception)
     }
   cache_info->rows=image->rows;
   cache_info->columns=image->columns;
+  UpdateCacheGeneration(cache_info);
+  tiles_on_disk=MagickFalse;
   if (cache_info->storage_class != UndefinedClass)
     {
       /*
@@ -2428,6 +3792,22 @@ OpenCache(Image *image,const MapMode mode,ExceptionInfo *exception)
           }
         case DiskCache:
           {
+            (void) DestroyDiskCacheIO(cache_info);
+            if (cache_info->tile_cache != (TileCache *) NULL)
+              {
+                /*
+                  Write back modified tiles so that the pixels are
+                  retained if the cache is re-opened with the same
+                  dimensions.
+                */
+                tiles_on_disk=((cache_info->tile_cache->columns ==
+                                image->columns) &&
+                               (cache_info->tile_cache->rows ==
+                                image->rows) &&
+                               (FlushTileCache(cache_info) != MagickFail));
+                DestroyTileCache(cache_info->tile_cache);
+                cache_info->tile_cache=(TileCache *) NULL;
+              }
             LiberateMagickResource(DiskResource,cache_info->length);
             if (cache_info->file == -1)
               break;
@@ -2442,6 +3822,10 @@ OpenCache(Image *image,const MapMode mode,ExceptionInfo *exception)
             LiberateMagickResource(MapResource,cache_info->length);
             break;
           }
+        case StreamCache:
+          {
+            break;
+          }
         }
     }
 
@@ -2462,6 +3846,7 @@ OpenCache(Image *image,const MapMode mode,ExceptionInfo *exception)
       cache_info->storage_class=image->storage_class;
       cache_info->colorspace=image->colorspace;
       cache_info->type=PingCache;
+      MagickFreeResourceLimitedMemory(cache_info->float_pixels);
       cache_info->pixels=(PixelPacket *) NULL;
       cache_info->indexes=(IndexPacket *) NULL;
       cache_info->length=0;
@@ -2474,6 +3859,25 @@ OpenCache(Image *image,const MapMode mode,ExceptionInfo *exception)
   if (CheckImagePixelLimits(image,exception) == MagickFail)
     return MagickFail;
 
+  if (cache_info->type == StreamCache)
+    {
+      /*
+        Rows are passed to the stream handler rather than stored.
+        Pending rows are discarded since their layout may change.
+      */
+      cache_info->storage_class=image->storage_class;
+      cache_info->colorspace=image->colorspace;
+      cache_info->pixels=(PixelPacket *) NULL;
+      cache_info->indexes=(IndexPacket *) NULL;
+      cache_info->length=0;
+      FreeStreamCacheRows(cache_info->stream_info);
+      (void) LogMagickEvent(CacheEvent,GetMagickModule(),
+                            "open %.1024s (stream, %lux%lu)",
+                            cache_info->filename,cache_info->columns,
+                            cache_info->rows);
+      return(MagickPass);
+    }
+
   /*
     Compute storage sizes.  Make sure that sizes fit within our
     numeric limits.
@@ -2490,6 +3894,61 @@ OpenCache(Image *image,const MapMode mode,ExceptionInfo *exception)
       return MagickFail;
     }
   cache_info->length=offset;
+  if ((image->extra->pixel_format == FloatPixelFormat) &&
+      ((cache_info->type == UndefinedCache) ||
+       (cache_info->type == MemoryCache)))
+    {
+      FloatPixelPacket
+        *float_pixels;
+
+      /*
+        Attempt to create floating point pixel cache in memory.  Float
+        pixels are only supported for memory resident caches.
+      */
+      float_pixels=(FloatPixelPacket *) NULL;
+      offset=number_pixels*(sizeof(FloatPixelPacket)+sizeof(IndexPacket));
+      if ((offset/number_pixels == (sizeof(FloatPixelPacket)+
+                                    sizeof(IndexPacket))) &&
+          (offset == (magick_uint64_t) ((size_t) offset)))
+        {
+          MagickFreeResourceLimitedMemory(cache_info->pixels);
+          float_pixels=
+            MagickReallocateResourceLimitedMemory(FloatPixelPacket *,
+                                                  cache_info->float_pixels,
+                                                  (size_t) offset);
+          if (float_pixels == (FloatPixelPacket *) NULL)
+            MagickFreeResourceLimitedMemory(cache_info->float_pixels);
+        }
+      if (float_pixels != (FloatPixelPacket *) NULL)
+        {
+          cache_info->length=offset;
+          cache_info->storage_class=image->storage_class;
+          cache_info->colorspace=image->colorspace;
+          cache_info->type=MemoryCache;
+          cache_info->pixels=(PixelPacket *) NULL;
+          cache_info->float_pixels=float_pixels;
+          cache_info->indexes=(IndexPacket *) NULL;
+          if (cache_info->indexes_valid)
+            cache_info->indexes=(IndexPacket *) (float_pixels+number_pixels);
+          FormatSize(cache_info->length,format);
+          if (image->logging)
+            (void) LogMagickEvent(CacheEvent,GetMagickModule(),
+                                  "open %.1024s (%.1024s float) storage_class=%s,"
+                                  " colorspace=%s",cache_info->filename,
+                                  format,
+                                  ClassTypeToString(cache_info->storage_class),
+                                  ColorspaceTypeToString(cache_info->colorspace));
+          return(MagickPass);
+        }
+      (void) LogMagickEvent(CacheEvent,GetMagickModule(),
+                            "unable to allocate float pixel cache for"
+                            " %.1024s, using quantum pixels",
+                            cache_info->filename);
+    }
+  else if (cache_info->float_pixels != (FloatPixelPacket *) NULL)
+    {
+      MagickFreeResourceLimitedMemory(cache_info->float_pixels);
+    }
   /*
     Attempt to create pixel cache in memory
   */
@@ -2536,8 +3995,24 @@ OpenCache(Image *image,const MapMode mode,ExceptionInfo *exception)
         }
     }
   /*
-    Create pixel cache on disk.
+    Create pixel cache on disk.  Temporary disk caches use a tiled
+    layout if requested so that column-oriented access is efficient.
   */
+  tile_columns=0;
+  tile_rows=0;
+  tile_limit=0;
+  if (!cache_info->persistent && (mode == IOMode))
+    GetCacheTileConfiguration(&tile_columns,&tile_rows,&tile_limit);
+  if (tile_columns != 0)
+    {
+      offset=(magick_uint64_t) ((image->columns+tile_columns-1)/tile_columns)*
+        ((image->rows+tile_rows-1)/tile_rows)*tile_columns*tile_rows*
+        packet_size;
+      if ((magick_uint64_t) ((magick_off_t) offset) == offset)
+        cache_info->length=offset;
+      else
+        tile_columns=0;
+    }
   if (!AcquireMagickResource(DiskResource,cache_info->length))
     {
       ThrowException(exception,ResourceLimitError,CacheResourcesExhausted,
@@ -2606,15 +4081,51 @@ OpenCache(Image *image,const MapMode mode,ExceptionInfo *exception)
       ThrowException(exception,CacheError,UnableToExtendCache,image->filename);
       return MagickFail;
     }
+  if (tile_columns != 0)
+    {
+      cache_info->tile_cache=AllocateTileCache(image->columns,image->rows,
+                                               tile_columns,tile_rows,
+                                               cache_info->indexes_valid,
+                                               tile_limit,tiles_on_disk);
+      if (cache_info->tile_cache == (TileCache *) NULL)
+        {
+          (void) close(file);
+          (void) LiberateTemporaryFile(cache_info->cache_filename);
+          LiberateMagickResource(DiskResource,cache_info->length);
+          ThrowException(exception,ResourceLimitError,MemoryAllocationFailed,
+                         image->filename);
+          return MagickFail;
+        }
+    }
   cache_info->storage_class=image->storage_class;
   cache_info->colorspace=image->colorspace;
   cache_info->type=DiskCache;
-  if ((cache_info->length > MinBlobExtent) &&
+  if ((cache_info->tile_cache == (TileCache *) NULL) &&
+      (cache_info->length > MinBlobExtent) &&
       (cache_info->length == ((size_t) cache_info->length)) &&
       AcquireMagickResource(MapResource,cache_info->length))
     {
-      pixels=(PixelPacket *) MapBlob(file,mode,(off_t) cache_info->offset,
-                                     (size_t) cache_info->length);
+#if defined(HAVE_MMAP_FILEIO)
+      if (cache_info->persistent && (mode == ReadMode))
+        {
+          /*
+            Map an attached persistent cache shared so that processes
+            attaching the same file use the same pages, and no private
+            copy is reserved.  Pixels are never written through this
+            mapping since ModifyCache() clones a read-only cache before
+            it is modified.
+          */
+          pixels=(PixelPacket *) MagickMmap((char *) NULL,
+                                            (size_t) cache_info->length,
+                                            PROT_READ,MAP_SHARED,file,
+                                            (off_t) cache_info->offset);
+          if ((void *) pixels == (void *) MAP_FAILED)
+            pixels=(PixelPacket *) NULL;
+        }
+      else
+#endif /* defined(HAVE_MMAP_FILEIO) */
+        pixels=(PixelPacket *) MapBlob(file,mode,(off_t) cache_info->offset,
+                                       (size_t) cache_info->length);
       if (pixels == (PixelPacket *) NULL)
         LiberateMagickResource(MapResource,cache_info->length);
       else
@@ -2636,6 +4147,9 @@ OpenCache(Image *image,const MapMode mode,ExceptionInfo *exception)
         cache_info->file=file;
       else
         (void) close(file);
+      if ((cache_info->file != -1) &&
+          (cache_info->tile_cache == (TileCache *) NULL))
+        cache_info->disk_io=AllocateDiskCacheIO();
     }
 #if defined(SIGBUS)
   /*   (void) signal(SIGBUS,CacheSignalHandler); */
@@ -2647,7 +4161,11 @@ OpenCache(Image *image,const MapMode mode,ExceptionInfo *exception)
                           " storage_class=%s, colorspace=%s",
                           cache_info->filename,cache_info->cache_filename,
                           cache_info->file,
-                          cache_info->type == MapCache ? "memory-mapped" : "disk",
+                          cache_info->type == MapCache ?
+                          (cache_info->persistent && cache_info->read_only ?
+                           "shared memory-mapped" : "memory-mapped") :
+                          cache_info->tile_cache != (TileCache *) NULL ?
+                          "tiled disk" : "disk",
                           format,
                           ClassTypeToString(cache_info->storage_class),
                           ColorspaceTypeToString(cache_info->colorspace));
@@ -2888,6 +4406,164 @@ AcquireCacheViewIndexes(const ViewInfo *view)
   return view_info->nexus_info.indexes;
 }
 
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   A c q u i r e I m a g e F l o a t P i x e l s                             %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  AcquireImageFloatPixels() copies a pixel region into a caller supplied
+%  array of FloatPixelPacket.  If the image pixel cache uses
+%  FloatPixelFormat, the stored values are returned without clamping or
+%  rounding, otherwise the quantum pixels are converted.  Channel values
+%  use the same scale as Quantum (0 to MaxRGB).  Pixels outside of the
+%  image are supplied according to the image virtual pixel method.
+%
+%  The format of the AcquireImageFloatPixels() method is:
+%
+%      MagickPassFail AcquireImageFloatPixels(const Image *image,
+%        const long x,const long y,const unsigned long columns,
+%        const unsigned long rows,FloatPixelPacket *pixels,
+%        ExceptionInfo *exception)
+%
+%  A description of each parameter follows:
+%
+%    o image: The image.
+%
+%    o x,y,columns,rows:  These values define the perimeter of a region of
+%      pixels.
+%
+%    o pixels: An array of columns*rows FloatPixelPacket to update.
+%
+%    o exception: Return any errors or warnings in this structure.
+%
+%
+*/
+static inline MagickBool
+VirtualFloatCoordinate(const VirtualPixelMethod method,const long offset,
+                       const unsigned long extent,long *coordinate)
+{
+  long
+    tile;
+
+  if ((offset >= 0) && (offset < (long) extent))
+    {
+      *coordinate=offset;
+      return MagickTrue;
+    }
+  tile=offset % (long) extent;
+  if (tile < 0)
+    tile+=(long) extent;
+  switch (method)
+    {
+    case ConstantVirtualPixelMethod:
+      return MagickFalse;
+    case MirrorVirtualPixelMethod:
+      *coordinate=(long) extent-tile-1;
+      break;
+    case TileVirtualPixelMethod:
+      *coordinate=tile;
+      break;
+    case EdgeVirtualPixelMethod:
+    default:
+      *coordinate=(offset < 0 ? 0 : (long) extent-1);
+      break;
+    }
+  return MagickTrue;
+}
+
+MagickExport MagickPassFail
+AcquireImageFloatPixels(const Image *image,const long x,const long y,
+                        const unsigned long columns,const unsigned long rows,
+                        FloatPixelPacket *pixels,ExceptionInfo *exception)
+{
+  const CacheInfo
+    * restrict cache_info;
+
+  FloatPixelPacket
+    background;
+
+  register FloatPixelPacket
+    *q;
+
+  long
+    u,
+    v;
+
+  assert(image != (Image *) NULL);
+  assert(image->signature == MagickSignature);
+  assert(image->cache != (Cache) NULL);
+  assert(pixels != (FloatPixelPacket *) NULL);
+  cache_info=(const CacheInfo *) image->cache;
+  assert(cache_info->signature == MagickSignature);
+  if ((cache_info->float_pixels == (FloatPixelPacket *) NULL) ||
+      (image->columns != cache_info->columns) ||
+      (image->rows != cache_info->rows))
+    {
+      register const PixelPacket
+        *p;
+
+      register size_t
+        i;
+
+      /*
+        Convert pixels acquired from the quantum pixel cache.
+      */
+      p=AcquireImagePixels(image,x,y,columns,rows,exception);
+      if (p == (const PixelPacket *) NULL)
+        return MagickFail;
+      for (i=0; i < (size_t) columns*rows; i++)
+        PixelPacketToFloat(&p[i],&pixels[i]);
+      return MagickPass;
+    }
+  PixelPacketToFloat(&image->background_color,&background);
+  q=pixels;
+  for (v=0; v < (long) rows; v++)
+    {
+      long
+        source_y;
+
+      if (((y+v) >= 0) && ((y+v) < (long) cache_info->rows) &&
+          (x >= 0) && ((x+columns) <= cache_info->columns))
+        {
+          /*
+            Copy a run of pixels inside the cache extents.
+          */
+          (void) memcpy(q,cache_info->float_pixels+
+                        (y+v)*(magick_off_t) cache_info->columns+x,
+                        columns*sizeof(FloatPixelPacket));
+          q+=columns;
+          continue;
+        }
+      if (!VirtualFloatCoordinate(cache_info->virtual_pixel_method,y+v,
+                                  cache_info->rows,&source_y))
+        {
+          for (u=0; u < (long) columns; u++)
+            *q++=background;
+          continue;
+        }
+      for (u=0; u < (long) columns; u++)
+        {
+          long
+            source_x;
+
+          if (VirtualFloatCoordinate(cache_info->virtual_pixel_method,x+u,
+                                     cache_info->columns,&source_x))
+            *q=cache_info->float_pixels[source_y*(magick_off_t)
+                                        cache_info->columns+source_x];
+          else
+            *q=background;
+          q++;
+        }
+    }
+  return MagickPass;
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -3007,6 +4683,8 @@ AcquireOneCacheViewPixelInlined(View *view_info,
       if ((cache_info->indexes_valid) &&
           (PseudoClass == cache_info->storage_class))
         *pixel=image->colormap[cache_info->indexes[offset]];
+      else if (cache_info->float_pixels != (FloatPixelPacket *) NULL)
+        FloatToPixelPacket(&cache_info->float_pixels[offset],pixel);
       else
         *pixel=cache_info->pixels[offset];
       status=MagickPass;
@@ -3299,7 +4977,33 @@ ClonePixelCache(Image *image,Image *clone_image,ExceptionInfo *exception)
 
   cache_info=(CacheInfo *) image->cache;
   clone_info=(CacheInfo *) clone_image->cache;
-  if (cache_info->length != clone_info->length)
+  if ((cache_info->float_pixels != (FloatPixelPacket *) NULL) &&
+      (clone_info->float_pixels != (FloatPixelPacket *) NULL) &&
+      (cache_info->columns == clone_info->columns) &&
+      (cache_info->rows == clone_info->rows))
+    {
+      magick_uint64_t
+        number_pixels;
+
+      /*
+        Floating point pixel cache clone (preserves unclamped values).
+      */
+      (void) LogMagickEvent(CacheEvent,GetMagickModule(),
+                            "float => float clone");
+      number_pixels=(magick_uint64_t) cache_info->columns*cache_info->rows;
+      (void) memcpy(clone_info->float_pixels,cache_info->float_pixels,
+                    (size_t) number_pixels*sizeof(FloatPixelPacket));
+      if ((cache_info->indexes != (IndexPacket *) NULL) &&
+          (clone_info->indexes != (IndexPacket *) NULL))
+        (void) memcpy(clone_info->indexes,cache_info->indexes,
+                      (size_t) number_pixels*sizeof(IndexPacket));
+      return(MagickPass);
+    }
+  if ((cache_info->length != clone_info->length) ||
+      ((cache_info->float_pixels != (FloatPixelPacket *) NULL) !=
+       (clone_info->float_pixels != (FloatPixelPacket *) NULL)) ||
+      (cache_info->tile_cache != (TileCache *) NULL) ||
+      (clone_info->tile_cache != (TileCache *) NULL))
     {
       Image
         *clip_mask,
@@ -3382,6 +5086,20 @@ ClonePixelCache(Image *image,Image *clone_image,ExceptionInfo *exception)
   LockSemaphoreInfo(cache_info->file_semaphore);
   LockSemaphoreInfo(clone_info->file_semaphore);
   status=MagickPass;
+  /*
+    The cache files are accessed directly below, so pending buffered
+    writes must reach the files and buffered reads are invalidated.
+  */
+  if ((FlushDiskCacheIO(cache_info) == MagickFail) ||
+      (FlushDiskCacheIO(clone_info) == MagickFail))
+    {
+      status=MagickFail;
+      ThrowException(exception,CacheError,UnableToCloneCache,
+                     image->filename);
+      goto clone_pixel_cache_done;
+    }
+  if (clone_info->disk_io != (DiskCacheIO *) NULL)
+    clone_info->disk_io->read_length=0;
   cache_file=cache_info->file;
   if (cache_info->type == DiskCache)
     {
@@ -3583,6 +5301,49 @@ CloseCacheView(ViewInfo *view)
     }
 }
 
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
++   C o p y S t r e a m C a c h e H a n d l e r                               %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  CopyStreamCacheHandler() converts a pixel cache which has not yet been
+%  opened into a stream cache using the same row handler as another stream
+%  cache.  Nothing is done if the other cache is not a stream cache.  This
+%  allows images allocated by a coder for an ImageInfo which carries a
+%  stream cache to pass their rows to the stream handler.
+%
+%  The format of the CopyStreamCacheHandler() method is:
+%
+%      void CopyStreamCacheHandler(Cache cache,const Cache stream_cache)
+%
+%  A description of each parameter follows:
+%
+%    o cache: The pixel cache to convert.
+%
+%    o stream_cache: The stream cache to copy the row handler from.
+%
+%
+*/
+extern void
+CopyStreamCacheHandler(Cache cache,const Cache stream_cache)
+{
+  const CacheInfo
+    *stream_cache_info = (const CacheInfo *) stream_cache;
+
+  if ((stream_cache_info == (const CacheInfo *) NULL) ||
+      (stream_cache_info->stream_info == (StreamCacheInfo *) NULL))
+    return;
+  assert(stream_cache_info->signature == MagickSignature);
+  (void) SetStreamCacheHandler(cache,stream_cache_info->stream_info->handler,
+                               stream_cache_info->stream_info->client_data);
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -3630,6 +5391,7 @@ DestroyCacheInfo(Cache cache_info)
   if (MemoryCache == cache_info->type)
     {
       MagickFreeResourceLimitedMemory(cache_info->pixels);
+      MagickFreeResourceLimitedMemory(cache_info->float_pixels);
     }
   else if (MapCache == cache_info->type)
     {
@@ -3637,12 +5399,32 @@ DestroyCacheInfo(Cache cache_info)
       cache_info->pixels = NULL;
       LiberateMagickResource(MapResource,cache_info->length);
     }
+  else if (StreamCache == cache_info->type)
+    {
+      DestroyStreamCacheInfo(cache_info);
+    }
 
   /*
     Release Cache File Resources
   */
   if ((MapCache == cache_info->type) || (DiskCache == cache_info->type))
     {
+      if (cache_info->tile_cache != (TileCache *) NULL)
+        {
+          (void) LogMagickEvent(CacheEvent,GetMagickModule(),
+                                "tile cache %.1024s: %" MAGICK_UINT64_F "u hits,"
+                                " %" MAGICK_UINT64_F "u misses,"
+                                " %" MAGICK_UINT64_F "u tile reads,"
+                                " %" MAGICK_UINT64_F "u tile writes",
+                                cache_info->filename,
+                                cache_info->tile_cache->hits,
+                                cache_info->tile_cache->misses,
+                                cache_info->tile_cache->tile_reads,
+                                cache_info->tile_cache->tile_writes);
+          DestroyTileCache(cache_info->tile_cache);
+          cache_info->tile_cache=(TileCache *) NULL;
+        }
+      (void) DestroyDiskCacheIO(cache_info);
       if (cache_info->file != -1)
         {
           (void) close(cache_info->file);
@@ -3760,6 +5542,7 @@ GetCacheInfo(Cache *cache)
   limit=GetMagickResourceLimit(HeightResource);
   cache_info->limit_height=Min(LONG_MAX,limit);
 
+  UpdateCacheGeneration(cache_info);
   cache_info->signature=MagickSignature;
   *cache=cache_info;
 }
@@ -3962,14 +5745,58 @@ GetCacheViewRegion(const ViewInfo *view)
   const NexusInfo
     *nexus_info;
 
-  assert(view_info != (View *) NULL);
-  assert(view_info->signature == MagickSignature);
-  nexus_info=&view_info->nexus_info;
-  assert(nexus_info != (NexusInfo *) NULL);
-  assert(nexus_info->signature == MagickSignature);
-  return nexus_info->region;
+  assert(view_info != (View *) NULL);
+  assert(view_info->signature == MagickSignature);
+  nexus_info=&view_info->nexus_info;
+  assert(nexus_info != (NexusInfo *) NULL);
+  assert(nexus_info->signature == MagickSignature);
+  return nexus_info->region;
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   G e t I m a g e P i x e l F o r m a t                                     %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  GetImagePixelFormat() returns the storage format of the image pixel
+%  cache.  If the pixel cache has not been opened yet, the format which
+%  will be requested when it is opened is returned.  Operations which
+%  support FloatPixelFormat use AcquireImageFloatPixels() and
+%  StoreImageFloatPixels() to process such images without clamping.
+%
+%  The format of the GetImagePixelFormat() method is:
+%
+%      CachePixelFormat GetImagePixelFormat(const Image *image)
+%
+%  A description of each parameter follows:
+%
+%    o image: The image.
+%
+%
+*/
+MagickExport CachePixelFormat
+GetImagePixelFormat(const Image *image)
+{
+  const CacheInfo
+    *cache_info;
+
+  assert(image != (Image *) NULL);
+  assert(image->signature == MagickSignature);
+  assert(image->cache != (Cache) NULL);
+  cache_info=(const CacheInfo *) image->cache;
+  assert(cache_info->signature == MagickSignature);
+  if (cache_info->type == UndefinedCache)
+    return(image->extra->pixel_format);
+  return(cache_info->float_pixels != (FloatPixelPacket *) NULL ?
+         FloatPixelFormat : QuantumPixelFormat);
 }
-
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -4257,6 +6084,91 @@ GetPixelCacheArea(const Image *image)
   return GetCacheViewArea(AccessDefaultCacheView(image));
 }
 
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
++   G e t P i x e l C a c h e I O S t a t i s t i c s                         %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  GetPixelCacheIOStatistics() returns a snapshot of the process-wide disk
+%  pixel cache I/O counters (read-ahead hits, coalesced writes, system
+%  calls issued, and tile cache hits and misses).
+%
+%  The format of the GetPixelCacheIOStatistics() method is:
+%
+%      void GetPixelCacheIOStatistics(PixelCacheIOStatistics *statistics)
+%
+%  A description of each parameter follows:
+%
+%    o statistics: The returned counters.
+%
+%
+*/
+extern void
+GetPixelCacheIOStatistics(PixelCacheIOStatistics *statistics)
+{
+  assert(statistics != (PixelCacheIOStatistics *) NULL);
+  *statistics=pixel_cache_io_statistics;
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
++   G e t P i x e l C a c h e G e n e r a t i o n                             %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  GetPixelCacheGeneration() returns a number which changes whenever the
+%  pixels of the image may have been modified.  The number is updated when
+%  the cache is (re)opened, when pixels are requested for update, and when
+%  updated pixels are synchronized.  Generation numbers are never reused so
+%  a result computed from the pixels remains valid for as long as the
+%  generation number is unchanged.  Zero is returned if the image does not
+%  have a pixel cache.
+%
+%  The format of the GetPixelCacheGeneration() method is:
+%
+%      magick_uint64_t GetPixelCacheGeneration(const Image *image)
+%
+%  A description of each parameter follows:
+%
+%    o image: Specifies a pointer to an Image structure.
+%
+%
+*/
+extern magick_uint64_t
+GetPixelCacheGeneration(const Image *image)
+{
+  magick_uint64_t
+    generation=0;
+
+  assert(image != (Image *) NULL);
+  assert(image->signature == MagickSignature);
+  if (image->cache != (Cache) NULL)
+    {
+      CacheInfo
+        *cache_info;
+
+      cache_info=(CacheInfo *) image->cache;
+      assert(cache_info->signature == MagickSignature);
+#if defined(__ATOMIC_ACQ_REL)
+      generation=__atomic_load_n(&cache_info->generation,__ATOMIC_ACQUIRE);
+#else
+      generation=cache_info->generation;
+#endif
+    }
+  return generation;
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -4352,6 +6264,49 @@ GetPixelCachePresent(const Image *image)
 
   return MagickTrue;
 }
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
++   G e t P i x e l C a c h e I s S t r e a m                                 %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  GetPixelCacheIsStream() tests to see if the pixel cache is a stream cache
+%  (see SetStreamCacheHandler()).  A stream cache does not retain rows once
+%  they are complete, so the pixels of a stream cache image may only be
+%  written once, in roughly ascending row order.
+%
+%  The format of the GetPixelCacheIsStream() method is:
+%
+%      MagickBool GetPixelCacheIsStream(const Image *image)
+%
+%  A description of each parameter follows:
+%
+%    o image: Specifies a pointer to an Image structure.
+%
+%
+*/
+MagickExport MagickBool
+GetPixelCacheIsStream(const Image *image)
+{
+  CacheInfo
+    *cache_info;
+
+  assert(image != (Image *) NULL);
+  assert(image->signature == MagickSignature);
+
+  if (image->cache == (Cache) NULL)
+    return MagickFalse;
+
+  cache_info=(CacheInfo *) image->cache;
+  assert(cache_info->signature == MagickSignature);
+  return (cache_info->type == StreamCache);
+}
 
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -4593,6 +6548,7 @@ ModifyCache(Image *image, ExceptionInfo *exception)
         image->taint=MagickTrue;
         image->is_grayscale=MagickFalse;
         image->is_monochrome=MagickFalse;
+        UpdateCacheGeneration((CacheInfo *) image->cache);
 
         /*
           Make sure that pixel cache reflects key image parameters
@@ -4667,6 +6623,9 @@ OpenCacheView(Image *image)
 %  PersistCache() attaches to or initializes a persistent pixel cache.  A
 %  persistent pixel cache is one that resides on disk and is not destroyed
 %  when the program exits.
+%  An attached cache is read-only and is memory-mapped shared where
+%  possible, so that processes attaching the same cache file share one copy
+%  of its pages.  It is copied into a private cache when it is modified.
 %
 %  The format of the PersistCache() method is:
 %
@@ -4731,6 +6690,7 @@ PersistCache(Image *image,const char *filename,
       */
       (void) strlcpy(cache_info->cache_filename,filename,MaxTextExtent);
       cache_info->type=DiskCache;
+      cache_info->persistent=MagickTrue;
       cache_info->offset=(*offset);
       if (!OpenCache(image,ReadMode,exception))
         return(MagickFail);
@@ -4743,12 +6703,14 @@ PersistCache(Image *image,const char *filename,
     }
   LockSemaphoreInfo(cache_info->reference_semaphore);
   if ((cache_info->reference_count == 1) &&
-      (cache_info->type != MemoryCache))
+      (cache_info->type != MemoryCache) &&
+      (cache_info->tile_cache == (TileCache *) NULL))
     {
       /*
         Usurp resident persistent pixel cache.
       */
-      status=rename(cache_info->cache_filename,filename);
+      status=(FlushDiskCacheIO(cache_info) != MagickFail ?
+              rename(cache_info->cache_filename,filename) : -1);
       if (status == 0)
         {
           (void) strlcpy(cache_info->cache_filename,filename,MaxTextExtent);
@@ -4770,6 +6732,7 @@ PersistCache(Image *image,const char *filename,
   cache_info=(CacheInfo *) clone_image->cache;
   (void) strlcpy(cache_info->cache_filename,filename,MaxTextExtent);
   cache_info->type=DiskCache;
+  cache_info->persistent=MagickTrue;
   cache_info->offset=(*offset);
   if (!OpenCache(clone_image,IOMode,exception))
     {
@@ -4812,7 +6775,7 @@ PersistCache(Image *image,const char *filename,
     CloseCacheView(image_view);
     CloseCacheView(clone_view);
   }
-  if (y < (long) image->rows)
+  if ((y < (long) image->rows) || (FlushDiskCacheIO(cache_info) == MagickFail))
     {
       DestroyImage(clone_image);
       return(MagickFail);
@@ -4905,6 +6868,100 @@ SetCacheViewPixels(ViewInfo *view,const long x,const long y,
                        &view_info->nexus_info,exception);
 }
 
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   S e t I m a g e P i x e l F o r m a t                                     %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  SetImagePixelFormat() selects the storage format of the image pixel
+%  cache.  QuantumPixelFormat stores PixelPacket at QuantumDepth (the
+%  default) while FloatPixelFormat stores a 32-bit float per channel so
+%  that operations which support it retain values outside of the quantum
+%  range as well as fractional values.  Existing pixels are converted to
+%  the new format.  Images derived from the image via CloneImage() inherit
+%  the format.  Float storage is only available for memory resident
+%  caches so the format falls back to QuantumPixelFormat if the memory
+%  can not be allocated.
+%
+%  The format of the SetImagePixelFormat() method is:
+%
+%      MagickPassFail SetImagePixelFormat(Image *image,
+%        const CachePixelFormat format,ExceptionInfo *exception)
+%
+%  A description of each parameter follows:
+%
+%    o image: The image.
+%
+%    o format: QuantumPixelFormat or FloatPixelFormat.
+%
+%    o exception: Return any errors or warnings in this structure.
+%
+%
+*/
+MagickExport MagickPassFail
+SetImagePixelFormat(Image *image,const CachePixelFormat format,
+                    ExceptionInfo *exception)
+{
+  CacheInfo
+    *cache_info;
+
+  Image
+    clone_image;
+
+  MagickPassFail
+    status;
+
+  assert(image != (Image *) NULL);
+  assert(image->signature == MagickSignature);
+  assert(image->cache != (Cache) NULL);
+  image->extra->pixel_format=format;
+  cache_info=(CacheInfo *) image->cache;
+  assert(cache_info->signature == MagickSignature);
+  if ((cache_info->type == UndefinedCache) ||
+      (cache_info->type == PingCache) ||
+      (cache_info->type == StreamCache))
+    return(MagickPass);
+  if ((cache_info->float_pixels != (FloatPixelPacket *) NULL) ==
+      (format == FloatPixelFormat))
+    return(MagickPass);
+  /*
+    Convert the existing pixels into a new pixel cache.
+  */
+  LockSemaphoreInfo(image->semaphore);
+  (void) LogMagickEvent(CacheEvent,GetMagickModule(),
+                        "convert %.1024s to %s pixels",cache_info->filename,
+                        format == FloatPixelFormat ? "float" : "quantum");
+  clone_image=(*image);
+  clone_image.semaphore=AllocateSemaphoreInfo();
+  clone_image.reference_count=1;
+  GetCacheInfo(&clone_image.cache);
+  ((CacheInfo *) clone_image.cache)->virtual_pixel_method=
+    cache_info->virtual_pixel_method;
+  status=OpenCache(&clone_image,IOMode,exception);
+  if (status != MagickFail)
+    status=ClonePixelCache(image,&clone_image,exception);
+  DestroySemaphoreInfo(&clone_image.semaphore);
+  if (status != MagickFail)
+    {
+      image->cache=clone_image.cache;
+      DestroyCacheInfo(cache_info);
+    }
+  else
+    {
+      DestroyCacheInfo(clone_image.cache);
+      ThrowException(exception,CacheError,UnableToCloneCache,
+                     image->filename);
+    }
+  UnlockSemaphoreInfo(image->semaphore);
+  return(status);
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -5073,6 +7130,177 @@ SetImageVirtualPixelMethod(const Image *image,
   return MagickPass;
 }
 
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
++   S e t S t r e a m C a c h e H a n d l e r                                 %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  SetStreamCacheHandler() converts a pixel cache which has not yet been
+%  opened into a stream cache.  A stream cache does not retain the image.
+%  Rows are passed to the handler in order as soon as they are complete,
+%  and are then discarded.  Rows written out of order are held until the
+%  rows preceding them have been written.  Rows which were passed to the
+%  handler may not be written or read again.  This allows a decoder which
+%  writes its rows in order to pass an image of any height through a small
+%  amount of memory.
+%
+%  The format of the SetStreamCacheHandler() method is:
+%
+%      MagickPassFail SetStreamCacheHandler(Cache cache,
+%                                           StreamCacheHandler handler,
+%                                           void *client_data)
+%
+%  A description of each parameter follows:
+%
+%    o cache: The pixel cache to convert.
+%
+%    o handler: The method which receives completed rows.
+%
+%    o client_data: Opaque data passed to the handler.
+%
+%
+*/
+extern MagickPassFail
+SetStreamCacheHandler(Cache cache,StreamCacheHandler handler,
+                      void *client_data)
+{
+  CacheInfo
+    *cache_info = (CacheInfo *) cache;
+
+  StreamCacheInfo
+    *stream_info;
+
+  assert(cache_info != (CacheInfo *) NULL);
+  assert(cache_info->signature == MagickSignature);
+  assert(handler != (StreamCacheHandler) NULL);
+  if ((cache_info->type != UndefinedCache) &&
+      (cache_info->type != StreamCache))
+    return(MagickFail);
+  stream_info=cache_info->stream_info;
+  if (stream_info == (StreamCacheInfo *) NULL)
+    {
+      stream_info=MagickAllocateClearedMemory(StreamCacheInfo *,
+                                              sizeof(StreamCacheInfo));
+      if (stream_info == (StreamCacheInfo *) NULL)
+        return(MagickFail);
+      stream_info->semaphore=AllocateSemaphoreInfo();
+      if (stream_info->semaphore == (SemaphoreInfo *) NULL)
+        {
+          MagickFreeMemory(stream_info);
+          return(MagickFail);
+        }
+      cache_info->stream_info=stream_info;
+    }
+  stream_info->handler=handler;
+  stream_info->client_data=client_data;
+  cache_info->type=StreamCache;
+  return(MagickPass);
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   S t o r e I m a g e F l o a t P i x e l s                                 %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  StoreImageFloatPixels() stores an array of FloatPixelPacket into a pixel
+%  region which must be inside the image.  If the image pixel cache uses
+%  FloatPixelFormat the values are stored without clamping or rounding,
+%  otherwise they are converted to quantum pixels.  Images with a clip
+%  mask or composite mask are always updated via the quantum pixels so
+%  that the mask is applied.
+%
+%  The format of the StoreImageFloatPixels() method is:
+%
+%      MagickPassFail StoreImageFloatPixels(Image *image,const long x,
+%        const long y,const unsigned long columns,const unsigned long rows,
+%        const FloatPixelPacket *pixels,ExceptionInfo *exception)
+%
+%  A description of each parameter follows:
+%
+%    o image: The image.
+%
+%    o x,y,columns,rows:  These values define the perimeter of a region of
+%      pixels.
+%
+%    o pixels: An array of columns*rows FloatPixelPacket to store.
+%
+%    o exception: Return any errors or warnings in this structure.
+%
+%
+*/
+MagickExport MagickPassFail
+StoreImageFloatPixels(Image *image,const long x,const long y,
+                      const unsigned long columns,const unsigned long rows,
+                      const FloatPixelPacket *pixels,ExceptionInfo *exception)
+{
+  CacheInfo
+    *cache_info;
+
+  register const FloatPixelPacket
+    *p;
+
+  long
+    v;
+
+  assert(image != (Image *) NULL);
+  assert(image->signature == MagickSignature);
+  assert(image->cache != (Cache) NULL);
+  assert(pixels != (const FloatPixelPacket *) NULL);
+  if ((x < 0) || (y < 0) || (columns == 0) || (rows == 0) ||
+      ((x+columns) > image->columns) || ((y+rows) > image->rows))
+    {
+      ThrowException(exception,CacheError,UnableToSyncCache,
+                     image->filename);
+      return(MagickFail);
+    }
+  if (ModifyCache(image,exception) == MagickFail)
+    return(MagickFail);
+  cache_info=(CacheInfo *) image->cache;
+  p=pixels;
+  if ((cache_info->float_pixels != (FloatPixelPacket *) NULL) &&
+      (*ImageGetClipMaskInlined(image) == (const Image *) NULL) &&
+      (*ImageGetCompositeMaskInlined(image) == (const Image *) NULL))
+    {
+      for (v=0; v < (long) rows; v++)
+        {
+          (void) memcpy(cache_info->float_pixels+
+                        (y+v)*(magick_off_t) cache_info->columns+x,p,
+                        columns*sizeof(FloatPixelPacket));
+          p+=columns;
+        }
+      return(MagickPass);
+    }
+  for (v=0; v < (long) rows; v++)
+    {
+      register PixelPacket
+        *q;
+
+      register long
+        u;
+
+      q=SetImagePixelsEx(image,x,y+v,columns,1,exception);
+      if (q == (PixelPacket *) NULL)
+        return(MagickFail);
+      for (u=0; u < (long) columns; u++)
+        FloatToPixelPacket(p++,q++);
+      if (!SyncImagePixelsEx(image,exception))
+        return(MagickFail);
+    }
+  return(MagickPass);
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -66,6 +66,17 @@ extern "C" {
   AcquireOnePixel(const Image *image,const long x,const long y,
                   ExceptionInfo *exception);
 
+  /*
+    AcquireImageFloatPixels() copies a pixel region into an array of
+    FloatPixelPacket.  Values are not clamped if the pixel cache uses
+    FloatPixelFormat.
+  */
+  extern MagickExport MagickPassFail
+  AcquireImageFloatPixels(const Image *image,const long x,const long y,
+                          const unsigned long columns,
+                          const unsigned long rows,
+                          FloatPixelPacket *pixels,ExceptionInfo *exception);
+
 
   /*
     GetImagePixels() and GetImagePixelsEx() obtains a pixel region for
@@ -79,6 +90,12 @@ extern "C" {
                     const unsigned long columns,const unsigned long rows,
                     ExceptionInfo *exception);
 
+  /*
+    GetImagePixelFormat() returns the pixel cache storage format.
+  */
+  extern MagickExport CachePixelFormat
+  GetImagePixelFormat(const Image *image) MAGICK_FUNC_PURE;
+
   /*
     GetImageVirtualPixelMethod() gets the "virtual pixels" method for
     the image.
@@ -137,6 +154,14 @@ extern "C" {
                     const unsigned long columns,const unsigned long rows,
                     ExceptionInfo *exception);
 
+  /*
+    SetImagePixelFormat() selects the pixel cache storage format,
+    converting any existing pixels.
+  */
+  extern MagickExport MagickPassFail
+  SetImagePixelFormat(Image *image,const CachePixelFormat format,
+                      ExceptionInfo *exception);
+
   /*
     SetImageVirtualPixelMethod() sets the "virtual pixels" method for
     the image.
@@ -145,6 +170,17 @@ extern "C" {
   SetImageVirtualPixelMethod(const Image *image,
                              const VirtualPixelMethod method);
 
+  /*
+    StoreImageFloatPixels() stores an array of FloatPixelPacket into a
+    pixel region inside the image.  Values are not clamped if the pixel
+    cache uses FloatPixelFormat.
+  */
+  extern MagickExport MagickPassFail
+  StoreImageFloatPixels(Image *image,const long x,const long y,
+                        const unsigned long columns,const unsigned long rows,
+                        const FloatPixelPacket *pixels,
+                        ExceptionInfo *exception);
+
   /*
     SyncImagePixels() and SyncImagePixelsEx() save the image pixels to
     the in-memory or disk cache.
@@ -439,6 +439,20 @@ typedef struct _ProfilePacket
     black;
 } ProfilePacket;
 
+/*
+  Adjust a 16-bit lcms pixel format so that each pixel occupies exactly
+  one ProfilePacket (four 16-bit samples).  Unused trailing samples are
+  described to lcms as extra channels, which it skips.  This allows an
+  array of ProfilePacket to be passed to cmsDoTransform() as a row.
+*/
+#define ProfilePacketFormat(type) \
+  (((type) & ~EXTRA_SH(7)) | EXTRA_SH(4U-(T_CHANNELS(type)+T_EXTRA(type))))
+
+/*
+  Maximum number of pixels to transform per cmsDoTransform() call.
+*/
+#define ProfilePacketsPerCall 2048
+
 typedef struct _TransformInfo
 {
   Image           *image;             /* image handle */
@@ -449,6 +463,8 @@ typedef struct _TransformInfo
   int             intent;             /* rendering intent */
   cmsUInt32Number flags;              /* create transform flags */
   ThreadViewDataSet *transform;       /* Thread-specific transforms */
+  ThreadViewDataSet *packets;         /* Thread-specific row buffers (or NULL) */
+  unsigned long   packets_per_call;   /* Pixels per row buffer */
   ColorspaceType  source_colorspace;  /* source image transform colorspace */
   ColorspaceType  target_colorspace;  /* target image transform colorspace */
   unsigned long   signature;          /* structure validation signature */
@@ -495,7 +511,12 @@ ProfileImagePixels(void *mutable_data,         /* User provided mutable data */
     *xform = (const TransformInfo *) immutable_data;
 
   register long
-    i;
+    i,
+    j;
+
+  long
+    count,
+    packets_per_call;
 
   cmsHTRANSFORM
     transform;
@@ -507,8 +528,10 @@ ProfileImagePixels(void *mutable_data,         /* User provided mutable data */
     target_colorspace = xform->target_colorspace;
 
   ProfilePacket
-    alpha,
-    beta;
+    alpha_packet,
+    beta_packet,
+    *alpha,
+    *beta;
 
   ARG_NOT_USED(mutable_data);
   ARG_NOT_USED(exception);
@@ -516,53 +539,70 @@ ProfileImagePixels(void *mutable_data,         /* User provided mutable data */
   transform=(cmsHTRANSFORM) AccessThreadViewData(xform->transform);
 
   /*
-    TODO: This may be optimized to use PixelPackets instead
-    of moving PixelPacket components to and from ProfilePackets.
-    The transform types below, then, must match #ifdef's in the
-    PixelPacket struct definition and should be optimized
-    based on Quantum size. Some (if not all?) YCbCr and LUV
-    profiles are (TIFF) scanline oriented, so transforming
-    one pixel at a time does not work for those profiles.
-
-    Notice that the performance penalty of transforming only
-    one pixel at a time is very small and probably not worth
-    optimizing.
+    Pixels are packed into a buffer of ProfilePackets so that a whole
+    row (up to ProfilePacketsPerCall pixels) may be transformed by a
+    single cmsDoTransform() call.  Some (if not all?) YCbCr and LUV
+    profiles are (TIFF) scanline oriented, so transforming more than
+    one pixel at a time does not work for those profiles.  In that case
+    no row buffer is allocated and we transform one pixel at a time.
   */
+  if (xform->packets != (ThreadViewDataSet *) NULL)
+    {
+      alpha=(ProfilePacket *) AccessThreadViewData(xform->packets);
+      packets_per_call=(long) xform->packets_per_call;
+      beta=alpha+packets_per_call;
+    }
+  else
+    {
+      alpha=&alpha_packet;
+      beta=&beta_packet;
+      packets_per_call=1;
+    }
 
-  for (i=0; i < npixels; i++)
+  for (i=0; i < npixels; i += count)
     {
-      alpha.red=ScaleQuantumToShort(pixels[i].red);
-      if (source_colorspace != GRAYColorspace)
-        {
-          alpha.green=ScaleQuantumToShort(pixels[i].green);
-          alpha.blue=ScaleQuantumToShort(pixels[i].blue);
-          if (source_colorspace == CMYKColorspace)
-            alpha.black=ScaleQuantumToShort(pixels[i].opacity);
-        }
-      cmsDoTransform(transform,&alpha,&beta,1);
-      pixels[i].red=ScaleShortToQuantum(beta.red);
-      if (IsGrayColorspace(target_colorspace))
+      count=Min(packets_per_call,npixels-i);
+      for (j=0; j < count; j++)
         {
-          pixels[i].green=pixels[i].red;
-          pixels[i].blue=pixels[i].red;
-        }
-      else
-        {
-          pixels[i].green=ScaleShortToQuantum(beta.green);
-          pixels[i].blue=ScaleShortToQuantum(beta.blue);
+          alpha[j].red=ScaleQuantumToShort(pixels[i+j].red);
+          if (source_colorspace != GRAYColorspace)
+            {
+              alpha[j].green=ScaleQuantumToShort(pixels[i+j].green);
+              alpha[j].blue=ScaleQuantumToShort(pixels[i+j].blue);
+              if (source_colorspace == CMYKColorspace)
+                alpha[j].black=ScaleQuantumToShort(pixels[i+j].opacity);
+            }
         }
-      if (image->matte)
+      cmsDoTransform(transform,alpha,beta,(cmsUInt32Number) count);
+      for (j=0; j < count; j++)
         {
-          if ((source_colorspace == CMYKColorspace) &&
-              (target_colorspace != CMYKColorspace))
-            pixels[i].opacity=indexes[i];
+          PixelPacket
+            *pixel = &pixels[i+j];
+
+          pixel->red=ScaleShortToQuantum(beta[j].red);
+          if (IsGrayColorspace(target_colorspace))
+            {
+              pixel->green=pixel->red;
+              pixel->blue=pixel->red;
+            }
           else
-            if ((source_colorspace != CMYKColorspace) &&
-                (target_colorspace == CMYKColorspace))
-              indexes[i]=pixels[i].opacity;
+            {
+              pixel->green=ScaleShortToQuantum(beta[j].green);
+              pixel->blue=ScaleShortToQuantum(beta[j].blue);
+            }
+          if (image->matte)
+            {
+              if ((source_colorspace == CMYKColorspace) &&
+                  (target_colorspace != CMYKColorspace))
+                pixel->opacity=indexes[i+j];
+              else
+                if ((source_colorspace != CMYKColorspace) &&
+                    (target_colorspace == CMYKColorspace))
+                  indexes[i+j]=pixel->opacity;
+            }
+          if (target_colorspace == CMYKColorspace)
+            pixel->opacity=ScaleShortToQuantum(beta[j].black);
         }
-      if (target_colorspace == CMYKColorspace)
-        pixels[i].opacity=ScaleShortToQuantum(beta.black);
     }
 
   return MagickPass;
@@ -936,6 +976,12 @@ ProfileImage(Image *image,const char *name,unsigned char *profile,
               }
             }
 
+          /*
+            Describe pixel formats in terms of ProfilePacket layout.
+          */
+          xform.source_type=ProfilePacketFormat(xform.source_type);
+          xform.target_type=ProfilePacketFormat(xform.target_type);
+
           /* Colorspace undefined */
           if ((xform.source_colorspace == UndefinedColorspace) ||
               (xform.target_colorspace == UndefinedColorspace))
@@ -1079,8 +1125,32 @@ ProfileImage(Image *image,const char *name,unsigned char *profile,
             }
           (void) cmsCloseProfile(xform.source_profile);
           (void) cmsCloseProfile(xform.target_profile);
+          /*
+            Allocate per-thread row buffers unless a scanline oriented
+            (YCbCr or LUV) colorspace is involved.
+          */
+          if ((status != MagickFail) &&
+              !IsYCbCrColorspace(xform.source_colorspace) &&
+              !IsYCbCrColorspace(xform.target_colorspace) &&
+              (xform.source_colorspace != YUVColorspace) &&
+              (xform.target_colorspace != YUVColorspace))
+            {
+              xform.packets_per_call=
+                Min(ProfilePacketsPerCall,
+                    Max(image->columns,(transform_colormap ? image->colors : 1)));
+              xform.packets=AllocateThreadViewDataArray(image,&image->exception,
+                                                        2*xform.packets_per_call,
+                                                        sizeof(ProfilePacket));
+              if (xform.packets == (ThreadViewDataSet *) NULL)
+                status=MagickFail;
+            }
+          (void) LogMagickEvent(TransformEvent,GetMagickModule(),
+                                "Transforming up to %lu pixels per call",
+                                (xform.packets != (ThreadViewDataSet *) NULL ?
+                                 xform.packets_per_call : 1UL));
           if (status == MagickFail)
             {
+              DestroyThreadViewDataSet(xform.packets);
               DestroyThreadViewDataSet(xform.transform);
               ThrowBinaryException3(ResourceLimitError,UnableToManageColor,
                                     UnableToCreateColorTransform);
@@ -1132,6 +1202,7 @@ ProfileImage(Image *image,const char *name,unsigned char *profile,
           */
           image->is_grayscale=IsGrayColorspace(xform.target_colorspace);
           image->is_monochrome=False;
+          DestroyThreadViewDataSet(xform.packets);
           DestroyThreadViewDataSet(xform.transform);
 
           /*
@@ -158,10 +158,9 @@
 %  color of all pixels that classify no lower than this node.  Each of
 %  these colors becomes an entry in the color map.
 %
-%  Finally,  the assignment phase reclassifies each pixel in the pruned
-%  tree to identify the deepest node containing the pixel's color.  The
-%  pixel's value in the pixel array becomes the index of this node's mean
-%  color in the color map.
+%  Finally,  the assignment phase finds the color map entry nearest to
+%  each pixel's color, using a k-d tree built from the color map.  The
+%  pixel's value in the pixel array becomes the index of this entry.
 %
 %  This method is based on a similar algorithm written by Paul Raveling.
 %
@@ -177,23 +176,32 @@
 #include "magick/colormap.h"
 #include "magick/enhance.h"
 #include "magick/monitor.h"
+#include "magick/omp_data_view.h"
 #include "magick/pixel_cache.h"
 #include "magick/quantize.h"
+#include "magick/resource.h"
 #include "magick/utility.h"
 
 /*
   Define declarations.
 */
 #define CacheShift  (QuantumDepth-6)
+#define ColorCacheSize  4096
 #define ExceptionQueueLength  16
 #define MaxNodes  266817
 #define MaxTreeDepth  8
 #define NodesInAList  1536
+#define ClassifyBandRows  128
 
 #define ColorToNodeId(red,green,blue,index) ((unsigned int) \
             (((ScaleQuantumToChar(red) >> index) & 0x01) << 2 | \
              ((ScaleQuantumToChar(green) >> index) & 0x01) << 1 | \
              ((ScaleQuantumToChar(blue) >> index) & 0x01)))
+
+#define ColorCacheHash(pixel) ((unsigned int) \
+            (((unsigned int) (pixel)->red*73856093U ^ \
+              (unsigned int) (pixel)->green*19349663U ^ \
+              (unsigned int) (pixel)->blue*83492791U) & (ColorCacheSize-1)))
 
 /*
   Typedef declarations.
@@ -238,19 +246,55 @@ typedef struct _Nodes
     *next;
 } Nodes;
 
-typedef struct _CubeInfo
+typedef struct _ClosestColorInfo
 {
-  NodeInfo
-    *root;
+  DoublePixelPacket
+    color;
+
+  double  /* was ErrorSumType */
+    distance;
+
+  unsigned long
+    color_number;
+} ClosestColorInfo;
+
+typedef struct _ColormapTreeNode
+{
+  PixelPacket
+    color;
+
+  unsigned long
+    color_number;
+
+  unsigned int
+    axis;
+} ColormapTreeNode;
+
+typedef struct _ColormapTree
+{
+  ColormapTreeNode
+    *nodes;
 
   unsigned long
     colors;
+} ColormapTree;
 
-  DoublePixelPacket
+typedef struct _ColorCacheEntry
+{
+  PixelPacket
     color;
 
-  double  /* was ErrorSumType */
-    distance;
+  unsigned long
+    color_number;  /* colormap index plus one, zero if the entry is unused */
+} ColorCacheEntry;
+
+typedef struct _CubeInfo
+{
+  NodeInfo
+    *root;
+
+  unsigned long
+    colors;
 
   ErrorSumType
     pruning_threshold,
@@ -258,8 +302,7 @@ typedef struct _CubeInfo
 
   unsigned long
     nodes,
-    free_nodes,
-    color_number;
+    free_nodes;
 
   NodeInfo
     *next_node;
@@ -267,6 +310,9 @@ typedef struct _CubeInfo
   Nodes
     *node_queue;
 
+  ColormapTree
+    *colormap_tree;
+
   long
     *cache;
 
@@ -291,7 +337,11 @@ typedef struct _CubeInfo
   Method prototypes.
 */
 static void
-  ClosestColor(Image *,CubeInfo *,const NodeInfo *);
+  ClosestColor(const ColormapTreeNode *,const unsigned long,
+    const unsigned long,ClosestColorInfo *);
+
+static unsigned long
+  FindClosestColor(const ColormapTree *,const PixelPacket *);
 
 static NodeInfo
   *GetNodeInfo(CubeInfo *,const unsigned int,const unsigned int,NodeInfo *);
@@ -299,8 +349,16 @@ static NodeInfo
 static unsigned int
   DitherImage(CubeInfo *,Image *);
 
+static ColormapTree
+  *AllocateColormapTree(const Image *);
+
+static CubeInfo
+  *GetCubeInfo(const QuantizeInfo *,unsigned long);
+
 static void
   DefineImageColormap(Image *,NodeInfo *),
+  DestroyColormapTree(ColormapTree *),
+  DestroyCubeInfo(CubeInfo *),
   HilbertCurve(CubeInfo *,Image *,const unsigned long,const unsigned int),
   PruneLevel(CubeInfo *,const NodeInfo *),
   PruneToCubeDepth(CubeInfo *,const NodeInfo *),
@@ -311,138 +369,245 @@ static void
 %                                                                             %
 %                                                                             %
 %                                                                             %
-+   A s s i g n I m a g e C o l o r s                                         %
++   A l l o c a t e C o l o r m a p T r e e                                   %
 %                                                                             %
 %                                                                             %
 %                                                                             %
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %
-%  AssignImageColors() generates the output image from the pruned tree.  The
-%  output image consists of two parts: (1)  A color map, which is an array
-%  of color descriptions (RGB triples) for each color present in the
-%  output image;  (2)  A pixel array, which represents each pixel as an
-%  index into the color map array.
-%
-%  First, the assignment phase makes one pass over the pruned color
-%  description tree to establish the image's color map.  For each node
-%  with n2  > 0, it divides Sr, Sg, and Sb by n2 .  This produces the mean
-%  color of all pixels that classify no lower than this node.  Each of
-%  these colors becomes an entry in the color map.
+%  AllocateColormapTree() builds a tree for finding the colormap entry of an
+%  image which is nearest to a color.  The tree is a k-d tree stored in an
+%  array: the colormap entries are ordered so that the middle entry of any
+%  range splits the entries on either side of it on the color component
+%  with the largest spread in that range.
 %
-%  Finally,  the assignment phase reclassifies each pixel in the pruned
-%  tree to identify the deepest node containing the pixel's color.  The
-%  pixel's value in the pixel array becomes the index of this node's mean
-%  color in the color map.
+%  The format of the AllocateColormapTree method is:
 %
-%  The format of the AssignImageColors() method is:
-%
-%      unsigned int AssignImageColors(CubeInfo *cube_info,Image *image)
+%      ColormapTree *AllocateColormapTree(const Image *image)
 %
 %  A description of each parameter follows.
 %
-%    o cube_info: A pointer to the Cube structure.
-%
-%    o image: Specifies a pointer to an Image structure;  returned from
-%      ReadImage.
+%    o image: The image whose colormap is searched.
 %
 %
 */
-static MagickPassFail AssignImageColors(CubeInfo *cube_info,Image *image)
+static int ColormapTreeCompareRed(const void *x,const void *y)
 {
-#define AssignImageText "[%s] Assign colors..."
+  const ColormapTreeNode
+    *a=(const ColormapTreeNode *) x,
+    *b=(const ColormapTreeNode *) y;
+
+  if (a->color.red != b->color.red)
+    return(a->color.red < b->color.red ? -1 : 1);
+  return(a->color_number < b->color_number ? -1 :
+         a->color_number > b->color_number ? 1 : 0);
+}
 
-  unsigned int
-    dither;
+static int ColormapTreeCompareGreen(const void *x,const void *y)
+{
+  const ColormapTreeNode
+    *a=(const ColormapTreeNode *) x,
+    *b=(const ColormapTreeNode *) y;
+
+  if (a->color.green != b->color.green)
+    return(a->color.green < b->color.green ? -1 : 1);
+  return(a->color_number < b->color_number ? -1 :
+         a->color_number > b->color_number ? 1 : 0);
+}
+
+static int ColormapTreeCompareBlue(const void *x,const void *y)
+{
+  const ColormapTreeNode
+    *a=(const ColormapTreeNode *) x,
+    *b=(const ColormapTreeNode *) y;
+
+  if (a->color.blue != b->color.blue)
+    return(a->color.blue < b->color.blue ? -1 : 1);
+  return(a->color_number < b->color_number ? -1 :
+         a->color_number > b->color_number ? 1 : 0);
+}
+
+static void BuildColormapTree(ColormapTreeNode *nodes,
+  const unsigned long first,const unsigned long last)
+{
+  PixelPacket
+    maximum,
+    minimum;
+
+  register unsigned long
+    i;
+
+  unsigned long
+    middle;
 
   unsigned int
-    is_grayscale,
-    is_monochrome;
+    axis;
+
+  if (first >= last)
+    return;
+  middle=first+(last-first)/2;
+  nodes[middle].axis=0;
+  if ((last-first) == 1)
+    return;
+  /*
+    Split on the color component with the largest spread.
+  */
+  minimum=nodes[first].color;
+  maximum=nodes[first].color;
+  for (i=first+1; i < last; i++)
+    {
+      if (nodes[i].color.red < minimum.red)
+        minimum.red=nodes[i].color.red;
+      if (nodes[i].color.red > maximum.red)
+        maximum.red=nodes[i].color.red;
+      if (nodes[i].color.green < minimum.green)
+        minimum.green=nodes[i].color.green;
+      if (nodes[i].color.green > maximum.green)
+        maximum.green=nodes[i].color.green;
+      if (nodes[i].color.blue < minimum.blue)
+        minimum.blue=nodes[i].color.blue;
+      if (nodes[i].color.blue > maximum.blue)
+        maximum.blue=nodes[i].color.blue;
+    }
+  axis=0;
+  if ((maximum.green-minimum.green) > (maximum.red-minimum.red))
+    axis=1;
+  if ((maximum.blue-minimum.blue) >
+      (axis == 0 ? maximum.red-minimum.red : maximum.green-minimum.green))
+    axis=2;
+  qsort((void *) (nodes+first),last-first,sizeof(ColormapTreeNode),
+        axis == 0 ? ColormapTreeCompareRed :
+        axis == 1 ? ColormapTreeCompareGreen : ColormapTreeCompareBlue);
+  nodes[middle].axis=axis;
+  BuildColormapTree(nodes,first,middle);
+  BuildColormapTree(nodes,middle+1,last);
+}
+
+static ColormapTree *AllocateColormapTree(const Image *image)
+{
+  ColormapTree
+    *colormap_tree;
+
+  register unsigned long
+    i;
+
+  colormap_tree=MagickAllocateMemory(ColormapTree *,sizeof(ColormapTree));
+  if (colormap_tree == (ColormapTree *) NULL)
+    return((ColormapTree *) NULL);
+  colormap_tree->colors=image->colors;
+  colormap_tree->nodes=MagickAllocateArray(ColormapTreeNode *,
+                                           Max(image->colors,1),
+                                           sizeof(ColormapTreeNode));
+  if (colormap_tree->nodes == (ColormapTreeNode *) NULL)
+    {
+      MagickFreeMemory(colormap_tree);
+      return((ColormapTree *) NULL);
+    }
+  for (i=0; i < image->colors; i++)
+    {
+      colormap_tree->nodes[i].color=image->colormap[i];
+      colormap_tree->nodes[i].color_number=i;
+      colormap_tree->nodes[i].axis=0;
+    }
+  BuildColormapTree(colormap_tree->nodes,0,colormap_tree->colors);
+  return(colormap_tree);
+}
+
+/*
+  Replace each pixel of the image by the nearest entry of its colormap,
+  which must already be defined along with cube_info->colormap_tree.
+*/
+static MagickPassFail AssignImagePixels(const CubeInfo *cube_info,
+  Image *image)
+{
+#define AssignImageText "[%s] Assign colors..."
+
+  ThreadViewDataSet
+    *color_cache;
+
+  unsigned long
+    row_count=0;
 
   MagickPassFail
     status=MagickPass;
 
+  MagickBool
+    monitor_active;
+
+  long
+    y;
+
   /*
-    Allocate image colormap.
-  */
-  if (!AllocateImageColormap(image,cube_info->colors))
-    ThrowBinaryException3(ResourceLimitError,MemoryAllocationFailed,
-                          UnableToQuantizeImage);
-  image->colors=0;
-  is_grayscale=image->is_grayscale;
-  is_monochrome=image->is_monochrome;
-  DefineImageColormap(image,cube_info->root);
-  if (cube_info->quantize_info->colorspace == TransparentColorspace)
-    image->storage_class=DirectClass;
-  /*
-    Create a reduced color image.
+    Each thread remembers the colormap entries recently found for
+    the colors it has seen, so that repeated colors do not need to
+    search the tree again.  The tree and colormap are only read
+    while assigning, so the result does not depend on the number
+    of threads.
   */
-  dither=cube_info->quantize_info->dither;
-  if (dither)
-    dither=DitherImage(cube_info,image);
-  if (!dither)
+  color_cache=AllocateThreadViewDataArray(image,&image->exception,
+                                          ColorCacheSize,
+                                          sizeof(ColorCacheEntry));
+  if (color_cache == (ThreadViewDataSet *) NULL)
+    return(MagickFail);
+  monitor_active=MagickMonitorActive();
+
+#if defined(HAVE_OPENMP)
+#  if defined(TUNE_OPENMP)
+#    pragma omp parallel for schedule(runtime) shared(row_count, status)
+#  else
+#    pragma omp parallel for schedule(guided) shared(row_count, status)
+#  endif
+#endif
+  for (y=0; y < (long) image->rows; y++)
     {
-      long
-        y;
+      ColorCacheEntry
+        *cache,
+        *entry;
 
-      /*
-        FIXME: Use OpenMP?
-      */
-      for (y=0; y < (long) image->rows; y++)
-        {
-          IndexPacket
-            index;
+      IndexPacket
+        index;
 
-          long
-            count;
+      long
+        count;
 
-          register IndexPacket
-            *indexes;
+      register IndexPacket
+        *indexes;
 
-          register long
-            i,
-            x;
+      register long
+        i,
+        x;
 
-          register const NodeInfo
-            *node_info;
+      register PixelPacket
+        *q;
 
-          register PixelPacket
-            *q;
+      MagickBool
+        thread_status;
 
-          unsigned int
-            id;
+      thread_status=status;
+      if (thread_status == MagickFail)
+        continue;
 
-          q=GetImagePixels(image,0,y,image->columns,1);
-          if (q == (PixelPacket *) NULL)
-            {
-              status=MagickFail;
-              break;
-            }
+      cache=AccessThreadViewData(color_cache);
+      q=GetImagePixelsEx(image,0,y,image->columns,1,&image->exception);
+      if (q == (PixelPacket *) NULL)
+        thread_status=MagickFail;
+      if (thread_status != MagickFail)
+        {
           indexes=AccessMutableIndexes(image);
           for (x=0; x < (long) image->columns; x+=count)
             {
-              /*
-                Identify the deepest node containing the pixel's color.
-              */
               for (count=1; (x+count) < (long) image->columns; count++)
                 if (NotColorMatch(q,q+count))
                   break;
-              node_info=cube_info->root;
-              for (index=MaxTreeDepth-1; (long) index > 0; index--)
+              entry=cache+ColorCacheHash(q);
+              if ((entry->color_number == 0) ||
+                  NotColorMatch(&entry->color,q))
                 {
-                  id=ColorToNodeId(q->red,q->green,q->blue,index);
-                  if (node_info->child[id] == (NodeInfo *) NULL)
-                    break;
-                  node_info=node_info->child[id];
+                  entry->color=(*q);
+                  entry->color_number=
+                    FindClosestColor(cube_info->colormap_tree,q)+1;
                 }
-              /*
-                Find closest color among siblings and their children.
-              */
-              cube_info->color.red=q->red;
-              cube_info->color.green=q->green;
-              cube_info->color.blue=q->blue;
-              cube_info->distance=3.0*(MaxRGBDouble+1.0)*(MaxRGBDouble+1.0);
-              ClosestColor(image,cube_info,node_info->parent);
-              index=(IndexPacket) cube_info->color_number;
+              index=(IndexPacket) (entry->color_number-1);
               for (i=0; i < count; i++)
                 {
                   if (image->storage_class == PseudoClass)
@@ -456,20 +621,49 @@ static MagickPassFail AssignImageColors(CubeInfo *cube_info,Image *image)
                   q++;
                 }
             }
-          if (!SyncImagePixels(image))
-            {
-              status=MagickFail;
-              break;
-            }
-          if (QuantumTick(y,image->rows))
-            if (!MagickMonitorFormatted(y,image->rows,&image->exception,
+          if (!SyncImagePixelsEx(image,&image->exception))
+            thread_status=MagickFail;
+        }
+      if (monitor_active)
+        {
+          unsigned long
+            thread_row_count;
+
+#if defined(HAVE_OPENMP)
+#  pragma omp atomic
+#endif
+          row_count++;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (row_count)
+#endif
+          thread_row_count=row_count;
+          if (QuantumTick(thread_row_count,image->rows))
+            if (!MagickMonitorFormatted(thread_row_count,image->rows,
+                                        &image->exception,
                                         AssignImageText,image->filename))
-              {
-                status=MagickFail;
-                break;
-              }
+              thread_status=MagickFail;
+        }
+      if (thread_status == MagickFail)
+        {
+          status=MagickFail;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (status)
+#endif
         }
     }
+  DestroyThreadViewDataSet(color_cache);
+  return(status);
+}
+
+/*
+  Finish an image whose pixels have been assigned colormap entries.
+*/
+static MagickPassFail CompleteImageColors(const CubeInfo *cube_info,
+  Image *image,unsigned int is_grayscale,unsigned int is_monochrome)
+{
+  MagickPassFail
+    status;
+
   if ((cube_info->quantize_info->number_colors == 2) &&
       (IsGrayColorspace(cube_info->quantize_info->colorspace)))
     {
@@ -499,11 +693,202 @@ static MagickPassFail AssignImageColors(CubeInfo *cube_info,Image *image)
     }
   if (cube_info->quantize_info->measure_error)
     (void) GetImageQuantizeError(image);
-  status &= SyncImage(image);
+  status=SyncImage(image);
   image->is_grayscale=is_grayscale;
   image->is_monochrome=is_monochrome;
   return(status);
 }
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
++   A s s i g n I m a g e C o l o r s                                         %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  AssignImageColors() generates the output image from the pruned tree.  The
+%  output image consists of two parts: (1)  A color map, which is an array
+%  of color descriptions (RGB triples) for each color present in the
+%  output image;  (2)  A pixel array, which represents each pixel as an
+%  index into the color map array.
+%
+%  First, the assignment phase makes one pass over the pruned color
+%  description tree to establish the image's color map.  For each node
+%  with n2  > 0, it divides Sr, Sg, and Sb by n2 .  This produces the mean
+%  color of all pixels that classify no lower than this node.  Each of
+%  these colors becomes an entry in the color map.
+%
+%  Finally,  the assignment phase finds the color map entry nearest to
+%  each pixel's color, using a k-d tree built from the color map.  The
+%  pixel's value in the pixel array becomes the index of this entry.
+%
+%  The format of the AssignImageColors() method is:
+%
+%      unsigned int AssignImageColors(CubeInfo *cube_info,Image *image)
+%
+%  A description of each parameter follows.
+%
+%    o cube_info: A pointer to the Cube structure.
+%
+%    o image: Specifies a pointer to an Image structure;  returned from
+%      ReadImage.
+%
+%
+*/
+static MagickPassFail AssignImageColors(CubeInfo *cube_info,Image *image)
+{
+  unsigned int
+    dither;
+
+  unsigned int
+    is_grayscale,
+    is_monochrome;
+
+  MagickPassFail
+    status=MagickPass;
+
+  /*
+    Allocate image colormap.
+  */
+  if (!AllocateImageColormap(image,cube_info->colors))
+    ThrowBinaryException3(ResourceLimitError,MemoryAllocationFailed,
+                          UnableToQuantizeImage);
+  image->colors=0;
+  is_grayscale=image->is_grayscale;
+  is_monochrome=image->is_monochrome;
+  DefineImageColormap(image,cube_info->root);
+  DestroyColormapTree(cube_info->colormap_tree);
+  cube_info->colormap_tree=AllocateColormapTree(image);
+  if (cube_info->colormap_tree == (ColormapTree *) NULL)
+    ThrowBinaryException3(ResourceLimitError,MemoryAllocationFailed,
+                          UnableToQuantizeImage);
+  if (cube_info->quantize_info->colorspace == TransparentColorspace)
+    image->storage_class=DirectClass;
+  /*
+    Create a reduced color image.
+  */
+  dither=cube_info->quantize_info->dither;
+  if (dither)
+    dither=DitherImage(cube_info,image);
+  if (!dither)
+    status=AssignImagePixels(cube_info,image);
+  status&=CompleteImageColors(cube_info,image,is_grayscale,is_monochrome);
+  return(status);
+}
+
+/*
+  Assign colors to each image of a sequence which shares the colormap of
+  cube_info, processing up to frame_threads images at once.  The colormap
+  and its search tree are defined once and only read while assigning, so
+  the images are the same as when AssignImageColors() is applied to each
+  in turn.  Dithering is not supported.
+*/
+static MagickPassFail AssignImageListColors(CubeInfo *cube_info,
+  Image *images,const unsigned long number_images,const int frame_threads)
+{
+  Image
+    **frames,
+    *image;
+
+  long
+    i;
+
+  MonitorHandler
+    handler;
+
+  MagickPassFail
+    status=MagickPass;
+
+  image=images;
+  frames=MagickAllocateArray(Image **,number_images,sizeof(Image *));
+  if (frames == (Image **) NULL)
+    ThrowBinaryException3(ResourceLimitError,MemoryAllocationFailed,
+                          UnableToQuantizeImageSequence);
+  for (i=0; i < (long) number_images; i++)
+    {
+      frames[i]=image;
+      image=image->next;
+    }
+  /*
+    Define the colormap using the first image and copy it to the others.
+  */
+  image=frames[0];
+  if (!AllocateImageColormap(image,cube_info->colors))
+    {
+      MagickFreeMemory(frames);
+      ThrowBinaryException3(ResourceLimitError,MemoryAllocationFailed,
+                            UnableToQuantizeImageSequence);
+    }
+  image->colors=0;
+  DefineImageColormap(image,cube_info->root);
+  DestroyColormapTree(cube_info->colormap_tree);
+  cube_info->colormap_tree=AllocateColormapTree(image);
+  if (cube_info->colormap_tree == (ColormapTree *) NULL)
+    {
+      MagickFreeMemory(frames);
+      ThrowBinaryException3(ResourceLimitError,MemoryAllocationFailed,
+                            UnableToQuantizeImageSequence);
+    }
+  for (i=1; i < (long) number_images; i++)
+    {
+      if (!AllocateImageColormap(frames[i],cube_info->colors))
+        {
+          image=frames[i];
+          MagickFreeMemory(frames);
+          ThrowBinaryException3(ResourceLimitError,MemoryAllocationFailed,
+                                UnableToQuantizeImageSequence);
+        }
+      (void) memcpy(frames[i]->colormap,image->colormap,
+                    image->colors*sizeof(PixelPacket));
+      frames[i]->colors=image->colors;
+    }
+  if (IsEventLogging())
+    (void) LogMagickEvent(TransformEvent,GetMagickModule(),
+                          "Assigning colors to %lu frames using %d threads",
+                          number_images,frame_threads);
+  handler=SetMonitorHandler((MonitorHandler) NULL);
+#if defined(HAVE_OPENMP)
+#  if defined(TUNE_OPENMP)
+#    pragma omp parallel for num_threads(frame_threads) schedule(runtime) shared(status)
+#  else
+#    pragma omp parallel for num_threads(frame_threads) schedule(dynamic,1) shared(status)
+#  endif
+#endif
+  for (i=0; i < (long) number_images; i++)
+    {
+      unsigned int
+        is_grayscale,
+        is_monochrome;
+
+      MagickPassFail
+        thread_status;
+
+      is_grayscale=frames[i]->is_grayscale;
+      is_monochrome=frames[i]->is_monochrome;
+      if (cube_info->quantize_info->colorspace == TransparentColorspace)
+        frames[i]->storage_class=DirectClass;
+      thread_status=AssignImagePixels(cube_info,frames[i]);
+      thread_status&=CompleteImageColors(cube_info,frames[i],is_grayscale,
+                                         is_monochrome);
+      if (cube_info->quantize_info->colorspace != RGBColorspace)
+        (void) TransformColorspace(frames[i],
+                                   cube_info->quantize_info->colorspace);
+      if (thread_status == MagickFail)
+        {
+          status=MagickFail;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (status)
+#endif
+        }
+    }
+  (void) SetMonitorHandler(handler);
+  MagickFreeMemory(frames);
+  return(status);
+}
 
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -555,8 +940,8 @@ static MagickPassFail AssignImageColors(CubeInfo *cube_info,Image *image)
 %
 %  The format of the ClassifyImageColors() method is:
 %
-%      unsigned int ClassifyImageColorsCubeInfo *cube_info,const Image *image,
-%        ExceptionInfo *exception)
+%      unsigned int ClassifyImageColors(CubeInfo *cube_info,
+%        const Image *image,ExceptionInfo *exception)
 %
 %  A description of each parameter follows.
 %
@@ -568,221 +953,363 @@ static MagickPassFail AssignImageColors(CubeInfo *cube_info,Image *image)
 %
 */
 
+#define ClassifyImageText "[%s] Classify colors..."
+
+/*
+  Classify one row of pixels, descending the tree to max_level.
+*/
+static MagickPassFail ClassifyImageRow(CubeInfo *cube_info,
+  const PixelPacket *p,const unsigned long columns,
+  const unsigned long max_level,ExceptionInfo *exception)
+{
+  double
+    bisect;
+
+  DoublePixelPacket
+    mid,
+    pixel;
+
+  long
+    count;
+
+  NodeInfo
+    *node_info;
+
+  register long
+    x;
+
+  unsigned long
+    index,
+    level;
+
+  unsigned int
+    id;
+
+  for (x=0; x < (long) columns; x+=count)
+  {
+    /*
+      Start at the root and descend the color cube tree.
+    */
+    for (count=1; (x+count) < (long) columns; count++)
+      if (NotColorMatch(p,p+count))
+        break;
+    index=MaxTreeDepth-1;
+    bisect=(MaxRGBDouble+1.0)/2.0;
+    mid.red=MaxRGBDouble/2.0;
+    mid.green=MaxRGBDouble/2.0;
+    mid.blue=MaxRGBDouble/2.0;
+    node_info=cube_info->root;
+    for (level=1; level <= max_level; level++)
+    {
+      bisect/=2.0;
+      id=ColorToNodeId(p->red,p->green,p->blue,index);
+      mid.red+=id & 4 ? bisect : -bisect;
+      mid.green+=id & 2 ? bisect : -bisect;
+      mid.blue+=id & 1 ? bisect : -bisect;
+      if (node_info->child[id] == (NodeInfo *) NULL)
+        {
+          /*
+            Set colors of new node to contain pixel.
+          */
+          node_info->child[id]=GetNodeInfo(cube_info,id,level,node_info);
+          if (node_info->child[id] == (NodeInfo *) NULL)
+            {
+              ThrowException3(exception,ResourceLimitError,
+                              MemoryAllocationFailed,UnableToQuantizeImage);
+              return(MagickFail);
+            }
+          if (level == max_level)
+            cube_info->colors++;
+        }
+      /*
+        Approximate the quantization error represented by this node.
+      */
+      node_info=node_info->child[id];
+      pixel.red=p->red-mid.red;
+      pixel.green=p->green-mid.green;
+      pixel.blue=p->blue-mid.blue;
+      node_info->quantize_error+=count*pixel.red*pixel.red+
+        count*pixel.green*pixel.green+count*pixel.blue*pixel.blue;
+      cube_info->root->quantize_error+=node_info->quantize_error;
+      index--;
+    }
+    /*
+      Sum RGB for this leaf for later derivation of the mean cube color.
+    */
+    node_info->number_unique+=count;
+    node_info->total_red+=(double) count*p->red;
+    node_info->total_green+=(double) count*p->green;
+    node_info->total_blue+=(double) count*p->blue;
+    p+=count;
+  }
+  return(MagickPass);
+}
+
+/*
+  Classify rows first_row to last_row-1 of the image.  The first 256
+  colors are classified to a tree depth of 8, and any further colors to
+  the cube depth.
+*/
+static MagickPassFail ClassifyImageRows(CubeInfo *cube_info,
+  const Image *image,const long first_row,const long last_row,
+  unsigned long *row_count,ExceptionInfo *exception)
+{
+  register const PixelPacket
+    *p;
+
+  unsigned long
+    max_level,
+    thread_row_count;
+
+  long
+    y;
+
+  MagickPassFail
+    status=MagickPass;
+
+  max_level=MaxTreeDepth;
+  for (y=first_row; y < last_row; y++)
+  {
+    if ((max_level == MaxTreeDepth) && (cube_info->colors >= 256))
+      {
+        /*
+          More than 256 colors;  classify to the cube_info->depth tree
+          depth.
+        */
+        PruneToCubeDepth(cube_info,cube_info->root);
+        max_level=0;
+      }
+    p=AcquireImagePixels(image,0,y,image->columns,1,exception);
+    if (p == (const PixelPacket *) NULL)
+      {
+        status=MagickFail;
+        break;
+      }
+    if (cube_info->nodes > MaxNodes)
+      {
+        /*
+          Prune one level if the color tree is too large.
+        */
+        PruneLevel(cube_info,cube_info->root);
+        cube_info->depth--;
+      }
+    status=ClassifyImageRow(cube_info,p,image->columns,
+                            max_level != 0 ? max_level : cube_info->depth,
+                            exception);
+    if (status == MagickFail)
+      break;
+#if defined(HAVE_OPENMP)
+#  pragma omp atomic
+#endif
+    (*row_count)++;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush
+#endif
+    thread_row_count=(*row_count);
+    if (QuantumTick(thread_row_count,image->rows))
+      if (!MagickMonitorFormatted(thread_row_count,image->rows,exception,
+                                  ClassifyImageText,image->filename))
+        {
+          status=MagickFail;
+          break;
+        }
+  }
+  return(status);
+}
+
+/*
+  Add the color statistics of a tree built by another thread to the tree.
+*/
+static MagickPassFail MergeNodeInfo(CubeInfo *cube_info,NodeInfo *node_info,
+  const NodeInfo *source)
+{
+  register unsigned int
+    id;
+
+  node_info->number_unique+=source->number_unique;
+  node_info->total_red+=source->total_red;
+  node_info->total_green+=source->total_green;
+  node_info->total_blue+=source->total_blue;
+  node_info->quantize_error+=source->quantize_error;
+  for (id=0; id < MaxTreeDepth; id++)
+    {
+      if (source->child[id] == (NodeInfo *) NULL)
+        continue;
+      if (node_info->child[id] == (NodeInfo *) NULL)
+        {
+          node_info->child[id]=GetNodeInfo(cube_info,id,
+                                           source->child[id]->level,
+                                           node_info);
+          if (node_info->child[id] == (NodeInfo *) NULL)
+            return(MagickFail);
+        }
+      if (MergeNodeInfo(cube_info,node_info->child[id],source->child[id])
+          == MagickFail)
+        return(MagickFail);
+    }
+  return(MagickPass);
+}
+
+/*
+  Count the nodes which represent a color.
+*/
+static unsigned long CountCubeColors(const NodeInfo *node_info)
+{
+  register unsigned int
+    id;
+
+  unsigned long
+    colors;
+
+  colors=(node_info->number_unique > 0.0 ? 1 : 0);
+  for (id=0; id < MaxTreeDepth; id++)
+    if (node_info->child[id] != (NodeInfo *) NULL)
+      colors+=CountCubeColors(node_info->child[id]);
+  return(colors);
+}
+
+/*
+  Returns the number of row bands to classify in parallel, or 1 if the
+  image should be classified serially.  Setting
+  MAGICK_QUANTIZE_DETERMINISTIC to TRUE forces serial classification, so
+  that results match exactly regardless of the number of threads.
+*/
+static unsigned int GetClassifyBands(const Image *image)
+{
+  const char
+    *env;
+
+  unsigned long
+    bands;
+
+  env=getenv("MAGICK_QUANTIZE_DETERMINISTIC");
+  if ((env != (const char *) NULL) && (LocaleCompare(env,"TRUE") == 0))
+    return(1);
+  bands=image->rows/ClassifyBandRows;
+  if (bands > (unsigned long) omp_get_max_threads())
+    bands=(unsigned long) omp_get_max_threads();
+  if (bands < 2)
+    bands=1;
+  return((unsigned int) bands);
+}
+
 static MagickPassFail ClassifyImageColors(CubeInfo *cube_info,const Image *image,
   ExceptionInfo *exception)
 {
-#define ClassifyImageText "[%s] Classify colors..."
-
-  double
-    bisect;
+  CubeInfo
+    **band_info;
 
-  DoublePixelPacket
-    mid,
-    pixel;
+  QuantizeInfo
+    band_quantize_info;
 
   long
-    count,
-    y;
-
-  NodeInfo
-    *node_info;
+    band;
 
-  register long
-    x;
-
-  register const PixelPacket
-    *p;
+  unsigned int
+    bands;
 
   unsigned long
-    index,
-    level;
+    depth,
+    row_count=0;
 
-  unsigned int
-    id;
+  MagickBool
+    prune;
 
   MagickPassFail
     status=MagickPass;
 
+  bands=GetClassifyBands(image);
+  if (bands == 1)
+    return(ClassifyImageRows(cube_info,image,0,(long) image->rows,
+                             &row_count,exception));
   /*
-    Classify the first 256 colors to a tree depth of 8.
+    Classify bands of rows into separate trees in parallel, and then
+    merge the trees in row order.
   */
-  for (y=0; (y < (long) image->rows) && (cube_info->colors < 256); y++)
-  {
-    p=AcquireImagePixels(image,0,y,image->columns,1,exception);
-    if (p == (const PixelPacket *) NULL)
-      {
-        status=MagickFail;
-        break;
-      }
-    if (cube_info->nodes > MaxNodes)
-      {
-        /*
-          Prune one level if the color tree is too large.
-        */
-        PruneLevel(cube_info,cube_info->root);
-        cube_info->depth--;
-      }
-    for (x=0; x < (long) image->columns; x+=count)
+  band_info=MagickAllocateArray(CubeInfo **,bands,sizeof(CubeInfo *));
+  if (band_info == (CubeInfo **) NULL)
     {
-      /*
-        Start at the root and descend the color cube tree.
-      */
-      for (count=1; (x+count) < (long) image->columns; count++)
-        if (NotColorMatch(p,p+count))
-          break;
-      index=MaxTreeDepth-1;
-      bisect=(MaxRGBDouble+1.0)/2.0;
-      mid.red=MaxRGBDouble/2.0;
-      mid.green=MaxRGBDouble/2.0;
-      mid.blue=MaxRGBDouble/2.0;
-      node_info=cube_info->root;
-      for (level=1; level <= 8; level++)
-      {
-        bisect/=2;
-        id=ColorToNodeId(p->red,p->green,p->blue,index);
-        mid.red+=id & 4 ? bisect : -bisect;
-        mid.green+=id & 2 ? bisect : -bisect;
-        mid.blue+=id & 1 ? bisect : -bisect;
-        if (node_info->child[id] == (NodeInfo *) NULL)
-          {
-            /*
-              Set colors of new node to contain pixel.
-            */
-            node_info->child[id]=GetNodeInfo(cube_info,id,level,node_info);
-            if (node_info->child[id] == (NodeInfo *) NULL)
-              {
-                ThrowException3(exception,ResourceLimitError,
-                                MemoryAllocationFailed,UnableToQuantizeImage);
-                status=MagickFail;
-                break;
-              }
-            if (level == MaxTreeDepth)
-              cube_info->colors++;
-          }
-        /*
-          Approximate the quantization error represented by this node.
-        */
-        node_info=node_info->child[id];
-        pixel.red=p->red-mid.red;
-        pixel.green=p->green-mid.green;
-        pixel.blue=p->blue-mid.blue;
-        node_info->quantize_error+=count*pixel.red*pixel.red+
-          count*pixel.green*pixel.green+count*pixel.blue*pixel.blue;
-        cube_info->root->quantize_error+=node_info->quantize_error;
-        index--;
-      }
-      if (status == MagickFail)
-        break;
-      /*
-        Sum RGB for this leaf for later derivation of the mean cube color.
-      */
-      node_info->number_unique+=count;
-      node_info->total_red+=(double) count*p->red;
-      node_info->total_green+=(double) count*p->green;
-      node_info->total_blue+=(double) count*p->blue;
-      p+=count;
+      ThrowException3(exception,ResourceLimitError,MemoryAllocationFailed,
+                      UnableToQuantizeImage);
+      return(MagickFail);
     }
-    if (QuantumTick(y,image->rows))
-      if (!MagickMonitorFormatted(y,image->rows,exception,
-                                  ClassifyImageText,image->filename))
+  (void) memset(band_info,0,bands*sizeof(CubeInfo *));
+  band_quantize_info=(*cube_info->quantize_info);
+  band_quantize_info.dither=MagickFalse;
+  for (band=0; band < (long) bands; band++)
+    {
+      band_info[band]=GetCubeInfo(&band_quantize_info,cube_info->depth);
+      if (band_info[band] == (CubeInfo *) NULL)
         {
+          ThrowException3(exception,ResourceLimitError,
+                          MemoryAllocationFailed,UnableToQuantizeImage);
           status=MagickFail;
           break;
         }
-  }
-  if ((status == MagickFail) || (y == (long) image->rows))
-    return status;
+    }
+  if (status != MagickFail)
+    {
+#if defined(HAVE_OPENMP)
+#  pragma omp parallel for schedule(static,1) shared(row_count, status)
+#endif
+      for (band=0; band < (long) bands; band++)
+        {
+          if (ClassifyImageRows(band_info[band],image,
+                                (long) ((band*image->rows)/bands),
+                                (long) (((band+1)*image->rows)/bands),
+                                &row_count,exception) == MagickFail)
+            {
+              status=MagickFail;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (status)
+#endif
+            }
+        }
+    }
   /*
-    More than 256 colors;  classify to the cube_info->depth tree depth.
+    The merged tree has to be pruned to the cube depth if the image has
+    more than 256 colors, just as if it had been classified serially.
   */
-  PruneToCubeDepth(cube_info,cube_info->root);
-  for ( ; y < (long) image->rows; y++)
-  {
-    p=AcquireImagePixels(image,0,y,image->columns,1,exception);
-    if (p == (const PixelPacket *) NULL)
-      {
-        status=MagickFail;
-        break;
-      }
-    if (cube_info->nodes > MaxNodes)
-      {
-        /*
-          Prune one level if the color tree is too large.
-        */
-        PruneLevel(cube_info,cube_info->root);
-        cube_info->depth--;
-      }
-    for (x=0; x < (long) image->columns; x+=count)
+  prune=(cube_info->colors >= 256);
+  depth=cube_info->depth;
+  for (band=0; (band < (long) bands) && (status != MagickFail); band++)
     {
-      /*
-        Start at the root and descend the color cube tree.
-      */
-      for (count=1; (x+count) < (long) image->columns; count++)
-        if (NotColorMatch(p,p+count))
-          break;
-      index=MaxTreeDepth-1;
-      bisect=(MaxRGBDouble+1.0)/2.0;
-      mid.red=MaxRGBDouble/2.0;
-      mid.green=MaxRGBDouble/2.0;
-      mid.blue=MaxRGBDouble/2.0;
-      node_info=cube_info->root;
-      for (level=1; level <= cube_info->depth; level++)
-      {
-        bisect/=2.0;
-        id=ColorToNodeId(p->red,p->green,p->blue,index);
-        mid.red+=id & 4 ? bisect : -bisect;
-        mid.green+=id & 2 ? bisect : -bisect;
-        mid.blue+=id & 1 ? bisect : -bisect;
-        if (node_info->child[id] == (NodeInfo *) NULL)
-          {
-            /*
-              Set colors of new node to contain pixel.
-            */
-            node_info->child[id]=GetNodeInfo(cube_info,id,level,node_info);
-            if (node_info->child[id] == (NodeInfo *) NULL)
-              {
-                ThrowException3(exception,ResourceLimitError,
-                                MemoryAllocationFailed,UnableToQuantizeImage);
-                status=MagickFail;
-                break;
-              }
-            if (level == cube_info->depth)
-              cube_info->colors++;
-          }
-        /*
-          Approximate the quantization error represented by this node.
-        */
-        node_info=node_info->child[id];
-        pixel.red=p->red-mid.red;
-        pixel.green=p->green-mid.green;
-        pixel.blue=p->blue-mid.blue;
-        node_info->quantize_error+=count*pixel.red*pixel.red+
-          count*pixel.green*pixel.green+count*pixel.blue*pixel.blue;
-        cube_info->root->quantize_error+=node_info->quantize_error;
-        index--;
-      }
-      if (status == MagickFail)
-        break;
-      /*
-        Sum RGB for this leaf for later derivation of the mean cube color.
-      */
-      node_info->number_unique+=count;
-      node_info->total_red+=(double) count*p->red;
-      node_info->total_green+=(double) count*p->green;
-      node_info->total_blue+=(double) count*p->blue;
-      p+=count;
-    }
-    if (QuantumTick(y,image->rows))
-      if (!MagickMonitorFormatted(y,image->rows,exception,
-                                  ClassifyImageText,image->filename))
+      if (band_info[band]->colors >= 256)
+        prune=MagickTrue;
+      if (band_info[band]->depth < depth)
+        depth=band_info[band]->depth;
+      if (MergeNodeInfo(cube_info,cube_info->root,band_info[band]->root)
+          == MagickFail)
         {
+          ThrowException3(exception,ResourceLimitError,
+                          MemoryAllocationFailed,UnableToQuantizeImage);
           status=MagickFail;
-          break;
         }
-  }
+    }
+  for (band=0; band < (long) bands; band++)
+    if (band_info[band] != (CubeInfo *) NULL)
+      DestroyCubeInfo(band_info[band]);
+  MagickFreeMemory(band_info);
+  if (status == MagickFail)
+    return(status);
+  cube_info->colors=CountCubeColors(cube_info->root);
+  if (prune || (cube_info->colors >= 256))
+    {
+      cube_info->depth=depth;
+      PruneToCubeDepth(cube_info,cube_info->root);
+      while (cube_info->nodes > MaxNodes)
+        {
+          /*
+            Prune one level if the color tree is too large.
+          */
+          PruneLevel(cube_info,cube_info->root);
+          cube_info->depth--;
+        }
+      cube_info->colors=CountCubeColors(cube_info->root);
+    }
   return(status);
 }
-
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -841,74 +1368,93 @@ MagickExport QuantizeInfo *CloneQuantizeInfo(const QuantizeInfo *quantize_info)
 %                                                                             %
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %
-%  ClosestColor() traverses the color cube tree at a particular node and
-%  determines which colormap entry best represents the input color.
+%  ClosestColor() searches a range of a colormap tree for the colormap entry
+%  nearest to a color.  Each node of the tree splits the colormap entries
+%  below it on one color component, so branches which can not hold an
+%  entry nearer than the closest one found so far are skipped.  When
+%  several entries are equally near, the one with the lowest index is
+%  selected.
 %
 %  This is a recursive function.
 %
 %  The format of the ClosestColor method is:
 %
-%      void ClosestColor(Image *image,CubeInfo *cube_info,
-%        const NodeInfo *node_info)
+%      void ClosestColor(const ColormapTreeNode *nodes,
+%        const unsigned long first,const unsigned long last,
+%        ClosestColorInfo *closest)
 %
 %  A description of each parameter follows.
 %
-%    o image: The image.
+%    o nodes: The nodes of the colormap tree.
 %
-%    o cube_info: A pointer to the Cube structure.
+%    o first, last: The range of nodes to search.  The root of the range
+%      is its middle node, and the two halves on either side are its
+%      branches.
 %
-%    o node_info: The address of a structure of type NodeInfo which points to a
-%      node in the color cube tree that is to be pruned.
+%    o closest: The color to search for, and the closest colormap entry
+%      and its distance found so far.
 %
 %
 */
-static void ClosestColor(Image *image,CubeInfo *cube_info,
-  const NodeInfo *node_info)
+static void ClosestColor(const ColormapTreeNode *nodes,
+  const unsigned long first,const unsigned long last,
+  ClosestColorInfo *closest)
 {
-  register unsigned int
-    id;
+  double
+    delta,
+    distance;
 
-  /*
-    Traverse any children.
-  */
-  for (id=0; id < MaxTreeDepth; id++)
-    if (node_info->child[id] != (NodeInfo *) NULL)
-      ClosestColor(image,cube_info,node_info->child[id]);
-  if (node_info->number_unique != 0)
-    {
-      double
-        distance;
+  DoublePixelPacket
+    pixel;
 
-      DoublePixelPacket
-        pixel;
+  register const ColormapTreeNode
+    *node;
 
-      register PixelPacket
-        *color;
+  unsigned long
+    middle;
 
-      /*
-        Determine if this color is "closest".
-      */
-      color=image->colormap+node_info->color_number;
-      pixel.red=color->red-cube_info->color.red;
-      distance=pixel.red*pixel.red;
-      if (distance < cube_info->distance)
-        {
-          pixel.green=color->green-cube_info->color.green;
-          distance+=pixel.green*pixel.green;
-          if (distance < cube_info->distance)
-            {
-              pixel.blue=color->blue-cube_info->color.blue;
-              distance+=pixel.blue*pixel.blue;
-              if (distance < cube_info->distance)
-                {
-                  cube_info->distance=distance;
-                  cube_info->color_number=node_info->color_number;
-                }
-            }
-        }
+  if (first >= last)
+    return;
+  middle=first+(last-first)/2;
+  node=nodes+middle;
+  /*
+    Determine if this color is "closest".
+  */
+  pixel.red=node->color.red-closest->color.red;
+  pixel.green=node->color.green-closest->color.green;
+  pixel.blue=node->color.blue-closest->color.blue;
+  distance=pixel.red*pixel.red+pixel.green*pixel.green+pixel.blue*pixel.blue;
+  if ((distance < closest->distance) ||
+      ((distance == closest->distance) &&
+       (node->color_number < closest->color_number)))
+    {
+      closest->distance=distance;
+      closest->color_number=node->color_number;
+    }
+  /*
+    Search the branch holding the color first, and the other branch only
+    if it may hold a color which is at least as near.
+  */
+  switch (node->axis)
+    {
+    case 0: delta=(-pixel.red); break;
+    case 1: delta=(-pixel.green); break;
+    default: delta=(-pixel.blue); break;
+    }
+  if (delta < 0.0)
+    {
+      ClosestColor(nodes,first,middle,closest);
+      if (delta*delta <= closest->distance)
+        ClosestColor(nodes,middle+1,last,closest);
+    }
+  else
+    {
+      ClosestColor(nodes,middle+1,last,closest);
+      if (delta*delta <= closest->distance)
+        ClosestColor(nodes,first,middle,closest);
     }
 }
-
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -1006,6 +1552,37 @@ static void DefineImageColormap(Image *image,NodeInfo *node_info)
     }
 }
 
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
++   D e s t r o y C o l o r m a p T r e e                                     %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  DestroyColormapTree() deallocates memory associated with a colormap tree.
+%
+%  The format of the DestroyColormapTree method is:
+%
+%      DestroyColormapTree(ColormapTree *colormap_tree)
+%
+%  A description of each parameter follows.
+%
+%    o colormap_tree: The colormap tree, or NULL.
+%
+%
+*/
+static void DestroyColormapTree(ColormapTree *colormap_tree)
+{
+  if (colormap_tree == (ColormapTree *) NULL)
+    return;
+  MagickFreeMemory(colormap_tree->nodes);
+  MagickFreeMemory(colormap_tree);
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -1046,6 +1623,7 @@ static void DestroyCubeInfo(CubeInfo *cube_info)
   } while (cube_info->node_queue != (Nodes *) NULL);
   if (cube_info->quantize_info->dither)
     MagickFreeMemory(cube_info->cache);
+  DestroyColormapTree(cube_info->colormap_tree);
   MagickFreeMemory(cube_info);
 }
 
@@ -1163,34 +1741,7 @@ static MagickPassFail Dither(CubeInfo *cube_info,Image *image,
       i=(pixel.blue >> CacheShift) << 12 | (pixel.green >> CacheShift) << 6 |
         (pixel.red >> CacheShift);
       if (p->cache[i] < 0)
-        {
-          register NodeInfo
-            *node_info;
-
-          register unsigned int
-            id;
-
-          /*
-            Identify the deepest node containing the pixel's color.
-          */
-          node_info=p->root;
-          for (index=MaxTreeDepth-1; (long) index > 0; index--)
-          {
-            id=ColorToNodeId(pixel.red,pixel.green,pixel.blue,index);
-            if (node_info->child[id] == (NodeInfo *) NULL)
-              break;
-            node_info=node_info->child[id];
-          }
-          /*
-            Find closest color among siblings and their children.
-          */
-          p->color.red=pixel.red;
-          p->color.green=pixel.green;
-          p->color.blue=pixel.blue;
-          p->distance=3.0*(MaxRGBDouble+1.0)*(MaxRGBDouble+1.0);
-          ClosestColor(image,p,node_info->parent);
-          p->cache[i]=(long) p->color_number;
-        }
+        p->cache[i]=(long) FindClosestColor(p->colormap_tree,&pixel);
       /*
         Assign pixel to closest colormap entry.
       */
@@ -1285,6 +1836,49 @@ static MagickPassFail DitherImage(CubeInfo *cube_info,Image *image)
   return(MagickPass);
 }
 
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
++   F i n d C l o s e s t C o l o r                                           %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  FindClosestColor() returns the index of the colormap entry nearest to a
+%  color.  The colormap tree is only read, so it may be called from several
+%  threads at once.
+%
+%  The format of the FindClosestColor method is:
+%
+%      unsigned long FindClosestColor(const ColormapTree *colormap_tree,
+%        const PixelPacket *pixel)
+%
+%  A description of each parameter follows.
+%
+%    o colormap_tree: The colormap tree returned by AllocateColormapTree().
+%
+%    o pixel: The color to search for.
+%
+%
+*/
+static unsigned long FindClosestColor(const ColormapTree *colormap_tree,
+  const PixelPacket *pixel)
+{
+  ClosestColorInfo
+    closest;
+
+  closest.color.red=pixel->red;
+  closest.color.green=pixel->green;
+  closest.color.blue=pixel->blue;
+  closest.distance=3.0*(MaxRGBDouble+1.0)*(MaxRGBDouble+1.0);
+  closest.color_number=0;
+  ClosestColor(colormap_tree->nodes,0,colormap_tree->colors,&closest);
+  return(closest.color_number);
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -2552,7 +3146,8 @@ MagickExport MagickPassFail QuantizeImages(const QuantizeInfo *quantize_info,
     *cube_info;
 
   int
-    depth;
+    depth,
+    frame_threads;
 
   MonitorHandler
     handler;
@@ -2646,26 +3241,39 @@ MagickExport MagickPassFail QuantizeImages(const QuantizeInfo *quantize_info,
       /*
         Reduce the number of colors in an image sequence.
       */
-      ReduceImageColors(image->filename,cube_info,number_colors,&image->exception);
-      image=images;
-      for (i=0; image != (Image *) NULL; i++)
-      {
-        handler=SetMonitorHandler((MonitorHandler) NULL);
-        status=AssignImageColors(cube_info,image);
-        if (status == MagickFail)
-          break;
-        if (quantize_info->colorspace != RGBColorspace)
-          (void) TransformColorspace(image,quantize_info->colorspace);
-        image=image->next;
-        (void) SetMonitorHandler(handler);
-        if ((image != (Image *) NULL) &&
-            (!MagickMonitorFormatted(i,number_images,&image->exception,
-                                     AssignImageText,image->filename)))
-          {
-            status=MagickFail;
-            break;
-          }
-      }
+      ReduceImageColors(images->filename,cube_info,number_colors,
+                        &images->exception);
+      frame_threads=(int) Min(GetMagickResourceLimit(ThreadsResource),
+                              (magick_int64_t) number_images);
+      if (!quantize_info->dither && (frame_threads > 1))
+        {
+          /*
+            Assign colors to several images at once.
+          */
+          status=AssignImageListColors(cube_info,images,number_images,
+                                       frame_threads);
+        }
+      else
+        {
+          for (image=images, i=0; image != (Image *) NULL; i++)
+            {
+              handler=SetMonitorHandler((MonitorHandler) NULL);
+              status=AssignImageColors(cube_info,image);
+              if (status == MagickFail)
+                break;
+              if (quantize_info->colorspace != RGBColorspace)
+                (void) TransformColorspace(image,quantize_info->colorspace);
+              image=image->next;
+              (void) SetMonitorHandler(handler);
+              if ((image != (Image *) NULL) &&
+                  (!MagickMonitorFormatted(i,number_images,&image->exception,
+                                           AssignImageText,image->filename)))
+                {
+                  status=MagickFail;
+                  break;
+                }
+            }
+        }
     }
   DestroyCubeInfo(cube_info);
   return(status);
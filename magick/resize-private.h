@@ -0,0 +1,23 @@
+/*
+  Copyright (C) 2026 GraphicsMagick Group
+
+  This program is covered by multiple licenses, which are described in
+  Copyright.txt. You should have received a copy of Copyright.txt with this
+  package; otherwise see http://www.graphicsmagick.org/www/Copyright.html.
+
+  GraphicsMagick Image Resize Methods (Private).
+*/
+
+extern void
+DestroyResizeInfo(void);
+
+extern MagickPassFail
+InitializeResizeInfo(void);
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 2
+ * fill-column: 78
+ * End:
+ */
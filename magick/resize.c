@@ -39,7 +39,31 @@
 #include "magick/omp_data_view.h"
 #include "magick/pixel_cache.h"
 #include "magick/resize.h"
+#include "magick/semaphore.h"
 #include "magick/utility.h"
+
+/*
+  Vectorized resize kernels accumulate in single precision and are
+  only provided for 8 and 16 bit quantums, where float has sufficient
+  precision.  SSE2 is part of the x86-64 baseline, while AVX2 is
+  selected at run time via CPU feature detection.
+*/
+#if (QuantumDepth == 8) || (QuantumDepth == 16)
+#  if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#    define RESIZE_SSE2_KERNELS 1
+#    include <emmintrin.h>
+#    if defined(__GNUC__) && !defined(__STRICT_ANSI__) && \
+  (defined(__clang__) || (__GNUC__ >= 5))
+#      define RESIZE_AVX2_KERNELS 1
+#      define RESIZE_AVX2_FUNC MAGICK_ATTRIBUTE((__target__("avx2")))
+#      include <immintrin.h>
+#    endif
+#  elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    define RESIZE_NEON_KERNELS 1
+#    include <arm_neon.h>
+#  endif
+#endif
 
 /*
   Typedef declarations.
@@ -49,16 +73,79 @@ typedef struct _ContributionInfo
   double
     weight;
 
-  long
-    pixel;
+  float
+    simd_weight; /* Weight as used by vectorized kernels */
 } ContributionInfo;
 
+typedef struct _ContributionRange
+{
+  long
+    start,      /* First contributing source pixel */
+    nearest;    /* Source pixel nearest to the center */
+
+  long
+    n;          /* Number of contributing source pixels */
+
+  size_t
+    offset;     /* Index of first weight in contributions */
+} ContributionRange;
+
+/*
+  Filter contributions for each destination column (or row) of a resize
+  pass.  The weights only depend on the source and destination lengths,
+  the filter, and the blur so a table is shared read-only by all threads
+  and is cached for reuse by subsequent images (e.g. the frames of an
+  animation) of the same geometry.
+*/
+typedef struct _ContributionTable
+{
+  unsigned long
+    source_length,
+    destination_length;
+
+  FilterTypes
+    filter;
+
+  double
+    blur,
+    factor;
+
+  MagickBool
+    point_sampling;
+
+  ContributionRange
+    *ranges;
+
+  ContributionInfo
+    *contributions;
+
+  unsigned long
+    references;
+
+  MagickBool
+    cached;
+
+  struct _ContributionTable
+    *next;
+} ContributionTable;
+
 typedef struct _FilterInfo
 {
   double
     (*function)(const double,const double),
     support;
 } FilterInfo;
+
+/*
+  Maximum number of contribution tables retained for reuse.
+*/
+#define MaxContributionTables 8
+
+static SemaphoreInfo
+  *contribution_semaphore = (SemaphoreInfo *) NULL;
+
+static ContributionTable
+  *contribution_tables = (ContributionTable *) NULL;
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -634,6 +721,12 @@ MagickExport Image *MinifyImage(const Image * restrict image,ExceptionInfo *exce
 %
 %  ResizeImage() was inspired by Paul Heckbert's zoom program.
 %
+%  When the CPU supports it, pixels are accumulated by SSE2, AVX2, or NEON
+%  kernels in single precision.  Results may then differ from the double
+%  precision scalar code by up to two quantum levels (usually by no more
+%  than one).  Set the MAGICK_RESIZE_SIMD environment variable to "scalar"
+%  in order to always use the scalar code.
+%
 %  The format of the ResizeImage method is:
 %
 %      Image *ResizeImage(Image *image,const unsigned long columns,
@@ -824,254 +917,1086 @@ static double Triangle(const double x,const double support)
   return(0.0);
 }
 
-static MagickPassFail
-HorizontalFilter(const Image * restrict source,Image * restrict destination,
-                 const double x_factor,const FilterInfo * restrict filter_info,
-                 const double blur,ThreadViewDataSet *view_data_set,
-                 const size_t span,unsigned long * restrict quantum_p,
-                 ExceptionInfo *exception)
+/*
+  Vectorized contribution kernels.
+
+  Each kernel computes 'count' destination pixels, stored contiguously
+  at q.  The source pixels for destination pixel k start at
+  p+k*advance and successive contributions are 'stride' pixels apart.
+  The opaque kernels set opacity to OpaqueOpacity while the matte
+  kernels weight color by alpha in the same way as the scalar code.
+  Since pixels are accumulated in float rather than double, results may
+  differ from the scalar code by rounding (at most two quantum levels
+  after both resize passes).
+*/
+typedef void (*ResizeKernelMethod)(const PixelPacket * restrict p,
+                                   const size_t advance,const size_t stride,
+                                   const ContributionInfo * restrict contribution,
+                                   const long n,PixelPacket * restrict q,
+                                   const unsigned long count);
+
+typedef struct _ResizeKernelInfo
 {
-#define ResizeImageText "[%s] Resize..."
+  const char
+    *name;
 
-  double
-    scale,
-    support;
+  ResizeKernelMethod
+    opaque,
+    matte;
+} ResizeKernelInfo;
 
-  DoublePixelPacket
-    zero;
+/*
+  Opacity is the last quantum of a PixelPacket for both RGBA and BGRA
+  orderings.
+*/
+#define ResizeOpacityLane 3
 
-  long
-    x;
+#if defined(RESIZE_SSE2_KERNELS)
+static inline __m128 ResizeLoadSSE2(const PixelPacket *p)
+{
+  __m128i
+    v;
 
-  unsigned long
-    quantum;
+#if QuantumDepth == 8
+  int
+    packed;
 
-  MagickBool
-    monitor_active;
+  (void) memcpy(&packed,p,sizeof(packed));
+  v=_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed),_mm_setzero_si128());
+#else
+  v=_mm_loadl_epi64((const __m128i *) p);
+#endif
+  return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v,_mm_setzero_si128()));
+}
 
-  MagickPassFail
-    status=MagickPass;
+static inline void ResizeStoreSSE2(PixelPacket *q,__m128 v)
+{
+  __m128i
+    i;
 
-  if (IsEventLogging())
-    (void) LogMagickEvent(TransformEvent,GetMagickModule(),
-                          "Horizontal Filter: %lux%lu => %lux%lu "
-                          "(x_factor %g, blur %g, span %"MAGICK_SIZE_T_F"u) ...",
-                          source->columns, source->rows,
-                          destination->columns, destination->rows,
-                          x_factor, blur, (MAGICK_SIZE_T) span);
+  v=_mm_min_ps(_mm_max_ps(v,_mm_setzero_ps()),_mm_set1_ps((float) MaxRGB));
+  i=_mm_cvttps_epi32(_mm_add_ps(v,_mm_set1_ps(0.5f)));
+#if QuantumDepth == 8
+  {
+    int
+      packed;
 
-  quantum = *quantum_p;
+    i=_mm_packs_epi32(i,i);
+    packed=_mm_cvtsi128_si32(_mm_packus_epi16(i,i));
+    (void) memcpy(q,&packed,sizeof(packed));
+  }
+#else
+  /*
+    SSE2 lacks an unsigned 32 to 16 bit pack so bias into signed range.
+  */
+  i=_mm_packs_epi32(_mm_sub_epi32(i,_mm_set1_epi32(32768)),
+                    _mm_setzero_si128());
+  _mm_storel_epi64((__m128i *) q,_mm_xor_si128(i,_mm_set1_epi16(-32768)));
+#endif
+}
 
-  scale=blur*Max(1.0/x_factor,1.0);
-  support=scale*filter_info->support;
-  destination->storage_class=source->storage_class;
-  if (support > 0.5)
-    destination->storage_class=DirectClass;
-  else
-    {
-      /*
-        Reduce to point sampling.
-      */
-      support=0.5+MagickEpsilon;
-      scale=1.0;
-    }
-  scale=1.0/scale;
-  (void) memset(&zero,0,sizeof(DoublePixelPacket));
+static inline __m128 ResizeNormalizeSSE2(const __m128 pixel,float normalize)
+{
+  normalize=(float) (1.0/(AbsoluteValue(normalize) <= MagickEpsilon ?
+                          1.0 : normalize));
+  return _mm_mul_ps(pixel,_mm_set_ps(1.0f,normalize,normalize,normalize));
+}
 
-  monitor_active=MagickMonitorActive();
+static inline __m128 ResizeOpaquePixelSSE2(const PixelPacket * restrict s,
+                                           const size_t stride,
+                                           const ContributionInfo * restrict contribution,
+                                           const long n)
+{
+  __m128
+    pixel;
 
-#if defined(HAVE_OPENMP)
-#  if defined(TUNE_OPENMP)
-#    pragma omp parallel for schedule(runtime) shared(status, quantum)
-#  else
-#    if defined(USE_STATIC_SCHEDULING_ONLY)
-#      pragma omp parallel for schedule(static) shared(status, quantum)
-#    else
-#      pragma omp parallel for schedule(guided) shared(status, quantum)
-#    endif
-#  endif
-#endif
-  for (x=0; x < (long) destination->columns; x++)
-    {
-      double
-        center,
-        density;
+  long
+    i;
 
-      ContributionInfo
-        * restrict contribution;
+  pixel=_mm_setzero_ps();
+  for (i=0; i < n; i++, s+=stride)
+    pixel=_mm_add_ps(pixel,_mm_mul_ps(_mm_set1_ps(contribution[i].simd_weight),
+                                      ResizeLoadSSE2(s)));
+  return pixel;
+}
 
-      register const PixelPacket
-        * restrict p;
+static inline __m128 ResizeMattePixelSSE2(const PixelPacket * restrict s,
+                                          const size_t stride,
+                                          const ContributionInfo * restrict contribution,
+                                          const long n)
+{
+  const __m128
+    opacity_mask=_mm_castsi128_ps(_mm_set_epi32(-1,0,0,0)),
+    one=_mm_set1_ps(1.0f),
+    scale=_mm_set1_ps((float) (1.0/TransparentOpacity));
 
-      register PixelPacket
-        * restrict q = (PixelPacket *) NULL;
+  __m128
+    normalize,
+    pixel;
 
-      const IndexPacket
-        * restrict source_indexes;
+  long
+    i;
 
-      IndexPacket
-        * restrict indexes;
+  pixel=_mm_setzero_ps();
+  normalize=_mm_setzero_ps();
+  for (i=0; i < n; i++, s+=stride)
+    {
+      __m128
+        transparency_coeff,
+        v,
+        weight;
+
+      v=ResizeLoadSSE2(s);
+      weight=_mm_set1_ps(contribution[i].simd_weight);
+      transparency_coeff=
+        _mm_mul_ps(weight,_mm_sub_ps(one,_mm_mul_ps(_mm_shuffle_ps(v,v,0xff),
+                                                    scale)));
+      weight=_mm_or_ps(_mm_and_ps(opacity_mask,weight),
+                       _mm_andnot_ps(opacity_mask,transparency_coeff));
+      pixel=_mm_add_ps(pixel,_mm_mul_ps(weight,v));
+      normalize=_mm_add_ss(normalize,transparency_coeff);
+    }
+  return ResizeNormalizeSSE2(pixel,_mm_cvtss_f32(normalize));
+}
 
-      long
-        n,
-        start,
-        stop,
-        y;
+static void ResizeOpaqueSSE2(const PixelPacket * restrict p,
+                             const size_t advance,const size_t stride,
+                             const ContributionInfo * restrict contribution,
+                             const long n,PixelPacket * restrict q,
+                             const unsigned long count)
+{
+  unsigned long
+    k;
 
-      MagickBool
-        thread_status;
+  /*
+    Two destination pixels per pass hide the latency of the
+    accumulation chain.
+  */
+  for (k=0; k+1 < count; k+=2)
+    {
+      const PixelPacket
+        * restrict s;
 
-      thread_status=status;
-      if (thread_status == MagickFail)
-        continue;
+      __m128
+        pixel_a,
+        pixel_b,
+        weight;
 
-      contribution=AccessThreadViewData(view_data_set);
-      /* fprintf(stderr,"Thread %d contribution %p\n",omp_get_thread_num(),contribution); */
-      center=(double) (x+0.5)/x_factor;
-      start=(long) Max(center-support+0.5,0);
-      stop=(long) Min(center+support+0.5,source->columns);
-      density=0.0;
-      for (n=0; n < (stop-start); n++)
-        {
-          contribution[n].pixel=start+n;
-          contribution[n].weight=
-            filter_info->function(scale*((double) start+n-center+0.5),filter_info->support);
-          density+=contribution[n].weight;
-        }
-      if ((density != 0.0) && (density != 1.0))
-        {
-          /*
-            Normalize.
-          */
-          long
-            i;
+      long
+        i;
 
-          density=1.0/density;
-          for (i=0; i < n; i++)
-            contribution[i].weight*=density;
+      s=p+k*advance;
+      pixel_a=_mm_setzero_ps();
+      pixel_b=_mm_setzero_ps();
+      for (i=0; i < n; i++, s+=stride)
+        {
+          weight=_mm_set1_ps(contribution[i].simd_weight);
+          pixel_a=_mm_add_ps(pixel_a,_mm_mul_ps(weight,ResizeLoadSSE2(s)));
+          pixel_b=_mm_add_ps(pixel_b,_mm_mul_ps(weight,
+                                                ResizeLoadSSE2(s+advance)));
         }
+      ResizeStoreSSE2(&q[k],pixel_a);
+      ResizeStoreSSE2(&q[k+1],pixel_b);
+      q[k].opacity=OpaqueOpacity;
+      q[k+1].opacity=OpaqueOpacity;
+    }
+  if (k < count)
+    {
+      ResizeStoreSSE2(&q[k],ResizeOpaquePixelSSE2(p+k*advance,stride,
+                                                  contribution,n));
+      q[k].opacity=OpaqueOpacity;
+    }
+}
 
-      p=AcquireImagePixels(source,contribution[0].pixel,0,
-                           contribution[n-1].pixel-contribution[0].pixel+1,
-                           source->rows,exception);
-      if (p == (const PixelPacket *) NULL)
-        thread_status=MagickFail;
-
-      if (thread_status != MagickFail)
-        q=SetImagePixelsEx(destination,x,0,1,destination->rows,exception);
-      if (q == (PixelPacket *) NULL)
-        thread_status=MagickFail;
+static void ResizeMatteSSE2(const PixelPacket * restrict p,
+                            const size_t advance,const size_t stride,
+                            const ContributionInfo * restrict contribution,
+                            const long n,PixelPacket * restrict q,
+                            const unsigned long count)
+{
+  unsigned long
+    k;
 
-      if (thread_status != MagickFail)
-        {
-          source_indexes=AccessImmutableIndexes(source);
-          indexes=AccessMutableIndexes(destination);
-          for (y=0; y < (long) destination->rows; y++)
-            {
-              double
-                weight;
+  for (k=0; k < count; k++)
+    ResizeStoreSSE2(&q[k],ResizeMattePixelSSE2(p+k*advance,stride,
+                                               contribution,n));
+}
 
-              DoublePixelPacket
-                pixel;
+static const ResizeKernelInfo
+  resize_sse2_kernel = { "SSE2", ResizeOpaqueSSE2, ResizeMatteSSE2 };
+#endif /* defined(RESIZE_SSE2_KERNELS) */
 
-              long
-                j;
+#if defined(RESIZE_AVX2_KERNELS)
+/*
+  AVX2 kernels compute two destination pixels per 256 bit register.
+*/
+static inline RESIZE_AVX2_FUNC __m256
+ResizeLoadPairAVX2(const PixelPacket *a,const PixelPacket *b)
+{
+#if QuantumDepth == 8
+  int
+    packed_a,
+    packed_b;
+
+  (void) memcpy(&packed_a,a,sizeof(packed_a));
+  (void) memcpy(&packed_b,b,sizeof(packed_b));
+  return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+    _mm_unpacklo_epi32(_mm_cvtsi32_si128(packed_a),
+                       _mm_cvtsi32_si128(packed_b))));
+#else
+  return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(
+    _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *) a),
+                       _mm_loadl_epi64((const __m128i *) b))));
+#endif
+}
 
-              register long
-                i;
+static inline RESIZE_AVX2_FUNC void
+ResizeStorePairAVX2(PixelPacket *q,__m256 v)
+{
+  __m128i
+    high,
+    low;
 
-              pixel=zero;
-              if ((destination->matte) || (destination->colorspace == CMYKColorspace))
-                {
-                  double
-                    transparency_coeff,
-                    normalize;
+  __m256i
+    i;
 
-                  normalize=0.0;
-                  for (i=0; i < n; i++)
-                    {
-                      j=y*(contribution[n-1].pixel-contribution[0].pixel+1)+
-                        (contribution[i].pixel-contribution[0].pixel);
-                      weight=contribution[i].weight;
-                      transparency_coeff = weight * (1 - ((double) p[j].opacity/TransparentOpacity));
-                      pixel.red+=transparency_coeff*p[j].red;
-                      pixel.green+=transparency_coeff*p[j].green;
-                      pixel.blue+=transparency_coeff*p[j].blue;
-                      pixel.opacity+=weight*p[j].opacity;
-                      normalize += transparency_coeff;
-                    }
-                  normalize = 1.0 / (AbsoluteValue(normalize) <= MagickEpsilon ? 1.0 : normalize);
-                  pixel.red *= normalize;
-                  pixel.green *= normalize;
-                  pixel.blue *= normalize;
-                  q[y].red=RoundDoubleToQuantum(pixel.red);
-                  q[y].green=RoundDoubleToQuantum(pixel.green);
-                  q[y].blue=RoundDoubleToQuantum(pixel.blue);
-                  q[y].opacity=RoundDoubleToQuantum(pixel.opacity);
-                }
-              else
-                {
-                  for (i=0; i < n; i++)
-                    {
-                      j=(long) (y*(contribution[n-1].pixel-contribution[0].pixel+1)+
-                                (contribution[i].pixel-contribution[0].pixel));
-                      weight=contribution[i].weight;
-                      pixel.red+=weight*p[j].red;
-                      pixel.green+=weight*p[j].green;
-                      pixel.blue+=weight*p[j].blue;
-                    }
-                  q[y].red=RoundDoubleToQuantum(pixel.red);
-                  q[y].green=RoundDoubleToQuantum(pixel.green);
-                  q[y].blue=RoundDoubleToQuantum(pixel.blue);
-                  q[y].opacity=OpaqueOpacity;
-                }
+  v=_mm256_min_ps(_mm256_max_ps(v,_mm256_setzero_ps()),
+                  _mm256_set1_ps((float) MaxRGB));
+  i=_mm256_cvttps_epi32(_mm256_add_ps(v,_mm256_set1_ps(0.5f)));
+  low=_mm256_castsi256_si128(i);
+  high=_mm256_extracti128_si256(i,1);
+#if QuantumDepth == 8
+  low=_mm_packs_epi32(low,high);
+  _mm_storel_epi64((__m128i *) q,_mm_packus_epi16(low,low));
+#else
+  _mm_storeu_si128((__m128i *) q,_mm_packus_epi32(low,high));
+#endif
+}
 
-              if ((indexes != (IndexPacket *) NULL) &&
-                  (source_indexes != (IndexPacket *) NULL))
-                {
-                  i=Min(Max((long) (center+0.5),start),stop-1);
-                  j=y*(contribution[n-1].pixel-contribution[0].pixel+1)+
-                    (contribution[i-start].pixel-contribution[0].pixel);
-                  indexes[y]=source_indexes[j];
-                }
-            }
-          if (!SyncImagePixelsEx(destination,exception))
-            thread_status=MagickFail;
-        }
+static RESIZE_AVX2_FUNC void
+ResizeOpaqueAVX2(const PixelPacket * restrict p,
+                 const size_t advance,const size_t stride,
+                 const ContributionInfo * restrict contribution,
+                 const long n,PixelPacket * restrict q,
+                 const unsigned long count)
+{
+  unsigned long
+    k;
 
-      if (monitor_active)
-        {
-          unsigned long
-            thread_quantum;
+  for (k=0; k+3 < count; k+=4)
+    {
+      const PixelPacket
+        * restrict s;
 
-#if defined(HAVE_OPENMP)
-#  pragma omp flush (quantum)
-#endif
-          thread_quantum=quantum;
-          if (QuantumTick(thread_quantum,span))
-            if (!MagickMonitorFormatted(thread_quantum,span,exception,
-                                        ResizeImageText,source->filename))
-              thread_status=MagickFail;
+      __m256
+        pixels_a,
+        pixels_b,
+        weight;
 
-#if defined(HAVE_OPENMP)
-#  pragma omp atomic
-#endif
-          quantum++;
-        }
+      long
+        i;
 
-      if (thread_status == MagickFail)
+      s=p+k*advance;
+      pixels_a=_mm256_setzero_ps();
+      pixels_b=_mm256_setzero_ps();
+      for (i=0; i < n; i++, s+=stride)
         {
-          status=MagickFail;
-#if defined(HAVE_OPENMP)
-#  pragma omp flush (status)
-#endif
+          weight=_mm256_set1_ps(contribution[i].simd_weight);
+          pixels_a=_mm256_add_ps(pixels_a,_mm256_mul_ps(weight,
+            ResizeLoadPairAVX2(s,s+advance)));
+          pixels_b=_mm256_add_ps(pixels_b,_mm256_mul_ps(weight,
+            ResizeLoadPairAVX2(s+2*advance,s+3*advance)));
         }
+      ResizeStorePairAVX2(&q[k],pixels_a);
+      ResizeStorePairAVX2(&q[k+2],pixels_b);
+      q[k].opacity=OpaqueOpacity;
+      q[k+1].opacity=OpaqueOpacity;
+      q[k+2].opacity=OpaqueOpacity;
+      q[k+3].opacity=OpaqueOpacity;
     }
+  for ( ; k < count; k++)
+    {
+      ResizeStoreSSE2(&q[k],ResizeOpaquePixelSSE2(p+k*advance,stride,
+                                                  contribution,n));
+      q[k].opacity=OpaqueOpacity;
+    }
+}
 
-  if (IsEventLogging())
-    (void) LogMagickEvent(TransformEvent,GetMagickModule(),
-                          "%s exit Horizontal Filter",
-                          (status == MagickFail ? "Error" : "Normal"));
+static RESIZE_AVX2_FUNC void
+ResizeMatteAVX2(const PixelPacket * restrict p,
+                const size_t advance,const size_t stride,
+                const ContributionInfo * restrict contribution,
+                const long n,PixelPacket * restrict q,
+                const unsigned long count)
+{
+  const __m256
+    one=_mm256_set1_ps(1.0f),
+    scale=_mm256_set1_ps((float) (1.0/TransparentOpacity));
+
+  unsigned long
+    k;
+
+  for (k=0; k+1 < count; k+=2)
+    {
+      const PixelPacket
+        * restrict s;
+
+      __m256
+        normalize,
+        pixels;
+
+      float
+        normalize_a,
+        normalize_b;
+
+      long
+        i;
+
+      s=p+k*advance;
+      pixels=_mm256_setzero_ps();
+      normalize=_mm256_setzero_ps();
+      for (i=0; i < n; i++, s+=stride)
+        {
+          __m256
+            transparency_coeff,
+            v,
+            weight;
+
+          v=ResizeLoadPairAVX2(s,s+advance);
+          weight=_mm256_set1_ps(contribution[i].simd_weight);
+          transparency_coeff=
+            _mm256_mul_ps(weight,
+                          _mm256_sub_ps(one,
+                                        _mm256_mul_ps(_mm256_shuffle_ps(v,v,0xff),
+                                                      scale)));
+          pixels=_mm256_add_ps(pixels,
+                               _mm256_mul_ps(_mm256_blend_ps(transparency_coeff,
+                                                             weight,0x88),v));
+          normalize=_mm256_add_ps(normalize,transparency_coeff);
+        }
+      normalize_a=_mm_cvtss_f32(_mm256_castps256_ps128(normalize));
+      normalize_b=_mm_cvtss_f32(_mm256_extractf128_ps(normalize,1));
+      normalize_a=(float) (1.0/(AbsoluteValue(normalize_a) <= MagickEpsilon ?
+                                1.0 : normalize_a));
+      normalize_b=(float) (1.0/(AbsoluteValue(normalize_b) <= MagickEpsilon ?
+                                1.0 : normalize_b));
+      pixels=_mm256_mul_ps(pixels,_mm256_set_ps(1.0f,normalize_b,normalize_b,
+                                                normalize_b,1.0f,normalize_a,
+                                                normalize_a,normalize_a));
+      ResizeStorePairAVX2(&q[k],pixels);
+    }
+  if (k < count)
+    ResizeStoreSSE2(&q[k],ResizeMattePixelSSE2(p+k*advance,stride,
+                                               contribution,n));
+}
+
+static const ResizeKernelInfo
+  resize_avx2_kernel = { "AVX2", ResizeOpaqueAVX2, ResizeMatteAVX2 };
+#endif /* defined(RESIZE_AVX2_KERNELS) */
+
+#if defined(RESIZE_NEON_KERNELS)
+static inline float32x4_t ResizeLoadNEON(const PixelPacket *p)
+{
+#if QuantumDepth == 8
+  uint32_t
+    packed;
+
+  (void) memcpy(&packed,p,sizeof(packed));
+  return vcvtq_f32_u32(vmovl_u16(vget_low_u16(
+    vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(packed))))));
+#else
+  uint16_t
+    quanta[4];
+
+  (void) memcpy(quanta,p,sizeof(quanta));
+  return vcvtq_f32_u32(vmovl_u16(vld1_u16(quanta)));
+#endif
+}
+
+static inline void ResizeStoreNEON(PixelPacket *q,float32x4_t v)
+{
+  uint16x4_t
+    i;
+
+  v=vminq_f32(vmaxq_f32(v,vdupq_n_f32(0.0f)),vdupq_n_f32((float) MaxRGB));
+  i=vmovn_u32(vcvtq_u32_f32(vaddq_f32(v,vdupq_n_f32(0.5f))));
+#if QuantumDepth == 8
+  {
+    uint32_t
+      packed;
+
+    packed=vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(i,i))),0);
+    (void) memcpy(q,&packed,sizeof(packed));
+  }
+#else
+  {
+    uint16_t
+      quanta[4];
+
+    vst1_u16(quanta,i);
+    (void) memcpy(q,quanta,sizeof(quanta));
+  }
+#endif
+}
+
+static void ResizeOpaqueNEON(const PixelPacket * restrict p,
+                             const size_t advance,const size_t stride,
+                             const ContributionInfo * restrict contribution,
+                             const long n,PixelPacket * restrict q,
+                             const unsigned long count)
+{
+  unsigned long
+    k;
+
+  for (k=0; k+1 < count; k+=2)
+    {
+      const PixelPacket
+        * restrict s;
+
+      float32x4_t
+        pixel_a,
+        pixel_b;
+
+      long
+        i;
+
+      s=p+k*advance;
+      pixel_a=vdupq_n_f32(0.0f);
+      pixel_b=vdupq_n_f32(0.0f);
+      for (i=0; i < n; i++, s+=stride)
+        {
+          pixel_a=vmlaq_n_f32(pixel_a,ResizeLoadNEON(s),
+                              contribution[i].simd_weight);
+          pixel_b=vmlaq_n_f32(pixel_b,ResizeLoadNEON(s+advance),
+                              contribution[i].simd_weight);
+        }
+      ResizeStoreNEON(&q[k],pixel_a);
+      ResizeStoreNEON(&q[k+1],pixel_b);
+      q[k].opacity=OpaqueOpacity;
+      q[k+1].opacity=OpaqueOpacity;
+    }
+  if (k < count)
+    {
+      const PixelPacket
+        * restrict s;
+
+      float32x4_t
+        pixel;
+
+      long
+        i;
+
+      s=p+k*advance;
+      pixel=vdupq_n_f32(0.0f);
+      for (i=0; i < n; i++, s+=stride)
+        pixel=vmlaq_n_f32(pixel,ResizeLoadNEON(s),contribution[i].simd_weight);
+      ResizeStoreNEON(&q[k],pixel);
+      q[k].opacity=OpaqueOpacity;
+    }
+}
+
+static void ResizeMatteNEON(const PixelPacket * restrict p,
+                            const size_t advance,const size_t stride,
+                            const ContributionInfo * restrict contribution,
+                            const long n,PixelPacket * restrict q,
+                            const unsigned long count)
+{
+  static const uint32_t
+    opacity_lanes[4] = { 0U, 0U, 0U, ~0U };
+
+  const uint32x4_t
+    opacity_mask=vld1q_u32(opacity_lanes);
+
+  const float
+    scale=(float) (1.0/TransparentOpacity);
+
+  unsigned long
+    k;
+
+  for (k=0; k < count; k++)
+    {
+      const PixelPacket
+        * restrict s;
+
+      float32x4_t
+        pixel;
+
+      float
+        normalize;
+
+      long
+        i;
+
+      s=p+k*advance;
+      pixel=vdupq_n_f32(0.0f);
+      normalize=0.0f;
+      for (i=0; i < n; i++, s+=stride)
+        {
+          float32x4_t
+            v;
+
+          float
+            transparency_coeff;
+
+          v=ResizeLoadNEON(s);
+          transparency_coeff=contribution[i].simd_weight*
+            (1.0f-vgetq_lane_f32(v,ResizeOpacityLane)*scale);
+          pixel=vmlaq_f32(pixel,v,
+                          vbslq_f32(opacity_mask,
+                                    vdupq_n_f32(contribution[i].simd_weight),
+                                    vdupq_n_f32(transparency_coeff)));
+          normalize+=transparency_coeff;
+        }
+      normalize=(float) (1.0/(AbsoluteValue(normalize) <= MagickEpsilon ?
+                              1.0 : normalize));
+      ResizeStoreNEON(&q[k],
+                      vmulq_f32(pixel,
+                                vsetq_lane_f32(1.0f,vdupq_n_f32(normalize),
+                                               ResizeOpacityLane)));
+    }
+}
+
+static const ResizeKernelInfo
+  resize_neon_kernel = { "NEON", ResizeOpaqueNEON, ResizeMatteNEON };
+#endif /* defined(RESIZE_NEON_KERNELS) */
+
+/*
+  Select the best vectorized kernel supported by the CPU, or NULL to
+  use the scalar code.  The MAGICK_RESIZE_SIMD environment variable
+  may be set to "scalar" to disable the vectorized kernels, or to the
+  name of an instruction set in order to limit the selection.
+*/
+static const ResizeKernelInfo *SelectResizeKernel(void)
+{
+  const ResizeKernelInfo
+    *kernel = (const ResizeKernelInfo *) NULL;
+
+  const char
+    *limit;
+
+  limit=getenv("MAGICK_RESIZE_SIMD");
+  if ((limit != (const char *) NULL) &&
+      ((LocaleCompare(limit,"scalar") == 0) ||
+       (LocaleCompare(limit,"none") == 0) ||
+       (LocaleCompare(limit,"false") == 0)))
+    return kernel;
+#if defined(RESIZE_NEON_KERNELS)
+  kernel=&resize_neon_kernel;
+#endif
+#if defined(RESIZE_SSE2_KERNELS)
+  kernel=&resize_sse2_kernel;
+#endif
+#if defined(RESIZE_AVX2_KERNELS)
+  if (((limit == (const char *) NULL) ||
+       (LocaleCompare(limit,"sse2") != 0)) &&
+      __builtin_cpu_supports("avx2"))
+    kernel=&resize_avx2_kernel;
+#endif
+  return kernel;
+}
+
+/*
+  Destroy a contribution table.
+*/
+static void DestroyContributionTable(ContributionTable *table)
+{
+  MagickFreeMemory(table->ranges);
+  MagickFreeMemory(table->contributions);
+  MagickFreeMemory(table);
+}
+
+/*
+  Compute the filter contributions for resizing a row (or column) of
+  source_length pixels to destination_length pixels.
+*/
+static ContributionTable *
+AllocateContributionTable(const unsigned long source_length,
+                          const unsigned long destination_length,
+                          const FilterTypes filter,
+                          const FilterInfo *filter_info,
+                          const double blur,ExceptionInfo *exception)
+{
+  ContributionTable
+    *table;
+
+  double
+    factor,
+    scale,
+    support;
+
+  size_t
+    stride;
+
+  long
+    x;
+
+  table=MagickAllocateMemory(ContributionTable *,sizeof(ContributionTable));
+  if (table == (ContributionTable *) NULL)
+    {
+      ThrowException3(exception,ResourceLimitError,MemoryAllocationFailed,
+                      UnableToResizeImage);
+      return (ContributionTable *) NULL;
+    }
+  (void) memset(table,0,sizeof(ContributionTable));
+  table->source_length=source_length;
+  table->destination_length=destination_length;
+  table->filter=filter;
+  table->blur=blur;
+  factor=(double) destination_length/source_length;
+  table->factor=factor;
+  scale=blur*Max(1.0/factor,1.0);
+  support=scale*filter_info->support;
+  if (support <= 0.5)
+    {
+      /*
+        Reduce to point sampling.
+      */
+      support=0.5+MagickEpsilon;
+      scale=1.0;
+      table->point_sampling=MagickTrue;
+    }
+  scale=1.0/scale;
+  stride=(size_t) (2.0*support+3);
+  table->ranges=MagickAllocateArray(ContributionRange *,destination_length,
+                                    sizeof(ContributionRange));
+  table->contributions=
+    MagickAllocateArray(ContributionInfo *,
+                        MagickArraySize(destination_length,stride),
+                        sizeof(ContributionInfo));
+  if ((table->ranges == (ContributionRange *) NULL) ||
+      (table->contributions == (ContributionInfo *) NULL))
+    {
+      DestroyContributionTable(table);
+      ThrowException3(exception,ResourceLimitError,MemoryAllocationFailed,
+                      UnableToResizeImage);
+      return (ContributionTable *) NULL;
+    }
+
+#if defined(HAVE_OPENMP)
+#  if defined(TUNE_OPENMP)
+#    pragma omp parallel for schedule(runtime)
+#  else
+#    pragma omp parallel for schedule(static)
+#  endif
+#endif
+  for (x=0; x < (long) destination_length; x++)
+    {
+      double
+        center,
+        density;
+
+      ContributionInfo
+        *contribution;
+
+      ContributionRange
+        *range;
+
+      long
+        i,
+        n,
+        start,
+        stop;
+
+      range=&table->ranges[x];
+      range->offset=(size_t) x*stride;
+      contribution=&table->contributions[range->offset];
+      center=(double) (x+0.5)/factor;
+      start=(long) Max(center-support+0.5,0);
+      stop=(long) Min(center+support+0.5,source_length);
+      density=0.0;
+      for (n=0; n < (stop-start); n++)
+        {
+          contribution[n].weight=
+            filter_info->function(scale*((double) start+n-center+0.5),filter_info->support);
+          density+=contribution[n].weight;
+        }
+      if ((density != 0.0) && (density != 1.0))
+        {
+          /*
+            Normalize.
+          */
+          density=1.0/density;
+          for (i=0; i < n; i++)
+            contribution[i].weight*=density;
+        }
+      for (i=0; i < n; i++)
+        contribution[i].simd_weight=(float) contribution[i].weight;
+      range->start=start;
+      range->nearest=Min(Max((long) (center+0.5),start),stop-1);
+      range->n=n;
+    }
+  return table;
+}
+
+/*
+  Obtain a reference to the contribution table for the specified
+  geometry, filter, and blur.  Recently used tables are retained so that
+  resizing a sequence of images of the same size computes the weights
+  only once.
+*/
+static ContributionTable *
+AcquireContributionTable(const unsigned long source_length,
+                         const unsigned long destination_length,
+                         const FilterTypes filter,
+                         const FilterInfo *filter_info,
+                         const double blur,ExceptionInfo *exception)
+{
+  ContributionTable
+    *previous,
+    *table;
+
+  unsigned long
+    count;
+
+  LockSemaphoreInfo(contribution_semaphore);
+  for (previous=(ContributionTable *) NULL, table=contribution_tables;
+       table != (ContributionTable *) NULL;
+       previous=table, table=table->next)
+    if ((table->source_length == source_length) &&
+        (table->destination_length == destination_length) &&
+        (table->filter == filter) && (table->blur == blur))
+      break;
+  if (table != (ContributionTable *) NULL)
+    {
+      /*
+        Move to the head of the list.
+      */
+      if (previous != (ContributionTable *) NULL)
+        {
+          previous->next=table->next;
+          table->next=contribution_tables;
+          contribution_tables=table;
+        }
+      table->references++;
+      UnlockSemaphoreInfo(contribution_semaphore);
+      return table;
+    }
+  UnlockSemaphoreInfo(contribution_semaphore);
+
+  table=AllocateContributionTable(source_length,destination_length,filter,
+                                  filter_info,blur,exception);
+  if (table == (ContributionTable *) NULL)
+    return table;
+  table->references=1;
+
+  /*
+    Add to the head of the list and forget the least recently used
+    tables beyond MaxContributionTables.
+  */
+  LockSemaphoreInfo(contribution_semaphore);
+  table->cached=MagickTrue;
+  table->next=contribution_tables;
+  contribution_tables=table;
+  for (count=1, previous=table; previous->next != (ContributionTable *) NULL; )
+    {
+      ContributionTable
+        *entry;
+
+      if (count < MaxContributionTables)
+        {
+          count++;
+          previous=previous->next;
+          continue;
+        }
+      entry=previous->next;
+      previous->next=entry->next;
+      entry->next=(ContributionTable *) NULL;
+      entry->cached=MagickFalse;
+      if (entry->references == 0)
+        DestroyContributionTable(entry);
+    }
+  UnlockSemaphoreInfo(contribution_semaphore);
+  return table;
+}
+
+/*
+  Release a reference obtained via AcquireContributionTable().
+*/
+static void ReleaseContributionTable(ContributionTable *table)
+{
+  MagickBool
+    destroy;
+
+  LockSemaphoreInfo(contribution_semaphore);
+  table->references--;
+  destroy=((!table->cached) && (table->references == 0));
+  UnlockSemaphoreInfo(contribution_semaphore);
+  if (destroy)
+    DestroyContributionTable(table);
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
++   D e s t r o y R e s i z e I n f o                                         %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  DestroyResizeInfo() releases the cached resize filter contribution
+%  tables.
+%
+%  The format of the DestroyResizeInfo method is:
+%
+%      void DestroyResizeInfo(void)
+%
+*/
+void DestroyResizeInfo(void)
+{
+  ContributionTable
+    *table;
+
+  while ((table=contribution_tables) != (ContributionTable *) NULL)
+    {
+      contribution_tables=table->next;
+      DestroyContributionTable(table);
+    }
+  DestroySemaphoreInfo(&contribution_semaphore);
+}
+
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
++   I n i t i a l i z e R e s i z e I n f o                                   %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  InitializeResizeInfo() initializes the cache of resize filter
+%  contribution tables.
+%
+%  The format of the InitializeResizeInfo method is:
+%
+%      MagickPassFail InitializeResizeInfo(void)
+%
+*/
+MagickPassFail InitializeResizeInfo(void)
+{
+  assert(contribution_semaphore == (SemaphoreInfo *) NULL);
+  contribution_semaphore=AllocateSemaphoreInfo();
+  return MagickPass;
+}
+
+static MagickPassFail
+HorizontalFilter(const Image * restrict source,Image * restrict destination,
+                 const ContributionTable * restrict table,
+                 const ResizeKernelInfo *kernel,const size_t span,
+                 unsigned long * restrict quantum_p,ExceptionInfo *exception)
+{
+#define ResizeImageText "[%s] Resize..."
+
+  DoublePixelPacket
+    zero;
+
+  long
+    x;
+
+  unsigned long
+    quantum;
+
+  MagickBool
+    monitor_active;
+
+  MagickPassFail
+    status=MagickPass;
+
+  if (IsEventLogging())
+    (void) LogMagickEvent(TransformEvent,GetMagickModule(),
+                          "Horizontal Filter: %lux%lu => %lux%lu "
+                          "(x_factor %g, blur %g, span %"MAGICK_SIZE_T_F"u) ...",
+                          source->columns, source->rows,
+                          destination->columns, destination->rows,
+                          table->factor, table->blur, (MAGICK_SIZE_T) span);
+
+  quantum = *quantum_p;
+
+  destination->storage_class=source->storage_class;
+  if (!table->point_sampling)
+    destination->storage_class=DirectClass;
+  (void) memset(&zero,0,sizeof(DoublePixelPacket));
+
+  monitor_active=MagickMonitorActive();
+
+#if defined(HAVE_OPENMP)
+#  if defined(TUNE_OPENMP)
+#    pragma omp parallel for schedule(runtime) shared(status, quantum)
+#  else
+#    if defined(USE_STATIC_SCHEDULING_ONLY)
+#      pragma omp parallel for schedule(static) shared(status, quantum)
+#    else
+#      pragma omp parallel for schedule(guided) shared(status, quantum)
+#    endif
+#  endif
+#endif
+  for (x=0; x < (long) destination->columns; x++)
+    {
+      const ContributionInfo
+        * restrict contribution;
+
+      const ContributionRange
+        * restrict range;
+
+      register const PixelPacket
+        * restrict p;
+
+      register PixelPacket
+        * restrict q = (PixelPacket *) NULL;
+
+      const IndexPacket
+        * restrict source_indexes;
+
+      IndexPacket
+        * restrict indexes;
+
+      long
+        n,
+        y;
+
+      MagickBool
+        thread_status;
+
+      thread_status=status;
+      if (thread_status == MagickFail)
+        continue;
+
+      range=&table->ranges[x];
+      contribution=&table->contributions[range->offset];
+      n=range->n;
+
+      p=AcquireImagePixels(source,range->start,0,n,source->rows,exception);
+      if (p == (const PixelPacket *) NULL)
+        thread_status=MagickFail;
+
+      if (thread_status != MagickFail)
+        q=SetImagePixelsEx(destination,x,0,1,destination->rows,exception);
+      if (q == (PixelPacket *) NULL)
+        thread_status=MagickFail;
+
+      if (thread_status != MagickFail)
+        {
+          if (kernel != (const ResizeKernelInfo *) NULL)
+            {
+              /*
+                Vectorized accumulation of all pixels in the column.
+              */
+              if ((destination->matte) || (destination->colorspace == CMYKColorspace))
+                kernel->matte(p,(size_t) n,1,contribution,n,q,destination->rows);
+              else
+                kernel->opaque(p,(size_t) n,1,contribution,n,q,destination->rows);
+            }
+          source_indexes=AccessImmutableIndexes(source);
+          indexes=AccessMutableIndexes(destination);
+          for (y=0; y < (long) destination->rows; y++)
+            {
+              double
+                weight;
+
+              DoublePixelPacket
+                pixel;
+
+              long
+                j;
+
+              register long
+                i;
+
+              if (kernel == (const ResizeKernelInfo *) NULL)
+                {
+                  pixel=zero;
+                  if ((destination->matte) || (destination->colorspace == CMYKColorspace))
+                    {
+                      double
+                        transparency_coeff,
+                        normalize;
+
+                      normalize=0.0;
+                      for (i=0; i < n; i++)
+                        {
+                          j=y*n+i;
+                          weight=contribution[i].weight;
+                          transparency_coeff = weight * (1 - ((double) p[j].opacity/TransparentOpacity));
+                          pixel.red+=transparency_coeff*p[j].red;
+                          pixel.green+=transparency_coeff*p[j].green;
+                          pixel.blue+=transparency_coeff*p[j].blue;
+                          pixel.opacity+=weight*p[j].opacity;
+                          normalize += transparency_coeff;
+                        }
+                      normalize = 1.0 / (AbsoluteValue(normalize) <= MagickEpsilon ? 1.0 : normalize);
+                      pixel.red *= normalize;
+                      pixel.green *= normalize;
+                      pixel.blue *= normalize;
+                      q[y].red=RoundDoubleToQuantum(pixel.red);
+                      q[y].green=RoundDoubleToQuantum(pixel.green);
+                      q[y].blue=RoundDoubleToQuantum(pixel.blue);
+                      q[y].opacity=RoundDoubleToQuantum(pixel.opacity);
+                    }
+                  else
+                    {
+                      for (i=0; i < n; i++)
+                        {
+                          j=y*n+i;
+                          weight=contribution[i].weight;
+                          pixel.red+=weight*p[j].red;
+                          pixel.green+=weight*p[j].green;
+                          pixel.blue+=weight*p[j].blue;
+                        }
+                      q[y].red=RoundDoubleToQuantum(pixel.red);
+                      q[y].green=RoundDoubleToQuantum(pixel.green);
+                      q[y].blue=RoundDoubleToQuantum(pixel.blue);
+                      q[y].opacity=OpaqueOpacity;
+                    }
+                }
+
+              if ((indexes != (IndexPacket *) NULL) &&
+                  (source_indexes != (IndexPacket *) NULL))
+                {
+                  j=y*n+(range->nearest-range->start);
+                  indexes[y]=source_indexes[j];
+                }
+            }
+          if (!SyncImagePixelsEx(destination,exception))
+            thread_status=MagickFail;
+        }
+
+      if (monitor_active)
+        {
+          unsigned long
+            thread_quantum;
+
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (quantum)
+#endif
+          thread_quantum=quantum;
+          if (QuantumTick(thread_quantum,span))
+            if (!MagickMonitorFormatted(thread_quantum,span,exception,
+                                        ResizeImageText,source->filename))
+              thread_status=MagickFail;
+
+#if defined(HAVE_OPENMP)
+#  pragma omp atomic
+#endif
+          quantum++;
+        }
+
+      if (thread_status == MagickFail)
+        {
+          status=MagickFail;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (status)
+#endif
+        }
+    }
+
+  if (IsEventLogging())
+    (void) LogMagickEvent(TransformEvent,GetMagickModule(),
+                          "%s exit Horizontal Filter",
+                          (status == MagickFail ? "Error" : "Normal"));
 
   *quantum_p = quantum;
 
@@ -1080,15 +2005,10 @@ HorizontalFilter(const Image * restrict source,Image * restrict destination,
 
 static MagickPassFail
 VerticalFilter(const Image * restrict source,Image * restrict destination,
-               const double y_factor,const FilterInfo * restrict filter_info,
-               const double blur,ThreadViewDataSet *view_data_set,
-               const size_t span,unsigned long * restrict quantum_p,
-               ExceptionInfo *exception)
+               const ContributionTable * restrict table,
+               const ResizeKernelInfo *kernel,const size_t span,
+               unsigned long * restrict quantum_p,ExceptionInfo *exception)
 {
-  double
-    scale,
-    support;
-
   DoublePixelPacket
     zero;
 
@@ -1110,27 +2030,16 @@ VerticalFilter(const Image * restrict source,Image * restrict destination,
                           "(y_factor %g, blur %g, span %"MAGICK_SIZE_T_F"u) ...",
                           source->columns, source->rows,
                           destination->columns, destination->rows,
-                          y_factor, blur, (MAGICK_SIZE_T) span);
+                          table->factor, table->blur, (MAGICK_SIZE_T) span);
 
   quantum = *quantum_p;
 
   /*
     Apply filter to resize vertically from source to destination.
   */
-  scale=blur*Max(1.0/y_factor,1.0);
-  support=scale*filter_info->support;
   destination->storage_class=source->storage_class;
-  if (support > 0.5)
+  if (!table->point_sampling)
     destination->storage_class=DirectClass;
-  else
-    {
-      /*
-        Reduce to point sampling.
-      */
-      support=0.5+MagickEpsilon;
-      scale=1.0;
-    }
-  scale=1.0/scale;
   (void) memset(&zero,0,sizeof(DoublePixelPacket));
 
   monitor_active=MagickMonitorActive();
@@ -1148,13 +2057,12 @@ VerticalFilter(const Image * restrict source,Image * restrict destination,
 #endif
   for (y=0; y < (long) destination->rows; y++)
     {
-      double
-        center,
-        density;
-
-      ContributionInfo
+      const ContributionInfo
         * restrict contribution;
 
+      const ContributionRange
+        * restrict range;
+
       register const PixelPacket
         * restrict p;
 
@@ -1169,8 +2077,6 @@ VerticalFilter(const Image * restrict source,Image * restrict destination,
 
       long
         n,
-        start,
-        stop,
         x;
 
       MagickBool
@@ -1180,34 +2086,11 @@ VerticalFilter(const Image * restrict source,Image * restrict destination,
       if (thread_status == MagickFail)
         continue;
 
-      contribution=AccessThreadViewData(view_data_set);
-      center=(double) (y+0.5)/y_factor;
-      start=(long) Max(center-support+0.5,0);
-      stop=(long) Min(center+support+0.5,source->rows);
-      density=0.0;
-      for (n=0; n < (stop-start); n++)
-        {
-          contribution[n].pixel=start+n;
-          contribution[n].weight=
-            filter_info->function(scale*((double) start+n-center+0.5),filter_info->support);
-          density+=contribution[n].weight;
-        }
-      if ((density != 0.0) && (density != 1.0))
-        {
-          /*
-            Normalize.
-          */
-          long
-            i;
-
-          density=1.0/density;
-          for (i=0; i < n; i++)
-            contribution[i].weight*=density;
-        }
+      range=&table->ranges[y];
+      contribution=&table->contributions[range->offset];
+      n=range->n;
 
-      p=AcquireImagePixels(source,0,contribution[0].pixel,source->columns,
-                           contribution[n-1].pixel-contribution[0].pixel+1,
-                           exception);
+      p=AcquireImagePixels(source,0,range->start,source->columns,n,exception);
       if (p == (const PixelPacket *) NULL)
         thread_status=MagickFail;
 
@@ -1218,6 +2101,16 @@ VerticalFilter(const Image * restrict source,Image * restrict destination,
 
       if (thread_status != MagickFail)
         {
+          if (kernel != (const ResizeKernelInfo *) NULL)
+            {
+              /*
+                Vectorized accumulation of all pixels in the row.
+              */
+              if ((source->matte) || (source->colorspace == CMYKColorspace))
+                kernel->matte(p,1,(size_t) source->columns,contribution,n,q,destination->columns);
+              else
+                kernel->opaque(p,1,(size_t) source->columns,contribution,n,q,destination->columns);
+            }
           source_indexes=AccessImmutableIndexes(source);
           indexes=AccessMutableIndexes(destination);
           for (x=0; x < (long) destination->columns; x++)
@@ -1234,59 +2127,58 @@ VerticalFilter(const Image * restrict source,Image * restrict destination,
               register long
                 i;
 
-              pixel=zero;
-              if ((source->matte) || (source->colorspace == CMYKColorspace))
+              if (kernel == (const ResizeKernelInfo *) NULL)
                 {
-                  double
-                    transparency_coeff,
-                    normalize;
-
-                  normalize=0.0;
-                  for (i=0; i < n; i++)
+                  pixel=zero;
+                  if ((source->matte) || (source->colorspace == CMYKColorspace))
                     {
-                      j=(long) ((contribution[i].pixel-contribution[0].pixel)*
-                                source->columns+x);
-                      weight=contribution[i].weight;
-                      transparency_coeff = weight * (1 - ((double) p[j].opacity/TransparentOpacity));
-                      pixel.red+=transparency_coeff*p[j].red;
-                      pixel.green+=transparency_coeff*p[j].green;
-                      pixel.blue+=transparency_coeff*p[j].blue;
-                      pixel.opacity+=weight*p[j].opacity;
-                      normalize += transparency_coeff;
-                    }
+                      double
+                        transparency_coeff,
+                        normalize;
 
-                  normalize = 1.0 / (AbsoluteValue(normalize) <= MagickEpsilon ? 1.0 : normalize);
-                  pixel.red *= normalize;
-                  pixel.green *= normalize;
-                  pixel.blue *= normalize;
-                  q[x].red=RoundDoubleToQuantum(pixel.red);
-                  q[x].green=RoundDoubleToQuantum(pixel.green);
-                  q[x].blue=RoundDoubleToQuantum(pixel.blue);
-                  q[x].opacity=RoundDoubleToQuantum(pixel.opacity);
-                }
-              else
-                {
-                  for (i=0; i < n; i++)
+                      normalize=0.0;
+                      for (i=0; i < n; i++)
+                        {
+                          j=(long) (i*source->columns+x);
+                          weight=contribution[i].weight;
+                          transparency_coeff = weight * (1 - ((double) p[j].opacity/TransparentOpacity));
+                          pixel.red+=transparency_coeff*p[j].red;
+                          pixel.green+=transparency_coeff*p[j].green;
+                          pixel.blue+=transparency_coeff*p[j].blue;
+                          pixel.opacity+=weight*p[j].opacity;
+                          normalize += transparency_coeff;
+                        }
+
+                      normalize = 1.0 / (AbsoluteValue(normalize) <= MagickEpsilon ? 1.0 : normalize);
+                      pixel.red *= normalize;
+                      pixel.green *= normalize;
+                      pixel.blue *= normalize;
+                      q[x].red=RoundDoubleToQuantum(pixel.red);
+                      q[x].green=RoundDoubleToQuantum(pixel.green);
+                      q[x].blue=RoundDoubleToQuantum(pixel.blue);
+                      q[x].opacity=RoundDoubleToQuantum(pixel.opacity);
+                    }
+                  else
                     {
-                      j=(long) ((contribution[i].pixel-contribution[0].pixel)*
-                                source->columns+x);
-                      weight=contribution[i].weight;
-                      pixel.red+=weight*p[j].red;
-                      pixel.green+=weight*p[j].green;
-                      pixel.blue+=weight*p[j].blue;
+                      for (i=0; i < n; i++)
+                        {
+                          j=(long) (i*source->columns+x);
+                          weight=contribution[i].weight;
+                          pixel.red+=weight*p[j].red;
+                          pixel.green+=weight*p[j].green;
+                          pixel.blue+=weight*p[j].blue;
+                        }
+                      q[x].red=RoundDoubleToQuantum(pixel.red);
+                      q[x].green=RoundDoubleToQuantum(pixel.green);
+                      q[x].blue=RoundDoubleToQuantum(pixel.blue);
+                      q[x].opacity=OpaqueOpacity;
                     }
-                  q[x].red=RoundDoubleToQuantum(pixel.red);
-                  q[x].green=RoundDoubleToQuantum(pixel.green);
-                  q[x].blue=RoundDoubleToQuantum(pixel.blue);
-                  q[x].opacity=OpaqueOpacity;
                 }
 
               if ((indexes != (IndexPacket *) NULL) &&
                   (source_indexes != (IndexPacket *) NULL))
                 {
-                  i=Min(Max((long) (center+0.5),start),stop-1);
-                  j=(long) ((contribution[i-start].pixel-contribution[0].pixel)*
-                            source->columns+x);
+                  j=(long) ((range->nearest-range->start)*source->columns+x);
                   indexes[x]=source_indexes[j];
                 }
             }
@@ -1334,25 +2226,230 @@ VerticalFilter(const Image * restrict source,Image * restrict destination,
   return (status);
 }
 
+/*
+  Resize pass for images which use FloatPixelFormat.  The same
+  contribution tables as the quantum passes are used, but pixels are
+  accumulated and stored as float without rounding or clamping so that
+  filter overshoot (e.g. Lanczos ringing) and values outside of the
+  quantum range are retained.  If 'vertical' is set, the pass resizes
+  rows, otherwise columns.
+*/
+static MagickPassFail
+FloatFilter(const Image * restrict source,Image * restrict destination,
+            const ContributionTable * restrict table,const MagickBool vertical,
+            const size_t span,unsigned long * restrict quantum_p,
+            ExceptionInfo *exception)
+{
+  ThreadViewDataSet
+    *source_set,
+    *result_set;
+
+  long
+    count,
+    max_n,
+    x;
+
+  unsigned long
+    length,
+    quantum;
+
+  MagickBool
+    matte,
+    monitor_active;
+
+  MagickPassFail
+    status=MagickPass;
+
+  if (IsEventLogging())
+    (void) LogMagickEvent(TransformEvent,GetMagickModule(),
+                          "%s Float Filter: %lux%lu => %lux%lu "
+                          "(factor %g, blur %g, span %"MAGICK_SIZE_T_F"u) ...",
+                          vertical ? "Vertical" : "Horizontal",
+                          source->columns, source->rows,
+                          destination->columns, destination->rows,
+                          table->factor, table->blur, (MAGICK_SIZE_T) span);
+
+  quantum = *quantum_p;
+  destination->storage_class=DirectClass;
+  matte=destination->matte;
+  count=(long) (vertical ? destination->rows : destination->columns);
+  length=(vertical ? source->columns : source->rows);
+  max_n=1;
+  for (x=0; x < count; x++)
+    max_n=Max(max_n,table->ranges[x].n);
+  source_set=AllocateThreadViewDataArray(source,exception,
+                                         (size_t) max_n*length,
+                                         sizeof(FloatPixelPacket));
+  result_set=AllocateThreadViewDataArray(source,exception,length,
+                                         sizeof(FloatPixelPacket));
+  if ((source_set == (ThreadViewDataSet *) NULL) ||
+      (result_set == (ThreadViewDataSet *) NULL))
+    {
+      DestroyThreadViewDataSet(source_set);
+      DestroyThreadViewDataSet(result_set);
+      return MagickFail;
+    }
+
+  monitor_active=MagickMonitorActive();
+
+#if defined(HAVE_OPENMP)
+#  if defined(TUNE_OPENMP)
+#    pragma omp parallel for schedule(runtime) shared(status, quantum)
+#  else
+#    pragma omp parallel for schedule(guided) shared(status, quantum)
+#  endif
+#endif
+  for (x=0; x < count; x++)
+    {
+      const ContributionInfo
+        * restrict contribution;
+
+      const ContributionRange
+        * restrict range;
+
+      FloatPixelPacket
+        * restrict p,
+        * restrict q;
+
+      long
+        n,
+        y;
+
+      MagickBool
+        thread_status;
+
+      thread_status=status;
+      if (thread_status == MagickFail)
+        continue;
+
+      range=&table->ranges[x];
+      contribution=&table->contributions[range->offset];
+      n=range->n;
+      p=AccessThreadViewData(source_set);
+      q=AccessThreadViewData(result_set);
+
+      if (vertical)
+        thread_status=AcquireImageFloatPixels(source,0,range->start,
+                                              length,n,p,exception);
+      else
+        thread_status=AcquireImageFloatPixels(source,range->start,0,
+                                              n,length,p,exception);
+
+      if (thread_status != MagickFail)
+        {
+          for (y=0; y < (long) length; y++)
+            {
+              double
+                normalize,
+                transparency_coeff,
+                weight;
+
+              DoublePixelPacket
+                pixel;
+
+              long
+                j;
+
+              register long
+                i;
+
+              pixel.red=pixel.green=pixel.blue=pixel.opacity=0.0;
+              normalize=0.0;
+              for (i=0; i < n; i++)
+                {
+                  j=(vertical ? i*(long) length+y : y*n+i);
+                  weight=contribution[i].weight;
+                  transparency_coeff=weight;
+                  if (matte)
+                    transparency_coeff*=(1.0-((double) p[j].opacity/
+                                              TransparentOpacity));
+                  pixel.red+=transparency_coeff*p[j].red;
+                  pixel.green+=transparency_coeff*p[j].green;
+                  pixel.blue+=transparency_coeff*p[j].blue;
+                  pixel.opacity+=weight*p[j].opacity;
+                  normalize+=transparency_coeff;
+                }
+              if (matte)
+                {
+                  normalize=1.0/(AbsoluteValue(normalize) <= MagickEpsilon ?
+                                 1.0 : normalize);
+                  pixel.red*=normalize;
+                  pixel.green*=normalize;
+                  pixel.blue*=normalize;
+                }
+              else
+                {
+                  pixel.opacity=OpaqueOpacity;
+                }
+              q[y].red=(float) pixel.red;
+              q[y].green=(float) pixel.green;
+              q[y].blue=(float) pixel.blue;
+              q[y].opacity=(float) pixel.opacity;
+            }
+          if (vertical)
+            thread_status=StoreImageFloatPixels(destination,0,x,length,1,q,
+                                                exception);
+          else
+            thread_status=StoreImageFloatPixels(destination,x,0,1,length,q,
+                                                exception);
+        }
+
+      if (monitor_active)
+        {
+          unsigned long
+            thread_quantum;
+
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (quantum)
+#endif
+          thread_quantum=quantum;
+          if (QuantumTick(thread_quantum,span))
+            if (!MagickMonitorFormatted(thread_quantum,span,exception,
+                                        ResizeImageText,source->filename))
+              thread_status=MagickFail;
+
+#if defined(HAVE_OPENMP)
+#  pragma omp atomic
+#endif
+          quantum++;
+        }
+
+      if (thread_status == MagickFail)
+        {
+          status=MagickFail;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (status)
+#endif
+        }
+    }
+  DestroyThreadViewDataSet(source_set);
+  DestroyThreadViewDataSet(result_set);
+
+  *quantum_p = quantum;
+
+  return (status);
+}
+
 MagickExport Image *ResizeImage(const Image *image,const unsigned long columns,
                                 const unsigned long rows,const FilterTypes filter,
                                 const double blur,
                                 ExceptionInfo *exception)
 {
-  ThreadViewDataSet
-    *view_data_set;
+  ContributionTable
+    *x_table,
+    *y_table;
 
   double
-    support,
     x_factor,
-    x_support,
-    y_factor,
-    y_support;
+    y_factor;
 
   Image
     *source_image,
     *resize_image;
 
+  const ResizeKernelInfo
+    *kernel;
+
   register long
     i;
 
@@ -1387,6 +2484,7 @@ MagickExport Image *ResizeImage(const Image *image,const unsigned long columns,
     quantum;
 
   MagickBool
+    float_pixels,
     order;
 
   /*
@@ -1441,55 +2539,83 @@ MagickExport Image *ResizeImage(const Image *image,const unsigned long columns,
                           image->columns,image->rows,columns,rows,
                           ResizeFilterToString((FilterTypes)i));
 
-  x_support=blur*Max(1.0/x_factor,1.0)*filters[i].support;
-  y_support=blur*Max(1.0/y_factor,1.0)*filters[i].support;
-  support=Max(x_support,y_support);
-  if (support < filters[i].support)
-    support=filters[i].support;
   /*
-    Allocate view data set.
+    Acquire filter contribution tables.
   */
-  view_data_set=AllocateThreadViewDataArray(image,exception,
-                                            (size_t) (2.0*Max(support,0.5)+3),
-                                            sizeof(ContributionInfo));
-  if (view_data_set == (ThreadViewDataSet *) NULL)
+  x_table=AcquireContributionTable(image->columns,columns,(FilterTypes) i,
+                                   &filters[i],blur,exception);
+  y_table=AcquireContributionTable(image->rows,rows,(FilterTypes) i,
+                                   &filters[i],blur,exception);
+  if ((x_table == (ContributionTable *) NULL) ||
+      (y_table == (ContributionTable *) NULL))
     {
+      if (x_table != (ContributionTable *) NULL)
+        ReleaseContributionTable(x_table);
+      if (y_table != (ContributionTable *) NULL)
+        ReleaseContributionTable(y_table);
       DestroyImage(resize_image);
       DestroyImage(source_image);
-      ThrowImageException3(ResourceLimitError,MemoryAllocationFailed,
-                           UnableToResizeImage);
+      return ((Image *) NULL);
     }
   /*
     Resize image.
   */
   status=MagickPass;
   quantum=0;
+  kernel=SelectResizeKernel();
+  float_pixels=((image->colorspace != CMYKColorspace) &&
+                (GetImagePixelFormat(image) == FloatPixelFormat));
   if (IsEventLogging())
     (void) LogMagickEvent(TransformEvent,GetMagickModule(),
-                          "Resize filter order: %s",
-                          order ? "Horizontal/Vertical" : "Vertical/Horizontal");
-  if (order)
+                          "Resize filter order: %s, %s kernel",
+                          order ? "Horizontal/Vertical" : "Vertical/Horizontal",
+                          float_pixels ? "float" :
+                          kernel != (const ResizeKernelInfo *) NULL ?
+                          kernel->name : "scalar");
+  if (float_pixels)
+    {
+      if (order)
+        {
+          span=(size_t) source_image->columns+resize_image->rows;
+          status=FloatFilter(image,source_image,x_table,MagickFalse,span,
+                             &quantum,exception);
+          if (status != MagickFail)
+            status=FloatFilter(source_image,resize_image,y_table,MagickTrue,
+                               span,&quantum,exception);
+        }
+      else
+        {
+          span=(size_t) resize_image->columns+source_image->rows;
+          status=FloatFilter(image,source_image,y_table,MagickTrue,span,
+                             &quantum,exception);
+          if (status != MagickFail)
+            status=FloatFilter(source_image,resize_image,x_table,MagickFalse,
+                               span,&quantum,exception);
+        }
+    }
+  else if (order)
     {
       span=(size_t) source_image->columns+resize_image->rows;
-      status=HorizontalFilter(image,source_image,x_factor,&filters[i],blur,
-                              view_data_set,span,&quantum,exception);
+      status=HorizontalFilter(image,source_image,x_table,kernel,span,
+                              &quantum,exception);
       if (status != MagickFail)
-        status=VerticalFilter(source_image,resize_image,y_factor,&filters[i],
-                              blur,view_data_set,span,&quantum,exception);
+        status=VerticalFilter(source_image,resize_image,y_table,kernel,span,
+                              &quantum,exception);
     }
   else
     {
       span=(size_t) resize_image->columns+source_image->rows;
-      status=VerticalFilter(image,source_image,y_factor,&filters[i],blur,
-                            view_data_set,span,&quantum,exception);
+      status=VerticalFilter(image,source_image,y_table,kernel,span,
+                            &quantum,exception);
       if (status != MagickFail)
-        status=HorizontalFilter(source_image,resize_image,x_factor,&filters[i],
-                                blur,view_data_set,span,&quantum,exception);
+        status=HorizontalFilter(source_image,resize_image,x_table,kernel,span,
+                                &quantum,exception);
     }
   /*
     Free allocated memory.
   */
-  DestroyThreadViewDataSet(view_data_set);
+  ReleaseContributionTable(x_table);
+  ReleaseContributionTable(y_table);
   DestroyImage(source_image);
   if (status == MagickFail)
     {
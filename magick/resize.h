@@ -32,6 +32,10 @@ extern MagickExport Image
   *ZoomImage(const Image *,const unsigned long,const unsigned long,
      ExceptionInfo *);
 
+#if defined(MAGICK_IMPLEMENTATION)
+#  include "magick/resize-private.h"
+#endif /* defined(MAGICK_IMPLEMENTATION) */
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }
 #endif /* defined(__cplusplus) || defined(c_plusplus) */
@@ -39,7 +39,9 @@
   Include declarations.
 */
 #include "magick/studio.h"
+#include "magick/blob.h"
 #include "magick/log.h"
+#include "magick/pixel_cache.h"
 #include "magick/resource.h"
 #include "magick/semaphore.h"
 #include "magick/utility.h"
@@ -50,6 +52,16 @@
 #define ResourceInfinity ((magick_int64_t) (~((magick_uint64_t) 0) >> 1))
 #define ResourceInfoMaxIndex ((unsigned int) (sizeof(resource_info)/sizeof(resource_info[0])-1))
 
+/*
+  Resource consumption is updated with compiler atomic builtins where
+  they are available, so that AcquireMagickResource() and
+  LiberateMagickResource() do not serialize on the resource semaphore.
+  The semaphore is then only used to serialize limit changes.
+*/
+#if defined(__ATOMIC_ACQ_REL)
+#  define MAGICK_RESOURCE_ATOMICS 1
+#endif
+
 /*
   Typedef declarations.
 */
@@ -83,6 +95,18 @@ typedef struct _ResourceInfo
   SemaphoreInfo
     *semaphore;
 
+  /*
+    Usage statistics reported by ListMagickResourceInfo().  The number
+    of retries counts the times an update raced with another thread.
+  */
+  magick_int64_t
+    peak;
+
+  magick_uint64_t
+    acquired,
+    failed,
+    retries;
+
 } ResourceInfo;
 
 /*
@@ -96,16 +120,67 @@ typedef struct _ResourceInfo
 static ResourceInfo
   resource_info[] =
   {
-    { "",       "",  "",                    0, 0,  ResourceInfinity, AbsoluteLimit, 0 },
-    { "disk",   "B", "MAGICK_LIMIT_DISK",   0, 0,  ResourceInfinity, SummationLimit, 0 },
-    { "files",  "",  "MAGICK_LIMIT_FILES",  0, 32, 256,              SummationLimit, 0 },
-    { "map",    "B", "MAGICK_LIMIT_MAP",    0, 0,  ResourceInfinity, SummationLimit, 0 },
-    { "memory", "B", "MAGICK_LIMIT_MEMORY", 0, 0,  ResourceInfinity, SummationLimit, 0 },
-    { "pixels", "P", "MAGICK_LIMIT_PIXELS", 0, 1,  ResourceInfinity, AbsoluteLimit, 0  },
-    { "threads", "", "OMP_NUM_THREADS",     1, 1,  ResourceInfinity, AbsoluteLimit, 0  },
-    { "width",  "P", "MAGICK_LIMIT_WIDTH",  0, 1,  PIXEL_LIMIT,      AbsoluteLimit, 0  },
-    { "height", "P", "MAGICK_LIMIT_HEIGHT", 0, 1,  PIXEL_LIMIT,      AbsoluteLimit, 0  }
+    { "",       "",  "",                    0, 0,  ResourceInfinity, AbsoluteLimit, 0,  0, 0, 0, 0 },
+    { "disk",   "B", "MAGICK_LIMIT_DISK",   0, 0,  ResourceInfinity, SummationLimit, 0, 0, 0, 0, 0 },
+    { "files",  "",  "MAGICK_LIMIT_FILES",  0, 32, 256,              SummationLimit, 0, 0, 0, 0, 0 },
+    { "map",    "B", "MAGICK_LIMIT_MAP",    0, 0,  ResourceInfinity, SummationLimit, 0, 0, 0, 0, 0 },
+    { "memory", "B", "MAGICK_LIMIT_MEMORY", 0, 0,  ResourceInfinity, SummationLimit, 0, 0, 0, 0, 0 },
+    { "pixels", "P", "MAGICK_LIMIT_PIXELS", 0, 1,  ResourceInfinity, AbsoluteLimit, 0,  0, 0, 0, 0 },
+    { "threads", "", "OMP_NUM_THREADS",     1, 1,  ResourceInfinity, AbsoluteLimit, 0,  0, 0, 0, 0 },
+    { "width",  "P", "MAGICK_LIMIT_WIDTH",  0, 1,  PIXEL_LIMIT,      AbsoluteLimit, 0,  0, 0, 0, 0 },
+    { "height", "P", "MAGICK_LIMIT_HEIGHT", 0, 1,  PIXEL_LIMIT,      AbsoluteLimit, 0,  0, 0, 0, 0 }
   };
+
+static inline magick_int64_t
+LoadResourceValue(const magick_int64_t *value)
+{
+#if defined(MAGICK_RESOURCE_ATOMICS)
+  return __atomic_load_n(value,__ATOMIC_RELAXED);
+#else
+  return *value;
+#endif
+}
+
+static inline void
+StoreResourceValue(magick_int64_t *value,const magick_int64_t new_value)
+{
+#if defined(MAGICK_RESOURCE_ATOMICS)
+  __atomic_store_n(value,new_value,__ATOMIC_RELAXED);
+#else
+  *value=new_value;
+#endif
+}
+
+static inline void
+AddResourceStatistic(magick_uint64_t *counter,const magick_uint64_t value)
+{
+#if defined(MAGICK_RESOURCE_ATOMICS)
+  (void) __atomic_fetch_add(counter,value,__ATOMIC_RELAXED);
+#elif defined(HAVE_OPENMP)
+#  pragma omp atomic
+  *counter+=value;
+#else
+  *counter+=value;
+#endif
+}
+
+static inline void
+UpdateResourcePeak(ResourceInfo *info,const magick_int64_t value)
+{
+#if defined(MAGICK_RESOURCE_ATOMICS)
+  magick_int64_t
+    peak;
+
+  peak=__atomic_load_n(&info->peak,__ATOMIC_RELAXED);
+  while ((value > peak) &&
+         !__atomic_compare_exchange_n(&info->peak,&peak,value,MagickTrue,
+                                      __ATOMIC_RELAXED,__ATOMIC_RELAXED))
+    ;
+#else
+  if (value > info->peak)
+    info->peak=value;
+#endif
+}
 
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -174,10 +249,17 @@ AcquireMagickResource(const ResourceType type,
             /*
               Limit depends only on the currently requested size.
             */
+            magick_int64_t
+              maximum;
+
             value=info->value;
-            if ((info->maximum != ResourceInfinity) &&
-                (size > (magick_uint64_t) info->maximum))
-              status=MagickFail;
+            maximum=LoadResourceValue(&info->maximum);
+            if ((maximum != ResourceInfinity) &&
+                (size > (magick_uint64_t) maximum))
+              {
+                AddResourceStatistic(&info->failed,1);
+                status=MagickFail;
+              }
             break;
           }
         case SummationLimit:
@@ -186,6 +268,36 @@ AcquireMagickResource(const ResourceType type,
               Limit depends on sum of previous allocations as well as
               the currently requested size.
             */
+#if defined(MAGICK_RESOURCE_ATOMICS)
+            magick_int64_t
+              current,
+              maximum;
+
+            magick_uint64_t
+              retries=0;
+
+            current=__atomic_load_n(&info->value,__ATOMIC_RELAXED);
+            for ( ; ; )
+              {
+                maximum=__atomic_load_n(&info->maximum,__ATOMIC_RELAXED);
+                value=current+size;
+                if ((maximum != ResourceInfinity) &&
+                    (value > (magick_uint64_t) maximum))
+                  {
+                    value=current;
+                    status=MagickFail;
+                    break;
+                  }
+                if (__atomic_compare_exchange_n(&info->value,&current,
+                                                (magick_int64_t) value,
+                                                MagickTrue,__ATOMIC_ACQ_REL,
+                                                __ATOMIC_RELAXED))
+                  break;
+                retries++;
+              }
+            if (retries != 0)
+              AddResourceStatistic(&info->retries,retries);
+#else
             LockSemaphoreInfo(info->semaphore);
             value=info->value+size;
             if ((info->maximum != ResourceInfinity) &&
@@ -198,7 +310,19 @@ AcquireMagickResource(const ResourceType type,
               {
                 info->value=value;
               }
+#endif
+            if (status == MagickPass)
+              {
+                AddResourceStatistic(&info->acquired,1);
+                UpdateResourcePeak(info,(magick_int64_t) value);
+              }
+            else
+              {
+                AddResourceStatistic(&info->failed,1);
+              }
+#if !defined(MAGICK_RESOURCE_ATOMICS)
             UnlockSemaphoreInfo(info->semaphore);
+#endif
             break;
           }
         }
@@ -329,9 +453,13 @@ MagickExport magick_int64_t GetMagickResource(const ResourceType type)
 
   if ((info=GetResourceInfo(type)))
     {
+#if defined(MAGICK_RESOURCE_ATOMICS)
+      resource=LoadResourceValue(&info->value);
+#else
       LockSemaphoreInfo(info->semaphore);
       resource=info->value;
       UnlockSemaphoreInfo(info->semaphore);
+#endif
     }
 
   return(resource);
@@ -374,9 +502,13 @@ MagickExport magick_int64_t GetMagickResourceLimit(const ResourceType type)
 
   if ((info=GetResourceInfo(type)))
     {
+#if defined(MAGICK_RESOURCE_ATOMICS)
+      resource=LoadResourceValue(&info->maximum);
+#else
       LockSemaphoreInfo(info->semaphore);
       resource=info->maximum;
       UnlockSemaphoreInfo(info->semaphore);
+#endif
     }
 
   return(resource);
@@ -767,13 +899,19 @@ MagickExport void LiberateMagickResource(const ResourceType type,
               Limit depends on sum of previous allocations as well as
               the currently requested size.
             */
+#if defined(MAGICK_RESOURCE_ATOMICS)
+            value=(magick_uint64_t)
+              __atomic_sub_fetch(&info->value,(magick_int64_t) size,
+                                 __ATOMIC_ACQ_REL);
+#else
             LockSemaphoreInfo(info->semaphore);
             info->value-=size;
-#if defined(DEBUG_MAGICK_RESOURCES) && DEBUG_MAGICK_RESOURCES
-            assert(info->value >= info->minimum);
-#endif /* if defined(DEBUG_MAGICK_RESOURCES) && DEBUG_MAGICK_RESOURCES */
             value=info->value;
             UnlockSemaphoreInfo(info->semaphore);
+#endif
+#if defined(DEBUG_MAGICK_RESOURCES) && DEBUG_MAGICK_RESOURCES
+            assert((magick_int64_t) value >= info->minimum);
+#endif /* if defined(DEBUG_MAGICK_RESOURCES) && DEBUG_MAGICK_RESOURCES */
             break;
           }
         }
@@ -830,7 +968,11 @@ MagickExport void LiberateMagickResource(const ResourceType type,
 %                                                                             %
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %
-%  Method ListMagickResourceInfo lists the resource info to a file.
+%  Method ListMagickResourceInfo lists the resource info to a file.  Once
+%  resources have been consumed, the current and peak consumption, the
+%  number of successful and failed acquisitions, and the number of times
+%  an update had to be retried due to a concurrent update from another
+%  thread are listed as well.
 %
 %  The format of the ListMagickResourceInfo method is:
 %
@@ -850,8 +992,6 @@ MagickExport MagickPassFail ListMagickResourceInfo(FILE *file,
   unsigned int
     index;
 
-  ARG_NOT_USED(exception);
-
   if (file == (const FILE *) NULL)
     file=stdout;
 
@@ -884,6 +1024,91 @@ MagickExport MagickPassFail ListMagickResourceInfo(FILE *file,
       fprintf(file,"%8s: %10s (%s)\n", heading, limit, environment);
       UnlockSemaphoreInfo(resource_info[index].semaphore);
     }
+  {
+    MagickBool
+      used=MagickFalse;
+
+    for (index=1 ; index <= ResourceInfoMaxIndex; index++)
+      if ((resource_info[index].acquired != 0) ||
+          (resource_info[index].failed != 0))
+        used=MagickTrue;
+    if (used)
+      {
+        fprintf(file,"\nResource Usage (%s)\n",
+#if defined(MAGICK_RESOURCE_ATOMICS)
+                "lock-free"
+#else
+                "locked"
+#endif
+                );
+        fprintf(file,"----------------------------------------------------\n");
+        fprintf(file,"%9s %10s %10s %10s %8s %8s\n","","Current","Peak",
+                "Acquired","Failed","Retries");
+        for (index=1 ; index <= ResourceInfoMaxIndex; index++)
+          {
+            char
+              current[MaxTextExtent],
+              heading[MaxTextExtent],
+              peak[MaxTextExtent];
+
+            const ResourceInfo
+              *info=&resource_info[index];
+
+            if ((info->acquired == 0) && (info->failed == 0))
+              continue;
+            FormatString(heading,"%c%s",toupper((int) info->name[0]),
+                         info->name+1);
+            if (info->limit_type == SummationLimit)
+              {
+                FormatSize(LoadResourceValue(&info->value),current);
+                strlcat(current,info->units,sizeof(current));
+                FormatSize(LoadResourceValue(&info->peak),peak);
+                strlcat(peak,info->units,sizeof(peak));
+              }
+            else
+              {
+                strlcpy(current,"----",sizeof(current));
+                strlcpy(peak,"----",sizeof(peak));
+              }
+            fprintf(file,"%8s: %10s %10s %10" MAGICK_UINT64_F "u %8"
+                    MAGICK_UINT64_F "u %8" MAGICK_UINT64_F "u\n",
+                    heading,current,peak,info->acquired,info->failed,
+                    info->retries);
+          }
+      }
+  }
+  {
+    PixelCacheIOStatistics
+      statistics;
+
+    GetPixelCacheIOStatistics(&statistics);
+    if ((statistics.read_requests != 0) || (statistics.write_requests != 0) ||
+        (statistics.tile_hits != 0) || (statistics.tile_misses != 0))
+      {
+        char
+          bytes_read[MaxTextExtent],
+          bytes_written[MaxTextExtent];
+
+        FormatSize((magick_int64_t) statistics.bytes_read,bytes_read);
+        FormatSize((magick_int64_t) statistics.bytes_written,bytes_written);
+        fprintf(file,"\nPixel Cache Disk I/O\n");
+        fprintf(file,"----------------------------------------------------\n");
+        fprintf(file,"   Reads: %" MAGICK_UINT64_F "u requested, %"
+                MAGICK_UINT64_F "u buffered, %" MAGICK_UINT64_F
+                "u system calls, %sB\n",
+                statistics.read_requests,statistics.read_hits,
+                statistics.reads,bytes_read);
+        fprintf(file,"  Writes: %" MAGICK_UINT64_F "u requested, %"
+                MAGICK_UINT64_F "u coalesced, %" MAGICK_UINT64_F
+                "u system calls, %sB\n",
+                statistics.write_requests,statistics.writes_coalesced,
+                statistics.writes,bytes_written);
+        fprintf(file,"   Tiles: %" MAGICK_UINT64_F "u hits, %"
+                MAGICK_UINT64_F "u misses\n",
+                statistics.tile_hits,statistics.tile_misses);
+      }
+  }
+  (void) ListBlobSpillInfo(file,exception);
   fprintf(file,
           "\n"
           "  IEC Binary Ranges:\n"
@@ -956,7 +1181,7 @@ MagickExport MagickPassFail SetMagickResourceLimit(const ResourceType type,
 
 
           FormatSize((magick_int64_t) limit, f_limit);
-          info->maximum = limit;
+          StoreResourceValue(&info->maximum,limit);
 #if defined(HAVE_OPENMP)
           if (ThreadsResource == type)
             omp_set_num_threads((int) limit);
@@ -46,6 +46,384 @@
   Define declarations.
 */
 #define Trunc32(x)  ((x) & 0xffffffffUL)
+
+/*
+  The SHA-256 block transform uses the x86 SHA extensions when the CPU
+  supports them.
+*/
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && \
+  !defined(__STRICT_ANSI__) && (defined(__clang__) || (__GNUC__ >= 5))
+#  define SIGNATURE_SHA_KERNEL 1
+#  define SIGNATURE_SHA_FUNC MAGICK_ATTRIBUTE((__target__("sha,sse4.1")))
+#  include <cpuid.h>
+#  include <immintrin.h>
+#endif
+
+/*
+  Number of rows serialized concurrently before they are passed to the
+  (sequential) legacy signature.
+*/
+#define SignatureBatchRows 64
+
+/*
+  Number of rows hashed into each leaf of the tree signature.
+*/
+#define SignatureLeafRows 64
+
+/*
+  Largest number of bytes which a pixel contributes to the message.
+*/
+#define SignaturePixelSize 20
+
+/*
+  Image signature methods.  The legacy method is the digest computed by
+  all earlier releases.  The tree method hashes bands of rows
+  independently (so that they may be hashed concurrently), and then
+  hashes the band digests.
+*/
+typedef enum
+{
+  LegacySignatureMethod = 1,
+  TreeSignatureMethod
+} SignatureMethod;
+
+/*
+  Transform a sequence of 64 byte message blocks into the SHA-256 state.
+*/
+typedef void (*SignatureBlocksFunc)(magick_uint32_t *state,
+  const unsigned char *blocks,size_t count);
+
+/*
+  Standard SHA-256 context used for the tree signature.  SignatureInfo
+  is not used since UpdateSignature() must continue to produce the
+  legacy digest.
+*/
+typedef struct _SHA256Info
+{
+  magick_uint32_t
+    state[8];
+
+  magick_uint64_t
+    length;
+
+  size_t
+    offset;
+
+  unsigned char
+    buffer[SignatureSize];
+} SHA256Info;
+
+static const magick_uint32_t
+  SignatureK[64] =
+  {
+    0x428a2f98U, 0x71374491U, 0xb5c0fbcfU, 0xe9b5dba5U, 0x3956c25bU,
+    0x59f111f1U, 0x923f82a4U, 0xab1c5ed5U, 0xd807aa98U, 0x12835b01U,
+    0x243185beU, 0x550c7dc3U, 0x72be5d74U, 0x80deb1feU, 0x9bdc06a7U,
+    0xc19bf174U, 0xe49b69c1U, 0xefbe4786U, 0x0fc19dc6U, 0x240ca1ccU,
+    0x2de92c6fU, 0x4a7484aaU, 0x5cb0a9dcU, 0x76f988daU, 0x983e5152U,
+    0xa831c66dU, 0xb00327c8U, 0xbf597fc7U, 0xc6e00bf3U, 0xd5a79147U,
+    0x06ca6351U, 0x14292967U, 0x27b70a85U, 0x2e1b2138U, 0x4d2c6dfcU,
+    0x53380d13U, 0x650a7354U, 0x766a0abbU, 0x81c2c92eU, 0x92722c85U,
+    0xa2bfe8a1U, 0xa81a664bU, 0xc24b8b70U, 0xc76c51a3U, 0xd192e819U,
+    0xd6990624U, 0xf40e3585U, 0x106aa070U, 0x19a4c116U, 0x1e376c08U,
+    0x2748774cU, 0x34b0bcb5U, 0x391c0cb3U, 0x4ed8aa4aU, 0x5b9cca4fU,
+    0x682e6ff3U, 0x748f82eeU, 0x78a5636fU, 0x84c87814U, 0x8cc70208U,
+    0x90befffaU, 0xa4506cebU, 0xbef9a3f7U, 0xc67178f2U
+  };  /* 32-bit fractional part of the cube root of the first 64 primes */
+
+static const magick_uint32_t
+  SignatureH[8] =
+  {
+    0x6a09e667U, 0xbb67ae85U, 0x3c6ef372U, 0xa54ff53aU, 0x510e527fU,
+    0x9b05688cU, 0x1f83d9abU, 0x5be0cd19U
+  };
+
+/*
+  Portable SHA-256 block transform.
+*/
+static void
+SignatureBlocksScalar(magick_uint32_t *state,const unsigned char *blocks,
+  size_t count)
+{
+#define Ch(x,y,z)  (((x) & (y))^(~(x) & (z)))
+#define Maj(x,y,z)  (((x) & (y))^((x) & (z))^((y) & (z)))
+#define Rot32(x,n)  (((x) >> (n)) | ((x) << (32-(n))))
+#define Sigma0(x)  (Rot32(x,7)^Rot32(x,18)^((x) >> 3))
+#define Sigma1(x)  (Rot32(x,17)^Rot32(x,19)^((x) >> 10))
+#define Suma0(x)  (Rot32(x,2)^Rot32(x,13)^Rot32(x,22))
+#define Suma1(x)  (Rot32(x,6)^Rot32(x,11)^Rot32(x,25))
+
+  register long
+    i;
+
+  magick_uint32_t
+    A,
+    B,
+    C,
+    D,
+    E,
+    F,
+    G,
+    H,
+    T1,
+    T2,
+    W[64];
+
+  for ( ; count != 0; count--)
+  {
+    for (i=0; i < 16; i++)
+    {
+      W[i]=((magick_uint32_t) blocks[0] << 24) |
+        ((magick_uint32_t) blocks[1] << 16) |
+        ((magick_uint32_t) blocks[2] << 8) | (magick_uint32_t) blocks[3];
+      blocks+=4;
+    }
+    for (i=16; i < 64; i++)
+      W[i]=Sigma1(W[i-2])+W[i-7]+Sigma0(W[i-15])+W[i-16];
+    A=state[0];
+    B=state[1];
+    C=state[2];
+    D=state[3];
+    E=state[4];
+    F=state[5];
+    G=state[6];
+    H=state[7];
+    for (i=0; i < 64; i++)
+    {
+      T1=H+Suma1(E)+Ch(E,F,G)+SignatureK[i]+W[i];
+      T2=Suma0(A)+Maj(A,B,C);
+      H=G;
+      G=F;
+      F=E;
+      E=D+T1;
+      D=C;
+      C=B;
+      B=A;
+      A=T1+T2;
+    }
+    state[0]+=A;
+    state[1]+=B;
+    state[2]+=C;
+    state[3]+=D;
+    state[4]+=E;
+    state[5]+=F;
+    state[6]+=G;
+    state[7]+=H;
+  }
+}
+
+#if defined(SIGNATURE_SHA_KERNEL)
+/*
+  SHA-256 block transform using the SHA extensions.  The extensions
+  keep the state in two registers as ABEF and CDGH, and perform two
+  rounds, and a quarter of the message schedule, per instruction.
+*/
+static SIGNATURE_SHA_FUNC void
+SignatureBlocksSHA(magick_uint32_t *state,const unsigned char *blocks,
+  size_t count)
+{
+  register long
+    i;
+
+  __m128i
+    abef,
+    abef_save,
+    cdgh,
+    cdgh_save,
+    m[4],
+    mask,
+    message,
+    t;
+
+  mask=_mm_set_epi64x(0x0c0d0e0f08090a0bLL,0x0405060700010203LL);
+  t=_mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[0]),0xb1);
+  cdgh=_mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[4]),0x1b);
+  abef=_mm_alignr_epi8(t,cdgh,8);
+  cdgh=_mm_blend_epi16(cdgh,t,0xf0);
+  for ( ; count != 0; count--)
+  {
+    abef_save=abef;
+    cdgh_save=cdgh;
+    for (i=0; i < 4; i++)
+      m[i]=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (blocks+16*i)),
+                            mask);
+    for (i=0; i < 16; i++)
+    {
+      if (i >= 4)
+        {
+          /*
+            W[4i..4i+3] from W[4i-16..4i-1].
+          */
+          t=_mm_sha256msg1_epu32(m[i & 3],m[(i+1) & 3]);
+          t=_mm_add_epi32(t,_mm_alignr_epi8(m[(i+3) & 3],m[(i+2) & 3],4));
+          m[i & 3]=_mm_sha256msg2_epu32(t,m[(i+3) & 3]);
+        }
+      message=_mm_add_epi32(m[i & 3],
+                            _mm_loadu_si128((const __m128i *) &SignatureK[4*i]));
+      cdgh=_mm_sha256rnds2_epu32(cdgh,abef,message);
+      message=_mm_shuffle_epi32(message,0x0e);
+      abef=_mm_sha256rnds2_epu32(abef,cdgh,message);
+    }
+    abef=_mm_add_epi32(abef,abef_save);
+    cdgh=_mm_add_epi32(cdgh,cdgh_save);
+    blocks+=SignatureSize;
+  }
+  t=_mm_shuffle_epi32(abef,0x1b);
+  cdgh=_mm_shuffle_epi32(cdgh,0xb1);
+  abef=_mm_blend_epi16(t,cdgh,0xf0);
+  cdgh=_mm_alignr_epi8(cdgh,t,8);
+  _mm_storeu_si128((__m128i *) &state[0],abef);
+  _mm_storeu_si128((__m128i *) &state[4],cdgh);
+}
+
+static MagickBool
+HaveSHAExtensions(void)
+{
+  unsigned int
+    eax,
+    ebx,
+    ecx,
+    edx;
+
+  if (!__get_cpuid(1,&eax,&ebx,&ecx,&edx) || !(ecx & bit_SSE4_1))
+    return MagickFalse;
+  if (__get_cpuid_max(0,(unsigned int *) NULL) < 7)
+    return MagickFalse;
+  __cpuid_count(7,0,eax,ebx,ecx,edx);
+  return ((ebx & (1U << 29)) != 0);
+}
+#endif /* defined(SIGNATURE_SHA_KERNEL) */
+
+/*
+  Return the block transform to use.  The SHA extensions are used if
+  the CPU supports them unless the MAGICK_SIGNATURE_SIMD environment
+  variable is set to "scalar".  The selection is made once; a thread
+  racing the first selection makes the same selection.
+*/
+static SignatureBlocksFunc
+GetSignatureBlocks(void)
+{
+  static SignatureBlocksFunc
+    signature_blocks = (SignatureBlocksFunc) NULL;
+
+  SignatureBlocksFunc
+    blocks;
+
+  blocks=signature_blocks;
+  if (blocks == (SignatureBlocksFunc) NULL)
+    {
+      const char
+        *limit;
+
+      blocks=SignatureBlocksScalar;
+      limit=getenv("MAGICK_SIGNATURE_SIMD");
+      if (!((limit != (const char *) NULL) &&
+            ((LocaleCompare(limit,"scalar") == 0) ||
+             (LocaleCompare(limit,"none") == 0) ||
+             (LocaleCompare(limit,"false") == 0))))
+        {
+#if defined(SIGNATURE_SHA_KERNEL)
+          if (HaveSHAExtensions())
+            blocks=SignatureBlocksSHA;
+#endif
+        }
+      signature_blocks=blocks;
+    }
+  return blocks;
+}
+
+/*
+  Transform message blocks into the digest of a SignatureInfo.
+*/
+static void
+TransformSignatureBlocks(SignatureInfo *signature_info,
+  const unsigned char *blocks,size_t count)
+{
+  magick_uint32_t
+    state[8];
+
+  register unsigned int
+    i;
+
+  for (i=0; i < 8; i++)
+    state[i]=(magick_uint32_t) signature_info->digest[i];
+  (GetSignatureBlocks())(state,blocks,count);
+  for (i=0; i < 8; i++)
+    signature_info->digest[i]=state[i];
+}
+
+/*
+  Standard SHA-256 message digest.
+*/
+static void
+InitializeSHA256(SHA256Info *sha_info)
+{
+  (void) memcpy(sha_info->state,SignatureH,sizeof(sha_info->state));
+  sha_info->length=0;
+  sha_info->offset=0;
+}
+
+static void
+UpdateSHA256(SHA256Info *sha_info,const unsigned char *message,size_t length)
+{
+  size_t
+    count;
+
+  sha_info->length+=length;
+  if (sha_info->offset != 0)
+    {
+      count=Min(length,SignatureSize-sha_info->offset);
+      (void) memcpy(sha_info->buffer+sha_info->offset,message,count);
+      sha_info->offset+=count;
+      message+=count;
+      length-=count;
+      if (sha_info->offset != SignatureSize)
+        return;
+      (GetSignatureBlocks())(sha_info->state,sha_info->buffer,1);
+      sha_info->offset=0;
+    }
+  count=length/SignatureSize;
+  if (count != 0)
+    {
+      (GetSignatureBlocks())(sha_info->state,message,count);
+      message+=count*SignatureSize;
+      length-=count*SignatureSize;
+    }
+  (void) memcpy(sha_info->buffer,message,length);
+  sha_info->offset=length;
+}
+
+static void
+FinalizeSHA256(SHA256Info *sha_info,unsigned char *digest)
+{
+  magick_uint64_t
+    bits;
+
+  register unsigned int
+    i;
+
+  bits=sha_info->length << 3;
+  sha_info->buffer[sha_info->offset++]=0x80;
+  if (sha_info->offset > (SignatureSize-8))
+    {
+      (void) memset(sha_info->buffer+sha_info->offset,0,
+                    SignatureSize-sha_info->offset);
+      (GetSignatureBlocks())(sha_info->state,sha_info->buffer,1);
+      sha_info->offset=0;
+    }
+  (void) memset(sha_info->buffer+sha_info->offset,0,
+                SignatureSize-8-sha_info->offset);
+  for (i=0; i < 8; i++)
+    sha_info->buffer[SignatureSize-1-i]=(unsigned char) (bits >> (8*i));
+  (GetSignatureBlocks())(sha_info->state,sha_info->buffer,1);
+  for (i=0; i < 8; i++)
+  {
+    digest[4*i]=(unsigned char) (sha_info->state[i] >> 24);
+    digest[4*i+1]=(unsigned char) (sha_info->state[i] >> 16);
+    digest[4*i+2]=(unsigned char) (sha_info->state[i] >> 8);
+    digest[4*i+3]=(unsigned char) sha_info->state[i];
+  }
+}
 
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
@@ -141,6 +519,318 @@ MagickExport void GetSignatureInfo(SignatureInfo *signature_info)
   signature_info->digest[7]=0x5be0cd19UL;
 }
 
+#define SignatureImageText "[%s] Compute SHA-256 signature..."
+
+/*
+  Serialize a row of pixels as the message hashed by SignatureImage().
+  Returns the number of bytes written to message.
+*/
+static size_t
+ExportSignatureRow(const Image *image,const PixelPacket *p,
+  const IndexPacket *indexes,unsigned char *message)
+{
+#define ExportSignatureQuantum(value) \
+  { \
+    quantum=ScaleQuantumToLong(value); \
+    *q++=(unsigned char) (quantum >> 24); \
+    *q++=(unsigned char) (quantum >> 16); \
+    *q++=(unsigned char) (quantum >> 8); \
+    *q++=(unsigned char) quantum; \
+  }
+
+  register long
+    x;
+
+  register unsigned char
+    *q;
+
+  unsigned long
+    quantum;
+
+  q=message;
+  for (x=0; x < (long) image->columns; x++)
+  {
+    ExportSignatureQuantum(p->red);
+    ExportSignatureQuantum(p->green);
+    ExportSignatureQuantum(p->blue);
+    if (!image->matte)
+      {
+        if (image->colorspace == CMYKColorspace)
+          ExportSignatureQuantum(p->opacity);
+        ExportSignatureQuantum(OpaqueOpacity);
+      }
+    else
+      {
+        ExportSignatureQuantum(p->opacity);
+        if (image->colorspace == CMYKColorspace)
+          ExportSignatureQuantum(indexes[x]);
+      }
+    p++;
+  }
+  return (size_t) (q-message);
+}
+
+/*
+  Return the signature method selected by the MAGICK_SIGNATURE_METHOD
+  environment variable.
+*/
+static SignatureMethod
+GetSignatureMethod(void)
+{
+  const char
+    *method;
+
+  method=getenv("MAGICK_SIGNATURE_METHOD");
+  if ((method != (const char *) NULL) && (LocaleCompare(method,"tree") == 0))
+    return TreeSignatureMethod;
+  return LegacySignatureMethod;
+}
+
+/*
+  Compute the legacy image digest.  Rows are serialized concurrently in
+  batches, and then passed to UpdateSignature() one row at a time,
+  exactly as earlier releases did.  As before, the digest covers the rows
+  preceding a row which could not be read.  False is returned only if
+  memory could not be allocated, and *complete is set to MagickFalse if
+  the digest does not cover the entire image.
+*/
+static MagickPassFail
+LegacySignatureImage(Image *image,unsigned char *digest,MagickBool *complete)
+{
+  long
+    y;
+
+  register long
+    i;
+
+  SignatureInfo
+    signature_info;
+
+  size_t
+    lengths[SignatureBatchRows],
+    row_size;
+
+  unsigned char
+    *message;
+
+  row_size=MagickArraySize(SignaturePixelSize,image->columns);
+  message=MagickAllocateArray(unsigned char *,SignatureBatchRows,row_size);
+  if ((row_size == 0) || (message == (unsigned char *) NULL))
+    {
+      MagickFreeMemory(message);
+      ThrowBinaryException3(ResourceLimitError,MemoryAllocationFailed,
+        UnableToComputeImageSignature);
+    }
+  *complete=MagickTrue;
+  GetSignatureInfo(&signature_info);
+  for (y=0; (*complete) && (y < (long) image->rows); y+=SignatureBatchRows)
+  {
+    long
+      rows;
+
+    rows=Min(SignatureBatchRows,(long) image->rows-y);
+#if defined(HAVE_OPENMP)
+#  if defined(TUNE_OPENMP)
+#    pragma omp parallel for schedule(runtime)
+#  else
+#    pragma omp parallel for schedule(static,4)
+#  endif
+#endif
+    for (i=0; i < rows; i++)
+    {
+      const PixelPacket
+        *p;
+
+      lengths[i]=0;
+      p=AcquireImagePixels(image,0,y+i,image->columns,1,&image->exception);
+      if (p != (const PixelPacket *) NULL)
+        lengths[i]=ExportSignatureRow(image,p,AccessImmutableIndexes(image),
+                                      message+i*row_size);
+    }
+    for (i=0; i < rows; i++)
+    {
+      if (lengths[i] == 0)
+        {
+          *complete=MagickFalse;
+          break;
+        }
+      UpdateSignature(&signature_info,message+i*row_size,lengths[i]);
+      if (QuantumTick(y+i,image->rows))
+        if (!MagickMonitorFormatted(y+i,image->rows,&image->exception,
+                                    SignatureImageText,image->filename))
+          {
+            *complete=MagickFalse;
+            break;
+          }
+    }
+  }
+  MagickFreeMemory(message);
+  FinalizeSignature(&signature_info);
+  for (i=0; i < 8; i++)
+  {
+    digest[4*i]=(unsigned char) (signature_info.digest[i] >> 24);
+    digest[4*i+1]=(unsigned char) (signature_info.digest[i] >> 16);
+    digest[4*i+2]=(unsigned char) (signature_info.digest[i] >> 8);
+    digest[4*i+3]=(unsigned char) signature_info.digest[i];
+  }
+  return MagickPass;
+}
+
+/*
+  Compute the tree image digest.  Each band of SignatureLeafRows rows
+  is hashed with SHA-256, concurrently.  The digest is the SHA-256 of a
+  header (the image columns and rows, the band height, and the bytes
+  per pixel, as 32-bit big-endian values) followed by the band digests
+  in order.  The return value and *complete are as for
+  LegacySignatureImage().
+*/
+static MagickPassFail
+TreeSignatureImage(Image *image,unsigned char *digest,MagickBool *complete)
+{
+  long
+    leaf;
+
+  MagickBool
+    memory_failed=MagickFalse,
+    monitor_active;
+
+  MagickPassFail
+    status=MagickPass;
+
+  register unsigned int
+    i;
+
+  SHA256Info
+    sha_info;
+
+  size_t
+    leaves,
+    row_size;
+
+  unsigned char
+    header[16],
+    *leaf_digests;
+
+  unsigned long
+    header_values[4],
+    leaf_count=0;
+
+  row_size=MagickArraySize(SignaturePixelSize,image->columns);
+  leaves=(image->rows+SignatureLeafRows-1)/SignatureLeafRows;
+  leaf_digests=MagickAllocateClearedArray(unsigned char *,leaves,32);
+  if ((row_size == 0) || (leaf_digests == (unsigned char *) NULL))
+    {
+      MagickFreeMemory(leaf_digests);
+      ThrowBinaryException3(ResourceLimitError,MemoryAllocationFailed,
+        UnableToComputeImageSignature);
+    }
+  monitor_active=MagickMonitorActive();
+#if defined(HAVE_OPENMP)
+#  if defined(TUNE_OPENMP)
+#    pragma omp parallel for schedule(runtime) shared(leaf_count, memory_failed, status)
+#  else
+#    pragma omp parallel for schedule(dynamic,1) shared(leaf_count, memory_failed, status)
+#  endif
+#endif
+  for (leaf=0; leaf < (long) leaves; leaf++)
+  {
+    const PixelPacket
+      *p;
+
+    long
+      y;
+
+    MagickPassFail
+      thread_status;
+
+    SHA256Info
+      leaf_info;
+
+    unsigned char
+      *message;
+
+    thread_status=status;
+    if (thread_status == MagickFail)
+      continue;
+    message=MagickAllocateMemory(unsigned char *,row_size);
+    if (message == (unsigned char *) NULL)
+      {
+        memory_failed=MagickTrue;
+        thread_status=MagickFail;
+      }
+    else
+      {
+        InitializeSHA256(&leaf_info);
+        for (y=leaf*SignatureLeafRows;
+             (thread_status != MagickFail) &&
+               (y < Min((leaf+1)*SignatureLeafRows,(long) image->rows));
+             y++)
+        {
+          p=AcquireImagePixels(image,0,y,image->columns,1,&image->exception);
+          if (p == (const PixelPacket *) NULL)
+            thread_status=MagickFail;
+          else
+            UpdateSHA256(&leaf_info,message,
+                         ExportSignatureRow(image,p,
+                                            AccessImmutableIndexes(image),
+                                            message));
+        }
+        MagickFreeMemory(message);
+        FinalizeSHA256(&leaf_info,leaf_digests+32*leaf);
+      }
+    if (monitor_active)
+      {
+        unsigned long
+          thread_leaf_count;
+
+#if defined(HAVE_OPENMP)
+#  pragma omp atomic
+#endif
+        leaf_count++;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (leaf_count)
+#endif
+        thread_leaf_count=leaf_count;
+        if (QuantumTick(thread_leaf_count,leaves))
+          if (!MagickMonitorFormatted(thread_leaf_count,leaves,
+                                      &image->exception,SignatureImageText,
+                                      image->filename))
+            thread_status=MagickFail;
+      }
+    if (thread_status == MagickFail)
+      {
+        status=MagickFail;
+#if defined(HAVE_OPENMP)
+#  pragma omp flush (status)
+#endif
+      }
+  }
+  if (memory_failed)
+    {
+      MagickFreeMemory(leaf_digests);
+      ThrowBinaryException3(ResourceLimitError,MemoryAllocationFailed,
+        UnableToComputeImageSignature);
+    }
+  *complete=(status != MagickFail);
+  header_values[0]=image->columns;
+  header_values[1]=image->rows;
+  header_values[2]=SignatureLeafRows;
+  header_values[3]=(image->colorspace == CMYKColorspace ? 20 : 16);
+  for (i=0; i < 4; i++)
+  {
+    header[4*i]=(unsigned char) (header_values[i] >> 24);
+    header[4*i+1]=(unsigned char) (header_values[i] >> 16);
+    header[4*i+2]=(unsigned char) (header_values[i] >> 8);
+    header[4*i+3]=(unsigned char) header_values[i];
+  }
+  InitializeSHA256(&sha_info);
+  UpdateSHA256(&sha_info,header,sizeof(header));
+  UpdateSHA256(&sha_info,leaf_digests,32*leaves);
+  FinalizeSHA256(&sha_info,digest);
+  MagickFreeMemory(leaf_digests);
+  return MagickPass;
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -157,6 +847,15 @@ MagickExport void GetSignatureInfo(SignatureInfo *signature_info)
 %  signature uniquely identifies the image and is convenient for determining
 %  if an image has been modified or whether two images are identical.
 %
+%  By default the digest is the same as computed by earlier releases.  If
+%  the MAGICK_SIGNATURE_METHOD environment variable is set to "tree", bands
+%  of rows are hashed independently (and concurrently), and the digest is
+%  computed from the band digests.  The two methods produce different
+%  signatures for the same image.
+%
+%  The signature is remembered along with the pixel cache generation, so
+%  that it is not computed again for as long as the pixels are unchanged.
+%
 %  The format of the SignatureImage method is:
 %
 %      unsigned int SignatureImage(Image *image)
@@ -167,124 +866,85 @@ MagickExport void GetSignatureInfo(SignatureInfo *signature_info)
 %
 %
 */
-#define SignatureImageText "[%s] Compute SHA-256 signature..."
 MagickExport unsigned int SignatureImage(Image *image)
 {
   char
     signature[MaxTextExtent];
 
-  const IndexPacket
-    *indexes;
+  const ImageAttribute
+    *attribute;
 
-  long
-    y;
+  magick_uint64_t
+    generation;
 
-  register const PixelPacket
-    *p;
+  MagickBool
+    complete;
 
-  register long
-    x;
+  MagickPassFail
+    status;
 
-  register unsigned char
-    *q;
-
-  SignatureInfo
-    signature_info;
+  SignatureMethod
+    method;
 
   unsigned char
-    *message;
+    digest[32];
 
-  unsigned long
-    quantum;
+  unsigned int
+    state;
 
-  /*
-    Allocate memory for digital signature.
-  */
   assert(image != (Image *) NULL);
   assert(image->signature == MagickSignature);
-  message=MagickAllocateArray(unsigned char *,20,image->columns);
-  if (message == (unsigned char *) NULL)
-    ThrowBinaryException3(ResourceLimitError,MemoryAllocationFailed,
-      UnableToComputeImageSignature);
+  method=GetSignatureMethod();
+  state=((unsigned int) method << 2) | (image->matte ? 1U : 0U) |
+    (image->colorspace == CMYKColorspace ? 2U : 0U);
+  generation=GetPixelCacheGeneration(image);
+  if ((generation != 0) &&
+      (image->extra->signature_generation == generation) &&
+      (image->extra->signature_state == state))
+    {
+      attribute=GetImageAttribute(image,"signature");
+      if ((attribute != (const ImageAttribute *) NULL) &&
+          (strcmp(attribute->value,image->extra->signature) == 0))
+        return(True);
+    }
   /*
     Compute image digital signature.
   */
-  GetSignatureInfo(&signature_info);
-  for (y=0; y < (long) image->rows; y++)
+  if (method == TreeSignatureMethod)
+    status=TreeSignatureImage(image,digest,&complete);
+  else
+    status=LegacySignatureImage(image,digest,&complete);
+  if (status == MagickFail)
+    return(False);
+  /*
+    Convert digital signature to a 64 character hex string.
+  */
   {
-    p=AcquireImagePixels(image,0,y,image->columns,1,&image->exception);
-    if (p == (const PixelPacket *) NULL)
-      break;
-    indexes=AccessImmutableIndexes(image);
-    q=message;
-    for (x=0; x < (long) image->columns; x++)
+    static const char
+      hex[] = "0123456789abcdef";
+
+    register unsigned int
+      i;
+
+    for (i=0; i < 32; i++)
     {
-      quantum=ScaleQuantumToLong(p->red);
-      *q++=(unsigned char) (quantum >> 24);
-      *q++=(unsigned char) (quantum >> 16);
-      *q++=(unsigned char) (quantum >> 8);
-      *q++=(unsigned char) quantum;
-      quantum=ScaleQuantumToLong(p->green);
-      *q++=(unsigned char) (quantum >> 24);
-      *q++=(unsigned char) (quantum >> 16);
-      *q++=(unsigned char) (quantum >> 8);
-      *q++=(unsigned char) quantum;
-      quantum=ScaleQuantumToLong(p->blue);
-      *q++=(unsigned char) (quantum >> 24);
-      *q++=(unsigned char) (quantum >> 16);
-      *q++=(unsigned char) (quantum >> 8);
-      *q++=(unsigned char) quantum;
-      if (!image->matte)
-        {
-          if (image->colorspace == CMYKColorspace)
-            {
-              quantum=ScaleQuantumToLong(p->opacity);
-              *q++=(unsigned char) (quantum >> 24);
-              *q++=(unsigned char) (quantum >> 16);
-              *q++=(unsigned char) (quantum >> 8);
-              *q++=(unsigned char) quantum;
-            }
-          quantum=ScaleQuantumToLong(OpaqueOpacity);
-          *q++=(unsigned char) (quantum >> 24);
-          *q++=(unsigned char) (quantum >> 16);
-          *q++=(unsigned char) (quantum >> 8);
-          *q++=(unsigned char) quantum;
-        }
-      else
-        {
-          quantum=ScaleQuantumToLong(p->opacity);
-          *q++=(unsigned char) (quantum >> 24);
-          *q++=(unsigned char) (quantum >> 16);
-          *q++=(unsigned char) (quantum >> 8);
-          *q++=(unsigned char) quantum;
-          if (image->colorspace == CMYKColorspace)
-            {
-              quantum=ScaleQuantumToLong(indexes[x]);
-              *q++=(unsigned char) (quantum >> 24);
-              *q++=(unsigned char) (quantum >> 16);
-              *q++=(unsigned char) (quantum >> 8);
-              *q++=(unsigned char) quantum;
-            }
-        }
-      p++;
+      signature[2*i]=hex[digest[i] >> 4];
+      signature[2*i+1]=hex[digest[i] & 0x0f];
     }
-    UpdateSignature(&signature_info,message,q-message);
-    if (QuantumTick(y,image->rows))
-      if (!MagickMonitorFormatted(y,image->rows,&image->exception,
-                                  SignatureImageText,image->filename))
-        break;
+    signature[64]='\0';
   }
-  FinalizeSignature(&signature_info);
-  MagickFreeMemory(message);
-  /*
-    Convert digital signature to a 64 character hex string.
-  */
-  FormatString(signature,"%08lx%08lx%08lx%08lx%08lx%08lx%08lx%08lx",
-    signature_info.digest[0],signature_info.digest[1],signature_info.digest[2],
-    signature_info.digest[3],signature_info.digest[4],signature_info.digest[5],
-    signature_info.digest[6],signature_info.digest[7]);
   (void) SetImageAttribute(image,"signature",(char *) NULL);
   (void) SetImageAttribute(image,"signature",signature);
+  if ((complete) && (generation != 0) &&
+      (GetPixelCacheGeneration(image) == generation))
+    {
+      image->extra->signature_generation=generation;
+      image->extra->signature_state=state;
+      (void) strlcpy(image->extra->signature,signature,
+                     sizeof(image->extra->signature));
+    }
+  else
+    image->extra->signature_generation=0;
   return(True);
 }
 
@@ -313,131 +973,7 @@ MagickExport unsigned int SignatureImage(Image *image)
 */
 MagickExport void TransformSignature(SignatureInfo *signature_info)
 {
-#define Ch(x,y,z)  (((x) & (y))^(~(x) & (z)))
-#define Maj(x,y,z)  (((x) & (y))^((x) & (z))^((y) & (z)))
-#define Rot32(x,n)  Trunc32(((x >> n) | (x << (32-n))))
-#define Sigma0(x)  (Rot32(x,7)^Rot32(x,18)^Trunc32(x >> 3))
-#define Sigma1(x)  (Rot32(x,17)^Rot32(x,19)^Trunc32(x >> 10))
-#define Suma0(x)  (Rot32(x,2)^Rot32(x,13)^Rot32(x,22))
-#define Suma1(x)  (Rot32(x,6)^Rot32(x,11)^Rot32(x,25))
-
-  static const unsigned long
-    K[64] =
-    {
-      0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL, 0x3956c25bUL,
-      0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL, 0xd807aa98UL, 0x12835b01UL,
-      0x243185beUL, 0x550c7dc3UL, 0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL,
-      0xc19bf174UL, 0xe49b69c1UL, 0xefbe4786UL, 0x0fc19dc6UL, 0x240ca1ccUL,
-      0x2de92c6fUL, 0x4a7484aaUL, 0x5cb0a9dcUL, 0x76f988daUL, 0x983e5152UL,
-      0xa831c66dUL, 0xb00327c8UL, 0xbf597fc7UL, 0xc6e00bf3UL, 0xd5a79147UL,
-      0x06ca6351UL, 0x14292967UL, 0x27b70a85UL, 0x2e1b2138UL, 0x4d2c6dfcUL,
-      0x53380d13UL, 0x650a7354UL, 0x766a0abbUL, 0x81c2c92eUL, 0x92722c85UL,
-      0xa2bfe8a1UL, 0xa81a664bUL, 0xc24b8b70UL, 0xc76c51a3UL, 0xd192e819UL,
-      0xd6990624UL, 0xf40e3585UL, 0x106aa070UL, 0x19a4c116UL, 0x1e376c08UL,
-      0x2748774cUL, 0x34b0bcb5UL, 0x391c0cb3UL, 0x4ed8aa4aUL, 0x5b9cca4fUL,
-      0x682e6ff3UL, 0x748f82eeUL, 0x78a5636fUL, 0x84c87814UL, 0x8cc70208UL,
-      0x90befffaUL, 0xa4506cebUL, 0xbef9a3f7UL, 0xc67178f2UL
-    };  /* 32-bit fractional part of the cube root of the first 64 primes */
-
-  int
-    j,
-    shift;
-
-  register long
-    i;
-
-  register unsigned char
-    *p;
-
-  unsigned long
-    A,
-    B,
-    C,
-    D,
-    E,
-    F,
-    G,
-    H,
-    lsb_first,
-    T,
-    T1,
-    T2,
-    W[64];
-
-  shift=32;
-  p=signature_info->message;
-  lsb_first=1;
-  if (*(char *) &lsb_first)
-    {
-      if (sizeof(lsb_first) > 4)
-        for (i=0; i < 16; i+=2)
-        {
-          T=(*((unsigned long *) p));
-          p+=8;
-          W[i]=((T << 24) & 0xff000000U) | ((T << 8) & 0x00ff0000U) |
-            ((T >> 8) & 0x0000ff00U) | ((T >> 24) & 0x000000ffU);
-          T>>=shift;
-          W[i+1]=((T << 24) & 0xff000000U) | ((T << 8) & 0x00ff0000U) |
-            ((T >> 8) & 0x0000ff00U) | ((T >> 24) & 0x000000ffU);
-        }
-      else
-        for (i=0; i < 16; i++)
-        {
-          T=(*((unsigned long *) p));
-          p+=4;
-          W[i]=((T << 24) & 0xff000000U) | ((T << 8) & 0x00ff0000U) |
-            ((T >> 8) & 0x0000ff00U) | ((T >> 24) & 0x000000ffU);
-        }
-    }
-  else
-    {
-      if (sizeof(lsb_first) > 4)
-        for (i=0; i < 16; i+=2)
-        {
-          T=(*((unsigned long *) p));
-          p+=8;
-          W[i]=Trunc32(T >> shift);
-          W[i+1]=Trunc32(T);
-        }
-      else
-        for (i=0; i < 16; i++)
-        {
-          T=(*((unsigned long *) p));
-          p+=4;
-          W[i]=Trunc32(T);
-        }
-    }
-  A=signature_info->digest[0];
-  B=signature_info->digest[1];
-  C=signature_info->digest[2];
-  D=signature_info->digest[3];
-  E=signature_info->digest[4];
-  F=signature_info->digest[5];
-  G=signature_info->digest[6];
-  H=signature_info->digest[7];
-  for (i=16; i < 64; i++)
-    W[i]=Trunc32(Sigma1(W[i-2])+W[i-7]+Sigma0(W[i-15])+W[i-16]);
-  for (j=0; j < 64; j++)
-  {
-    T1=Trunc32(H+Suma1(E)+Ch(E,F,G)+K[j]+W[j]);
-    T2=Trunc32(Suma0(A)+Maj(A,B,C));
-    H=G;
-    G=F;
-    F=E;
-    E=Trunc32(D+T1);
-    D=C;
-    C=B;
-    B=A;
-    A=Trunc32(T1+T2);
-  }
-  signature_info->digest[0]=Trunc32(signature_info->digest[0]+A);
-  signature_info->digest[1]=Trunc32(signature_info->digest[1]+B);
-  signature_info->digest[2]=Trunc32(signature_info->digest[2]+C);
-  signature_info->digest[3]=Trunc32(signature_info->digest[3]+D);
-  signature_info->digest[4]=Trunc32(signature_info->digest[4]+E);
-  signature_info->digest[5]=Trunc32(signature_info->digest[5]+F);
-  signature_info->digest[6]=Trunc32(signature_info->digest[6]+G);
-  signature_info->digest[7]=Trunc32(signature_info->digest[7]+H);
+  TransformSignatureBlocks(signature_info,signature_info->message,1);
 }
 
 /*
@@ -502,13 +1038,15 @@ MagickExport void UpdateSignature(SignatureInfo *signature_info,
         return;
       TransformSignature(signature_info);
     }
-  while (n >= SignatureSize)
-  {
-    (void) memcpy(signature_info->message,message,SignatureSize);
-    message+=SignatureSize;
-    n-=SignatureSize;
-    TransformSignature(signature_info);
-  }
+  if (n >= SignatureSize)
+    {
+      /*
+        Transform whole blocks directly from the message.
+      */
+      TransformSignatureBlocks(signature_info,message,n/SignatureSize);
+      message+=n-(n % SignatureSize);
+      n%=SignatureSize;
+    }
   (void) memcpy(signature_info->message,message,n);
   signature_info->offset=(long) n;
 }
@@ -24,6 +24,7 @@
 #define AcquireCacheView GmAcquireCacheView
 #define AcquireCacheViewIndexes GmAcquireCacheViewIndexes
 #define AcquireCacheViewPixels GmAcquireCacheViewPixels
+#define AcquireImageFloatPixels GmAcquireImageFloatPixels
 #define AcquireImagePixels GmAcquireImagePixels
 #define AcquireMagickRandomKernel GmAcquireMagickRandomKernel
 #define AcquireMagickResource GmAcquireMagickResource
@@ -129,6 +130,7 @@
 #define ConvertImageCommand GmConvertImageCommand
 #define ConvolveImage GmConvolveImage
 #define CopyException GmCopyException
+#define CopyStreamCacheHandler GmCopyStreamCacheHandler
 #define CropImage GmCropImage
 #define CycleColormapImage GmCycleColormapImage
 #define DeallocateImageProfileIterator GmDeallocateImageProfileIterator
@@ -140,8 +142,10 @@
 #define DeleteMagickRegistry GmDeleteMagickRegistry
 #define DescribeImage GmDescribeImage
 #define DespeckleImage GmDespeckleImage
+#define DestroyAnnotateInfo GmDestroyAnnotateInfo
 #define DestroyBlob GmDestroyBlob
 #define DestroyBlobInfo GmDestroyBlobInfo
+#define DestroyBlobSpillInfo GmDestroyBlobSpillInfo
 #define DestroyCacheInfo GmDestroyCacheInfo
 #define DestroyColorInfo GmDestroyColorInfo
 #define DestroyConstitute GmDestroyConstitute
@@ -164,6 +168,7 @@
 #define DestroyMagickResources GmDestroyMagickResources
 #define DestroyMontageInfo GmDestroyMontageInfo
 #define DestroyQuantizeInfo GmDestroyQuantizeInfo
+#define DestroyResizeInfo GmDestroyResizeInfo
 #define DestroySemaphore GmDestroySemaphore
 #define DestroySemaphoreInfo GmDestroySemaphoreInfo
 #define DestroyTemporaryFiles GmDestroyTemporaryFiles
@@ -379,6 +384,7 @@
 #define GetImageInfoAttribute GmGetImageInfoAttribute
 #define GetImageListLength GmGetImageListLength
 #define GetImageMagick GmGetImageMagick
+#define GetImagePixelFormat GmGetImagePixelFormat
 #define GetImagePixels GmGetImagePixels
 #define GetImagePixelsEx GmGetImagePixelsEx
 #define GetImageProfile GmGetImageProfile
@@ -412,7 +418,9 @@
 #define GetPageGeometry GmGetPageGeometry
 #define GetPathComponent GmGetPathComponent
 #define GetPixelCacheArea GmGetPixelCacheArea
+#define GetPixelCacheIOStatistics GmGetPixelCacheIOStatistics
 #define GetPixelCacheInCore GmGetPixelCacheInCore
+#define GetPixelCacheIsStream GmGetPixelCacheIsStream
 #define GetPixelCachePresent GmGetPixelCachePresent
 #define GetPixels GmGetPixels
 #define GetPostscriptDelegateInfo GmGetPostscriptDelegateInfo
@@ -457,6 +465,8 @@
 #define ImportImagePixelArea GmImportImagePixelArea
 #define ImportPixelAreaOptionsInit GmImportPixelAreaOptionsInit
 #define ImportViewPixelArea GmImportViewPixelArea
+#define InitializeAnnotateInfo GmInitializeAnnotateInfo
+#define InitializeBlobSpillInfo GmInitializeBlobSpillInfo
 #define InitializeColorInfo GmInitializeColorInfo
 #define InitializeConstitute GmInitializeConstitute
 #define InitializeDelegateInfo GmInitializeDelegateInfo
@@ -475,6 +485,7 @@
 #define InitializeMagickRegistry GmInitializeMagickRegistry
 #define InitializeMagickResources GmInitializeMagickResources
 #define InitializePixelIteratorOptions GmInitializePixelIteratorOptions
+#define InitializeResizeInfo GmInitializeResizeInfo
 #define InitializeSemaphore GmInitializeSemaphore
 #define InitializeTemporaryFiles GmInitializeTemporaryFiles
 #define InitializeTypeInfo GmInitializeTypeInfo
@@ -492,6 +503,7 @@
 #define IsGeometry GmIsGeometry
 #define IsGlob GmIsGlob
 #define IsGrayImage GmIsGrayImage
+#define IsImageStreamable GmIsImageStreamable
 #define IsImagesEqual GmIsImagesEqual
 #define IsMagickConflict GmIsMagickConflict
 #define IsMonochromeImage GmIsMonochromeImage
@@ -508,6 +520,7 @@
 #define LiberateMemory GmLiberateMemory
 #define LiberateSemaphoreInfo GmLiberateSemaphoreInfo
 #define LiberateTemporaryFile GmLiberateTemporaryFile
+#define ListBlobSpillInfo GmListBlobSpillInfo
 #define ListColorInfo GmListColorInfo
 #define ListDelegateInfo GmListDelegateInfo
 #define ListFiles GmListFiles
@@ -760,6 +773,7 @@
 #define RGBTransformImage GmRGBTransformImage
 #define RaiseImage GmRaiseImage
 #define RandomChannelThresholdImage GmRandomChannelThresholdImage
+#define RankFilterImage GmRankFilterImage
 #define ReacquireMemory GmReacquireMemory
 #define ReadBlob GmReadBlob
 #define ReadBlobByte GmReadBlobByte
@@ -788,6 +802,7 @@
 #define ReadImage GmReadImage
 #define ReadInlineImage GmReadInlineImage
 #define ReallocateImageColormap GmReallocateImageColormap
+#define RecordBlobSpill GmRecordBlobSpill
 #define ReduceNoiseImage GmReduceNoiseImage
 #define ReferenceBlob GmReferenceBlob
 #define ReferenceCache GmReferenceCache
@@ -929,6 +944,7 @@
 #define SetImageEx GmSetImageEx
 #define SetImageInfo GmSetImageInfo
 #define SetImageOpacity GmSetImageOpacity
+#define SetImagePixelFormat GmSetImagePixelFormat
 #define SetImagePixels GmSetImagePixels
 #define SetImagePixelsEx GmSetImagePixelsEx
 #define SetImageProfile GmSetImageProfile
@@ -946,6 +962,7 @@
 #define SetMagickRegistry GmSetMagickRegistry
 #define SetMagickResourceLimit GmSetMagickResourceLimit
 #define SetMonitorHandler GmSetMonitorHandler
+#define SetStreamCacheHandler GmSetStreamCacheHandler
 #define SetWarningHandler GmSetWarningHandler
 #define ShadeImage GmShadeImage
 #define SharpenImage GmSharpenImage
@@ -963,6 +980,8 @@
 #define StereoImage GmStereoImage
 #define StopTimer GmStopTimer
 #define StorageTypeToString GmStorageTypeToString
+#define StoreImageFloatPixels GmStoreImageFloatPixels
+#define StreamImage GmStreamImage
 #define StretchTypeToString GmStretchTypeToString
 #define StringToArgv GmStringToArgv
 #define StringToChannelType GmStringToChannelType
@@ -0,0 +1,208 @@
+/*
+  Copyright (C) 2026 GraphicsMagick Group
+
+  This program is covered by multiple licenses, which are described in
+  Copyright.txt. You should have received a copy of Copyright.txt with this
+  package; otherwise see http://www.graphicsmagick.org/www/Copyright.html.
+
+  Test RankFilterImage() by comparing the minimum, median, and maximum
+  filters with a brute force selection from each neighborhood.  A NaN
+  percentile must select the minimum.
+
+  Usage: rankfilter [-radius radius] infile
+*/
+
+#include <magick/api.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int CompareQuantum(const void *x,const void *y)
+{
+  const Quantum
+    *a = (const Quantum *) x,
+    *b = (const Quantum *) y;
+
+  return (*a < *b) ? -1 : (*a > *b) ? 1 : 0;
+}
+
+/*
+  Select the value of rank from the neighborhood of each channel of the
+  pixel at x,y and compare with the filtered pixel.
+*/
+static int CheckRankPixel(const Image *image,const Image *filtered,
+                          const long x,const long y,const long width,
+                          const unsigned long rank,Quantum *values,
+                          ExceptionInfo *exception)
+{
+  const PixelPacket
+    *neighbors,
+    *pixel;
+
+  unsigned int
+    channel,
+    channels;
+
+  long
+    count,
+    i;
+
+  neighbors=AcquireImagePixels(image,x-width/2,y-width/2,width,width,
+                               exception);
+  pixel=AcquireImagePixels(filtered,x,y,1,1,exception);
+  if ((neighbors == (const PixelPacket *) NULL) ||
+      (pixel == (const PixelPacket *) NULL))
+    return 1;
+  count=width*width;
+  channels=(image->matte ? 4 : 3);
+  for (channel=0; channel < channels; channel++)
+    {
+      Quantum
+        actual = 0;
+
+      for (i=0; i < count; i++)
+        values[i]=(channel == 0 ? neighbors[i].red :
+                   channel == 1 ? neighbors[i].green :
+                   channel == 2 ? neighbors[i].blue :
+                   neighbors[i].opacity);
+      qsort(values,count,sizeof(Quantum),CompareQuantum);
+      actual=(channel == 0 ? pixel->red :
+              channel == 1 ? pixel->green :
+              channel == 2 ? pixel->blue :
+              pixel->opacity);
+      if (actual != values[rank])
+        {
+          (void) printf("Pixel %ld,%ld channel %u: expected %u, got %u\n",
+                        x,y,channel,(unsigned int) values[rank],
+                        (unsigned int) actual);
+          return 1;
+        }
+    }
+  return 0;
+}
+
+int main(int argc,char **argv)
+{
+  char
+    infile[MaxTextExtent];
+
+  double
+    percentiles[4],
+    radius = 1.0,
+    zero = 0.0;
+
+  ExceptionInfo
+    exception;
+
+  Image
+    *filtered = (Image *) NULL,
+    *image = (Image *) NULL;
+
+  ImageInfo
+    *image_info;
+
+  int
+    arg,
+    exit_status = 0;
+
+  long
+    width,
+    x,
+    y;
+
+  Quantum
+    *values = (Quantum *) NULL;
+
+  unsigned int
+    i;
+
+  unsigned long
+    count,
+    ranks[4];
+
+  InitializeMagick(*argv);
+  image_info=CloneImageInfo(0);
+  GetExceptionInfo(&exception);
+  *infile='\0';
+  for (arg=1; arg < argc; arg++)
+    {
+      char
+        *option = argv[arg];
+
+      if (LocaleCompare("-radius",option) == 0)
+        {
+          arg++;
+          if ((arg == argc) || (sscanf(argv[arg],"%lf",&radius) != 1))
+            {
+              (void) printf("-radius argument missing or not a number\n");
+              exit_status=1;
+              goto program_exit;
+            }
+        }
+      else
+        {
+          (void) strncpy(infile,option,MaxTextExtent-1);
+          infile[MaxTextExtent-1]='\0';
+        }
+    }
+  if (*infile == '\0')
+    {
+      (void) printf("Usage: %s [-radius radius] infile\n",argv[0]);
+      exit_status=1;
+      goto program_exit;
+    }
+
+  (void) strncpy(image_info->filename,infile,MaxTextExtent);
+  image=ReadImage(image_info,&exception);
+  if (image == (Image *) NULL)
+    {
+      CatchException(&exception);
+      exit_status=1;
+      goto program_exit;
+    }
+
+  width=(long) GetOptimalKernelWidth2D(radius,0.5);
+  count=(unsigned long) width*width;
+  values=(Quantum *) malloc(count*sizeof(Quantum));
+  if (values == (Quantum *) NULL)
+    {
+      (void) printf("Failed to allocate memory\n");
+      exit_status=1;
+      goto program_exit;
+    }
+  percentiles[0]=0.0;
+  ranks[0]=0;
+  percentiles[1]=50.0;
+  ranks[1]=(count-1)/2;
+  percentiles[2]=100.0;
+  ranks[2]=count-1;
+  percentiles[3]=zero/zero;
+  ranks[3]=0;
+  for (i=0; (exit_status == 0) && (i < 4); i++)
+    {
+      (void) printf("Radius %g, percentile %g\n",radius,percentiles[i]);
+      filtered=RankFilterImage(image,radius,percentiles[i],&exception);
+      if (filtered == (Image *) NULL)
+        {
+          CatchException(&exception);
+          exit_status=1;
+          break;
+        }
+      for (y=0; (exit_status == 0) && (y < (long) image->rows); y++)
+        for (x=0; (exit_status == 0) && (x < (long) image->columns); x++)
+          exit_status=CheckRankPixel(image,filtered,x,y,width,ranks[i],
+                                     values,&exception);
+      DestroyImage(filtered);
+      filtered=(Image *) NULL;
+    }
+
+ program_exit:
+  free(values);
+  if (image != (Image *) NULL)
+    DestroyImage(image);
+  DestroyImageInfo(image_info);
+  DestroyExceptionInfo(&exception);
+  DestroyMagick();
+  return exit_status;
+}
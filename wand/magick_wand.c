@@ -9840,6 +9840,62 @@ WandExport unsigned int MagickSetSamplingFactors(MagickWand *wand,
   return(True);
 }
 
+/*
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%   M a g i c k S e t S h r i n k O n L o a d                                 %
+%                                                                             %
+%                                                                             %
+%                                                                             %
+%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+%
+%  MagickSetShrinkOnLoad() tells image decoders which support it (currently
+%  JPEG) the size that the image is going to be resized to after it has been
+%  read.  The decoder may then return a smaller image (but at least twice the
+%  requested size) without ever decoding the full resolution image, which
+%  is much faster and uses much less memory.  Set it before reading the
+%  image.  Passing zero for one of the dimensions constrains only the
+%  other dimension, and passing zero for both disables shrink-on-load.
+%
+%  The format of the MagickSetShrinkOnLoad method is:
+%
+%      unsigned int MagickSetShrinkOnLoad(MagickWand *wand,
+%        const unsigned long columns,const unsigned long rows)
+%
+%  A description of each parameter follows:
+%
+%    o wand: The magick wand.
+%
+%    o columns: The width in pixels the image will be resized to.
+%
+%    o rows: The height in pixels the image will be resized to.
+%
+%
+*/
+WandExport unsigned int MagickSetShrinkOnLoad(MagickWand *wand,
+  const unsigned long columns,const unsigned long rows)
+{
+  char
+    geometry[MaxTextExtent];
+
+  assert(wand != (MagickWand *) NULL);
+  assert(wand->signature == MagickSignature);
+  if ((columns == 0) && (rows == 0))
+    {
+      (void) RemoveDefinitions(wand->image_info,"jpeg:shrink-on-load");
+      return(True);
+    }
+  if (rows == 0)
+    (void) MagickFormatString(geometry,MaxTextExtent,"%lu",columns);
+  else if (columns == 0)
+    (void) MagickFormatString(geometry,MaxTextExtent,"x%lu",rows);
+  else
+    (void) MagickFormatString(geometry,MaxTextExtent,"%lux%lu",columns,rows);
+  return(MagickSetImageOption(wand,"jpeg","shrink-on-load",geometry));
+}
+
 /*
 %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 %                                                                             %
@@ -324,6 +324,7 @@ extern WandExport unsigned int
   MagickSetResolutionUnits(MagickWand *wand,const ResolutionType units),
   MagickSetResourceLimit(const ResourceType type,const unsigned long limit),
   MagickSetSamplingFactors(MagickWand *,const unsigned long,const double *),
+  MagickSetShrinkOnLoad(MagickWand *,const unsigned long,const unsigned long),
   MagickSetSize(MagickWand *,const unsigned long,const unsigned long),
   MagickSetImageWhitePoint(MagickWand *,const double,const double),
   MagickSetInterlaceScheme(MagickWand *,const InterlaceType),
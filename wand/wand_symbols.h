@@ -348,6 +348,7 @@
 #define MagickSetResolutionUnits GmMagickSetResolutionUnits
 #define MagickSetResourceLimit GmMagickSetResourceLimit
 #define MagickSetSamplingFactors GmMagickSetSamplingFactors
+#define MagickSetShrinkOnLoad GmMagickSetShrinkOnLoad
 #define MagickSetSize GmMagickSetSize
 #define MagickSharpenImage GmMagickSharpenImage
 #define MagickShaveImage GmMagickShaveImage